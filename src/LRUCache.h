@@ -7,187 +7,334 @@
 
 #ifndef LRUCACHE_H_
 #define LRUCACHE_H_
-#include <list>
-#include <map>
-#include <iostream>
-#include <iterator>
+#include <algorithm>
+#include <cstddef>
 #include <functional>
+#include <list>
+#include <stdexcept>
+#include <utility>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_set.hpp>
+
+/**
+ * Counts of how an LRUCache has been used, for sizing it.
+ */
+struct LRUCacheStats {
+    LRUCacheStats() : hits(0), misses(0), evictions(0) {}
+
+    unsigned long hits;         // lookups that found their key
+    unsigned long misses;       // lookups that didn't
+    unsigned long evictions;    // entries dropped to stay under capacity
 
-template<typename K, typename V, typename C>
-class LRUCache; // forward declaration
-template<typename K, typename V, typename C, typename A>
-class LRUCacheIterator; // forward declaration
+    /**
+     * @return hits / (hits + misses), or 0 if nothing has been looked up
+     */
+    double hitRate() const {
+        if (hits + misses == 0) return 0.0;
+        return (double)hits / (double)(hits + misses);
+    }
+};
+
+/**
+ * The default cost of an LRUCache entry for its byte capacity: the size of
+ * its key and value objects.  Types that own memory outside the object
+ * (strings, containers) need their own functor to be counted properly.
+ */
+template <typename K, typename V>
+struct LRUCacheEntrySize {
+    std::size_t operator()(const K& /* key */, const V& /* value */) const {return sizeof(K) + sizeof(V);}
+};
 
-template<typename K, typename V, typename C = std::less<K> >
+/**
+ * A map that holds a limited number of entries, evicting the least
+ * recently used one to make room for a new one.
+ *
+ * Entries are kept in a list in order of use, most recent first, and
+ * indexed by a hash table of list positions, so lookups, inserts and
+ * evictions are all O(1) and each key is stored once.  Using an entry
+ * moves it to the front of the list with splice(), which copies nothing.
+ *
+ * The capacity is a number of entries, and optionally also a number of
+ * bytes as measured by S (see setByteCapacity()).  A capacity of 0 entries
+ * turns the cache off.
+ *
+ * find() and get() count hits and misses; count() and peek() don't, and
+ * don't change the order of use.
+ */
+template<typename K, typename V, typename H = boost::hash<K>, typename P = std::equal_to<K>,
+        typename S = LRUCacheEntrySize<K, V> >
 class LRUCache {
-private:
-    typedef std::pair< K,V > ValuePair;
-    typedef std::list< ValuePair > ValueList;
-    typedef std::map< K, typename ValueList::iterator, C > ValueMap;
 public:
     typedef K key_type;
     typedef V mapped_type;
-    typedef std::pair<K, V> value_type;
-    typedef C key_compare;
-
-    class value_compare : public std::binary_function<value_type, value_type, bool> {
-        friend class LRUCache<K, V, C>;
-    protected:
-        C comp_;
-        value_compare(C comp__) : comp_(comp__) {}
-    public:
-        bool operator()(const value_type& x, const value_type& y) {
-            return comp_(x.first, y.first);
-        }
-    };
-
-    typedef LRUCacheIterator<K, ValuePair, C, typename ValueMap::allocator_type> iterator;
+    typedef std::pair<const K, V> value_type;
+    typedef H hasher;
+    typedef P key_equal;
 
-    LRUCache(unsigned int maxCapacity=1024);
+    explicit LRUCache(unsigned int maxCapacity=1024, std::size_t maxBytes=0,
+            const H& hash=H(), const P& equal=P(), const S& sizeOf=S());
+    LRUCache(const LRUCache& c);
+    LRUCache& operator=(LRUCache c);
+    void swap(LRUCache& b);
 
-    void insert(K key, V value);
+    /**
+     * Add an entry, replacing any entry with the same key, and make it the
+     * most recently used.  Entries bigger than the byte capacity are not
+     * added.
+     */
+    void insert(const K& key, const V& value);
     void insert(const std::pair<K, V>& pair);
-    int count(K key) const {return map_.count(key);}
-    int size() const {return vals_.size();}
-    V get(K key);
+
+    /**
+     * Look up a key, making its entry the most recently used.
+     *
+     * @return a pointer to the key's value, valid until the entry is
+     *   evicted or replaced, or null on a miss
+     */
+    V* find(const K& key);
+
+    /**
+     * Look up an entry with a key of another type, without building a K.
+     * hash(key) must equal H()(k) for any k with equal(key, k) true.
+     */
+    template <typename CK, typename CH, typename CP>
+    V* find(const CK& key, const CH& hash, const CP& equal);
+
+    /**
+     * Look up a key, making its entry the most recently used.
+     *
+     * @return a copy of the key's value
+     * @throws std::out_of_range on a miss
+     */
+    V get(const K& key);
+
+    /**
+     * Look up a key without counting it or changing the order of use.
+     *
+     * @return a pointer to the key's value, or null if it isn't cached
+     */
+    const V* peek(const K& key) const;
+
+    int count(const K& key) const;
+    bool erase(const K& key);
+    std::size_t size() const {return entries_.size();}
+    bool empty() const {return entries_.empty();}
     void clear();
+
     unsigned int capacity() const {return maxCapacity_;}
     void setCapacity(unsigned int maxCapacity);
+
+    /**
+     * @return the byte capacity, or 0 if there isn't one
+     */
+    std::size_t byteCapacity() const {return maxBytes_;}
+    void setByteCapacity(std::size_t maxBytes);
+
+    /**
+     * @return the total size, as measured by S, of the cached entries
+     */
+    std::size_t bytes() const {return bytes_;}
+
+    const LRUCacheStats& stats() const {return stats_;}
+    void resetStats() {stats_ = LRUCacheStats();}
+
 private:
-    ValueList vals_;
-    ValueMap map_;
+    struct Entry {
+        Entry(const K& k, const V& v, std::size_t h, std::size_t b) : value(k, v), hash(h), bytes(b) {}
+
+        value_type value;
+        std::size_t hash;
+        std::size_t bytes;
+    };
+    typedef std::list<Entry> EntryList;
+    typedef typename EntryList::iterator EntryIt;
+
+    struct IndexHash {
+        std::size_t operator()(const EntryIt& it) const {return it->hash;}
+    };
+
+    struct IndexEqual {
+        IndexEqual(const P& equal) : equal_(equal) {}
+        bool operator()(const EntryIt& a, const EntryIt& b) const {
+            return a->hash == b->hash && equal_(a->value.first, b->value.first);
+        }
+        P equal_;
+    };
+
+    // adapt a key (of any type) and its hash/equality for looking up in
+    // index_
+    template <typename CK, typename CP>
+    struct KeyEqual {
+        KeyEqual(const CP& equal) : equal_(equal) {}
+        bool operator()(const CK& key, const EntryIt& it) const {return equal_(key, it->value.first);}
+        bool operator()(const EntryIt& it, const CK& key) const {return equal_(key, it->value.first);}
+        const CP& equal_;
+    };
+
+    typedef boost::unordered_set<EntryIt, IndexHash, IndexEqual> Index;
+
+    V* promote(typename Index::iterator found);
+    void evict();
+    void rebuildIndex();
+
+    EntryList entries_;
+    Index index_;
     unsigned int maxCapacity_;
+    std::size_t maxBytes_;
+    std::size_t bytes_;
+    H hash_;
+    P equal_;
+    S sizeOf_;
+    LRUCacheStats stats_;
 };
 
-template<typename K, typename V, typename C>
-LRUCache<K,V,C>::LRUCache(unsigned int maxCapacity)
-    : vals_(), map_(), maxCapacity_(maxCapacity){
+template<typename K, typename V, typename H, typename P, typename S>
+LRUCache<K,V,H,P,S>::LRUCache(unsigned int maxCapacity, std::size_t maxBytes,
+        const H& hash, const P& equal, const S& sizeOf)
+    : entries_(), index_(0, IndexHash(), IndexEqual(equal)), maxCapacity_(maxCapacity),
+      maxBytes_(maxBytes), bytes_(0), hash_(hash), equal_(equal), sizeOf_(sizeOf), stats_() {}
 
+// the index holds iterators into the list, so a copy has to build its own
+template<typename K, typename V, typename H, typename P, typename S>
+LRUCache<K,V,H,P,S>::LRUCache(const LRUCache& c)
+    : entries_(c.entries_), index_(0, IndexHash(), IndexEqual(c.equal_)), maxCapacity_(c.maxCapacity_),
+      maxBytes_(c.maxBytes_), bytes_(c.bytes_), hash_(c.hash_), equal_(c.equal_), sizeOf_(c.sizeOf_),
+      stats_(c.stats_) {
+    rebuildIndex();
 }
 
-template<typename K, typename V, typename C>
-void LRUCache<K,V,C>::insert(K key, V value) {
-    insert(ValuePair(key, value));
+template<typename K, typename V, typename H, typename P, typename S>
+LRUCache<K,V,H,P,S>& LRUCache<K,V,H,P,S>::operator=(LRUCache c) {
+    swap(c);
+    return *this;
 }
 
-template<typename K, typename V, typename C>
-void LRUCache<K,V,C>::insert(const std::pair<K, V>& pair) {
+// iterators stay valid when lists are swapped, so the indexes can be
+// swapped along with them
+template<typename K, typename V, typename H, typename P, typename S>
+void LRUCache<K,V,H,P,S>::swap(LRUCache& b) {
+    using std::swap;
+    entries_.swap(b.entries_);
+    index_.swap(b.index_);
+    swap(maxCapacity_, b.maxCapacity_);
+    swap(maxBytes_, b.maxBytes_);
+    swap(bytes_, b.bytes_);
+    swap(hash_, b.hash_);
+    swap(equal_, b.equal_);
+    swap(sizeOf_, b.sizeOf_);
+    swap(stats_, b.stats_);
+}
+
+template<typename K, typename V, typename H, typename P, typename S>
+void LRUCache<K,V,H,P,S>::insert(const K& key, const V& value) {
     if (maxCapacity_ == 0) return;
-    // check to see if we have something already, if so overwrite
-    K key = pair.first;
-    if (map_.count(key) == 1) {
-        typename ValueMap::iterator oldPairIt = map_.find(key);
-        typename ValueList::iterator oldVal = oldPairIt->second;
-        vals_.erase(oldVal);
-        map_.erase(oldPairIt);
-    }
-    // if we are at capacity, remove the last item (least recently used)
-    if (vals_.size() >= maxCapacity_) {
-        ValuePair lruItem = vals_.back();
-        vals_.pop_back();
-        map_.erase(lruItem.first);
-    }
-    // add the item
-    vals_.push_front(pair);
-    typename ValueList::iterator valIt = vals_.begin();
-    map_.insert(std::pair<K, typename ValueList::iterator>(key, valIt));
-}
-
-template<typename K, typename V, typename C>
-V LRUCache<K,V,C>::get(K key) {
-    typename ValueMap::iterator oldMapIt = map_.find(key);
-    typename ValueList::iterator oldValIt = oldMapIt->second;
-    ValuePair valPair = *oldValIt;
-    if (oldValIt == vals_.begin()) {
-        return valPair.second;
-    }
-    // do some rearranging
-    vals_.erase(oldValIt);
-    map_.erase(oldMapIt);
+    erase(key);
+    std::size_t entryBytes = sizeOf_(key, value);
+    if (maxBytes_ != 0 && entryBytes > maxBytes_) return;
 
-    vals_.push_front(valPair);
-    typename ValueList::iterator valIt = vals_.begin();
-    map_.insert(std::pair<K, typename ValueList::iterator>(key, valIt));
-    return valPair.second;
+    entries_.push_front(Entry(key, value, hash_(key), entryBytes));
+    index_.insert(entries_.begin());
+    bytes_ += entryBytes;
+    evict();
 }
 
-template<typename K, typename V, typename C>
-void LRUCache<K,V,C>::clear() {
-    map_.clear();
-    vals_.clear();
+template<typename K, typename V, typename H, typename P, typename S>
+void LRUCache<K,V,H,P,S>::insert(const std::pair<K, V>& pair) {
+    insert(pair.first, pair.second);
 }
 
-template<typename K, typename V, typename C>
-void LRUCache<K,V,C>::setCapacity(unsigned int maxCapacity) {
-    if (maxCapacity >= maxCapacity_) {
-        // no changes needed, great
-        maxCapacity_ = maxCapacity;
-        return;
-    }
-    maxCapacity_ = maxCapacity;
-    // throw away least recently used items until we are under capacity
-    while (vals_.size() > maxCapacity_) {
-        K key = vals_.back().first;
-        vals_.pop_back();
-        map_.erase(key);
+template<typename K, typename V, typename H, typename P, typename S>
+V* LRUCache<K,V,H,P,S>::find(const K& key) {
+    return find(key, hash_, equal_);
+}
+
+template<typename K, typename V, typename H, typename P, typename S>
+template <typename CK, typename CH, typename CP>
+V* LRUCache<K,V,H,P,S>::find(const CK& key, const CH& hash, const CP& equal) {
+    typename Index::iterator found = index_.find(key, hash, KeyEqual<CK, CP>(equal));
+    if (found == index_.end()) {
+        stats_.misses++;
+        return 0;
     }
+    stats_.hits++;
+    return promote(found);
+}
 
+template<typename K, typename V, typename H, typename P, typename S>
+V LRUCache<K,V,H,P,S>::get(const K& key) {
+    V* value = find(key);
+    if (value == 0) throw std::out_of_range("LRUCache::get(): key is not in the cache");
+    return *value;
 }
 
-namespace {
-template <class K, class V, class C, class A>
-class LRUCacheIterator : std::iterator<std::bidirectional_iterator_tag, V> {
-public:
-    LRUCacheIterator() : it_() {}
-    LRUCacheIterator(const LRUCacheIterator& i) : it_(i.it_) {}
+template<typename K, typename V, typename H, typename P, typename S>
+const V* LRUCache<K,V,H,P,S>::peek(const K& key) const {
+    typename Index::const_iterator found = index_.find(key, hash_, KeyEqual<K, P>(equal_));
+    if (found == index_.end()) return 0;
+    return &(*found)->value.second;
+}
 
-    LRUCacheIterator& operator=(const LRUCacheIterator& i) {
-        if (this != &i) {
-            it_ = i.it_;
-        }
-        return *this;
-    }
+template<typename K, typename V, typename H, typename P, typename S>
+int LRUCache<K,V,H,P,S>::count(const K& key) const {
+    return (peek(key) == 0 ? 0 : 1);
+}
 
-    V& operator*() {
-        return *(it_->second);
-    }
+template<typename K, typename V, typename H, typename P, typename S>
+bool LRUCache<K,V,H,P,S>::erase(const K& key) {
+    typename Index::iterator found = index_.find(key, hash_, KeyEqual<K, P>(equal_));
+    if (found == index_.end()) return false;
+    EntryIt entry = *found;
+    index_.erase(found);
+    bytes_ -= entry->bytes;
+    entries_.erase(entry);
+    return true;
+}
 
-    V* operator->() {
-        return &(operator*());
-    }
+template<typename K, typename V, typename H, typename P, typename S>
+void LRUCache<K,V,H,P,S>::clear() {
+    index_.clear();
+    entries_.clear();
+    bytes_ = 0;
+}
 
-    LRUCacheIterator& operator++() {
-        it_++;
-        return *this;
-    }
+template<typename K, typename V, typename H, typename P, typename S>
+void LRUCache<K,V,H,P,S>::setCapacity(unsigned int maxCapacity) {
+    maxCapacity_ = maxCapacity;
+    evict();
+}
 
-    LRUCacheIterator operator++(int) {
-        LRUCacheIterator itold(*this);
-        it_++;
-        return itold;
-    }
+template<typename K, typename V, typename H, typename P, typename S>
+void LRUCache<K,V,H,P,S>::setByteCapacity(std::size_t maxBytes) {
+    maxBytes_ = maxBytes;
+    evict();
+}
 
-    LRUCacheIterator& operator--() {
-        it_--;
-        return *this;
-    }
+template<typename K, typename V, typename H, typename P, typename S>
+V* LRUCache<K,V,H,P,S>::promote(typename Index::iterator found) {
+    EntryIt entry = *found;
+    if (entry != entries_.begin()) entries_.splice(entries_.begin(), entries_, entry);
+    return &entry->value.second;
+}
 
-    LRUCacheIterator operator--(int) {
-        LRUCacheIterator itold(*this);
-        it_--;
-        return itold;
+// throw away least recently used items until we are under capacity
+template<typename K, typename V, typename H, typename P, typename S>
+void LRUCache<K,V,H,P,S>::evict() {
+    while (!entries_.empty()
+            && (entries_.size() > maxCapacity_ || (maxBytes_ != 0 && bytes_ > maxBytes_))) {
+        EntryIt last = --entries_.end();
+        index_.erase(last);
+        bytes_ -= last->bytes;
+        entries_.erase(last);
+        stats_.evictions++;
     }
+}
 
-    bool operator==(const LRUCacheIterator& i) const{
-        return (it_ == i.it_);
+template<typename K, typename V, typename H, typename P, typename S>
+void LRUCache<K,V,H,P,S>::rebuildIndex() {
+    index_.clear();
+    for (EntryIt it = entries_.begin(); it != entries_.end(); it++) {
+        index_.insert(it);
     }
-    bool operator!=(const LRUCacheIterator& i) const {return !operator==(i);}
-protected:
-    typedef typename std::map<K, typename std::list<V>::iterator, C, A >::iterator cache_it;
-    LRUCacheIterator(const cache_it& it) : it_(it) {}
-private:
-    cache_it it_;
-};
 }
 
 #endif /* LRUCACHE_H_ */
@@ -12,6 +12,7 @@
 namespace po = boost::program_options;
 #include <boost/foreach.hpp>
 #include <boost/random/mersenne_twister.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <iostream>
 #include <cstdio>
 #include <string>
@@ -19,11 +20,13 @@ namespace po = boost::program_options;
 #include <utility>
 #include <ctime>
 #include <map>
+#include <sstream>
 #include <cstdlib>
 #include "PEL.h"
 #include "logic/ELSyntax.h"
 #include "logic/FOLParser.h"
 #include "logic/Domain.h"
+#include "logic/DomainCache.h"
 #include "Log.h"
 #include "logic/Moves.h"
 #include "inference/MaxWalkSat.h"
@@ -68,12 +71,41 @@ int main(int argc, char* argv[]) {
         }
     }
     try {
-        Domain d = FOLParse::loadDomainFromFiles(vm["facts-file"].as<std::string>(), vm["formula-file"].as<std::string>());
-        if (vm.count("max") || vm.count("min")) {
-            Interval maxInt = d.maxInterval();
-            if (vm.count("max")) maxInt.setFinish(vm["max"].as<unsigned int>());
-            if (vm.count("min")) maxInt.setStart(vm["min"].as<unsigned int>());
-            d.setMaxInterval(maxInt);
+        ParseOptions parseOptions;
+        parseOptions.setNumThreads(vm["threads"].as<unsigned int>());
+        bool unitProp = vm.count("unitProp") && !vm.count("evalModel");
+
+        // everything that goes into the domain before inference, for the cache
+        std::vector<std::string> inputFiles;
+        inputFiles.push_back(vm["facts-file"].as<std::string>());
+        inputFiles.push_back(vm["formula-file"].as<std::string>());
+        std::stringstream cacheOptions;
+        cacheOptions << "closedWorld=" << parseOptions.assumeClosedWorldInFacts();
+        if (vm.count("max")) cacheOptions << ", max=" << vm["max"].as<unsigned int>();
+        if (vm.count("min")) cacheOptions << ", min=" << vm["min"].as<unsigned int>();
+        cacheOptions << ", unitProp=" << unitProp;
+
+        Domain d;
+        std::string cacheKey;
+        bool cached = false;
+        if (vm.count("cache")) {
+            cacheKey = DomainCache::makeKey(inputFiles, cacheOptions.str());
+            cached = DomainCache(vm["cache"].as<std::string>()).load(cacheKey, d);
+            if (cached) LOG_PRINT(LOG_INFO) << "using cached domain " << cacheKey;
+        }
+        if (!cached) {
+            d = FOLParse::loadDomainFromFiles(inputFiles[0], inputFiles[1], parseOptions);
+            if (vm.count("max") || vm.count("min")) {
+                Interval maxInt = d.maxInterval();
+                if (vm.count("max")) maxInt.setFinish(vm["max"].as<unsigned int>());
+                if (vm.count("min")) maxInt.setStart(vm["min"].as<unsigned int>());
+                d.setMaxInterval(maxInt);
+            }
+            if (unitProp) {
+                LOG_PRINT(LOG_INFO) << "running unit propagation...";
+                d = performUnitPropagation(d);
+            }
+            if (vm.count("cache")) DomainCache(vm["cache"].as<std::string>()).store(cacheKey, d);
         }
 
         Model model = d.defaultModel();
@@ -97,12 +129,14 @@ int main(int argc, char* argv[]) {
             }
             LOG_PRINT(LOG_INFO) << "total score of model: " << sum;
         } else {
-            if (vm.count("unitProp")) {
-                LOG_PRINT(LOG_INFO) << "running unit propagation...";
-                d = performUnitPropagation(d);
-            }
             double p = vm["prob"].as<double>();
             unsigned int iterations = vm["iterations"].as<unsigned int>();
+            unsigned int restarts = vm["restarts"].as<unsigned int>();
+            unsigned int threads = vm["threads"].as<unsigned int>();
+            if (restarts == 0 || threads == 0) {
+                std::cerr << "restarts and threads must both be at least 1" << std::endl;
+                return EXIT_FAILURE;
+            }
 
             // rewrite all our infinite weighted sentences
             LOG(LOG_INFO) << "rewriting infinite weights as pseudo-weights using factor of " << Domain::hardFormulaFactor;
@@ -120,7 +154,16 @@ int main(int argc, char* argv[]) {
             }
             */
             MWSSolver mwsSolver(iterations, p, &d);
-            Model maxModel = mwsSolver.run(rng, defModel);
+            mwsSolver.setNumThreads(threads);
+            // the first search starts from the default model, the rest from random ones
+            std::vector<Model> initialModels(1, defModel);
+            while (initialModels.size() < restarts) initialModels.push_back(d.randomModel(rng));
+
+            LOG(LOG_INFO) << "running " << restarts << " search(es) on " << threads << " thread(s)";
+            boost::posix_time::ptime searchStart = boost::posix_time::microsec_clock::universal_time();
+            Model maxModel = mwsSolver.runBest(rng, initialModels);
+            boost::posix_time::time_duration searchTime = boost::posix_time::microsec_clock::universal_time() - searchStart;
+            LOG_PRINT(LOG_INFO) << "search took " << searchTime.total_milliseconds() / 1000.0 << "s";
 
             LOG_PRINT(LOG_INFO) << "Best model found: " << std::endl;
             LOG_PRINT(LOG_INFO) << maxModel;
@@ -141,6 +184,7 @@ int main(int argc, char* argv[]) {
                 fprintf(outputFile, "# run with %d iterations and %g chance of choosing a random move\n",
                          iterations,
                         p);
+                fprintf(outputFile, "# best of %d restart(s)\n", restarts);
                 std::stringstream stream;
                 stream << maxModel;
                 fputs(stream.str().c_str(), outputFile);
@@ -169,7 +213,10 @@ void initConfig(int argc,
         ("prob,p", po::value<double>()->default_value(0.25), "probability of taking a random move")
         ("iterations,i", po::value<unsigned int>()->default_value(1000), "number of iterations before returning a model")
         ("output,o", po::value<std::string>(), "output model file")
+        ("restarts,r", po::value<unsigned int>()->default_value(1), "number of independent searches to run; the best model found is kept")
+        ("threads,t", po::value<unsigned int>()->default_value(1), "number of threads to load files and search with")
         ("unitProp,u", "perform unit propagation only and exit")
+        ("cache,c", po::value<std::string>(), "directory to cache loaded domains in, so runs on the same files skip parsing")
 //        ("datafile,d", po::value<std::string>(), "log scores from maxwalksat to this file (csv form)")
     ;
 
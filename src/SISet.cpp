@@ -6,6 +6,8 @@
  */
 #include <set>
 #include <list>
+#include <vector>
+#include <algorithm>
 #include <stdexcept>
 #include <sstream>
 #include <iostream>
@@ -17,14 +19,118 @@
 #include <boost/random/uniform_int.hpp>
 #include "SISet.h"
 #include "SpanInterval.h"
+#include "SpanIntervalBlock.h"
 #include "Log.h"
 #include "infix_ostream_iterator.h"
 
+namespace {
+    // true if two intervals intersect or meet (so their union is an interval)
+    bool touches(const Interval& a, const Interval& b) {
+        if (a.finish() < b.start()) return b.start() - a.finish() == 1;
+        if (b.finish() < a.start()) return a.start() - b.finish() == 1;
+        return true;
+    }
+
+    // orders a starting point against the start of a spanning interval's
+    // starting range; used to bound scans over a sorted SISet
+    struct StartsAfter {
+        bool operator()(unsigned int point, const SpanInterval& si) const {
+            return point < si.start().start();
+        }
+    };
+
+    // orders a liquid spanning interval before any point it cannot touch
+    struct FinishesBefore {
+        bool operator()(const SpanInterval& si, unsigned int point) const {
+            return si.start().finish() < point && point - si.start().finish() > 1;
+        }
+    };
+
+    // remove every member of sorted (which must be disjoint) from si,
+    // writing the leftover spanning intervals to out
+    template <class OutputIterator>
+    void subtractAll(const SpanInterval& si, const std::vector<SpanInterval>& sorted,
+            bool liquid, OutputIterator out) {
+        std::vector<SpanInterval> pieces(1, si);
+        std::vector<SpanInterval>::const_iterator bound =
+                std::upper_bound(sorted.begin(), sorted.end(), si.start().finish(), StartsAfter());
+        for (std::vector<SpanInterval>::const_iterator it = sorted.begin(); it != bound && !pieces.empty(); it++) {
+            std::vector<SpanInterval> leftover;
+            for (std::vector<SpanInterval>::const_iterator pIt = pieces.begin(); pIt != pieces.end(); pIt++) {
+                if (!intersection(*pIt, *it)) {
+                    leftover.push_back(*pIt);
+                } else if (liquid) {
+                    pIt->liqSubtract(*it, std::back_inserter(leftover));
+                } else {
+                    pIt->subtract(*it, std::back_inserter(leftover));
+                }
+            }
+            pieces.swap(leftover);
+        }
+        std::copy(pieces.begin(), pieces.end(), out);
+    }
+
+    bool allLiquid(const std::vector<SpanInterval>& set) {
+        for (std::vector<SpanInterval>::const_iterator it = set.begin(); it != set.end(); it++) {
+            if (!it->isLiquid()) return false;
+        }
+        return true;
+    }
+
+    // fill in the interval tree nodes for members [lo, hi), returning the
+    // position of the node for that range
+    template <class Node>
+    std::size_t buildIndex(const std::vector<SpanInterval>& set, std::size_t lo, std::size_t hi,
+            std::vector<Node>& index) {
+        std::size_t mid = lo + (hi - lo)/2;
+        Node& node = index[mid];
+        node.maxStartFinish = set[mid].start().finish();
+        node.maxFinish = set[mid].finish().finish();
+        if (lo < mid) {
+            const Node& left = index[buildIndex(set, lo, mid, index)];
+            node.maxStartFinish = std::max(node.maxStartFinish, left.maxStartFinish);
+            node.maxFinish = std::max(node.maxFinish, left.maxFinish);
+        }
+        if (mid+1 < hi) {
+            const Node& right = index[buildIndex(set, mid+1, hi, index)];
+            node.maxStartFinish = std::max(node.maxStartFinish, right.maxStartFinish);
+            node.maxFinish = std::max(node.maxFinish, right.maxFinish);
+        }
+        return mid;
+    }
+
+    // visitors for SISet::visitIndexed()
+    struct FindInterval {
+        FindInterval(const Interval& i) : interval(i) {}
+        bool operator()(const SpanInterval& si) const {
+            return si.start().start() <= interval.start() && interval.start() <= si.start().finish()
+                    && si.finish().start() <= interval.finish() && interval.finish() <= si.finish().finish();
+        }
+        Interval interval;
+    };
+
+    struct FindOverlap {
+        FindOverlap(const SpanInterval& s) : si(s) {}
+        bool operator()(const SpanInterval& member) const {
+            return intersection(member, si).is_initialized();
+        }
+        SpanInterval si;
+    };
+
+    struct CollectAll {
+        bool operator()(const SpanInterval& member) {
+            found.push_back(member);
+            return false;
+        }
+        std::vector<SpanInterval> found;
+    };
+}
 
 SISet::SISet(const SpanInterval& si, bool forceLiquid,
             const Interval& maxInterval)
-    : set_(), forceLiquid_(forceLiquid), maxInterval_(maxInterval) {
-    set_.push_back(si);
+    : set_(), forceLiquid_(forceLiquid), maxInterval_(maxInterval),
+      size_(0), liqSize_(0), valid_(0), disjoint_(false), index_(), block_() {
+    add(si);
 }
 
 
@@ -34,51 +140,96 @@ std::set<SpanInterval> SISet::asSet() const {
 
 
 SISet SISet::compliment() const {
-    if (size() == 0) {
-        // compliment is max interval
-        SISet max(forceLiquid_, maxInterval_);
-        max.add(SpanInterval(maxInterval_));
-        return max;
-    }
-
-    // {A U B U C U.. }^c = A^c I B^c I ...
-    // {A U B U ..} intersect {C U D U } .. intersect D
-    // expensive operation!  faster way to do this?
-    std::list<std::list<SpanInterval> > intersections;
-    for (std::list<SpanInterval>::const_iterator it = set_.begin(); it != set_.end(); it++) {
-        std::list<SpanInterval> compliment;
-        if (forceLiquid_) {
-            it->liqCompliment(SpanInterval(maxInterval_), std::inserter(compliment, compliment.end()));
-        } else {
-            it->compliment(SpanInterval(maxInterval_), std::inserter(compliment, compliment.end()));
+    SISet result(forceLiquid_, maxInterval_);
+    const unsigned int lo = maxInterval_.start();
+    const unsigned int hi = maxInterval_.finish();
+
+    if (forceLiquid_) {
+        // members are merged and sorted, so the compliment is just the gaps
+        // between them
+        unsigned int next = lo;
+        bool done = false;
+        for (std::vector<SpanInterval>::const_iterator it = set_.begin(); it != set_.end(); it++) {
+            unsigned int i = it->start().start();
+            unsigned int j = it->start().finish();
+            if (i > next) result.set_.push_back(SpanInterval(next, i-1, next, i-1));
+            if (j >= hi) {
+                done = true;
+                break;
+            }
+            next = j+1;
         }
-        intersections.push_back(compliment);
-    }
-
-    // now we have a list of set unions that we need to intersect; perform pairwise intersection
-    while (intersections.size() > 1) {
-        // merge the first two sets
-        std::list<SpanInterval> first = intersections.front();
-        intersections.pop_front();
-        std::list<SpanInterval> second = intersections.front();
-        intersections.pop_front();
-        std::list<SpanInterval> intersected;
-        for (std::list<SpanInterval>::const_iterator lIt = first.begin(); lIt != first.end(); lIt++) {
-            for (std::list<SpanInterval>::const_iterator sIt = second.begin(); sIt != second.end(); sIt++) {
-                boost::optional<SpanInterval> intersect = intersection(*lIt, *sIt);
-                if (intersect) {
-                    intersected.push_back(*intersect);
-                }
+        if (!done) result.set_.push_back(SpanInterval(next, hi, next, hi));
+        return result;
+    }
+
+    // sweep over the starting points in bands where the same members are
+    // active.  within a band, the uncovered finishing points form a list of
+    // gaps, and each gap gives one spanning interval of the compliment.
+    // consecutive bands with the same gaps are merged into one.
+    std::vector<unsigned int> bands;
+    bands.reserve(2*set_.size() + 1);
+    bands.push_back(lo);
+    for (std::vector<SpanInterval>::const_iterator it = set_.begin(); it != set_.end(); it++) {
+        bands.push_back(it->start().start());
+        if (it->start().finish() < hi) bands.push_back(it->start().finish()+1);
+    }
+    std::sort(bands.begin(), bands.end());
+    bands.erase(std::unique(bands.begin(), bands.end()), bands.end());
+
+    std::vector<SpanInterval>::const_iterator nextMember = set_.begin();
+    std::vector<const SpanInterval*> active;
+    std::vector<Interval> covered;
+    std::vector<Interval> gaps, prevGaps;
+    unsigned int prevStart = lo;
+    for (std::vector<unsigned int>::size_type b = 0; b < bands.size(); b++) {
+        const unsigned int bs = bands[b];
+
+        // drop members that ended before this band, pick up those that begin
+        std::vector<const SpanInterval*>::iterator keep = active.begin();
+        for (std::vector<const SpanInterval*>::iterator aIt = active.begin(); aIt != active.end(); aIt++) {
+            if ((*aIt)->start().finish() >= bs) *keep++ = *aIt;
+        }
+        active.erase(keep, active.end());
+        for (; nextMember != set_.end() && nextMember->start().start() <= bs; nextMember++) {
+            active.push_back(&*nextMember);
+        }
+
+        covered.clear();
+        for (std::vector<const SpanInterval*>::const_iterator aIt = active.begin(); aIt != active.end(); aIt++) {
+            covered.push_back((*aIt)->finish());
+        }
+        std::sort(covered.begin(), covered.end());
+
+        gaps.clear();
+        unsigned int next = lo;
+        bool done = false;
+        for (std::vector<Interval>::const_iterator cIt = covered.begin(); cIt != covered.end(); cIt++) {
+            if (cIt->finish() < next) continue;
+            if (cIt->start() > next) gaps.push_back(Interval(next, cIt->start()-1));
+            if (cIt->finish() >= hi) {
+                done = true;
+                break;
             }
+            next = cIt->finish()+1;
         }
-        if (!intersected.empty()) {
-            intersections.push_front(intersected);
+        if (!done) gaps.push_back(Interval(next, hi));
+
+        if (b != 0 && gaps != prevGaps) {
+            for (std::vector<Interval>::const_iterator gIt = prevGaps.begin(); gIt != prevGaps.end(); gIt++) {
+                boost::optional<SpanInterval> si = SpanInterval(Interval(prevStart, bs-1), *gIt).normalize();
+                if (si) result.set_.push_back(*si);
+            }
+            prevStart = bs;
         }
+        if (b == 0 || gaps != prevGaps) prevGaps.swap(gaps);
     }
-    if (intersections.empty()) {
-        return SISet(forceLiquid_, maxInterval_);
+    for (std::vector<Interval>::const_iterator gIt = prevGaps.begin(); gIt != prevGaps.end(); gIt++) {
+        boost::optional<SpanInterval> si = SpanInterval(Interval(prevStart, hi), *gIt).normalize();
+        if (si) result.set_.push_back(*si);
     }
-    return SISet(intersections.front().begin(), intersections.front().end(), forceLiquid_, maxInterval_);
+    std::sort(result.set_.begin(), result.set_.end(), SpanIntervalStartFinishComparator());
+    return result;
 }
 
 Interval SISet::maxInterval() const {
@@ -86,253 +237,311 @@ Interval SISet::maxInterval() const {
 }
 
 unsigned int SISet::size() const {
-    // look, this doesn't mean much if the list isn't disjoint
-    SISet copy(*this);
-    copy.makeDisjoint();
-
+    if (valid_ & SIZE_VALID) return size_;
+    // the set is always disjoint, so just add up the members
     unsigned int sum = 0;
-    BOOST_FOREACH(SpanInterval sp, copy.set_) {
-        sum += sp.size();
+    for (std::vector<SpanInterval>::const_iterator it = set_.begin(); it != set_.end(); it++) {
+        sum += it->size();
     }
+    size_ = sum;
+    valid_ |= SIZE_VALID;
     return sum;
 }
 
 unsigned int SISet::liqSize() const {
-    SISet copy(*this);
-    copy.makeDisjoint();
-
+    if (valid_ & LIQSIZE_VALID) return liqSize_;
     unsigned int sum = 0;
-    BOOST_FOREACH(SpanInterval sp, copy.set_) {
-        sum += sp.liqSize();
+    for (std::vector<SpanInterval>::const_iterator it = set_.begin(); it != set_.end(); it++) {
+        sum += it->liqSize();
     }
+    liqSize_ = sum;
+    valid_ |= LIQSIZE_VALID;
     return sum;
 }
 
-// O(n^2) for every call :(  perhaps set a flag instead?
+const SISet::Index& SISet::index() const {
+    if (!index_) {
+        boost::shared_ptr<Index> index(new Index(set_.size()));
+        if (!set_.empty()) buildIndex(set_, 0, set_.size(), *index);
+        index_ = index;
+    }
+    return *index_;
+}
+
+const SpanIntervalBlock& SISet::block() const {
+    if (!block_) block_.reset(new SpanIntervalBlock(set_.begin(), set_.end()));
+    return *block_;
+}
+
+template <class Visitor>
+bool SISet::visitIndexed(std::size_t lo, std::size_t hi, unsigned int startUpTo,
+        unsigned int minStartFinish, unsigned int minFinish, Visitor& visit) const {
+    const Index& nodes = index();
+    while (lo < hi) {
+        std::size_t mid = lo + (hi - lo)/2;
+        if (nodes[mid].maxStartFinish < minStartFinish || nodes[mid].maxFinish < minFinish) return false;
+        if (visitIndexed(lo, mid, startUpTo, minStartFinish, minFinish, visit)) return true;
+        const SpanInterval& si = set_[mid];
+        // members are sorted by starting point, so nothing from here on can match
+        if (si.start().start() > startUpTo) return false;
+        if (si.start().finish() >= minStartFinish && si.finish().finish() >= minFinish && visit(si)) return true;
+        lo = mid+1;
+    }
+    return false;
+}
+
+bool SISet::contains(const Interval& interval) const {
+    if (set_.empty() || interval.start() > interval.finish()) return false;
+    FindInterval find(interval);
+    return visitIndexed(0, set_.size(), interval.start(), interval.start(), interval.finish(), find);
+}
+
+bool SISet::overlaps(const SpanInterval& si) const {
+    if (set_.empty() || si.isEmpty()) return false;
+    FindOverlap find(si);
+    return visitIndexed(0, set_.size(), si.start().finish(), si.start().start(), si.finish().start(), find);
+}
+
+std::vector<SpanInterval> SISet::stab(unsigned int timepoint) const {
+    CollectAll collect;
+    if (!set_.empty()) visitIndexed(0, set_.size(), timepoint, 0, timepoint, collect);
+    return collect.found;
+}
+
+void SISet::fillCaches() const {
+    size();
+    isDisjoint();
+    index();
+    block();
+    for (std::vector<SpanInterval>::const_iterator it = set_.begin(); it != set_.end(); it++) {
+        if (!it->isLiquid()) return;
+    }
+    liqSize();
+}
+
 bool SISet::isDisjoint() const {
-    for (std::list<SpanInterval>::const_iterator fIt = set_.begin(); fIt != set_.end(); fIt++) {
-        for (std::list<SpanInterval>::const_iterator sIt = fIt; sIt != set_.end(); sIt++) {
-            // dont compare to yourself
-            if (sIt == fIt) {
-                continue;
-            }
-            if (intersection(*fIt, *sIt)) {
-                return false;
-            }
+    if (!(valid_ & DISJOINT_VALID)) {
+        disjoint_ = checkDisjoint();
+        valid_ |= DISJOINT_VALID;
+    }
+    return disjoint_;
+}
+
+bool SISet::checkDisjoint() const {
+    // since we're sorted by starting point, only the members that start
+    // before fIt's starting range ends can intersect it
+    for (std::vector<SpanInterval>::const_iterator fIt = set_.begin(); fIt != set_.end(); fIt++) {
+        std::vector<SpanInterval>::const_iterator bound =
+                std::upper_bound(fIt+1, set_.end(), fIt->start().finish(), StartsAfter());
+        if (block().intersectsAny(*fIt, (fIt+1) - set_.begin(), bound - set_.begin())) {
+            return false;
         }
     }
     return true;
 }
 
 void SISet::setMaxInterval(const Interval& maxInterval) {
+    invalidate();
     maxInterval_ = maxInterval;
-    std::list<SpanInterval> resized;
-    for (std::list<SpanInterval>::iterator it = set_.begin(); it != set_.end(); it++) {
-        SpanInterval si = *it;
-        boost::optional<SpanInterval> siOpt = intersection(si, SpanInterval(maxInterval, maxInterval));
+    std::vector<SpanInterval> resized;
+    resized.reserve(set_.size());
+    for (std::vector<SpanInterval>::const_iterator it = set_.begin(); it != set_.end(); it++) {
+        boost::optional<SpanInterval> siOpt = intersection(*it, SpanInterval(maxInterval, maxInterval));
         if (siOpt) {
             resized.push_back(siOpt.get());
         }
     }
+    // clipping can reorder members that now share a starting point
+    std::sort(resized.begin(), resized.end(), SpanIntervalStartFinishComparator());
     set_.swap(resized);
 }
 
 void SISet::add(const SpanInterval &s) {
     boost::optional<SpanInterval> sCopy = intersection(s, SpanInterval(maxInterval_));
     if (!sCopy) return;
+    invalidate();
     SpanInterval sp = *sCopy;
     if (forceLiquid_ && !sp.isLiquid()) {
         std::runtime_error e("tried to add a non-liquid SI to a liquid SI");
         throw e;
     }
     if (forceLiquid_) {
-        // we have to merge this with pre-existing intervals
-        for (std::list<SpanInterval>::iterator it = set_.begin(); it != set_.end();) {
-            SpanInterval b = *it;
-            Interval sInt = sp.start();
-            Interval bInt = b.start();
-            if (meets(sInt, bInt) || meetsI(sInt, bInt)
-                    || overlaps(sInt, bInt) || overlapsI(sInt, bInt)
-                    || starts(sInt, bInt) || startsI(sInt, bInt)
-                    || finishes(sInt, bInt) || finishesI(sInt, bInt)
-                    || during(sInt, bInt) || duringI(sInt, bInt)) {
-                // they intersect, pull it out
-                std::list<SpanInterval>::iterator toErase(it);
-                it++;
-                set_.erase(toErase);
-
-                // now reset scopy to be the newly resized span interval
-                unsigned int i = (b.start().start() < sp.start().start()
-                        ? b.start().start() : sp.start().start());
-                unsigned int j = (b.start().finish() > sp.start().finish()
-                        ? b.start().finish() : sp.start().finish());
-
-                sp.setStart(Interval(i,j));
-                sp.setFinish(Interval(i,j));
-            } else {
-                it++;
-            }
+        // we have to merge this with the pre-existing intervals it meets or
+        // overlaps; since we're sorted, those form a contiguous run
+        std::vector<SpanInterval>::iterator first =
+                std::lower_bound(set_.begin(), set_.end(), sp.start().start(), FinishesBefore());
+        std::vector<SpanInterval>::iterator last = first;
+        unsigned int i = sp.start().start();
+        unsigned int j = sp.start().finish();
+        while (last != set_.end() && touches(last->start(), sp.start())) {
+            i = std::min(i, last->start().start());
+            j = std::max(j, last->start().finish());
+            last++;
+        }
+        if (first == last) {
+            set_.insert(first, sp);
+        } else {
+            *first = SpanInterval(i, j, i, j);
+            set_.erase(first+1, last);
         }
-        // now insert our element into the list
-        set_.push_back(sp);
     } else {
-        set_.push_back(sp);
+        // only keep the parts of sp we don't already have
+        std::vector<SpanInterval> pieces;
+        subtractAll(sp, set_, false, std::back_inserter(pieces));
+        insertDisjoint(pieces);
     }
 }
 
 void SISet::add(const SISet &b) {
-    for (std::list<SpanInterval>::const_iterator it = b.set_.begin(); it != b.set_.end(); it++) {
-        add(*it);
-    }
-}
-
-void SISet::makeDisjoint() {
-    if (forceLiquid_) {
-        // we are already disjoint
-        return;
-        /*
-        // all our intervals are liquid so we can make them disjoint by
-        // merging them
-        for (std::list<SpanInterval>::const_iterator fIt = set_.begin(); fIt != set_.end(); fIt++) {
-            std::list<SpanInterval>::const_iterator sIt = fIt;
-            sIt++;
-            if (sIt != set_.end() && !intersection(*fIt, *sIt).isEmpty()) {
-                // merge the two
-                unsigned int start = fIt->start().start();
-                unsigned int end = sIt->finish().finish();
-                SpanInterval merged(start, end, start, end, maxInterval_);
-                set_.erase(sIt);    // invalidates sIt
-                set_.erase(fIt);    // invalidates fIt
-                fIt = set_.insert(merged).first;
+    if (b.set_.empty()) return;
+    invalidate();
+    if (!forceLiquid_ || !b.forceLiquid_) {
+        // pieces of b are already disjoint from each other, so each only
+        // needs to have our original members removed
+        std::vector<SpanInterval> pieces;
+        for (std::vector<SpanInterval>::const_iterator it = b.set_.begin(); it != b.set_.end(); it++) {
+            boost::optional<SpanInterval> clipped = intersection(*it, SpanInterval(maxInterval_));
+            if (!clipped) continue;
+            if (forceLiquid_) {
+                add(*clipped);  // merging with earlier pieces of b is needed here
+            } else {
+                subtractAll(*clipped, set_, false, std::back_inserter(pieces));
             }
         }
-        */
-    } else {
-        std::list<SpanInterval> setCopy;
-
-        BOOST_FOREACH(SpanInterval siToAdd, set_) {
-            SISet sisetToAdd(false, maxInterval_);
-            sisetToAdd.add(siToAdd);
-            // subtract whats already stored and only add if there is some left over
-            BOOST_FOREACH(SpanInterval siAlreadyIn, setCopy) {
-                sisetToAdd.subtract(siAlreadyIn);
-            }
-            setCopy.insert(setCopy.end(), sisetToAdd.set_.begin(), sisetToAdd.set_.end());
+        insertDisjoint(pieces);
+        return;
+    }
+    // both are liquid: merge the two sorted lists, joining anything that touches
+    std::vector<SpanInterval> merged;
+    merged.reserve(set_.size() + b.set_.size());
+    std::vector<SpanInterval>::const_iterator aIt = set_.begin();
+    std::vector<SpanInterval>::const_iterator bIt = b.set_.begin();
+    while (aIt != set_.end() || bIt != b.set_.end()) {
+        SpanInterval next;
+        if (bIt == b.set_.end() || (aIt != set_.end() && aIt->start().start() <= bIt->start().start())) {
+            next = *aIt;
+            aIt++;
+        } else {
+            boost::optional<SpanInterval> clipped = intersection(*bIt, SpanInterval(maxInterval_));
+            bIt++;
+            if (!clipped) continue;
+            next = *clipped;
         }
-        set_ = setCopy;
-
-        /*
-        // scan over all pairs, looking for intersections
-        for (std::set<SpanInterval>::const_iterator fIt = set_.begin(); fIt != set_.end(); fIt++) {
-            for (std::set<SpanInterval>::const_iterator sIt = fIt; sIt != set_.end(); sIt++) {
-                // don't compare to yourself
-                if (sIt == fIt) {
-                    continue;
-                }
-                SpanInterval intersect = intersection(*fIt, *sIt);
-                if (!intersect.isEmpty()) {
-
-                    // remove it from the second set
-                    std::set<SpanInterval> leftover;
-                    sIt->subtract(intersect, leftover);
-
-                    std::set<SpanInterval>::const_iterator toRemove = sIt;
-                    sIt--;
-                    set_.erase(toRemove);
-
-                    BOOST_FOREACH(SpanInterval sp, leftover) {
-                        if (!sp.isEmpty()) sp = sp.normalize().get();
-                        if (!sp.isEmpty()) set_.insert(sp);
-                    }
-                }
-            }
+        if (!merged.empty() && touches(merged.back().start(), next.start())) {
+            unsigned int i = merged.back().start().start();
+            unsigned int j = std::max(merged.back().start().finish(), next.start().finish());
+            merged.back() = SpanInterval(i, j, i, j);
+        } else {
+            merged.push_back(next);
         }
-        */
     }
-    // don't trust myself - remove this later as an optimization step
-    if (!isDisjoint()) {
-        LOG_PRINT(LOG_ERROR) << "set is supposed to be disjoint, but isnt!  set: " << this->toString() << ", forceliquid: " << forceLiquid_;
-        std::runtime_error error("inside SISet::makeDisjoint() - set was attempted to make disjoint but isn't!");
-        throw error;
+    set_.swap(merged);
+}
+
+void SISet::insertDisjoint(std::vector<SpanInterval>& pieces) {
+    if (pieces.empty()) return;
+    if (pieces.size() == 1) {
+        set_.insert(std::lower_bound(set_.begin(), set_.end(), pieces.front(), SpanIntervalStartFinishComparator()),
+                pieces.front());
+        return;
     }
+    std::sort(pieces.begin(), pieces.end(), SpanIntervalStartFinishComparator());
+    std::vector<SpanInterval> merged;
+    merged.reserve(set_.size() + pieces.size());
+    std::merge(set_.begin(), set_.end(), pieces.begin(), pieces.end(),
+            std::back_inserter(merged), SpanIntervalStartFinishComparator());
+    set_.swap(merged);
+}
+
+void SISet::makeDisjoint() {
+    // add() and subtract() keep the set disjoint, so there's nothing left to
+    // do here.
 }
 
 void SISet::setForceLiquid(bool forceLiquid) {
     if (forceLiquid && !forceLiquid_) {
-        // first, make it disjoint
-        makeDisjoint();
-
-        std::list<SpanInterval> newSet;
-        BOOST_FOREACH(SpanInterval sp, set_) {
+        invalidate();
+        std::vector<SpanInterval> oldSet;
+        oldSet.swap(set_);
+        forceLiquid_ = true;
+        // the liquid versions may overlap, so add them back in to merge them
+        BOOST_FOREACH(SpanInterval sp, oldSet) {
             sp = sp.toLiquidExc();
             if (!sp.isEmpty()) {
-                sp.normalize();
-                newSet.push_back(sp);
+                add(sp);
             }
         }
-        set_.swap(newSet);
     }
     forceLiquid_ = forceLiquid;
 };
 
 void SISet::subtract(const SpanInterval& si) {
-    std::list<SpanInterval> newSet;
-
     if (set_.size() == 0) return;
     if (si.size() == 0) return;
-
-    BOOST_FOREACH(SpanInterval siInSet, set_) {
-        if (intersection(siInSet, si)) {
-            if (forceLiquid_) siInSet.liqSubtract(si, back_inserter(newSet));
-            else siInSet.subtract(si, back_inserter(newSet));
+    invalidate();
+
+    std::vector<SpanInterval> newSet;
+    std::vector<SpanInterval> pieces;
+    newSet.reserve(set_.size());
+    std::vector<SpanInterval>::const_iterator bound =
+            std::upper_bound(set_.begin(), set_.end(), si.start().finish(), StartsAfter());
+    for (std::vector<SpanInterval>::const_iterator it = set_.begin(); it != set_.end(); it++) {
+        if (it < bound && intersection(*it, si)) {
+            if (forceLiquid_) it->liqSubtract(si, back_inserter(pieces));
+            else it->subtract(si, back_inserter(pieces));
         } else {
-            newSet.push_back(siInSet);
+            newSet.push_back(*it);
         }
     }
-    set_ = newSet;
+    set_.swap(newSet);
+    // whatever's left over still lies inside the members it came from
+    insertDisjoint(pieces);
 }
 
 void SISet::subtract(const SISet& sis) {
-    // TODO why not just subtract each item individually??
-
-    //LOG_PRINT(LOG_DEBUG) << "called SISet::subtract with *this=" << this->toString() << " and sis=" << sis.toString();
-    std::list<SISet> toIntersect;
-
     if (set_.size() == 0) return;
-    if (sis.size() == 0) return;
-
-    BOOST_FOREACH(SpanInterval b, sis.set_) {
-        SISet copy(*this);
-        //copy.setForceLiquid(false);
-    //  LOG_PRINT(LOG_DEBUG) << "copy size:" << copy.set_.size();
-        copy.subtract(b);
-    //  LOG_PRINT(LOG_DEBUG) << "this \\ b (where b = "<< b.toString() <<") = " << copy.toString();
-        toIntersect.push_back(copy);
-    }
-    if (toIntersect.size() == 0) {
-        set_.clear();
+    if (sis.set_.size() == 0) return;
+    invalidate();
+
+    std::vector<SpanInterval> newSet;
+    if (forceLiquid_ && allLiquid(sis.set_)) {
+        // both sides are sorted liquid intervals, so sweep across them
+        std::vector<SpanInterval>::const_iterator bIt = sis.set_.begin();
+        for (std::vector<SpanInterval>::const_iterator aIt = set_.begin(); aIt != set_.end(); aIt++) {
+            unsigned int curStart = aIt->start().start();
+            unsigned int curFinish = aIt->start().finish();
+            while (bIt != sis.set_.end() && bIt->start().finish() < curStart) bIt++;
+            bool consumed = false;
+            for (std::vector<SpanInterval>::const_iterator rIt = bIt;
+                    rIt != sis.set_.end() && rIt->start().start() <= curFinish;
+                    rIt++) {
+                if (rIt->start().start() > curStart) {
+                    newSet.push_back(SpanInterval(curStart, rIt->start().start()-1));
+                }
+                if (rIt->start().finish() >= curFinish) {
+                    consumed = true;
+                    break;
+                }
+                curStart = rIt->start().finish()+1;
+            }
+            if (!consumed) newSet.push_back(SpanInterval(curStart, curFinish));
+        }
+        set_.swap(newSet);
         return;
     }
-    // now collapse the intersect set
-    while (toIntersect.size() > 1) {
-        SISet a = toIntersect.front();
-        toIntersect.pop_front();
-        SISet b = toIntersect.front();
-        toIntersect.pop_front();
 
-        SISet intersected = intersection(a, b);
-    //  LOG_PRINT(LOG_DEBUG) << "a=" << a.toString() <<", b=" << b.toString() << ", a intersect b = "<< intersected.toString();
-        toIntersect.push_front(intersected);
+    for (std::vector<SpanInterval>::const_iterator it = set_.begin(); it != set_.end(); it++) {
+        subtractAll(*it, sis.set_, forceLiquid_, std::back_inserter(newSet));
     }
-    set_ = toIntersect.front().set_;
-    //LOG_PRINT(LOG_DEBUG) << "final value: " << this->toString();
+    std::sort(newSet.begin(), newSet.end(), SpanIntervalStartFinishComparator());
+    set_.swap(newSet);
 }
 
 const SISet SISet::satisfiesRelation(const Interval::INTERVAL_RELATION& rel) const {
     SISet newSet(false, maxInterval_);
     newSet.clear();
 
-    for (std::list<SpanInterval>::const_iterator it = set_.begin(); it != set_.end(); it++) {
+    for (std::vector<SpanInterval>::const_iterator it = set_.begin(); it != set_.end(); it++) {
         boost::optional<SpanInterval> siOpt = it->satisfiesRelation(rel, SpanInterval(maxInterval_));
         if (siOpt) newSet.add(siOpt.get());
     }
@@ -406,20 +615,14 @@ SISet SISet::randomSISet(bool forceLiquid, const Interval& maxInterval, boost::m
 }
 
 SpanInterval SISet::randomSI(boost::mt19937& rng) const {
-    if (size() == 0) {
+    if (empty()) {
         LOG_PRINT(LOG_ERROR) << "called randomSI() on an empty SISet.";
         std::runtime_error e("called randomSI() on an empty SISet.");
         throw e;
     }
     // choose a random number from 0 to size
     boost::uniform_int<std::size_t> setFlip(0, set_.size()-1);
-    std::size_t index = setFlip(rng);
-    std::list<SpanInterval>::const_iterator it = set_.begin();
-    while (index != 0) {
-        it++;
-        index--;
-    }
-    return *it;
+    return set_[setFlip(rng)];
 }
 
 std::string SISet::toString() const {
@@ -430,8 +633,9 @@ std::string SISet::toString() const {
 
 std::ostream& operator<<(std::ostream& o, const SISet& s) {
     o << "{";
-    std::list<SpanInterval> copy(s.set_);
-    copy.sort();
+    // print in the natural ordering of spanning intervals
+    std::vector<SpanInterval> copy(s.set_);
+    std::sort(copy.begin(), copy.end());
 
     infix_ostream_iterator<SpanInterval> oIt(o, ", ");
     std::copy(copy.begin(), copy.end(), oIt);
@@ -441,30 +645,42 @@ std::ostream& operator<<(std::ostream& o, const SISet& s) {
 
 
 SISet intersection(const SISet& a, const SISet& b) {
-    SISet result(a.forceLiquid(), a.maxInterval_);  // TODO: better way?
-    //result.setMaxInterval(a.maxInterval_);  // TODO: better way?
-    if (a.forceLiquid() && b.forceLiquid()) {
-        result.setForceLiquid(true);
-    } else {
-        result.setForceLiquid(false);
-    }
-    // pairwise intersection - ugh
-    BOOST_FOREACH(SpanInterval siA, a.set_) {
-        BOOST_FOREACH(SpanInterval siB, b.set_) {
-            boost::optional<SpanInterval> intersect = intersection(siA, siB);
-            if (intersect) {
-                result.add(*intersect);
-            }
+    SISet result(a.forceLiquid() && b.forceLiquid(), a.maxInterval_);  // TODO: better way?
+    if (a.set_.empty() || b.set_.empty()) return result;
+
+    if (result.forceLiquid_) {
+        // both sorted lists of liquid intervals; walk them together
+        std::vector<SpanInterval>::const_iterator aIt = a.set_.begin();
+        std::vector<SpanInterval>::const_iterator bIt = b.set_.begin();
+        while (aIt != a.set_.end() && bIt != b.set_.end()) {
+            boost::optional<SpanInterval> intersect = intersection(*aIt, *bIt);
+            if (intersect) result.set_.push_back(*intersect);
+            if (aIt->start().finish() < bIt->start().finish()) aIt++;
+            else bIt++;
         }
+        return result;
     }
+
+    // intersections of members of two disjoint sets are themselves disjoint,
+    // so we only need to skip pairs whose starting ranges can't meet
+    for (std::vector<SpanInterval>::const_iterator aIt = a.set_.begin(); aIt != a.set_.end(); aIt++) {
+        std::vector<SpanInterval>::const_iterator bound =
+                std::upper_bound(b.set_.begin(), b.set_.end(), aIt->start().finish(), StartsAfter());
+        b.block().intersect(*aIt, 0, bound - b.set_.begin(), result.set_);
+    }
+    std::sort(result.set_.begin(), result.set_.end(), SpanIntervalStartFinishComparator());
     return result;
 };
 
 SISet intersection(const SISet& a, const SpanInterval& si) {
-    // cheat for now
-    SISet copy(false, a.maxInterval_);
-    copy.add(si);
-    return intersection(a, copy);
+    SISet result(false, a.maxInterval_);
+    boost::optional<SpanInterval> clipped = intersection(si, SpanInterval(a.maxInterval_));
+    if (!clipped) return result;
+    std::vector<SpanInterval>::const_iterator bound =
+            std::upper_bound(a.set_.begin(), a.set_.end(), clipped->start().finish(), StartsAfter());
+    a.block().intersect(*clipped, 0, bound - a.set_.begin(), result.set_);
+    std::sort(result.set_.begin(), result.set_.end(), SpanIntervalStartFinishComparator());
+    return result;
 }
 
 SISet span(const SpanInterval& a, const SpanInterval& b, const Interval& maxInterval) {
@@ -535,11 +751,11 @@ bool equalByInterval(const SISet& a, const SISet& b) {
     std::set<Interval> aIntervals;
     std::set<Interval> bIntervals;
 
-    for (std::list<SpanInterval>::const_iterator it = a.set_.begin(); it != a.set_.end(); it++) {
+    for (std::vector<SpanInterval>::const_iterator it = a.set_.begin(); it != a.set_.end(); it++) {
         SpanInterval si = *it;
         aIntervals.insert(si.begin(), si.end());
     }
-    for (std::list<SpanInterval>::const_iterator it = b.set_.begin(); it != b.set_.end(); it++) {
+    for (std::vector<SpanInterval>::const_iterator it = b.set_.begin(); it != b.set_.end(); it++) {
         SpanInterval si = *it;
         aIntervals.insert(si.begin(), si.end());
     }
@@ -8,19 +8,45 @@
 #ifndef SISET_H_
 #define SISET_H_
 #include <set>
-#include <list>
+#include <vector>
 #include <iostream>
 #include "SpanInterval.h"
 #include <boost/functional/hash.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/serialization/access.hpp>
-#include <boost/serialization/list.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/tracking.hpp>
+#include <boost/serialization/vector.hpp>
 
+class SpanIntervalBlock;
+
+/**
+ * A set of intervals, represented as a union of spanning intervals.
+ *
+ * The spanning intervals are always kept disjoint and stored in a contiguous
+ * vector sorted by SpanIntervalStartFinishComparator, so that unions,
+ * intersections and subtractions can be computed by merging two sorted
+ * sequences.  Liquid sets additionally merge any spanning intervals that
+ * meet or overlap, so each liquid set has exactly one representation.
+ *
+ * size(), liqSize() and isDisjoint() are cached after their first call and
+ * only recomputed once a modifier has changed the set.  Likewise, the
+ * point and overlap queries (contains(), overlaps(), stab()) build an
+ * interval tree over the members on first use, which is dropped by any
+ * modifier.  Bulk intersection tests run on a SpanIntervalBlock copy of
+ * the members that is cached the same way.
+ *
+ * Since reading a set can fill in these caches, a set can only be read
+ * from several threads at once once fillCaches() has been called on it
+ * (and until it is next modified).
+ */
 class SISet {
 public:
     SISet(bool forceLiquid=false,
             const Interval& maxInterval=Interval(0,0))
-    : set_(), forceLiquid_(forceLiquid), maxInterval_(maxInterval) {}
+    : set_(), forceLiquid_(forceLiquid), maxInterval_(maxInterval),
+      size_(0), liqSize_(0), valid_(0), disjoint_(false), index_(), block_() {}
 
     SISet(const SpanInterval& si, bool forceLiquid,
           const Interval& maxInterval);
@@ -29,9 +55,14 @@ public:
     SISet(InputIterator begin, InputIterator end,
             bool forceLiquid,
             const Interval& maxInterval)
-    : set_(begin, end), forceLiquid_(forceLiquid), maxInterval_(maxInterval) {}
+    : set_(), forceLiquid_(forceLiquid), maxInterval_(maxInterval),
+      size_(0), liqSize_(0), valid_(0), disjoint_(false), index_(), block_() {
+        for (InputIterator it = begin; it != end; it++) {
+            add(*it);
+        }
+    }
 
-    typedef std::list<SpanInterval>::const_iterator const_iterator;
+    typedef std::vector<SpanInterval>::const_iterator const_iterator;
 
     const_iterator begin() const;
     const_iterator end() const;
@@ -45,14 +76,14 @@ public:
     unsigned int size() const;
     unsigned int liqSize() const;
     bool empty() const;
-    const std::list<SpanInterval>& intervals() const {return set_;}
+    const std::vector<SpanInterval>& intervals() const {return set_;}
 
     // modifiers
     void add(const SpanInterval &s);
     void add(const SISet& b);
 
     void makeDisjoint();
-    void clear() {set_.clear();};
+    void clear() {set_.clear(); invalidate();};
     void setMaxInterval(const Interval& maxInterval);
     void setForceLiquid(bool forceLiquid);
     void subtract(const SpanInterval& si);
@@ -69,6 +100,43 @@ public:
     bool includes(const SpanInterval& si) const;
     bool includes(const Interval& interval) const;
 
+    /**
+     * Check to see if a single interval is in this set.  Same as
+     * includes(const Interval&), but answered with the interval index in
+     * O(log n) rather than by set subtraction.
+     *
+     * @param interval  the interval to look for
+     * @return true if interval is in this set
+     */
+    bool contains(const Interval& interval) const;
+
+    /**
+     * Check to see if this set shares at least one interval with a spanning
+     * interval.
+     *
+     * @param si  the spanning interval to check against
+     * @return true if the intersection of si and this set is not empty
+     */
+    bool overlaps(const SpanInterval& si) const;
+
+    /**
+     * Find the members of this set that have at least one interval
+     * containing a timepoint.
+     *
+     * @param timepoint  the timepoint to stab the set with
+     * @return the members (in sorted order) holding an interval that starts
+     *   at or before timepoint and finishes at or after it
+     */
+    std::vector<SpanInterval> stab(unsigned int timepoint) const;
+
+    /**
+     * Compute everything that is otherwise cached on first use, so that
+     * const member functions no longer write to the set.  liqSize() is
+     * only filled in if every member is liquid, since it makes no sense
+     * otherwise.
+     */
+    void fillCaches() const;
+
     const SISet satisfiesRelation(const Interval::INTERVAL_RELATION& rel) const;
 
     /**
@@ -97,13 +165,58 @@ public:
     friend std::size_t hash_value(const SISet& si);
 private:
     friend class boost::serialization::access;
+    friend class Snapshot;
 
     template <class Archive>
-    void serialize(Archive& ar, const unsigned int version);
+    void save(Archive& ar, const unsigned int version) const;
+    template <class Archive>
+    void load(Archive& ar, const unsigned int version);
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+    // pairwise check behind isDisjoint()
+    bool checkDisjoint() const;
+
+    // merge pieces that are disjoint from each other and from set_ into set_
+    void insertDisjoint(std::vector<SpanInterval>& pieces);
+
+    // forget the cached metadata; must be called whenever set_ changes
+    void invalidate() {valid_ = 0; index_.reset(); block_.reset();}
+
+    // node of the implicit interval tree over set_.  the node for the
+    // members in [lo, hi) is stored at the midpoint and holds the maxima
+    // over that whole range.
+    struct IndexNode {
+        unsigned int maxStartFinish;    // largest start().finish()
+        unsigned int maxFinish;         // largest finish().finish()
+    };
+    typedef std::vector<IndexNode> Index;
+
+    // the interval tree, building it if needed
+    const Index& index() const;
+
+    // the members as a SpanIntervalBlock, building it if needed
+    const SpanIntervalBlock& block() const;
+
+    // call visit on each member with start().start() <= startUpTo,
+    // start().finish() >= minStartFinish and finish().finish() >= minFinish,
+    // in sorted order, until it returns true
+    template <class Visitor>
+    bool visitIndexed(std::size_t lo, std::size_t hi, unsigned int startUpTo,
+            unsigned int minStartFinish, unsigned int minFinish, Visitor& visit) const;
 
-    std::list<SpanInterval> set_;
+    // bits of valid_ marking which cached values are current
+    enum {SIZE_VALID = 1, LIQSIZE_VALID = 2, DISJOINT_VALID = 4};
+
+    std::vector<SpanInterval> set_;
     bool forceLiquid_;
     Interval maxInterval_;
+
+    mutable unsigned int size_;
+    mutable unsigned int liqSize_;
+    mutable unsigned char valid_;
+    mutable bool disjoint_;
+    mutable boost::shared_ptr<const Index> index_;
+    mutable boost::shared_ptr<const SpanIntervalBlock> block_;
 };
 
 
@@ -156,7 +269,8 @@ unsigned long hammingDistance(const SISet& a, const SISet& b);
 // IMPLEMENTATION
 inline SISet::const_iterator SISet::begin() const {return set_.begin();}
 inline SISet::const_iterator SISet::end() const {return set_.end();}
-inline bool SISet::empty() const { return size() == 0;}
+// members are never empty spanning intervals
+inline bool SISet::empty() const { return set_.empty();}
 
 
 inline bool SISet::includes(const SISet& s) const {
@@ -172,7 +286,7 @@ inline bool SISet::includes(const SpanInterval& si) const {
 }
 
 inline bool SISet::includes(const Interval& interval) const {
-    return includes(SpanInterval(interval.start(), interval.start(), interval.finish(), interval.finish()));
+    return contains(interval);
 }
 
 //inline bool operator==(const SISet& l, const SISet& r) {return l.includes(r) && r.includes(l);}    //TODO: is this the right thing to do???
@@ -199,10 +313,28 @@ void SISet::collectSegments(OutIter out) const {
 }
 
 template <class Archive>
-void SISet::serialize(Archive& ar, const unsigned int version) {
+void SISet::save(Archive& ar, const unsigned int version) const {
     ar & set_;
     ar & forceLiquid_;
     ar & maxInterval_;
 }
 
+template <class Archive>
+void SISet::load(Archive& ar, const unsigned int version) {
+    std::vector<SpanInterval> stored;
+    ar & stored;
+    ar & forceLiquid_;
+    ar & maxInterval_;
+    // older archives may hold unsorted, overlapping spanning intervals
+    clear();
+    for (std::vector<SpanInterval>::const_iterator it = stored.begin(); it != stored.end(); it++) {
+        add(*it);
+    }
+}
+
+// SISets are values; tracking them would make the archive write a
+// reference instead of a set whenever a set is stored at an address used
+// earlier in the same archive (e.g. sets shared between Model copies)
+BOOST_CLASS_TRACKING(SISet, boost::serialization::track_never)
+
 #endif
@@ -183,6 +183,20 @@ public:
     }
 };
 
+/**
+ * Simple functor for sorting spanning intervals by their starting range
+ * start point, breaking ties with their finishing range start point.  Two
+ * disjoint (normalized) spanning intervals never compare equal under this
+ * ordering.
+ */
+struct SpanIntervalStartFinishComparator : std::binary_function<SpanInterval, SpanInterval, bool> {
+public:
+    bool operator()(const SpanInterval& l, const SpanInterval& r) const {
+        if (l.start().start() != r.start().start()) return (l.start().start() < r.start().start());
+        return (l.finish().start() < r.finish().start());
+    }
+};
+
 // IMPLEMENTATION
 inline SpanInterval::SpanInterval()
 : start_(0, 0), finish_(0, 0) {}
@@ -0,0 +1,142 @@
+/*
+ * SpanIntervalBlock.cpp
+ */
+#include <algorithm>
+#include <stdexcept>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "SpanIntervalBlock.h"
+
+namespace {
+    // intersect si with one member; the result is [(i, j), (k, l)] in
+    // normalized form, and is only meaningful if true is returned
+    inline bool intersectOne(unsigned int ss, unsigned int sf, unsigned int fs, unsigned int ff,
+            const SpanInterval& si,
+            unsigned int& i, unsigned int& j, unsigned int& k, unsigned int& l) {
+        i = std::max(ss, si.start().start());
+        j = std::min(sf, si.start().finish());
+        k = std::max(fs, si.finish().start());
+        l = std::min(ff, si.finish().finish());
+        if (i > j || i > l || k > l) return false;
+        j = std::min(j, l);
+        k = std::max(k, i);
+        return true;
+    }
+
+    // collects non-empty intersections
+    struct AppendIntersection {
+        AppendIntersection(std::vector<SpanInterval>& o) : out(o) {}
+        bool operator()(unsigned int i, unsigned int j, unsigned int k, unsigned int l) {
+            out.push_back(SpanInterval(i, j, k, l));
+            return false;
+        }
+        std::vector<SpanInterval>& out;
+    };
+
+    // stops at the first non-empty intersection
+    struct FoundIntersection {
+        bool operator()(unsigned int, unsigned int, unsigned int, unsigned int) {
+            return true;
+        }
+    };
+
+    // call emit(i, j, k, l) on the non-empty intersections of si with
+    // members [first, last), in order, until it returns true.  returns true
+    // if emit did.
+    template <class Emit>
+    bool intersectRange(const unsigned int* ss, const unsigned int* sf,
+            const unsigned int* fs, const unsigned int* ff,
+            std::size_t first, std::size_t last,
+            const SpanInterval& si, Emit& emit) {
+        std::size_t n = first;
+#if defined(__AVX2__)
+        const __m256i qss = _mm256_set1_epi32(si.start().start());
+        const __m256i qsf = _mm256_set1_epi32(si.start().finish());
+        const __m256i qfs = _mm256_set1_epi32(si.finish().start());
+        const __m256i qff = _mm256_set1_epi32(si.finish().finish());
+        for (; n + 8 <= last; n += 8) {
+            __m256i i = _mm256_max_epu32(_mm256_loadu_si256((const __m256i*)(ss+n)), qss);
+            __m256i j = _mm256_min_epu32(_mm256_loadu_si256((const __m256i*)(sf+n)), qsf);
+            __m256i k = _mm256_max_epu32(_mm256_loadu_si256((const __m256i*)(fs+n)), qfs);
+            __m256i l = _mm256_min_epu32(_mm256_loadu_si256((const __m256i*)(ff+n)), qff);
+            // a <= b exactly when max(a, b) == b
+            __m256i ok = _mm256_and_si256(
+                    _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(i, j), j),
+                                     _mm256_cmpeq_epi32(_mm256_max_epu32(i, l), l)),
+                    _mm256_cmpeq_epi32(_mm256_max_epu32(k, l), l));
+            int mask = _mm256_movemask_ps(_mm256_castsi256_ps(ok));
+            if (mask == 0) continue;
+            unsigned int iv[8], jv[8], kv[8], lv[8];
+            _mm256_storeu_si256((__m256i*)iv, i);
+            _mm256_storeu_si256((__m256i*)jv, _mm256_min_epu32(j, l));
+            _mm256_storeu_si256((__m256i*)kv, _mm256_max_epu32(k, i));
+            _mm256_storeu_si256((__m256i*)lv, l);
+            for (int lane = 0; lane < 8; lane++) {
+                if ((mask & (1 << lane)) && emit(iv[lane], jv[lane], kv[lane], lv[lane])) return true;
+            }
+        }
+#elif defined(__SSE2__)
+        // SSE2 only compares signed integers, so flip the sign bits first
+        const __m128i bias = _mm_set1_epi32((int)0x80000000);
+        const __m128i qss = _mm_xor_si128(_mm_set1_epi32(si.start().start()), bias);
+        const __m128i qsf = _mm_xor_si128(_mm_set1_epi32(si.start().finish()), bias);
+        const __m128i qfs = _mm_xor_si128(_mm_set1_epi32(si.finish().start()), bias);
+        const __m128i qff = _mm_xor_si128(_mm_set1_epi32(si.finish().finish()), bias);
+        for (; n + 4 <= last; n += 4) {
+            __m128i a, gt;
+            a = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(ss+n)), bias);
+            gt = _mm_cmpgt_epi32(a, qss);
+            __m128i i = _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, qss));
+            a = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(sf+n)), bias);
+            gt = _mm_cmpgt_epi32(a, qsf);
+            __m128i j = _mm_or_si128(_mm_and_si128(gt, qsf), _mm_andnot_si128(gt, a));
+            a = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(fs+n)), bias);
+            gt = _mm_cmpgt_epi32(a, qfs);
+            __m128i k = _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, qfs));
+            a = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(ff+n)), bias);
+            gt = _mm_cmpgt_epi32(a, qff);
+            __m128i l = _mm_or_si128(_mm_and_si128(gt, qff), _mm_andnot_si128(gt, a));
+
+            __m128i empty = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(i, j), _mm_cmpgt_epi32(i, l)),
+                    _mm_cmpgt_epi32(k, l));
+            int mask = ~_mm_movemask_ps(_mm_castsi128_ps(empty)) & 0xF;
+            if (mask == 0) continue;
+            gt = _mm_cmpgt_epi32(j, l);
+            j = _mm_or_si128(_mm_and_si128(gt, l), _mm_andnot_si128(gt, j));
+            gt = _mm_cmpgt_epi32(i, k);
+            k = _mm_or_si128(_mm_and_si128(gt, i), _mm_andnot_si128(gt, k));
+            unsigned int iv[4], jv[4], kv[4], lv[4];
+            _mm_storeu_si128((__m128i*)iv, _mm_xor_si128(i, bias));
+            _mm_storeu_si128((__m128i*)jv, _mm_xor_si128(j, bias));
+            _mm_storeu_si128((__m128i*)kv, _mm_xor_si128(k, bias));
+            _mm_storeu_si128((__m128i*)lv, _mm_xor_si128(l, bias));
+            for (int lane = 0; lane < 4; lane++) {
+                if ((mask & (1 << lane)) && emit(iv[lane], jv[lane], kv[lane], lv[lane])) return true;
+            }
+        }
+#endif
+        for (; n < last; n++) {
+            unsigned int i, j, k, l;
+            if (intersectOne(ss[n], sf[n], fs[n], ff[n], si, i, j, k, l) && emit(i, j, k, l)) return true;
+        }
+        return false;
+    }
+}
+
+void SpanIntervalBlock::intersect(const SpanInterval& si, size_type first, size_type last,
+        std::vector<SpanInterval>& out) const {
+    if (first > last || last > size()) throw std::out_of_range("SpanIntervalBlock::intersect() - range is out of bounds");
+    if (first == last) return;
+    AppendIntersection append(out);
+    intersectRange(&startStart_[0], &startFinish_[0], &finishStart_[0], &finishFinish_[0],
+            first, last, si, append);
+}
+
+bool SpanIntervalBlock::intersectsAny(const SpanInterval& si, size_type first, size_type last) const {
+    if (first > last || last > size()) throw std::out_of_range("SpanIntervalBlock::intersectsAny() - range is out of bounds");
+    if (first == last) return false;
+    FoundIntersection found;
+    return intersectRange(&startStart_[0], &startFinish_[0], &finishStart_[0], &finishFinish_[0],
+            first, last, si, found);
+}
@@ -0,0 +1,126 @@
+/*
+ * SpanIntervalBlock.h
+ *
+ *  Structure-of-arrays storage for spanning intervals, with batch kernels
+ *  that test one spanning interval against many at once.
+ */
+
+#ifndef SPANINTERVALBLOCK_H
+#define SPANINTERVALBLOCK_H
+
+#include <vector>
+#include <cstddef>
+#include "SpanInterval.h"
+
+/**
+ * A block of spanning intervals stored as four parallel arrays of
+ * endpoints (start().start(), start().finish(), finish().start() and
+ * finish().finish()) rather than as an array of SpanInterval objects.
+ *
+ * The layout lets the batch operations below compare one spanning interval
+ * against several members of the block per instruction.  When compiled
+ * for a target with AVX2 or SSE2 the kernels use those instruction sets;
+ * otherwise they fall back to a plain loop.  All of them give exactly the
+ * same results as calling intersection() on each member in turn.
+ */
+class SpanIntervalBlock {
+public:
+    typedef std::vector<unsigned int>::size_type size_type;
+
+    SpanIntervalBlock();
+
+    template <class InputIterator>
+    SpanIntervalBlock(InputIterator begin, InputIterator end);
+
+    size_type size() const;
+    bool empty() const;
+    void reserve(size_type n);
+    void push_back(const SpanInterval& si);
+    void clear();
+
+    /**
+     * Get a member of the block.
+     *
+     * @param n  the index of the member
+     * @return the nth spanning interval in the block
+     */
+    SpanInterval at(size_type n) const;
+
+    /**
+     * Intersect a spanning interval with the members [first, last) of the
+     * block.
+     *
+     * @param si     the spanning interval to intersect with
+     * @param first  index of the first member to consider
+     * @param last   one past the index of the last member to consider
+     * @param out    every non-empty intersection is appended to out (in
+     *   normalized form, in order of the members they came from)
+     */
+    void intersect(const SpanInterval& si, size_type first, size_type last,
+            std::vector<SpanInterval>& out) const;
+
+    /**
+     * Check to see if a spanning interval intersects any of the members
+     * [first, last) of the block.
+     *
+     * @param si     the spanning interval to check
+     * @param first  index of the first member to consider
+     * @param last   one past the index of the last member to consider
+     * @return true if intersection(si, at(n)) is non-empty for some n in
+     *   [first, last)
+     */
+    bool intersectsAny(const SpanInterval& si, size_type first, size_type last) const;
+
+private:
+    std::vector<unsigned int> startStart_;
+    std::vector<unsigned int> startFinish_;
+    std::vector<unsigned int> finishStart_;
+    std::vector<unsigned int> finishFinish_;
+};
+
+// IMPLEMENTATION
+inline SpanIntervalBlock::SpanIntervalBlock()
+    : startStart_(), startFinish_(), finishStart_(), finishFinish_() {}
+
+template <class InputIterator>
+SpanIntervalBlock::SpanIntervalBlock(InputIterator begin, InputIterator end)
+    : startStart_(), startFinish_(), finishStart_(), finishFinish_() {
+    for (InputIterator it = begin; it != end; it++) {
+        push_back(*it);
+    }
+}
+
+inline SpanIntervalBlock::size_type SpanIntervalBlock::size() const {
+    return startStart_.size();
+}
+
+inline bool SpanIntervalBlock::empty() const {
+    return startStart_.empty();
+}
+
+inline void SpanIntervalBlock::reserve(size_type n) {
+    startStart_.reserve(n);
+    startFinish_.reserve(n);
+    finishStart_.reserve(n);
+    finishFinish_.reserve(n);
+}
+
+inline void SpanIntervalBlock::push_back(const SpanInterval& si) {
+    startStart_.push_back(si.start().start());
+    startFinish_.push_back(si.start().finish());
+    finishStart_.push_back(si.finish().start());
+    finishFinish_.push_back(si.finish().finish());
+}
+
+inline void SpanIntervalBlock::clear() {
+    startStart_.clear();
+    startFinish_.clear();
+    finishStart_.clear();
+    finishFinish_.clear();
+}
+
+inline SpanInterval SpanIntervalBlock::at(size_type n) const {
+    return SpanInterval(startStart_.at(n), startFinish_.at(n), finishStart_.at(n), finishFinish_.at(n));
+}
+
+#endif /* SPANINTERVALBLOCK_H */
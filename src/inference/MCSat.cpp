@@ -6,12 +6,20 @@
  */
 
 #include <cmath>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <boost/bind.hpp>
+#include <boost/math/special_functions/fpclassify.hpp>
 #include <boost/random/bernoulli_distribution.hpp>
 #include "MCSat.h"
 #include "MaxWalkSat.h"
+#include "../util/ThreadPool.h"
 #include "../logic/UnitProp.h"
 #include "../logic/Domain.h"
 #include "../logic/syntax/ELSentence.h"
+#include "../Log.h"
 
 const unsigned int MCSat::defNumSamples = 1000;
 const unsigned int MCSat::defBurnInIterations = 1000;
@@ -20,6 +28,89 @@ const double MCSat::defWalksatRandomMoveProb = 0.2;
 const unsigned int MCSat::defWalksatNumRandomRestarts = 4;
 const bool MCSat::defUseRandomInitialModels = true;
 const bool MCSat::defUseUnitPropagation = true;
+const unsigned int MCSat::defDiagnosticInterval = 100;
+const double MCSat::defMaxRHat = 1.1;
+
+MCSatDiagnostics::MCSatDiagnostics()
+    : samples(0), acceptanceRate(0.0), novelRate(0.0), mean(), ess(), stdError(), rHat() {}
+
+namespace {
+// add one sample's worth of counts for set, as difference arrays: for each
+// length len up to maxLength, row len-1 of diffs (timesteps+1 wide) gets
+// +1/-1 around each run of starting points t such that [t:t+len-1] is in
+// set and inside where.  the set's spanning intervals are disjoint, so
+// every interval is counted at most once.  returns the number counted.
+unsigned long addIntervalCounts(const SISet& set, const Interval& where, unsigned int maxLength, std::vector<int>& diffs) {
+    unsigned long counted = 0;
+    long start = where.start();
+    long finish = where.finish();
+    std::size_t width = where.size()+1;
+    const std::vector<SpanInterval>& intervals = set.intervals();
+    for (std::vector<SpanInterval>::const_iterator it = intervals.begin(); it != intervals.end(); it++) {
+        for (unsigned int len = 1; len <= maxLength; len++) {
+            long lo = std::max<long>(it->start().start(), (long)it->finish().start() - (len-1));
+            long hi = std::min<long>(it->start().finish(), (long)it->finish().finish() - (len-1));
+            lo = std::max(lo, start);
+            hi = std::min(hi, finish - (long)(len-1));
+            if (lo > hi) continue;
+            std::size_t row = (len-1) * width;
+            diffs[row + (lo - start)]++;
+            diffs[row + (hi - start) + 1]--;
+            counted += hi - lo + 1;
+        }
+    }
+    return counted;
+}
+
+// add the prefix sums of each row of diffs (timesteps+1 wide) to the
+// matching row of counts (timesteps wide)
+void addDiffsTo(const std::vector<int>& diffs, std::size_t timesteps, std::vector<unsigned int>& counts) {
+    for (std::size_t row = 0; row * (timesteps+1) < diffs.size(); row++) {
+        int running = 0;
+        for (std::size_t i = 0; i < timesteps; i++) {
+            running += diffs[row * (timesteps+1) + i];
+            counts[row * timesteps + i] += running;
+        }
+    }
+}
+
+// add the n'th value x of a quantity to a chain's running sums
+void addObservation(double x, unsigned int n, double& sum, double& sumSq, double& sumLag, double& last) {
+    sum += x;
+    sumSq += x*x;
+    if (n > 0) sumLag += x*last;
+    last = x;
+}
+
+// effective sample size of one chain, assuming its autocorrelation decays
+// geometrically from the lag-1 autocorrelation (an AR(1) approximation)
+double chainEss(unsigned int n, double sum, double sumSq, double sumLag) {
+    if (n < 2) return n;
+    double mean = sum / n;
+    double variance = sumSq / n - mean*mean;
+    if (variance <= 1e-12) return n;
+    double rho = (sumLag / (n-1) - mean*mean) / variance;
+    rho = std::max(0.0, std::min(rho, 0.999));
+    return std::max(1.0, n * (1.0 - rho) / (1.0 + rho));
+}
+
+// Gelman-Rubin potential scale reduction from each chain's mean and
+// variance, n being the (average) chain length.  NaN with fewer than two
+// chains.
+double gelmanRubin(const std::vector<double>& means, const std::vector<double>& variances, double n) {
+    if (means.size() < 2) return std::numeric_limits<double>::quiet_NaN();
+    double grandMean = std::accumulate(means.begin(), means.end(), 0.0) / means.size();
+    double betweenOverN = 0.0;
+    for (std::vector<double>::const_iterator it = means.begin(); it != means.end(); it++) {
+        betweenOverN += (*it - grandMean) * (*it - grandMean);
+    }
+    betweenOverN /= means.size() - 1;
+    double within = std::accumulate(variances.begin(), variances.end(), 0.0) / variances.size();
+    if (within <= 0.0) return (betweenOverN <= 0.0 ? 1.0 : std::numeric_limits<double>::infinity());
+    double pooled = (n - 1.0) / n * within + betweenOverN;
+    return std::sqrt(pooled / within);
+}
+}
 
 void MCSat::run(boost::mt19937& rng) { // TODO: setup using random initial models
     if (d_ == 0) {
@@ -28,8 +119,20 @@ void MCSat::run(boost::mt19937& rng) { // TODO: setup using random initial model
     if (sampleStrategy_ == 0) {
         throw std::logic_error("MCSat::run() - SampleStrategy not set");
     }
-    samples_.clear();
-    samples_.reserve(numSamples_);
+    clear();
+    samples_.reserve(keepSamples_ ? numSamples_ : 0);
+    sampleChains_.reserve(keepSamples_ ? numSamples_ : 0);
+
+    // look up the query atoms once, rather than in every chain
+    queryIds_.clear();
+    for (std::vector<Proposition>::const_iterator it = queryProps_.begin(); it != queryProps_.end(); it++) {
+        queryIds_.push_back(AtomTable::global().intern(it->atom()));
+    }
+    marginalIds_.clear();
+    for (std::vector<Atom>::const_iterator it = marginalAtoms_.begin(); it != marginalAtoms_.end(); it++) {
+        marginalIds_.push_back(AtomTable::global().intern(*it));
+    }
+    marginalInterval_ = d_->maxInterval();
 
     //std::cout << "initial domain: ";
     //d_->printDebugDescription(std::cout);
@@ -44,77 +147,278 @@ void MCSat::run(boost::mt19937& rng) { // TODO: setup using random initial model
     //std::cout << "reduced domain: ";
     //reduced.printDebugDescription(std::cout);
 
+    // split the samples between the chains.  a single chain uses our rng
+    // directly; otherwise each chain gets its own random stream, seeded up
+    // front so the samples don't depend on how many threads run the chains
+    std::vector<ChainState> chains(numChains_);
+    for (unsigned int c = 0; c < numChains_; c++) {
+        chains[c].numSamples = numSamples_ / numChains_ + (c < numSamples_ % numChains_ ? 1 : 0);
+        chains[c].rng = (numChains_ == 1 ? rng : boost::mt19937(rng()));
+    }
 
-    Model prevModel = (useRandomInitialModels_ ? reduced.randomModel(rng) : reduced.defaultModel());
+    // each thread gets its own sampler (for its strategy) and its own copy
+    // of the domain, since SISets aren't safe to read from several threads.
+    // a single chain runs here, and gives sampleSat() our threads instead
+    std::auto_ptr<ThreadPool> pool;
+    std::vector<MCSat> samplers;
+    std::vector<Domain> domains;
+    if (numChains_ > 1) {
+        pool.reset(new ThreadPool(std::min(numThreads_, numChains_)));
+        samplers.resize(pool->size(), *this);
+        for (unsigned int worker = 0; worker < pool->size(); worker++) {
+            samplers[worker].numThreads_ = 1;
+            samplers[worker].trace_ = 0;
+            domains.push_back(reduced.deepCopy());
+        }
+    }
+    for (unsigned int c = 0; c < numChains_; c++) {
+        startChain(numChains_ == 1 ? reduced : domains[0], chains[c]);
+    }
+
+    // with early stopping or tracing, run the chains in rounds of
+    // diagnosticInterval_ samples each and check them in between
+    unsigned int longest = chains[0].numSamples;
+    unsigned int step = (targetPrecision_ > 0.0 || trace_ != 0 ? diagnosticInterval_ : longest);
+    bool stoppedEarly = false;
+    for (unsigned int until = std::min(step, longest); ; until = std::min(until + step, longest)) {
+        if (numChains_ == 1) {
+            advanceChain(reduced, chains[0], until, true);
+        } else {
+            pool->parallelFor(numChains_, boost::bind(&MCSat::advanceChainTask, boost::ref(samplers),
+                    boost::ref(domains), boost::ref(chains), until, _1, _2));
+        }
+        diagnostics_ = computeDiagnostics(chains);
+        if (trace_ != 0) writeTrace(diagnostics_, until <= step);
+        if (until >= longest) break;
+        if (targetPrecision_ > 0.0 && converged(diagnostics_)) {
+            stoppedEarly = true;
+            break;
+        }
+    }
+    if (stoppedEarly) {
+        LOG(LOG_INFO) << "MCSat reached the target precision after " << diagnostics_.samples << " samples";
+    }
+
+    // merge the chains, in chain order
+    for (unsigned int c = 0; c < numChains_; c++) {
+        sampleChains_.insert(sampleChains_.end(), chains[c].samples.size(), c);
+        merge(chains[c]);
+    }
+    if (numChains_ == 1) rng = chains[0].rng;
+}
+
+void MCSat::startChain(const Domain& reduced, ChainState& chain) const {
+    chain.samples.clear();
+    chain.queryCounts.assign(queryProps_.size(), 0);
+    chain.marginalDiffs.assign(marginalAtoms_.size(), std::vector<int>(marginalInterval_.size()+1, 0));
+    chain.samplesCounted = 0;
+    chain.attempts = chain.satisfied = chain.novel = 0;
+    std::size_t quantities = queryProps_.size() + marginalAtoms_.size();
+    chain.sum.assign(quantities, 0.0);
+    chain.sumSq.assign(quantities, 0.0);
+    chain.sumLag.assign(quantities, 0.0);
+    chain.last.assign(quantities, 0.0);
+    chain.iteration = 1;
+    if (chain.numSamples == 0) return;
+
+    chain.model = (useRandomInitialModels_ ? reduced.randomModel(chain.rng) : reduced.defaultModel());
 
     // do a starting run on the whole problem as our initial sample
     //boost::unordered_set<Model> initModels = sampleSat(prevModel, reduced);
     //prevModel = *initModels.begin();
-    Domain prevDomain = reduced;
 
-    if (burnInIterations_ == 0) samples_.push_back(prevModel);
-    unsigned int totalIterations = numSamples_+burnInIterations_;
+    if (burnInIterations_ == 0) record(chain.model, chain);
+}
 
+void MCSat::advanceChain(const Domain& reduced, ChainState& chain, unsigned int untilSamples,
+        bool showProgress) {
+    unsigned int totalIterations = chain.numSamples+burnInIterations_;
+    // the facts are the same every iteration, so propagate them once
+    std::auto_ptr<UnitPropagator> base;
+    if (useUnitPropagation_ && chain.samplesCounted < std::min(untilSamples, chain.numSamples)) {
+        std::vector<ELSentence> none;
+        try {
+            base.reset(new UnitPropagator(reduced.withFormulas(none.begin(), none.end())));
+        } catch (contradiction& c) {
+            // leave it to sampleSat() to find each time
+        }
+    }
 
-    for (unsigned int iteration = 1; iteration < totalIterations; iteration++) {
+    for (; chain.samplesCounted < std::min(untilSamples, chain.numSamples) && chain.iteration < totalIterations;
+            chain.iteration++) {
         std::vector<ELSentence> newSentences;
 
-        if ( totalIterations < 20 ||
-                iteration % (totalIterations / 20) == 0) {
-            std::cout << (((double)iteration) / ((double) totalIterations))*100 << "% done." << std::endl;
+        if (showProgress && (totalIterations < 20 ||
+                chain.iteration % (totalIterations / 20) == 0)) {
+            LOG(LOG_DEBUG) << (((double)chain.iteration) / ((double) totalIterations))*100 << "% done.";
         }
 
-        sampleStrategy_->sampleSentences(prevModel, reduced, rng, newSentences);
-//        if (iteration == 1) {
-//            std::cout << "initial sampled sentences: ";
-//            std::copy(newSentences.begin(), newSentences.end(), std::ostream_iterator<ELSentence>(std::cout, "\n"));
-//            std::cout << "initial model:";
-//            std::cout << prevModel;
-//            for (Domain::formula_const_iterator it = prevDomain.formulas_begin();
-//                    it != prevDomain.formulas_end();
-//                    it++) {
-//                std::cout << "formula " << *it << " is satisfied at: " << it->dSatisfied(prevModel, prevDomain) << std::endl;
-//            }
-//            std::cin.get();
-//        }
-
-        // make a new domain using new Sentences
-        Domain curDomain;
-        curDomain.setMaxInterval(prevDomain.maxInterval());
-        for (Domain::fact_const_iterator it = prevDomain.facts_begin(); it != prevDomain.facts_end(); it++) {
-            curDomain.addFact(*it);
-        }
-        for (std::vector<ELSentence>::const_iterator it = newSentences.begin(); it != newSentences.end(); it++) {
-            curDomain.addFormula(*it);
-        }
-        curDomain.addAtoms(prevDomain.atoms_begin(), prevDomain.atoms_end());
-//
-//        if (iteration == burnInIterations_ + numSamples_/2) {
-//            std::cout << "ITERATION: " << iteration << std::endl;
-//            std::cout << "curDomain";
-//            curDomain.printDebugDescription(std::cout);
-//            std::cout << "sampled sentences: ";
-//            std::copy(newSentences.begin(), newSentences.end(), std::ostream_iterator<ELSentence>(std::cout, "\n"));
-//        }
-
-
-        boost::unordered_set<Model> curModels = sampleSat(prevModel, curDomain, rng);
+        sampleStrategy_->sampleSentences(chain.model, reduced, chain.rng, newSentences);
+
+        // make a new domain using new Sentences.  it shares the facts and
+        // atoms of the reduced domain, so only the sampled sentences are new
+        Domain curDomain = reduced.withFormulas(newSentences.begin(), newSentences.end());
+
+        boost::unordered_set<Model> curModels = sampleSat(chain.model, curDomain, chain.rng, base.get());
         assert(!curModels.empty());
         // choose a random model
         boost::uniform_int<std::size_t> pickModel(0, curModels.size()-1);
-        boost::unordered_set<Model>::size_type index = pickModel(rng);
+        boost::unordered_set<Model>::size_type index = pickModel(chain.rng);
         boost::unordered_set<Model>::const_iterator it = curModels.begin();
         while (index > 0) {
             it++;
             index--;
         }
+        // sampleSat() always returns the model it started from
+        chain.attempts++;
+        if (curModels.size() > 1) chain.satisfied++;
+        if (*it != chain.model) chain.novel++;
         // add the model
-        if (iteration >= burnInIterations_) samples_.push_back(*it);
-        prevModel = *it;
-        prevDomain = curDomain;
+        if (chain.iteration >= burnInIterations_) record(*it, chain);
+        chain.model = *it;
+    }
+}
+
+void MCSat::advanceChainTask(std::vector<MCSat>& samplers, std::vector<Domain>& domains,
+        std::vector<ChainState>& chains, unsigned int untilSamples,
+        unsigned int worker, std::size_t chain) {
+    samplers[worker].advanceChain(domains[worker], chains[chain], untilSamples, chain == 0);
+}
+
+void MCSat::record(const Model& m, ChainState& chain) const {
+    if (keepSamples_) chain.samples.push_back(m);
+    std::size_t k = 0;
+    for (std::size_t q = 0; q < queryIds_.size(); q++, k++) {
+        bool holds = (m.getAtom(queryIds_[q]).contains(queryIntervals_[q]) == queryProps_[q].sign());
+        if (holds) chain.queryCounts[q]++;
+        addObservation(holds ? 1.0 : 0.0, chain.samplesCounted, chain.sum[k], chain.sumSq[k], chain.sumLag[k], chain.last[k]);
+    }
+    for (std::size_t q = 0; q < marginalIds_.size(); q++, k++) {
+        unsigned long trueAt = addIntervalCounts(m.getAtom(marginalIds_[q]), marginalInterval_, 1, chain.marginalDiffs[q]);
+        double fraction = (marginalInterval_.size() == 0 ? 0.0 : (double)trueAt / marginalInterval_.size());
+        addObservation(fraction, chain.samplesCounted, chain.sum[k], chain.sumSq[k], chain.sumLag[k], chain.last[k]);
+    }
+    chain.samplesCounted++;
+}
+
+void MCSat::merge(ChainState& chain) {
+    if (samples_.empty()) {
+        samples_.swap(chain.samples);
+    } else {
+        samples_.insert(samples_.end(), chain.samples.begin(), chain.samples.end());
+    }
+    samplesCounted_ += chain.samplesCounted;
+    for (std::size_t q = 0; q < queryCounts_.size(); q++) {
+        queryCounts_[q] += chain.queryCounts[q];
+    }
+    for (std::size_t q = 0; q < marginalCounts_.size(); q++) {
+        std::vector<unsigned int>& counts = marginalCounts_[q];
+        if (counts.empty()) counts.resize(marginalInterval_.size(), 0);
+        addDiffsTo(chain.marginalDiffs[q], marginalInterval_.size(), counts);
     }
 }
 
+MCSatDiagnostics MCSat::computeDiagnostics(const std::vector<ChainState>& chains) const {
+    MCSatDiagnostics diag;
+    unsigned int attempts = 0, satisfied = 0, novel = 0;
+    for (std::vector<ChainState>::const_iterator it = chains.begin(); it != chains.end(); it++) {
+        diag.samples += it->samplesCounted;
+        attempts += it->attempts;
+        satisfied += it->satisfied;
+        novel += it->novel;
+    }
+    diag.acceptanceRate = (attempts == 0 ? 0.0 : (double)satisfied / attempts);
+    diag.novelRate = (attempts == 0 ? 0.0 : (double)novel / attempts);
+
+    std::size_t quantities = queryProps_.size() + marginalAtoms_.size();
+    for (std::size_t k = 0; k < quantities; k++) {
+        double sum = 0.0, sumSq = 0.0, ess = 0.0;
+        // chain means and variances, for R-hat
+        std::vector<double> means, variances;
+        double n = 0.0;
+        for (std::vector<ChainState>::const_iterator it = chains.begin(); it != chains.end(); it++) {
+            if (it->samplesCounted == 0) continue;
+            sum += it->sum[k];
+            sumSq += it->sumSq[k];
+            ess += chainEss(it->samplesCounted, it->sum[k], it->sumSq[k], it->sumLag[k]);
+            if (it->samplesCounted < 2) continue;
+            double chainN = it->samplesCounted;
+            double chainMean = it->sum[k] / chainN;
+            means.push_back(chainMean);
+            variances.push_back(std::max(0.0, (it->sumSq[k] - chainN*chainMean*chainMean) / (chainN - 1)));
+            n += chainN;
+        }
+        double mean = (diag.samples == 0 ? 0.0 : sum / diag.samples);
+        double variance = (diag.samples == 0 ? 0.0 : std::max(0.0, sumSq / diag.samples - mean*mean));
+        diag.mean.push_back(mean);
+        diag.ess.push_back(ess);
+        diag.stdError.push_back(ess > 0.0 ? std::sqrt(variance / ess) : std::numeric_limits<double>::infinity());
+        diag.rHat.push_back(gelmanRubin(means, variances, means.empty() ? 0.0 : n / means.size()));
+    }
+    return diag;
+}
+
+bool MCSat::converged(const MCSatDiagnostics& diag) const {
+    if (diag.mean.empty()) return false;    // nothing to judge precision by
+    for (std::size_t k = 0; k < diag.mean.size(); k++) {
+        if (!(diag.stdError[k] <= targetPrecision_)) return false;
+        if (!boost::math::isnan(diag.rHat[k]) && !(diag.rHat[k] <= maxRHat_)) return false;
+    }
+    return true;
+}
+
+void MCSat::writeTrace(const MCSatDiagnostics& diag, bool header) const {
+    std::ostream& out = *trace_;
+    if (header) {
+        out << "samples\tacceptance\tnovel";
+        for (std::size_t q = 0; q < queryProps_.size(); q++) {
+            out << "\tq" << q << "_mean\tq" << q << "_ess\tq" << q << "_se\tq" << q << "_rhat";
+        }
+        for (std::size_t q = 0; q < marginalAtoms_.size(); q++) {
+            out << "\tm" << q << "_mean\tm" << q << "_ess\tm" << q << "_se\tm" << q << "_rhat";
+        }
+        out << "\n";
+    }
+    out << diag.samples << "\t" << diag.acceptanceRate << "\t" << diag.novelRate;
+    for (std::size_t k = 0; k < diag.mean.size(); k++) {
+        out << "\t" << diag.mean[k] << "\t" << diag.ess[k] << "\t" << diag.stdError[k] << "\t" << diag.rHat[k];
+    }
+    out << std::endl;
+}
+
+std::vector<std::vector<unsigned int> > MCSat::countMarginals(const std::vector<Atom>& atoms,
+        unsigned int maxLength) const {
+    if (d_ == 0) throw std::logic_error("MCSat::countMarginals() - Domain not set");
+    if (maxLength == 0) throw std::logic_error("MCSat::countMarginals() - maxLength must be at least 1");
+    Interval where = d_->maxInterval();
+    std::size_t timesteps = where.size();
+    std::vector<std::vector<unsigned int> > counts(atoms.size());
+
+    if (!keepSamples_) {
+        // only the registered per-timestep grids are available
+        for (std::size_t a = 0; a < atoms.size(); a++) {
+            std::vector<Atom>::const_iterator found = std::find(marginalAtoms_.begin(), marginalAtoms_.end(), atoms[a]);
+            if (maxLength != 1 || found == marginalAtoms_.end() || marginalInterval_ != where) {
+                throw std::logic_error("MCSat::countMarginals() - samples weren't kept and the marginal wasn't registered before run()");
+            }
+            counts[a] = marginalCounts_[found - marginalAtoms_.begin()];
+            counts[a].resize(timesteps, 0);
+        }
+        return counts;
+    }
+
+    for (std::size_t a = 0; a < atoms.size(); a++) {
+        AtomId id = d_->atomId(atoms[a]);
+        std::vector<int> diffs(maxLength * (timesteps+1), 0);
+        for (std::vector<Model>::const_iterator it = samples_.begin(); it != samples_.end(); it++) {
+            addIntervalCounts(it->getAtom(id), where, maxLength, diffs);
+        }
+        counts[a].resize(maxLength * timesteps, 0);
+        addDiffsTo(diffs, timesteps, counts[a]);
+    }
+    return counts;
+}
+
 Domain MCSat::applyUP(const Domain& d) {
     Domain reduced;
     try {
@@ -123,7 +427,25 @@ Domain MCSat::applyUP(const Domain& d) {
         // rewrite error message
         throw contradiction("Contradiction found in MCSat::run() when running unit prop()");
     }
+    checkHardClauses(reduced);
+    return reduced;
+}
 
+Domain MCSat::applyUP(const std::vector<ELSentence>& formulas, UnitPropagator& base) {
+    Domain reduced;
+    try {
+        base.push(formulas);
+    } catch (contradiction& c) {
+        // rewrite error message
+        throw contradiction("Contradiction found in MCSat::run() when running unit prop()");
+    }
+    reduced = base.domain();
+    base.pop();
+    checkHardClauses(reduced);
+    return reduced;
+}
+
+void MCSat::checkHardClauses(const Domain& reduced) {
     // default model is guaranteed to satisfy the facts
     Model m = reduced.defaultModel();
     // check to make sure hard clauses are satisfied
@@ -134,7 +456,6 @@ Domain MCSat::applyUP(const Domain& d) {
             throw contradiction("Contradiction found in MCSat::run() when verifying hard clauses are satisfied");
         }
     }
-    return reduced;
 }
 
 /*
@@ -173,67 +494,88 @@ void MCSatSampleSegmentsStrategy::sampleSentences(const Model& m, const Domain&
 */
 
 boost::unordered_set<Model> MCSat::sampleSat(const Model& initialModel, const Domain& d, boost::mt19937& rng) {
+    return sampleSat(initialModel, d, rng, 0);
+}
+
+boost::unordered_set<Model> MCSat::sampleSat(const Model& initialModel, const Domain& d, boost::mt19937& rng,
+        UnitPropagator* base) {
     boost::unordered_set<Model> models;
     models.insert(initialModel); // always include the initial model
 
     // transform domain into a SAT problem
-    Domain dSat;
-    for (Domain::fact_const_iterator it = d.facts_begin(); it != d.facts_end(); it++) {
-        dSat.addFact(*it);
-    }
-    for (Domain::formula_const_iterator it = d.formulas_begin(); it != d.formulas_end(); it++) {
-        ELSentence s = *it;
-        s.setHasInfWeight(true);
-        dSat.addFormula(s);
+    std::vector<ELSentence> hardForms(d.formulas_begin(), d.formulas_end());
+    for (std::vector<ELSentence>::iterator it = hardForms.begin(); it != hardForms.end(); it++) {
+        it->setHasInfWeight(true);
     }
-    dSat.addAtoms(d.atoms_begin(), d.atoms_end());
-    // perform UP (if possible)
+    // perform UP (if possible).  base has d's facts propagated already, so
+    // only the hard forms need propagating
     Domain reduced;
     if (useUnitPropagation_) {
         try {
-            reduced = MCSat::applyUP(dSat);
+            reduced = (base != 0 ? MCSat::applyUP(hardForms, *base)
+                    : MCSat::applyUP(d.withFormulas(hardForms.begin(), hardForms.end())));
         } catch (contradiction& c) {
             return models;  // can't continue, just return our models which has only one item.
         }
     } else {
-        reduced = dSat;
+        reduced = d.withFormulas(hardForms.begin(), hardForms.end());
     }
 
     // rewrite infinite weighted formulas so they have singular weight
     reduced = reduced.replaceInfForms();
 
     // do some random restarts and hope for different models
-    MWSSolver walksatSolver(walksatIterations_, walksatRandomMoveProb_, &reduced);
-    for (unsigned int i = 1; i <= walksatNumRandomRestarts_; i++) {
-        Model iterInitModel = reduced.randomModel(rng);   // TODO: better way to make random models
-        if (reduced.formulas_size() == 0) {
-            // just add the random model and continue
+    if (reduced.formulas_size() == 0) {
+        // nothing to search for; just add random models
+        for (unsigned int i = 1; i <= walksatNumRandomRestarts_; i++) {
             models.insert(reduced.randomModel(rng));
-            continue;
         }
+        return models;
+    }
+    std::vector<Model> initModels;
+    for (unsigned int i = 1; i <= walksatNumRandomRestarts_; i++) {
+        initModels.push_back(reduced.randomModel(rng));   // TODO: better way to make random models
+    }
 
-        //std::cout << "--\nFormulas for maxwalksat: ";
-        //std::copy(reduced.formulas_begin(), reduced.formulas_end(), std::ostream_iterator<ELSentence>(std::cout, ", "));
-        //std::cout << std::endl;
-
-        Model iterModel = walksatSolver.run(rng, iterInitModel);
-        if (reduced.isFullySatisfied(iterModel)) models.insert(iterModel);
+    MWSSolver walksatSolver(walksatIterations_, walksatRandomMoveProb_, &reduced);
+    walksatSolver.setNumThreads(numThreads_);
+    std::vector<Model> found = walksatSolver.runRestarts(rng, initModels);
+    for (std::vector<Model>::const_iterator it = found.begin(); it != found.end(); it++) {
+        if (reduced.isFullySatisfied(*it)) models.insert(*it);
     }
     return models;
 }
 
 double MCSat::estimateProbability(const Proposition& prop, const Interval& where) const {
-    return ((double)countProps(prop, where)) / ((double) numSamples_);
+    if (samplesCounted_ == 0) return 0.0;
+    return ((double)countProps(prop, where)) / ((double) samplesCounted_);
 }
 
 unsigned int MCSat::countProps(const Proposition& prop, const Interval& where) const {
-    assert(samples_.size() == numSamples_);
+    // answer from the registered queries if we can
+    for (std::size_t q = 0; q < queryProps_.size(); q++) {
+        if (queryProps_[q] == prop && queryIntervals_[q] == where) return queryCounts_[q];
+    }
+    if (!marginalInterval_.isNull() && where.start() == where.finish()
+            && where.start() >= marginalInterval_.start() && where.finish() <= marginalInterval_.finish()) {
+        for (std::size_t q = 0; q < marginalAtoms_.size(); q++) {
+            if (marginalAtoms_[q] != prop.atom() || marginalCounts_[q].empty()) continue;
+            unsigned int trueCount = marginalCounts_[q][where.start() - marginalInterval_.start()];
+            return (prop.sign() ? trueCount : samplesCounted_ - trueCount);
+        }
+    }
+    if (!keepSamples_) {
+        throw std::logic_error("MCSat::countProps() - samples weren't kept and the query wasn't registered before run()");
+    }
     unsigned int count = 0;
 
+    // look the atom up once rather than once per sample.  an atom that was
+    // never interned isn't in any sample, and noAtomId isn't in any model
+    AtomId id;
+    if (!AtomTable::global().find(prop.atom(), id)) id = noAtomId;
     for (std::vector<Model>::const_iterator it = samples_.begin(); it != samples_.end(); it++) {
-        SISet trueAt = it->getAtom(prop.atom());
-        if ((trueAt.includes(where) && prop.sign())
-                || (!trueAt.includes(where) && !prop.sign())) {
+        const SISet& trueAt = it->getAtom(id);
+        if (trueAt.contains(where) == prop.sign()) {
             count++;
         }
     }
@@ -311,7 +653,21 @@ bool operator==(const MCSat& l, const MCSat& r) {
             l.walksatNumRandomRestarts_ == r.walksatNumRandomRestarts_ &&
             l.useRandomInitialModels_ == r.useRandomInitialModels_ &&
             l.useUnitPropagation_ == r.useUnitPropagation_ &&
+            l.numChains_ == r.numChains_ &&
+            l.keepSamples_ == r.keepSamples_ &&
             l.samples_ == r.samples_ &&
+            l.sampleChains_ == r.sampleChains_ &&
+            l.queryProps_ == r.queryProps_ &&
+            l.queryIntervals_ == r.queryIntervals_ &&
+            l.queryCounts_ == r.queryCounts_ &&
+            l.marginalAtoms_ == r.marginalAtoms_ &&
+            l.marginalCounts_ == r.marginalCounts_ &&
+            l.marginalInterval_.isNull() == r.marginalInterval_.isNull() &&
+            (l.marginalInterval_.isNull() || l.marginalInterval_ == r.marginalInterval_) &&
+            l.samplesCounted_ == r.samplesCounted_ &&
+            l.targetPrecision_ == r.targetPrecision_ &&
+            l.maxRHat_ == r.maxRHat_ &&
+            l.diagnosticInterval_ == r.diagnosticInterval_ &&
             (l.sampleStrategy_ == r.sampleStrategy_ || (l.sampleStrategy_ != NULL && r.sampleStrategy_ != NULL && *l.sampleStrategy_ == *r.sampleStrategy_))
             );
 //    ar & d_;
@@ -9,6 +9,8 @@
 #define MCSAT_H_
 
 #include <vector>
+#include <algorithm>
+#include <iostream>
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/vector.hpp>
@@ -19,6 +21,25 @@
 #include "MCSatSampleLiquidlyStrategy.h"
 
 class Model;
+class UnitPropagator;
+
+/**
+ * Convergence diagnostics for an MCSat run.  They cover each query
+ * registered with MCSat::addQuery() (in order), followed by each marginal
+ * registered with MCSat::addMarginalQuery(), where the value of a sample is
+ * the fraction of timesteps at which the atom is true.
+ */
+struct MCSatDiagnostics {
+    MCSatDiagnostics();
+
+    unsigned int samples;           // samples taken, over all chains
+    double acceptanceRate;          // fraction of sampleSat() calls that found a satisfying model
+    double novelRate;               // fraction of iterations that moved a chain to a different model
+    std::vector<double> mean;       // estimate of each quantity
+    std::vector<double> ess;        // effective sample size, summed over the chains
+    std::vector<double> stdError;   // Monte Carlo standard error of mean
+    std::vector<double> rHat;       // Gelman-Rubin R-hat across chains; NaN with one chain
+};
 
 class MCSat {
 public:
@@ -29,6 +50,8 @@ public:
     static const unsigned int defWalksatNumRandomRestarts;
     static const bool defUseRandomInitialModels;
     static const bool defUseUnitPropagation;
+    static const unsigned int defDiagnosticInterval;
+    static const double defMaxRHat;
 
     boost::unordered_set<Model> sampleSat(const Model& initialModel, const Domain& d, boost::mt19937& rng);
 
@@ -50,13 +73,25 @@ public:
     unsigned int walksatNumRandomRestarts() const;
     bool useRandomInitialModels() const;
     bool useUnitPropagation() const;
-
+    unsigned int numThreads() const;
+    unsigned int numChains() const;
+    bool keepSamples() const;
+    double targetPrecision() const;
+    double maxRHat() const;
+    unsigned int diagnosticInterval() const;
 
     const_iterator begin() const;
     const_iterator end() const;
     const MCSatSampleStrategy* sampleStrategy() const;
     std::size_t size() const;
 
+    /**
+     * @param sample  index of a sample (in begin() order)
+     * @return the chain that produced the sample, between 0 and
+     *   numChains()-1
+     */
+    unsigned int chainOf(std::size_t sample) const;
+
     void setDomain(const Domain *d);
     void setNumSamples(unsigned int numSamples);
     void setBurnInIterations(unsigned int burnInIterations);
@@ -67,12 +102,112 @@ public:
     void setUseRandomInitialModels(bool b);
     void setUseUnitPropagation(bool b);
 
+    /**
+     * Set the number of threads used to run the walksat restarts in
+     * sampleSat() concurrently (see MWSSolver::runRestarts()).  This is a
+     * runtime setting, so it isn't archived or compared.
+     */
+    void setNumThreads(unsigned int numThreads);
+
+    /**
+     * Set the number of independent Markov chains run() uses.  Each chain
+     * does its own burn-in from its own initial model and random stream, and
+     * contributes its share of numSamples() to the merged samples.  Chains
+     * run concurrently on up to numThreads() threads.
+     */
+    void setNumChains(unsigned int numChains);
+
+    /**
+     * Choose whether run() stores every sample (the default) or only
+     * updates the counts of the registered queries.  Without the samples,
+     * countProps() and estimateProbability() can only answer registered
+     * queries, but memory use and archive size no longer grow with the
+     * number of samples.
+     */
+    void setKeepSamples(bool b);
+
+    /**
+     * Register a query to be counted while sampling: the number of samples
+     * where prop holds over all of where.  Queries must be added before
+     * run().
+     *
+     * @return the query's index, for queryCount()
+     */
+    std::size_t addQuery(const Proposition& prop, const Interval& where);
+
+    /**
+     * Register a per-timestep marginal query for an atom: for each timestep
+     * t in the domain's max interval, the number of samples where the atom
+     * is true at [t:t].  Queries must be added before run().
+     *
+     * @return the query's index, for marginalCounts()
+     */
+    std::size_t addMarginalQuery(const Atom& atom);
+    void clearQueries();
+
+    /**
+     * Stop sampling early once every diagnostic quantity (see
+     * MCSatDiagnostics) has a standard error of at most precision and, with
+     * several chains, an R-hat of at most maxRHat().  The check runs every
+     * diagnosticInterval() samples per chain.  0 (the default) disables
+     * early stopping.
+     */
+    void setTargetPrecision(double precision);
+    void setMaxRHat(double maxRHat);
+    void setDiagnosticInterval(unsigned int samples);
+
+    /**
+     * Write the diagnostics as tab-separated lines to out every
+     * diagnosticInterval() samples per chain, starting with a header line.
+     * The stream isn't owned or archived; pass 0 to stop tracing.
+     */
+    void setTraceStream(std::ostream* out);
+
+    /**
+     * @return the diagnostics as of the end of the last run()
+     */
+    const MCSatDiagnostics& diagnostics() const;
+
+    /**
+     * @return the number of samples the query counts cover; this is size()
+     *   when samples are kept
+     */
+    unsigned int samplesCounted() const;
+    unsigned int queryCount(std::size_t query) const;
+
+    /**
+     * @return counts for a marginal query, indexed by timestep minus
+     *   marginalInterval().start()
+     */
+    const std::vector<unsigned int>& marginalCounts(std::size_t query) const;
+    Interval marginalInterval() const;
+
     void clear();
 
     void run(boost::mt19937& rng);
     double estimateProbability(const Proposition& prop, const Interval& where) const;
     unsigned int countProps(const Proposition& prop, const Interval& where) const;
 
+    /**
+     * Count, in one pass over the samples, how many samples have each atom
+     * true at each timestep of the domain's max interval, and optionally
+     * over each interval up to maxLength timesteps long.  The counts come
+     * from a sweep over each sample's spanning intervals, so the cost is
+     * proportional to the number of intervals in the samples rather than
+     * the number of timesteps queried.
+     *
+     * Without kept samples (see setKeepSamples()), only per-timestep
+     * counts for atoms registered with addMarginalQuery() are available.
+     *
+     * @param atoms      the atoms to count
+     * @param maxLength  longest interval to count
+     * @return counts[a][(len-1)*T + (t-start)] is the number of samples
+     *   where atoms[a] holds over [t:t+len-1], where T and start are the
+     *   size and start of the domain's max interval
+     */
+    std::vector<std::vector<unsigned int> > countMarginals(const std::vector<Atom>& atoms,
+            unsigned int maxLength=1) const;
+
     friend bool operator==(const MCSat& l, const MCSat& r);
     friend bool operator!=(const MCSat& l, const MCSat& r);
 private:
@@ -81,6 +216,40 @@ private:
     void serialize(Archive& ar, const unsigned int version);
 
     static Domain applyUP(const Domain& d);   // TODO: move this to UnitProp.h eventually
+    // propagate formulas on top of base (which is left as it was)
+    static Domain applyUP(const std::vector<ELSentence>& formulas, UnitPropagator& base);
+    static void checkHardClauses(const Domain& reduced);
+    // sampleSat() on d, reusing base's propagation of d's facts
+    boost::unordered_set<Model> sampleSat(const Model& initialModel, const Domain& d, boost::mt19937& rng,
+            UnitPropagator* base);
+    // one Markov chain: where it is, and what it has produced so far
+    struct ChainState {
+        boost::mt19937 rng;
+        Model model;                    // the chain's current model
+        unsigned int iteration;         // next iteration to run
+        unsigned int numSamples;        // samples this chain should take
+        std::vector<Model> samples;
+        std::vector<unsigned int> queryCounts;
+        std::vector<std::vector<int> > marginalDiffs;    // see addIntervalCounts()
+        unsigned int samplesCounted;
+        // sampleSat() calls, how many found a model, how many moved the chain
+        unsigned int attempts, satisfied, novel;
+        // running sums of each diagnostic quantity, its square, and its
+        // product with the previous sample's value
+        std::vector<double> sum, sumSq, sumLag, last;
+    };
+
+    void startChain(const Domain& reduced, ChainState& chain) const;
+    void advanceChain(const Domain& reduced, ChainState& chain, unsigned int untilSamples,
+            bool showProgress);
+    void record(const Model& m, ChainState& chain) const;
+    void merge(ChainState& chain);
+    MCSatDiagnostics computeDiagnostics(const std::vector<ChainState>& chains) const;
+    bool converged(const MCSatDiagnostics& diag) const;
+    void writeTrace(const MCSatDiagnostics& diag, bool header) const;
+    static void advanceChainTask(std::vector<MCSat>& samplers, std::vector<Domain>& domains,
+            std::vector<ChainState>& chains, unsigned int untilSamples,
+            unsigned int worker, std::size_t chain);
 
     const Domain* d_;
 
@@ -91,8 +260,29 @@ private:
     unsigned int walksatNumRandomRestarts_;
     bool useRandomInitialModels_;
     bool useUnitPropagation_;
+    unsigned int numThreads_;
+    unsigned int numChains_;
+    bool keepSamples_;
+    double targetPrecision_;
+    double maxRHat_;
+    unsigned int diagnosticInterval_;
+    std::ostream* trace_;               // not owned or archived
+    MCSatDiagnostics diagnostics_;      // not archived
 
     std::vector<Model> samples_;
+    std::vector<unsigned int> sampleChains_;    // chain that produced each sample
+
+    // registered queries and their counts over the samples taken so far
+    std::vector<Proposition> queryProps_;
+    std::vector<Interval> queryIntervals_;
+    std::vector<unsigned int> queryCounts_;
+    std::vector<Atom> marginalAtoms_;
+    std::vector<std::vector<unsigned int> > marginalCounts_;
+    Interval marginalInterval_;
+    unsigned int samplesCounted_;
+    // atom ids of the queries above, filled in by run().  not archived
+    std::vector<AtomId> queryIds_;
+    std::vector<AtomId> marginalIds_;
     MCSatSampleStrategy *sampleStrategy_;
 };
 
@@ -147,7 +337,25 @@ inline MCSat::MCSat(const Domain *d)
       walksatNumRandomRestarts_(defWalksatNumRandomRestarts),
       useRandomInitialModels_(defUseRandomInitialModels),
       useUnitPropagation_(defUseUnitPropagation),
+      numThreads_(1),
+      numChains_(1),
+      keepSamples_(true),
+      targetPrecision_(0.0),
+      maxRHat_(defMaxRHat),
+      diagnosticInterval_(defDiagnosticInterval),
+      trace_(0),
+      diagnostics_(),
       samples_(),
+      sampleChains_(),
+      queryProps_(),
+      queryIntervals_(),
+      queryCounts_(),
+      marginalAtoms_(),
+      marginalCounts_(),
+      marginalInterval_(),
+      samplesCounted_(0),
+      queryIds_(),
+      marginalIds_(),
       sampleStrategy_(0) {
     // use default strategy of liquid strategy
     sampleStrategy_ = new MCSatSampleLiquidlyStrategy();
@@ -163,7 +371,25 @@ inline MCSat::MCSat(const MCSat& m)
       walksatNumRandomRestarts_(m.walksatNumRandomRestarts_),
       useRandomInitialModels_(m.useRandomInitialModels_),
       useUnitPropagation_(m.useUnitPropagation_),
+      numThreads_(m.numThreads_),
+      numChains_(m.numChains_),
+      keepSamples_(m.keepSamples_),
+      targetPrecision_(m.targetPrecision_),
+      maxRHat_(m.maxRHat_),
+      diagnosticInterval_(m.diagnosticInterval_),
+      trace_(m.trace_),
+      diagnostics_(m.diagnostics_),
       samples_(m.samples_),
+      sampleChains_(m.sampleChains_),
+      queryProps_(m.queryProps_),
+      queryIntervals_(m.queryIntervals_),
+      queryCounts_(m.queryCounts_),
+      marginalAtoms_(m.marginalAtoms_),
+      marginalCounts_(m.marginalCounts_),
+      marginalInterval_(m.marginalInterval_),
+      samplesCounted_(m.samplesCounted_),
+      queryIds_(m.queryIds_),
+      marginalIds_(m.marginalIds_),
       sampleStrategy_(m.sampleStrategy_ == 0 ? 0 : m.sampleStrategy_->clone()) {}
 
 inline MCSat::~MCSat() {
@@ -182,7 +408,25 @@ inline void swap(MCSat& l, MCSat& r) {
     swap(l.walksatNumRandomRestarts_, r.walksatNumRandomRestarts_);
     swap(l.useRandomInitialModels_, r.useRandomInitialModels_);
     swap(l.useUnitPropagation_, r.useUnitPropagation_);
+    swap(l.numThreads_, r.numThreads_);
+    swap(l.numChains_, r.numChains_);
+    swap(l.keepSamples_, r.keepSamples_);
+    swap(l.targetPrecision_, r.targetPrecision_);
+    swap(l.maxRHat_, r.maxRHat_);
+    swap(l.diagnosticInterval_, r.diagnosticInterval_);
+    swap(l.trace_, r.trace_);
+    swap(l.diagnostics_, r.diagnostics_);
     swap(l.samples_, r.samples_);
+    swap(l.sampleChains_, r.sampleChains_);
+    swap(l.queryProps_, r.queryProps_);
+    swap(l.queryIntervals_, r.queryIntervals_);
+    swap(l.queryCounts_, r.queryCounts_);
+    swap(l.marginalAtoms_, r.marginalAtoms_);
+    swap(l.marginalCounts_, r.marginalCounts_);
+    swap(l.marginalInterval_, r.marginalInterval_);
+    swap(l.samplesCounted_, r.samplesCounted_);
+    swap(l.queryIds_, r.queryIds_);
+    swap(l.marginalIds_, r.marginalIds_);
     swap(l.sampleStrategy_, r.sampleStrategy_);
 }
 
@@ -199,8 +443,22 @@ inline MCSat::const_iterator MCSat::begin() const { return samples_.begin();}
 inline MCSat::const_iterator MCSat::end() const { return samples_.end();}
 inline const MCSatSampleStrategy* MCSat::sampleStrategy() const { return sampleStrategy_;}
 inline std::size_t MCSat::size() const {return samples_.size(); }
+inline unsigned int MCSat::chainOf(std::size_t sample) const { return sampleChains_.at(sample);}
 inline bool MCSat::useRandomInitialModels() const {return useRandomInitialModels_;}
 inline bool MCSat::useUnitPropagation() const { return useUnitPropagation_;}
+inline unsigned int MCSat::numThreads() const { return numThreads_;}
+inline unsigned int MCSat::numChains() const { return numChains_;}
+inline bool MCSat::keepSamples() const { return keepSamples_;}
+inline double MCSat::targetPrecision() const { return targetPrecision_;}
+inline double MCSat::maxRHat() const { return maxRHat_;}
+inline unsigned int MCSat::diagnosticInterval() const { return diagnosticInterval_;}
+inline const MCSatDiagnostics& MCSat::diagnostics() const { return diagnostics_;}
+inline unsigned int MCSat::samplesCounted() const { return samplesCounted_;}
+inline unsigned int MCSat::queryCount(std::size_t query) const { return queryCounts_.at(query);}
+inline const std::vector<unsigned int>& MCSat::marginalCounts(std::size_t query) const {
+    return marginalCounts_.at(query);
+}
+inline Interval MCSat::marginalInterval() const { return marginalInterval_;}
 
 
 inline void MCSat::setDomain(const Domain* d) {d_ = d;}
@@ -214,8 +472,54 @@ inline void MCSat::setSampleStrategy(MCSatSampleStrategy *strategy) {
 }
 inline void MCSat::setUseRandomInitialModels(bool b) {useRandomInitialModels_ = b;}
 inline void MCSat::setUseUnitPropagation(bool b) {useUnitPropagation_ = b;}
+inline void MCSat::setNumThreads(unsigned int numThreads) {
+    if (numThreads == 0) throw std::logic_error("MCSat::setNumThreads() - need at least one thread");
+    numThreads_ = numThreads;
+}
+inline void MCSat::setNumChains(unsigned int numChains) {
+    if (numChains == 0) throw std::logic_error("MCSat::setNumChains() - need at least one chain");
+    numChains_ = numChains;
+}
+inline void MCSat::setKeepSamples(bool b) {keepSamples_ = b;}
+inline void MCSat::setTargetPrecision(double precision) {
+    if (precision < 0.0) throw std::logic_error("MCSat::setTargetPrecision() - precision can't be negative");
+    targetPrecision_ = precision;
+}
+inline void MCSat::setMaxRHat(double maxRHat) {maxRHat_ = maxRHat;}
+inline void MCSat::setDiagnosticInterval(unsigned int samples) {
+    if (samples == 0) throw std::logic_error("MCSat::setDiagnosticInterval() - need at least one sample between checks");
+    diagnosticInterval_ = samples;
+}
+inline void MCSat::setTraceStream(std::ostream* out) {trace_ = out;}
+
+inline std::size_t MCSat::addQuery(const Proposition& prop, const Interval& where) {
+    queryProps_.push_back(prop);
+    queryIntervals_.push_back(where);
+    queryCounts_.push_back(0);
+    return queryProps_.size()-1;
+}
 
-inline void MCSat::clear() {samples_.clear();}
+inline std::size_t MCSat::addMarginalQuery(const Atom& atom) {
+    marginalAtoms_.push_back(atom);
+    marginalCounts_.push_back(std::vector<unsigned int>());
+    return marginalAtoms_.size()-1;
+}
+
+inline void MCSat::clearQueries() {
+    queryProps_.clear();
+    queryIntervals_.clear();
+    queryCounts_.clear();
+    marginalAtoms_.clear();
+    marginalCounts_.clear();
+}
+
+inline void MCSat::clear() {
+    samples_.clear();
+    sampleChains_.clear();
+    std::fill(queryCounts_.begin(), queryCounts_.end(), 0);
+    marginalCounts_.assign(marginalAtoms_.size(), std::vector<unsigned int>());
+    samplesCounted_ = 0;
+}
 /*
 inline MCSatSampleSegmentsStrategy::MCSatSampleSegmentsStrategy()
     : formulaToSegment_() {}
@@ -249,9 +553,40 @@ void MCSat::serialize(Archive& ar, const unsigned int version) {
     }
     ar & samples_;
     ar & sampleStrategy_;
+    if (version > 1) {
+        ar & numChains_;
+        ar & sampleChains_;
+    } else if (Archive::is_loading::value) {
+        // older archives come from a single chain
+        numChains_ = 1;
+        sampleChains_.assign(samples_.size(), 0);
+    }
+    if (version > 2) {
+        ar & keepSamples_;
+        ar & queryProps_;
+        ar & queryIntervals_;
+        ar & queryCounts_;
+        ar & marginalAtoms_;
+        ar & marginalCounts_;
+        ar & marginalInterval_;
+        ar & samplesCounted_;
+    } else if (Archive::is_loading::value) {
+        keepSamples_ = true;
+        clearQueries();
+        samplesCounted_ = samples_.size();
+    }
+    if (version > 3) {
+        ar & targetPrecision_;
+        ar & maxRHat_;
+        ar & diagnosticInterval_;
+    } else if (Archive::is_loading::value) {
+        targetPrecision_ = 0.0;
+        maxRHat_ = defMaxRHat;
+        diagnosticInterval_ = defDiagnosticInterval;
+    }
 }
 
-BOOST_CLASS_VERSION(MCSat, 1)
+BOOST_CLASS_VERSION(MCSat, 4)
 
 inline bool operator!=(const MCSat& l, const MCSat& r) { return !operator==(l,r);}
 
@@ -19,7 +19,8 @@ void MCSatSamplePerfectlyStrategy::sampleSentences(const Model& m, const Domain&
             sampled.push_back(curSentence); // have to take it
             continue;
         }
-        SISet satisfied = curSentence.dSatisfied(m, d);
+        // the compiled plan has its atoms' ids already
+        SISet satisfied = d.formulaSatisfied(it - d.formulas_begin(), m);
 
         double prob = 1.0 - exp(-(double)(curSentence.weight()));   // probability to sample an interval
         SISet where(false, d.maxInterval());
@@ -9,10 +9,12 @@
 #include "../logic/syntax/ELSentence.h"
 #include "../logic/Domain.h"
 #include "../logic/Moves.h"
+#include "../util/ThreadPool.h"
 #include <boost/random/uniform_int.hpp>
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/unordered_map.hpp>
 #include <limits>
+#include <memory>
 
 const unsigned int MWSSolver::defNumIterations = 1000;
 const double MWSSolver::defProbOfRandomMove = 0.2;
@@ -26,18 +28,99 @@ Model MWSSolver::run(boost::mt19937& rng) {
 }
 
 namespace {
-// we will calculate the resulting model and score for all
-// moves, and choose the highest scoring one to move to.  This struct
-// makes it a lot more convenient to do.
+// we will calculate the resulting score for all moves, and choose the
+// highest scoring one to move to.  Rather than keeping a copy of the model
+// and of every formula's score for each candidate, this struct only records
+// what the move changes: the formulas touching the move's atoms along with
+// their new scores.  The chosen move is then re-applied to the current model.
 struct MWSState {
     Move move;
-    Model model;
     double score;
-    // the three below here are copies of the versions above
-    std::vector<bool> localFormNeedUpdates;
-    std::vector<double> localScores;
-    std::vector<bool> localFormFullySat;
+    Domain::MoveScores rescored;
 };
+
+// fill in state for state.move applied to model, given the current score
+// of every formula (see Domain::scoreDelta())
+void evaluateMove(const Domain& d,
+        const Model& model,
+        const std::vector<double>& scores,
+        double currentScore,
+        EvaluationContext& context,
+        MWSState& state) {
+    state.score = currentScore + d.scoreDelta(state.move, model, scores, state.rescored, context);
+}
+
+// scores moves[i] into states[i] on behalf of a ThreadPool worker.  the
+// workers share the domain and the current model, whose caches have been
+// filled in (see Model::fillCaches()), so reading them writes nothing; each
+// move is applied to a copy of the model, which clones only the sets the
+// move touches, and scored with the worker's own evaluation context.
+struct ScoreMoveTask {
+    ScoreMoveTask(const Domain& d,
+            std::vector<EvaluationContext>& c,
+            const Model& m,
+            const std::vector<Move>& mv,
+            const std::vector<double>& fs,
+            double cs,
+            std::vector<MWSState>& st)
+        : domain(d), contexts(c), currentModel(m), moves(mv),
+          formScores(fs), currentScore(cs), states(st) {}
+
+    void operator()(unsigned int worker, std::size_t i) const {
+        states[i].move = moves[i];
+        evaluateMove(domain, currentModel, formScores, currentScore, contexts[worker], states[i]);
+    }
+
+    const Domain& domain;
+    std::vector<EvaluationContext>& contexts;
+    const Model& currentModel;
+    const std::vector<Move>& moves;
+    const std::vector<double>& formScores;
+    double currentScore;
+    std::vector<MWSState>& states;
+};
+
+// runs one restart of MWSSolver::runRestarts() on behalf of a ThreadPool
+// worker.  the restarts share the domain and the initial models, whose
+// caches have been filled in; each search scores with its own evaluation
+// context and only ever modifies its own copies of the models.
+struct RestartTask {
+    RestartTask(Domain* d,
+            unsigned int ni,
+            double p,
+            const std::vector<boost::mt19937::result_type>& s,
+            const std::vector<Model>& im,
+            std::vector<Model>& r)
+        : domain(d), numIterations(ni), probOfRandomMove(p), seeds(s),
+          initialModels(im), results(r) {}
+
+    void operator()(unsigned int /* worker */, std::size_t i) const {
+        MWSSolver solver(numIterations, probOfRandomMove, domain);
+        boost::mt19937 rng(seeds[i]);
+        results[i] = solver.run(rng, initialModels[i]);
+    }
+
+    Domain* domain;
+    unsigned int numIterations;
+    double probOfRandomMove;
+    const std::vector<boost::mt19937::result_type>& seeds;
+    const std::vector<Model>& initialModels;
+    std::vector<Model>& results;
+};
+
+// move to the given state, updating the running score in place
+void applyState(const MWSState& state, const Domain& d,
+        Model& model,
+        double& score,
+        std::vector<double>& formScores,
+        std::vector<bool>& formFullySat) {
+    model = executeMove(d, state.move, model);
+    score = state.score;
+    for (std::size_t i = 0; i < state.rescored.formulas.size(); i++) {
+        formScores[state.rescored.formulas[i]] = state.rescored.scores[i];
+        formFullySat[state.rescored.formulas[i]] = state.rescored.fullySatisfied[i];
+    }
+}
 }
 
 Model MWSSolver::run(boost::mt19937& rng, const Model& initialModel) {
@@ -73,34 +156,30 @@ Model MWSSolver::run(boost::mt19937& rng, const Model& initialModel) {
         }
     }
 
-    // now record which sentences contain each atom - this is used to cache
-    // the results of previous satisfied sentences.
-    boost::unordered_map<Atom, std::vector<std::vector<ELSentence>::size_type > > atomToSentence;
-    for (std::vector<ELSentence>::size_type i = 0;
-            i != formulas.size();
-            i++) {
-        AtomCollector collector;
-        formulas[i].sentence()->visit(collector);
-        for (AtomCollector::atom_set::const_iterator atomit = collector.atoms.begin();
-                atomit != collector.atoms.end();
-                atomit++) {
-            atomToSentence[*atomit].push_back(i);
-        }
-    }
-
     // setup stores for the score as well as whether each sentence is fully satisfied
     std::vector<double> formScores(formulas.size(), 0.0);
     std::vector<bool> formFullySat(formulas.size(), false);
     // also setup a vector we will use to mark which scores need updating
     std::vector<bool> formNeedUpdates(formulas.size(), true);
 
-    updateScores(formulas, initialModel, formNeedUpdates, formScores, formFullySat);
+    EvaluationContext context = domain_->newEvaluationContext();
+    updateScores(initialModel, formNeedUpdates, formScores, formFullySat, context);
 
     double currentScore = std::accumulate(formScores.begin(), formScores.end(), 0.0);
     double bestScore = currentScore;
     Model currentModel = initialModel;
     Model bestModel = initialModel;
 
+    // threads for scoring candidate moves, if we're using more than one,
+    // and an evaluation context for each
+    std::auto_ptr<ThreadPool> pool;
+    std::vector<EvaluationContext> contexts;
+    if (numThreads_ > 1) {
+        pool.reset(new ThreadPool(numThreads_));
+        contexts.resize(numThreads_, domain_->newEvaluationContext());
+        domain_->fillCaches();
+    }
+
     unsigned int showPeriodMod = (numIterations_ < 20 ? 1 : numIterations_/20); // TODO: make this configurable
     for (unsigned int iteration=1; iteration <= numIterations_; iteration++) {
         if (iteration % showPeriodMod == 0) {
@@ -170,7 +249,7 @@ Model MWSSolver::run(boost::mt19937& rng, const Model& initialModel) {
                 si = SpanInterval(start, start, finish, finish);
             }
             // make a random flip to add/subtract
-            Move::change ch(atom, si);
+            Move::change ch(AtomTable::global().intern(atom), si);
             boost::bernoulli_distribution<> flip(0.5);
             if (flip(rng)) {
                 nextMove.toAdd.push_back(ch);
@@ -209,10 +288,10 @@ Model MWSSolver::run(boost::mt19937& rng, const Model& initialModel) {
                 Move aMove = moves[movesPick(rng)];
                 LOG(LOG_DEBUG) << "taking random move: " << aMove.toString();
 
-                currentModel = updateWithMove(aMove, currentModel, atomToSentence, formNeedUpdates);
-                // update scores
-                updateScores(formulas, currentModel, formNeedUpdates, formScores, formFullySat);
-                currentScore = std::accumulate(formScores.begin(), formScores.end(), 0.0);
+                MWSState state;
+                state.move = aMove;
+                evaluateMove(*domain_, currentModel, formScores, currentScore, context, state);
+                applyState(state, *domain_, currentModel, currentScore, formScores, formFullySat);
             } else {
                 // instead of choosing a random move, choose the move that leads to the
                 // highest scoring move.
@@ -221,57 +300,43 @@ Model MWSSolver::run(boost::mt19937& rng, const Model& initialModel) {
                 // moves, and choose the highest scoring one to move to
                 MWSState bestMWSState;
 
-                bestMWSState.score = std::numeric_limits<double>::min();    // the lowest value possible
-                // also have a vector of best models in case of ties
+                bestMWSState.score = -std::numeric_limits<double>::infinity();
+                // also have a vector of best states in case of ties
                 std::vector<MWSState> ties;
 
-                //std::vector<std::pair<Model, double> > nearbyModels;
-                for (std::vector<Move>::const_iterator it = moves.begin(); it != moves.end(); it++) {
-                    Move m = *it;
-                    std::vector<bool> localFormNeedUpdates(formNeedUpdates);
-                    Model nearbyModel = updateWithMove(m, currentModel, atomToSentence, localFormNeedUpdates);
-
-                    std::vector<double> localScores(formScores);
-                    std::vector<bool> localFormFullySat(formFullySat);
-                    updateScores(formulas, nearbyModel, localFormNeedUpdates, localScores, localFormFullySat);
-                    double nearbyScore = std::accumulate(localScores.begin(), localScores.end(), 0.0);
+                std::vector<MWSState> states(moves.size());
+                if (pool.get() != 0 && moves.size() > 1) {
+                    currentModel.fillCaches();
+                    pool->parallelFor(moves.size(), ScoreMoveTask(*domain_, contexts, currentModel,
+                            moves, formScores, currentScore, states));
+                } else {
+                    for (std::size_t i = 0; i < moves.size(); i++) {
+                        states[i].move = moves[i];
+                        evaluateMove(*domain_, currentModel, formScores, currentScore, context, states[i]);
+                    }
+                }
 
-                    if (nearbyScore > bestMWSState.score) {
+                // pick the best in the order the moves were generated, so the
+                // result doesn't depend on how the scoring was scheduled
+                for (std::vector<MWSState>::const_iterator it = states.begin(); it != states.end(); it++) {
+                    if (it->score > bestMWSState.score) {
                         // save it
-                        bestMWSState.move = m;
-                        bestMWSState.model = nearbyModel;
-                        bestMWSState.score = nearbyScore;
-                        bestMWSState.localFormNeedUpdates = localFormNeedUpdates;
-                        bestMWSState.localScores = localScores;
-                        bestMWSState.localFormFullySat = localFormFullySat;
-
+                        bestMWSState = *it;
                         ties.clear();
-                        ties.push_back(bestMWSState);
-                    } else if (nearbyScore == bestMWSState.score) {
+                        ties.push_back(*it);
+                    } else if (it->score == bestMWSState.score) {
                         // found a tie
-                        MWSState tieState;
-                        tieState.move = m;
-                        tieState.model = nearbyModel;
-                        tieState.score = nearbyScore;
-                        tieState.localFormNeedUpdates = localFormNeedUpdates;
-                        tieState.localScores = localScores;
-                        tieState.localFormFullySat = localFormFullySat;
-
-                        ties.push_back(tieState);
+                        ties.push_back(*it);
                     }
                 }
-                assert(bestMWSState.score > std::numeric_limits<double>::min());
+                assert(bestMWSState.score > -std::numeric_limits<double>::infinity());
                 if (ties.size() > 1) {
                     // pick a choice randomly
                     boost::uniform_int<std::size_t> tieChoice(0, ties.size()-1);
                     bestMWSState = ties[tieChoice(rng)];
                 }
                 LOG(LOG_DEBUG) << "taking move " << bestMWSState.move.toString();
-                currentModel = bestMWSState.model;
-                currentScore = bestMWSState.score;
-                formNeedUpdates = bestMWSState.localFormNeedUpdates;
-                formScores = bestMWSState.localScores;
-                formFullySat = bestMWSState.localFormFullySat;
+                applyState(bestMWSState, *domain_, currentModel, currentScore, formScores, formFullySat);
             }
         }
         // check to see if its the best score foudn so far
@@ -283,6 +348,14 @@ Model MWSSolver::run(boost::mt19937& rng, const Model& initialModel) {
 
     }
     LOG(LOG_INFO) << "returning the best model found with a score of " << bestScore;
+    SatisfactionCacheStats cacheStats = context.cache.stats();
+    for (std::vector<EvaluationContext>::const_iterator it = contexts.begin(); it != contexts.end(); it++) {
+        cacheStats.hits += it->cache.stats().hits;
+        cacheStats.misses += it->cache.stats().misses;
+        cacheStats.evictions += it->cache.stats().evictions;
+    }
+    LOG(LOG_DEBUG) << "satisfaction cache: " << cacheStats.hits << " hits, " << cacheStats.misses
+            << " misses, " << cacheStats.evictions << " evictions";
     return bestModel;
 
 //    for (int iteration=1; iteration <= numIterations; iteration++) {
@@ -396,42 +469,6 @@ Model MWSSolver::run(boost::mt19937& rng, const Model& initialModel) {
     throw e;
 }
 
-Model MWSSolver::updateWithMove(const Move& m,
-        const Model& currentModel,
-        const boost::unordered_map<Atom, std::vector<std::vector<ELSentence>::size_type > >& atomMap,
-        std::vector<bool>& formsNeedUpdate) {
-    // scan over all atoms in the move - if its being modified, mark the formula as needing update
-    boost::unordered_set<Atom> moveAtoms;
-    for (std::vector<Move::change>::const_iterator it = m.toAdd.begin();
-            it != m.toAdd.end();
-            it++) {
-        moveAtoms.insert(it->get<0>());
-    }
-    for (std::vector<Move::change>::const_iterator it = m.toDel.begin();
-            it != m.toDel.end();
-            it++) {
-        moveAtoms.insert(it->get<0>());
-    }
-
-    for (boost::unordered_set<Atom>::const_iterator it = moveAtoms.begin();
-            it != moveAtoms.end();
-            it++) {
-        Atom a = *it;
-        if (atomMap.count(a)) {
-            // TODO: loop over all sentences
-            std::vector<std::vector<ELSentence>::size_type > formsWithAtom = atomMap.at(a);
-            for (std::vector<std::vector<ELSentence>::size_type >::const_iterator atomIt = formsWithAtom.begin();
-                    atomIt != formsWithAtom.end();
-                    atomIt++) {
-            formsNeedUpdate[*atomIt] = true;
-            }
-        }
-    }
-
-    // now execute the move
-    return executeMove(*domain_, m, currentModel);
-}
-
 /*
 Model maxWalkSat(Domain& d,
         int numIterations,
@@ -660,11 +697,67 @@ namespace {
 }
 */
 
-void MWSSolver::updateScores(const std::vector<ELSentence>& formulas,
-        const Model& model,
+std::vector<Model> MWSSolver::runRestarts(boost::mt19937& rng, const std::vector<Model>& initialModels) {
+    if (domain_ == NULL) {
+        std::logic_error e("unable to run MWSSolver with Domain set to null ptr");
+        throw e;
+    }
+    if (initialModels.size() == 1) {
+        // a single search uses rng as it is, just like run()
+        return std::vector<Model>(1, run(rng, initialModels[0]));
+    }
+    // draw every seed up front so each search gets the same stream no
+    // matter which thread runs it
+    std::vector<boost::mt19937::result_type> seeds;
+    for (std::size_t i = 0; i < initialModels.size(); i++) {
+        seeds.push_back(rng());
+    }
+
+    std::vector<Model> results(initialModels.size());
+    if (numThreads_ == 1) {
+        // nothing to spread out; let each search use our threads instead
+        for (std::size_t i = 0; i < initialModels.size(); i++) {
+            boost::mt19937 restartRng(seeds[i]);
+            results[i] = run(restartRng, initialModels[i]);
+        }
+        return results;
+    }
+
+    ThreadPool pool(std::min<std::size_t>(numThreads_, initialModels.size()));
+    domain_->fillCaches();
+    for (std::vector<Model>::const_iterator it = initialModels.begin(); it != initialModels.end(); it++) {
+        it->fillCaches();
+    }
+    pool.parallelFor(initialModels.size(), RestartTask(domain_, numIterations_, probOfRandomMove_,
+            seeds, initialModels, results));
+    return results;
+}
+
+Model MWSSolver::runBest(boost::mt19937& rng, const std::vector<Model>& initialModels) {
+    if (initialModels.empty()) {
+        std::logic_error e("MWSSolver::runBest() needs at least one initial model");
+        throw e;
+    }
+    std::vector<Model> results = runRestarts(rng, initialModels);
+    std::size_t best = 0;
+    double bestScore = domain_->score(results[0]);
+    for (std::size_t i = 1; i < results.size(); i++) {
+        double score = domain_->score(results[i]);
+        LOG(LOG_DEBUG) << "restart " << i << " found a model with score " << score;
+        if (score > bestScore) {
+            best = i;
+            bestScore = score;
+        }
+    }
+    LOG(LOG_INFO) << "best of " << results.size() << " restarts was restart " << best << " with a score of " << bestScore;
+    return results[best];
+}
+
+void MWSSolver::updateScores(const Model& model,
         std::vector<bool>& whichToUpdate,
         std::vector<double>& scores,
-        std::vector<bool>& fullySatisfied) {
+        std::vector<bool>& fullySatisfied,
+        EvaluationContext& context) {
 //    std::cout << "in MWSSolver::updateScores()" << std::endl;
 //
 //    std::cout << "fullySatisfied: ";
@@ -680,25 +773,9 @@ void MWSSolver::updateScores(const std::vector<ELSentence>& formulas,
 //            std::cout << "  asked not to update this formula" << std::endl;
             continue;    // skip elements that don't need updating
         }
-        ELSentence formula = formulas[i];
-
-        // find the quantification for the current sentence
-        SISet quantification(domain_->maxSpanInterval(), false, domain_->maxInterval());
-        if (formula.isQuantified()) {
-            quantification = formula.quantification();
-        }
-
-        SISet formSat = formula.dSatisfied(model, *domain_);
-        // next, overwrite the score for the model
-        scores[i] = ((double)formSat.size()) * formula.weight();
-        // finally, mark if its completely satisfied
-        SISet leftover = quantification;
-        leftover.subtract(formSat);
-        if (leftover.empty()) {
-            fullySatisfied[i] = true;
-        } else {
-            fullySatisfied[i] = false;
-        }
+        bool fullySat;
+        scores[i] = domain_->scoreFormula(i, model, fullySat, context);
+        fullySatisfied[i] = fullySat;
         // done updating!  make a note
         whichToUpdate[i] = false;
     }
@@ -20,6 +20,7 @@ class Model;
 class Domain;
 class Atom;
 class ELSentence;
+struct EvaluationContext;
 //struct AtomStringCompare;
 
 /**
@@ -77,6 +78,14 @@ public:
      */
     Domain* domain() const;
 
+    /**
+     * Get the number of threads used to score candidate moves.
+     *
+     * @return  the number of threads (1 means everything runs on the
+     *   calling thread)
+     */
+    unsigned int numThreads() const;
+
     /**
      * Set the number of iterations that the solver should run for when
      * calling run().
@@ -101,6 +110,17 @@ public:
      */
     void setDomain(Domain* d);
 
+    /**
+     * Set the number of threads used to score the candidate moves in each
+     * greedy step.  The threads share the domain and the current model
+     * (see Domain::fillCaches()), each with its own evaluation context,
+     * and the best move is chosen in the order the moves were generated,
+     * so a given seed gives the same model for any number of threads.
+     *
+     * @param numThreads  the number of threads to use (at least 1)
+     */
+    void setNumThreads(unsigned int numThreads);
+
     /**
      * Run the MaxWalkSat algorithm with the current configuration.  Note that
      * the domain object must not be NULL (or a logic_error exception is thrown).
@@ -122,42 +142,68 @@ public:
      * @return  the highest scoring model found for the set domain.
      */
     Model run(boost::mt19937& rng, const Model& initialModel);
+
+    /**
+     * Run one independent search from each of the given initial models and
+     * return the model each search finds, in the same order.
+     *
+     * The searches run concurrently on numThreads() threads (each search
+     * is then single-threaded).  Every search uses its own generator,
+     * seeded from rng before any of them start, so the results for a
+     * given seed don't depend on the number of threads.  A single initial
+     * model is searched with rng itself, exactly as run() would.
+     *
+     * @param rng  the random number generator the seeds are drawn from.
+     * @param initialModels  the model to start each search with.
+     * @return  the highest scoring model found by each search.
+     */
+    std::vector<Model> runRestarts(boost::mt19937& rng, const std::vector<Model>& initialModels);
+
+    /**
+     * Run one independent search from each of the given initial models (see
+     * runRestarts()) and return the highest scoring model found by any of
+     * them.  Ties go to the earliest search.
+     *
+     * @param rng  the random number generator the seeds are drawn from.
+     * @param initialModels  the model to start each search with (must not
+     *   be empty).
+     * @return  the highest scoring model found.
+     */
+    Model runBest(boost::mt19937& rng, const std::vector<Model>& initialModels);
 private:
     // update the formula scores and return a list of sentences that are not fully satisfied and have moves
-    void updateScores(const std::vector<ELSentence>& formulas,
-            const Model& m,
+    void updateScores(const Model& m,
             std::vector<bool>& whichToUpdate,
             std::vector<double>& scores,
-            std::vector<bool>& fullySatisfied);
-
-    // execute a move, updating all sentences that need scores updating at the same time
-    Model updateWithMove(const Move& m,
-            const Model& currentModel,
-            const boost::unordered_map<Atom, std::vector<std::vector<ELSentence>::size_type > >& atomMap,
-            std::vector<bool>& formsNeedUpdate);
+            std::vector<bool>& fullySatisfied,
+            EvaluationContext& context);
 
     unsigned int numIterations_;
     double probOfRandomMove_;
     Domain* domain_;
+    unsigned int numThreads_;
 };
 
 // IMPLEMENTATION
 inline MWSSolver::MWSSolver()
     : numIterations_(defNumIterations),
       probOfRandomMove_(defProbOfRandomMove),
-      domain_(NULL) {}
+      domain_(NULL),
+      numThreads_(1) {}
 
 inline MWSSolver::MWSSolver(Domain* d)
     : numIterations_(defNumIterations),
       probOfRandomMove_(defProbOfRandomMove),
-      domain_(d) {};
+      domain_(d),
+      numThreads_(1) {};
 
 inline MWSSolver::MWSSolver(unsigned int numIterations,
         double probOfRandomMove,
         Domain* d)
     : numIterations_(numIterations),
       probOfRandomMove_(probOfRandomMove),
-      domain_(d) {
+      domain_(d),
+      numThreads_(1) {
     if (probOfRandomMove < 0.0 || probOfRandomMove > 1.0) {
         std::logic_error e("probOfRandomMove is out of range for MWSSolver");
         throw e;
@@ -192,6 +238,18 @@ inline void MWSSolver::setDomain(Domain* d) {
     domain_ = d;
 }
 
+inline unsigned int MWSSolver::numThreads() const {
+    return numThreads_;
+}
+
+inline void MWSSolver::setNumThreads(unsigned int numThreads) {
+    if (numThreads == 0) {
+        std::logic_error e("MWSSolver needs at least one thread");
+        throw e;
+    }
+    numThreads_ = numThreads;
+}
+
 
 /*
 
@@ -0,0 +1,44 @@
+/*
+ * AtomTable.cpp
+ */
+#include "AtomTable.h"
+
+AtomTable& AtomTable::global() {
+    static AtomTable table;
+    return table;
+}
+
+AtomId AtomTable::intern(const Atom& a) {
+    if (GroundAtom::canRepresent(a)) return intern(GroundAtom(a));
+
+    AtomId id;
+    if (find(a, id)) return id;
+
+    boost::unique_lock<boost::shared_mutex> lock(mutex_);
+    // another thread may have added it since we looked
+    boost::unordered_map<Atom, AtomId>::const_iterator it = otherIds_.find(a);
+    if (it != otherIds_.end()) return it->second;
+    id = add(a);
+    otherIds_.insert(std::make_pair(a, id));
+    return id;
+}
+
+AtomId AtomTable::intern(const GroundAtom& a) {
+    AtomId id;
+    if (find(a, id)) return id;
+
+    // build the atom before locking, since that reads the SymbolTable
+    Atom atom = a.toAtom();
+    boost::unique_lock<boost::shared_mutex> lock(mutex_);
+    boost::unordered_map<GroundAtom, AtomId>::const_iterator it = groundIds_.find(a);
+    if (it != groundIds_.end()) return it->second;
+    id = add(atom);
+    groundIds_.insert(std::make_pair(a, id));
+    return id;
+}
+
+AtomId AtomTable::add(const Atom& a) {
+    AtomId id = atoms_.size();
+    atoms_.push_back(a);
+    return id;
+}
@@ -0,0 +1,132 @@
+/*
+ * AtomTable.h
+ */
+
+#ifndef ATOMTABLE_H_
+#define ATOMTABLE_H_
+
+#include <deque>
+#include <stdexcept>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include "GroundAtom.h"
+#include "syntax/Atom.h"
+
+/**
+ * Dense integer identifier for a ground atom.  Ids are handed out in order
+ * starting from 0 by AtomTable::intern().
+ */
+typedef boost::uint32_t AtomId;
+
+/**
+ * An id no atom is ever given, for "no such atom".  No model has a set for
+ * it.
+ */
+const AtomId noAtomId = (AtomId)-1;
+
+/**
+ * Interning table that maps atoms to dense ids and back.  There is a single
+ * process-wide table (see global()), so an atom has the same id in every
+ * Domain and Model and ids can be compared without looking at the atom.
+ *
+ * Domain interns every atom it knows about as it is built, so the atoms of
+ * a domain end up with small, contiguous ids.
+ *
+ * Ground atoms are keyed by their GroundAtom, so looking one up from a
+ * GroundAtom only hashes and compares integers; atoms GroundAtom can't
+ * represent are keyed by the Atom itself.
+ *
+ * The table is safe to use from several threads at once: lookups share a
+ * read lock and intern() takes a write lock only when it adds an atom.
+ * Inference threads mostly work with atoms their domain has already
+ * interned, so in practice they only ever take the read lock, but a move
+ * or a compiled formula that comes across a new atom on a worker thread
+ * gets a consistent id for it rather than corrupting the table.
+ */
+class AtomTable {
+public:
+    /**
+     * Get the table shared by all domains and models.
+     */
+    static AtomTable& global();
+
+    /**
+     * Get the id for an atom, assigning the next free one if the atom hasn't
+     * been seen before.
+     *
+     * @param a  the atom to intern
+     * @return the id for a
+     */
+    AtomId intern(const Atom& a);
+    AtomId intern(const GroundAtom& a);
+
+    /**
+     * Look up the id for an atom without assigning one.
+     *
+     * @param a   the atom to look up
+     * @param id  set to a's id if it has one
+     * @return true if a has been interned
+     */
+    bool find(const Atom& a, AtomId& id) const;
+    bool find(const GroundAtom& a, AtomId& id) const;
+
+    /**
+     * Get the atom with a given id.  The reference stays valid for the
+     * lifetime of the table.
+     *
+     * @param id  an id previously returned by intern()
+     * @return the atom for id
+     */
+    const Atom& atom(AtomId id) const;
+
+    /**
+     * @return the number of atoms interned so far (which is also the next
+     *   id to be assigned).
+     */
+    std::size_t size() const;
+
+private:
+    // add an atom not already in the table.  caller holds the write lock.
+    AtomId add(const Atom& a);
+
+    mutable boost::shared_mutex mutex_;
+    boost::unordered_map<GroundAtom, AtomId> groundIds_;
+    boost::unordered_map<Atom, AtomId> otherIds_;
+    std::deque<Atom> atoms_;    // deque so references aren't invalidated
+};
+
+// IMPLEMENTATION
+inline bool AtomTable::find(const GroundAtom& a, AtomId& id) const {
+    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    boost::unordered_map<GroundAtom, AtomId>::const_iterator it = groundIds_.find(a);
+    if (it == groundIds_.end()) return false;
+    id = it->second;
+    return true;
+}
+
+inline bool AtomTable::find(const Atom& a, AtomId& id) const {
+    if (GroundAtom::canRepresent(a)) {
+        GroundAtom g;
+        return GroundAtom::lookup(a, g) && find(g, id);
+    }
+    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    boost::unordered_map<Atom, AtomId>::const_iterator it = otherIds_.find(a);
+    if (it == otherIds_.end()) return false;
+    id = it->second;
+    return true;
+}
+
+inline const Atom& AtomTable::atom(AtomId id) const {
+    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    if (id >= atoms_.size()) throw std::out_of_range("AtomTable::atom() - no atom with that id");
+    return atoms_[id];
+}
+
+inline std::size_t AtomTable::size() const {
+    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    return atoms_.size();
+}
+
+#endif /* ATOMTABLE_H_ */
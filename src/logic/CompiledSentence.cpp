@@ -0,0 +1,210 @@
+/*
+ * CompiledSentence.cpp
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <boost/optional.hpp>
+#include "CompiledSentence.h"
+#include "Domain.h"
+#include "Model.h"
+#include "ELSyntax.h"
+#include "Collectors.h"
+
+CompiledSentence::CompiledSentence(const boost::shared_ptr<const Sentence>& s)
+    : sentence_(s), code_(), relations_(), subformulas_(), registersNeeded_(0) {
+    compile(sentence_, false, 0);
+}
+
+// emit code leaving the value of s (as s.satisfied(m, d, forceLiquid)) in
+// register reg.  registers above reg are free to use as scratch.
+void CompiledSentence::compile(const boost::shared_ptr<const Sentence>& sp, bool forceLiquid, std::size_t reg) {
+    const Sentence& s = *sp;
+    if (s.getTypeCode() == Atom::TypeCode) {
+        const Atom& a = static_cast<const Atom&>(s);
+        // ungrounded atoms throw when evaluated; leave that to Atom
+        if (!a.isGrounded()) {
+            emit(SENTENCE, forceLiquid, reg, 0).node = &s;
+            return;
+        }
+        emit(ATOM, forceLiquid, reg, 0).atom = AtomTable::global().intern(a);
+        return;
+    }
+    if (s.getTypeCode() == BoolLit::TypeCode) {
+        const BoolLit& b = static_cast<const BoolLit&>(s);
+        emit(b.value() ? TRUE_LIT : FALSE_LIT, forceLiquid, reg, 0);
+        return;
+    }
+
+    // conjunctions, disjunctions and diamonds are worth caching, apart from
+    // the whole sentence (whose atoms have always changed when it's
+    // rescored).  the probe learns where the subformula's code ends once
+    // it has been emitted.
+    std::size_t probe = code_.size();
+    std::size_t sub = noSubformula;
+    if (&s != sentence_.get() && (s.getTypeCode() == Conjunction::TypeCode
+            || s.getTypeCode() == Disjunction::TypeCode
+            || s.getTypeCode() == DiamondOp::TypeCode)) {
+        sub = subformulas_.size();
+        emit(PROBE, forceLiquid, reg, 0).sub = sub;
+        subformulas_.push_back(Subformula());
+        subformulas_.back().sentence = sp;
+        subformulas_.back().hash = hash_value(s);
+        AtomCollector acollect;
+        s.visit(acollect);
+        for (AtomCollector::atom_set::const_iterator it = acollect.atoms.begin(); it != acollect.atoms.end(); it++) {
+            subformulas_.back().atoms.push_back(AtomTable::global().intern(*it));
+        }
+        std::sort(subformulas_.back().atoms.begin(), subformulas_.back().atoms.end());
+    }
+
+    if (s.getTypeCode() == Negation::TypeCode) {
+        const Negation& neg = static_cast<const Negation&>(s);
+        compile(neg.sentence(), forceLiquid, reg);
+        emit(NEGATION, forceLiquid, reg, 0);
+    } else if (s.getTypeCode() == Disjunction::TypeCode) {
+        const Disjunction& dis = static_cast<const Disjunction&>(s);
+        compile(dis.left(), forceLiquid, reg);
+        compile(dis.right(), forceLiquid, reg+1);
+        emit(DISJUNCTION, forceLiquid, reg, 1);
+    } else if (s.getTypeCode() == Conjunction::TypeCode) {
+        const Conjunction& con = static_cast<const Conjunction&>(s);
+        compile(con.left(), forceLiquid, reg);
+        compile(con.right(), forceLiquid, reg+1);
+        setRelations(emit(CONJUNCTION, forceLiquid, reg, 2), con.relations());
+    } else if (s.getTypeCode() == DiamondOp::TypeCode) {
+        // a diamond under a liquid op is an error, but only once evaluated
+        const DiamondOp& dia = static_cast<const DiamondOp&>(s);
+        compile(dia.sentence(), false, reg);
+        setRelations(emit(DIAMOND, forceLiquid, reg, 1), dia.relations());
+    } else if (s.getTypeCode() == LiquidOp::TypeCode) {
+        const LiquidOp& liq = static_cast<const LiquidOp&>(s);
+        compile(liq.sentence(), true, reg);
+        emit(LIQUID, forceLiquid, reg, 0);
+    } else {
+        emit(SENTENCE, forceLiquid, reg, 0).node = &s;
+    }
+    if (sub == noSubformula) return;
+    code_.back().sub = sub;
+    code_[probe].target = code_.size()-1;
+}
+
+CompiledSentence::Instruction& CompiledSentence::emit(OpCode op, bool forceLiquid, std::size_t reg, std::size_t scratch) {
+    Instruction in;
+    in.op = op;
+    in.forceLiquid = forceLiquid;
+    in.reg = reg;
+    in.atom = 0;
+    in.relBegin = in.relEnd = 0;
+    in.node = 0;
+    in.sub = noSubformula;
+    in.target = 0;
+    code_.push_back(in);
+    registersNeeded_ = std::max(registersNeeded_, reg + scratch + 1);
+    return code_.back();
+}
+
+void CompiledSentence::setRelations(Instruction& in, const std::set<Interval::INTERVAL_RELATION>& rels) {
+    in.relBegin = relations_.size();
+    relations_.insert(relations_.end(), rels.begin(), rels.end());
+    in.relEnd = relations_.size();
+}
+
+const SISet& CompiledSentence::satisfied(const Model& m, const Domain& d, std::vector<SISet>& registers,
+        SatisfactionCache* cache) const {
+    if (registers.size() < registersNeeded_) registers.resize(registersNeeded_);
+    const Interval maxInterval = d.maxInterval();
+    const SpanInterval universe = d.maxSpanInterval();
+
+    for (std::vector<Instruction>::const_iterator in = code_.begin(); in != code_.end(); in++) {
+        SISet& r = registers[in->reg];
+        switch (in->op) {
+        case ATOM:
+            if (m.hasAtom(in->atom)) {
+                r = m.getAtom(in->atom);
+                r.setForceLiquid(in->forceLiquid);
+            } else {
+                r = SISet(in->forceLiquid, maxInterval);
+            }
+            break;
+        case TRUE_LIT:
+            r = SISet(universe, in->forceLiquid, maxInterval);
+            break;
+        case FALSE_LIT:
+            r = SISet(in->forceLiquid, maxInterval);
+            break;
+        case NEGATION:
+            r.setForceLiquid(in->forceLiquid);
+            r = r.compliment();
+            break;
+        case DISJUNCTION: {
+            SISet& right = registers[in->reg+1];
+            r.setForceLiquid(in->forceLiquid);
+            right.setForceLiquid(in->forceLiquid);
+            r.add(right);
+            break;
+        }
+        case CONJUNCTION: {
+            SISet& right = registers[in->reg+1];
+            r.setForceLiquid(in->forceLiquid);
+            right.setForceLiquid(in->forceLiquid);
+            if (in->forceLiquid) {
+                r = intersection(r, right);
+                break;
+            }
+            SISet& result = registers[in->reg+2];
+            result = SISet(false, maxInterval);
+            for (SISet::const_iterator lIt = r.begin(); lIt != r.end(); lIt++) {
+                for (SISet::const_iterator rIt = right.begin(); rIt != right.end(); rIt++) {
+                    for (std::size_t rel = in->relBegin; rel != in->relEnd; rel++) {
+                        result.add(composedOf(*lIt, *rIt, relations_[rel], universe));
+                    }
+                }
+            }
+            r = result;
+            break;
+        }
+        case DIAMOND: {
+            if (in->forceLiquid) throw std::runtime_error("DiamondOp::doSatisfied(): given parameter forceLiquid=true, but diamond op is a non liquid operator!");
+            r.setForceLiquid(false);
+            SISet& result = registers[in->reg+1];
+            result = SISet(false, r.maxInterval());
+            for (SISet::const_iterator sIt = r.begin(); sIt != r.end(); sIt++) {
+                for (std::size_t rel = in->relBegin; rel != in->relEnd; rel++) {
+                    boost::optional<SpanInterval> spr = sIt->satisfiesRelation(relations_[rel], universe);
+                    if (spr) result.add(*spr);
+                }
+            }
+            r = result;
+            break;
+        }
+        case LIQUID:
+            r.setForceLiquid(in->forceLiquid);
+            break;
+        case SENTENCE:
+            r = in->node->satisfied(m, d, in->forceLiquid);
+            break;
+        case PROBE:
+            if (cache != 0) {
+                const Subformula& sub = subformulas_[in->sub];
+                if (cache->find(*sub.sentence, sub.hash, in->forceLiquid, maxInterval, m, sub.atoms, r)) {
+                    in = code_.begin() + in->target;
+                    continue;
+                }
+            }
+            break;
+        }
+        if (cache != 0 && in->sub != noSubformula && in->op != PROBE) {
+            const Subformula& sub = subformulas_[in->sub];
+            cache->insert(sub.sentence, sub.hash, in->forceLiquid, maxInterval, m, sub.atoms, r);
+        }
+    }
+    return registers[0];
+}
+
+SISet CompiledSentence::dSatisfied(const Model& m, const Domain& d, const SISet& where, std::vector<SISet>& registers,
+        SatisfactionCache* cache) const {
+    SISet set = intersection(satisfied(m, d, registers, cache), where);
+    set.makeDisjoint();
+    return set;
+}
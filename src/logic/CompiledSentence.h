@@ -0,0 +1,153 @@
+/*
+ * CompiledSentence.h
+ */
+
+#ifndef COMPILEDSENTENCE_H_
+#define COMPILEDSENTENCE_H_
+
+#include <cstddef>
+#include <set>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "AtomTable.h"
+#include "SatisfactionCache.h"
+#include "../Interval.h"
+#include "../SISet.h"
+#include "syntax/Sentence.h"
+
+class Model;
+class Domain;
+
+/**
+ * What evaluating compiled sentences writes to: the registers the plans run
+ * on and a cache for the results of subformulas.  A Domain keeps one for
+ * its own scoring methods; code that scores against one domain from several
+ * threads gives each thread its own (see Domain::newEvaluationContext()).
+ */
+struct EvaluationContext {
+    explicit EvaluationContext(unsigned int cacheCapacity=SatisfactionCache::defCapacity,
+            std::size_t cacheByteCapacity=0);
+
+    std::vector<SISet> registers;
+    SatisfactionCache cache;
+};
+
+/**
+ * A sentence lowered into a flat evaluation plan.  Sentence::satisfied()
+ * walks the syntax tree through virtual calls, looks every atom up in the
+ * AtomTable and builds a fresh SISet at each node.  A compiled sentence
+ * instead runs a post-order sequence of instructions over a stack of
+ * scratch SISets ("registers") that the caller keeps between calls, so
+ * evaluating it again reuses the registers' storage.  Atom ids and the
+ * forceLiquid flag of each node are worked out once, at compile time.
+ *
+ * The result is exactly what sentence->satisfied(m, d, false) returns.
+ * Sentence types without an instruction of their own are evaluated by
+ * calling satisfied() on them.
+ *
+ * Results for subformulas (conjunctions, disjunctions and diamonds below
+ * the root) can be kept in a SatisfactionCache.  Before such a
+ * subformula's code is a probe instruction that, on a cache hit, loads the
+ * result and jumps past it.
+ *
+ * A compiled sentence is immutable once built, so copies of a domain can
+ * share one; the registers are not shared, since SISets are not safe to
+ * use from several threads at once (see EvaluationContext).
+ */
+class CompiledSentence {
+public:
+    /**
+     * Compile a sentence.  Interns the ground atoms it mentions into
+     * AtomTable::global().
+     *
+     * @param s  the sentence to compile; kept alive by the compiled sentence
+     */
+    explicit CompiledSentence(const boost::shared_ptr<const Sentence>& s);
+
+    /**
+     * Evaluate the sentence on a model.
+     *
+     * @param m          the model to evaluate on
+     * @param d          the domain, for its maximum interval
+     * @param registers  scratch space, grown as needed and reusable across
+     *   calls and sentences
+     * @param cache      cache for the results of subformulas, or null
+     * @return where the sentence is satisfied (as s->satisfied(m, d, false)).
+     *   The reference points into registers and is valid until they are
+     *   next used.
+     */
+    const SISet& satisfied(const Model& m, const Domain& d, std::vector<SISet>& registers,
+            SatisfactionCache* cache=0) const;
+
+    /**
+     * Evaluate the sentence on a model, restricted to a set of intervals
+     * (as s->dSatisfied(m, d, where)).
+     */
+    SISet dSatisfied(const Model& m, const Domain& d, const SISet& where, std::vector<SISet>& registers,
+            SatisfactionCache* cache=0) const;
+
+    /**
+     * @return the number of instructions in the plan
+     */
+    std::size_t size() const;
+
+    /**
+     * @return the number of registers evaluation uses
+     */
+    std::size_t registersNeeded() const;
+
+private:
+    enum OpCode {
+        ATOM,           // load atom's set from the model
+        TRUE_LIT,       // everywhere
+        FALSE_LIT,      // nowhere
+        NEGATION,       // complement reg
+        DISJUNCTION,    // reg = reg + reg+1
+        CONJUNCTION,    // reg = reg ; reg+1, via reg+2 when not liquid
+        DIAMOND,        // reg = <>reg, via reg+1
+        LIQUID,         // reset forceLiquid on reg
+        SENTENCE,       // reg = node->satisfied()
+        PROBE           // on a cache hit, reg = cached and jump past target
+    };
+
+    struct Instruction {
+        OpCode op;
+        bool forceLiquid;
+        std::size_t reg;
+        AtomId atom;
+        // relations of a conjunction/diamond, a range in relations_
+        std::size_t relBegin, relEnd;
+        const Sentence* node;
+        // the subformula this instruction computes (or probes for) if its
+        // result is cached, else noSubformula
+        std::size_t sub;
+        std::size_t target;     // for PROBE, the instruction computing sub
+    };
+
+    struct Subformula {
+        boost::shared_ptr<const Sentence> sentence;
+        std::size_t hash;
+        std::vector<AtomId> atoms;  // sorted
+    };
+
+    static const std::size_t noSubformula = (std::size_t)-1;
+
+    void compile(const boost::shared_ptr<const Sentence>& s, bool forceLiquid, std::size_t reg);
+    Instruction& emit(OpCode op, bool forceLiquid, std::size_t reg, std::size_t scratch);
+    void setRelations(Instruction& in, const std::set<Interval::INTERVAL_RELATION>& rels);
+
+    boost::shared_ptr<const Sentence> sentence_;
+    std::vector<Instruction> code_;
+    std::vector<Interval::INTERVAL_RELATION> relations_;
+    std::vector<Subformula> subformulas_;
+    std::size_t registersNeeded_;
+};
+
+// IMPLEMENTATION
+inline EvaluationContext::EvaluationContext(unsigned int cacheCapacity, std::size_t cacheByteCapacity)
+    : registers(), cache(cacheCapacity, cacheByteCapacity) {}
+
+inline std::size_t CompiledSentence::size() const {return code_.size();}
+inline std::size_t CompiledSentence::registersNeeded() const {return registersNeeded_;}
+
+#endif /* COMPILEDSENTENCE_H_ */
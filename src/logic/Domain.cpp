@@ -1,12 +1,14 @@
 #include "Domain.h"
 #include "ELSyntax.h"
 #include "Model.h"
+#include "Moves.h"
 #include "../Log.h"
 
 #include <boost/shared_ptr.hpp>
 #include <stdexcept>
 #include <sstream>
 #include <vector>
+#include <algorithm>
 
 /*
 void Domain::addObservedPredicate(const Atom& a) {
@@ -25,6 +27,10 @@ void swap(Domain& a, Domain& b) {
     swap(a.partialModel_, b.partialModel_);
     //swap(a.predTypes_, b.predTypes_);
     swap(a.allAtoms_, b.allAtoms_);
+    swap(a.formulasByAtom_, b.formulasByAtom_);
+    swap(a.plans_, b.plans_);
+    swap(a.context_.registers, b.context_.registers);
+    a.context_.cache.swap(b.context_.cache);
     swap(a.generator_, b.generator_);
 }
 
@@ -43,8 +49,8 @@ SISet Domain::getModifiableSISet(const Atom& a, const SISet& where) const {
     SISet modifiable = where;
     Proposition trueAt(a, true);
     Proposition falseAt(a, false);
-    if (partialModel_.count(trueAt) != 0) modifiable.subtract(partialModel_.at(trueAt));
-    if (partialModel_.count(falseAt) != 0) modifiable.subtract(partialModel_.at(falseAt));
+    if (partialModel_->count(trueAt) != 0) modifiable.subtract(partialModel_->at(trueAt));
+    if (partialModel_->count(falseAt) != 0) modifiable.subtract(partialModel_->at(falseAt));
 
     return modifiable;
 }
@@ -68,14 +74,15 @@ void Domain::addFact(const Proposition& p, const SISet& where) {
     SISet newSet(where);
     if (!maxInterval_.isNull()) newSet.setMaxInterval(span(where.maxInterval(), maxInterval_));
 
-    if (partialModel_.count(p) == 0) {
-        partialModel_.insert(std::make_pair(p, newSet));
+    PropMap& facts = writableFacts();
+    if (facts.count(p) == 0) {
+        facts.insert(std::make_pair(p, newSet));
     } else {
-        partialModel_.at(p).setMaxInterval(newSet.maxInterval());
-        partialModel_.at(p).add(newSet);
+        facts.at(p).setMaxInterval(newSet.maxInterval());
+        facts.at(p).add(newSet);
     }
    // predTypes_.insert(p.atom().predicateType());
-    allAtoms_.insert(p.atom());
+    addAtom(p.atom());
     growMaxInterval(where.maxInterval());
 }
 /*
@@ -111,7 +118,8 @@ void Domain::addFormula(const ELSentence& e) {
     */
     AtomCollector acollect;
     e.sentence()->visit(acollect);
-    allAtoms_.insert(acollect.atoms.begin(), acollect.atoms.end());
+    addAtoms(acollect.atoms.begin(), acollect.atoms.end());
+    indexFormula(formulas_.size()-1);
     // update our list of unobs preds
     /*
     PredCollector collect;
@@ -124,19 +132,21 @@ void Domain::addFormula(const ELSentence& e) {
 
 void Domain::addAtom(const Atom& a) {
  //   predTypes_.insert(a.predicateType());
-    allAtoms_.insert(a);
+    if (allAtoms_->count(a) == 0) writableAtoms().insert(a);
+    // hand out ids as atoms arrive so a domain's atoms get contiguous ids
+    AtomTable::global().intern(a);
 }
 
 Model Domain::randomModel(boost::mt19937& rng) const {
     Model newModel(maxInterval_);
     //std::set<Atom, atomcmp> atoms = observations_.atoms();
-    for (boost::unordered_set<Atom>::const_iterator it = allAtoms_.begin(); it != allAtoms_.end(); it++) {
+    for (boost::unordered_set<Atom>::const_iterator it = allAtoms_->begin(); it != allAtoms_->end(); it++) {
         SISet random = SISet::randomSISet(isLiquid(it->name()), maxInterval_, rng);
         // enforce our partial model
         Proposition trueProp(*it, true);
         Proposition falseProp(*it, false);
-        if (partialModel_.count(trueProp) != 0) random.add(     partialModel_.at(trueProp));
-        if (partialModel_.count(falseProp) != 0) random.subtract(partialModel_.at(falseProp));
+        if (partialModel_->count(trueProp) != 0) random.add(     partialModel_->at(trueProp));
+        if (partialModel_->count(falseProp) != 0) random.subtract(partialModel_->at(falseProp));
 
         random.makeDisjoint();
         //newModel.clearAtom(obsPair->first);
@@ -148,6 +158,8 @@ Model Domain::randomModel(boost::mt19937& rng) const {
 
 void Domain::setMaxInterval(const Interval& maxInterval) {
     maxInterval_ = maxInterval;
+    // cached results for the old interval can't be hit any more
+    context_.cache.clear();
     // resize formulas
     for (std::vector<ELSentence>::iterator it = formulas_.begin(); it != formulas_.end(); it++) {
         if (it->isQuantified()) {
@@ -156,8 +168,10 @@ void Domain::setMaxInterval(const Interval& maxInterval) {
             it->setQuantification(copy);
         }
     }
-    for (PropMap::iterator it = partialModel_.begin(); it != partialModel_.end(); it++) {
-        partialModel_.at(it->first).setMaxInterval(maxInterval);
+    if (partialModel_->empty()) return;
+    PropMap& facts = writableFacts();
+    for (PropMap::iterator it = facts.begin(); it != facts.end(); it++) {
+        it->second.setMaxInterval(maxInterval);
     }
 }
 
@@ -166,6 +180,12 @@ bool Domain::isLiquid(const std::string& predicate) const {
     return true;
 }
 
+bool Domain::isLiquid(AtomId /* atom */) const {
+    // every predicate is liquid until isLiquid(const std::string&) is
+    // implemented; then this wants a table of liquid atoms by id
+    return true;
+}
+
 double Domain::score(const ELSentence& w, const Model& m) const {
     SISet quantification = SISet(maxSpanInterval(), false, maxInterval());
     if (w.isQuantified()) quantification = w.quantification();
@@ -177,16 +197,102 @@ double Domain::score(const ELSentence& w, const Model& m) const {
 
 double Domain::score(const Model& m) const {
     double sum = 0.0;
-    for (std::vector<ELSentence>::const_iterator it = formulas_.begin(); it != formulas_.end(); it++) {
-        double x = score(*it, m);
+    for (std::size_t i = 0; i < formulas_.size(); i++) {
+        double x = scoreFormula(i, m);
         sum += x;
     }
     return sum;
 }
 
+SISet Domain::formulaSatisfied(std::size_t i, const Model& m) const {
+    return formulaSatisfied(i, m, context_);
+}
+
+SISet Domain::formulaSatisfied(std::size_t i, const Model& m, EvaluationContext& context) const {
+    const ELSentence& w = formulas_.at(i);
+    SatisfactionCache* cache = (context.cache.enabled() ? &context.cache : 0);
+    if (w.isQuantified()) return plans_[i]->dSatisfied(m, *this, w.quantification(), context.registers, cache);
+    return plans_[i]->dSatisfied(m, *this, SISet(maxSpanInterval(), false, maxInterval()), context.registers, cache);
+}
+
+double Domain::scoreFormula(std::size_t i, const Model& m) const {
+    return scoreFormula(i, m, context_);
+}
+
+double Domain::scoreFormula(std::size_t i, const Model& m, EvaluationContext& context) const {
+    SISet sat = formulaSatisfied(i, m, context);
+    return (double)sat.size() * formulas_[i].weight();
+}
+
+double Domain::scoreFormula(std::size_t i, const Model& m, bool& fullySatisfied, EvaluationContext& context) const {
+    const ELSentence& w = formulas_.at(i);
+    SISet sat = formulaSatisfied(i, m, context);
+    SISet leftover = (w.isQuantified() ? w.quantification() : SISet(maxSpanInterval(), false, maxInterval()));
+    leftover.subtract(sat);
+    fullySatisfied = leftover.empty();
+    return (double)sat.size() * w.weight();
+}
+
+bool Domain::formulaFullySatisfied(std::size_t i, const Model& m) const {
+    const ELSentence& w = formulas_.at(i);
+    SISet toSatisfyAt = (w.isQuantified() ? w.quantification() : SISet(maxSpanInterval(), false, maxInterval()));
+    toSatisfyAt.subtract(formulaSatisfied(i, m));
+    return toSatisfyAt.empty();
+}
+
+std::vector<std::size_t> Domain::formulasTouchedBy(const Move& move) const {
+    std::vector<std::size_t> touched;
+    for (int pass = 0; pass < 2; pass++) {
+        const std::vector<Move::change>& changes = (pass == 0 ? move.toAdd : move.toDel);
+        for (std::vector<Move::change>::const_iterator it = changes.begin(); it != changes.end(); it++) {
+            AtomId id = it->get<0>();
+            if (id >= formulasByAtom_.size()) continue;
+            touched.insert(touched.end(), formulasByAtom_[id].begin(), formulasByAtom_[id].end());
+        }
+    }
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    return touched;
+}
+
+double Domain::scoreDelta(const Move& move, const Model& m) const {
+    return scoreDelta(move, m, context_);
+}
+
+double Domain::scoreDelta(const Move& move, const Model& m, EvaluationContext& context) const {
+    // only the touched formulas' current scores are needed
+    std::vector<double> scores(formulas_.size(), 0.0);
+    std::vector<std::size_t> touched = formulasTouchedBy(move);
+    for (std::vector<std::size_t>::const_iterator it = touched.begin(); it != touched.end(); it++) {
+        scores[*it] = scoreFormula(*it, m, context);
+    }
+    MoveScores rescored;
+    return scoreDelta(move, m, scores, rescored, context);
+}
+
+double Domain::scoreDelta(const Move& move, const Model& m, const std::vector<double>& scores,
+        MoveScores& rescored, EvaluationContext& context) const {
+    rescored.formulas = formulasTouchedBy(move);
+    rescored.scores.resize(rescored.formulas.size());
+    rescored.fullySatisfied.resize(rescored.formulas.size());
+    if (rescored.formulas.empty()) return 0.0;
+
+    // models share the sets of atoms the move doesn't touch, so this only
+    // copies what changes
+    Model moved = executeMove(*this, move, m);
+    double delta = 0.0;
+    for (std::size_t i = 0; i < rescored.formulas.size(); i++) {
+        bool fullySat;
+        rescored.scores[i] = scoreFormula(rescored.formulas[i], moved, fullySat, context);
+        rescored.fullySatisfied[i] = fullySat;
+        delta += rescored.scores[i] - scores[rescored.formulas[i]];
+    }
+    return delta;
+}
+
 bool Domain::isFullySatisfied(const Model& m) const {
-    for (formula_const_iterator it = formulas_begin(); it != formulas_end(); it++) {
-        if (!it->fullySatisfied(m, *this)) return false;
+    for (std::size_t i = 0; i < formulas_.size(); i++) {
+        if (!formulaFullySatisfied(i, m)) return false;
     }
     return true;
 }
@@ -215,6 +321,50 @@ Domain Domain::replaceInfForms() const {
     return d;
 }
 
+Domain Domain::deepCopy() const {
+    Domain d(*this);
+    d.partialModel_.reset(new PropMap(*partialModel_));
+    d.allAtoms_.reset(new boost::unordered_set<Atom>(*allAtoms_));
+    return d;
+}
+
+void Domain::fillCaches() const {
+    for (PropMap::const_iterator it = partialModel_->begin(); it != partialModel_->end(); it++) {
+        it->second.fillCaches();
+    }
+}
+
+Domain::PropMap& Domain::writableFacts() {
+    if (!partialModel_.unique()) partialModel_.reset(new PropMap(*partialModel_));
+    return *partialModel_;
+}
+
+boost::unordered_set<Atom>& Domain::writableAtoms() {
+    if (!allAtoms_.unique()) allAtoms_.reset(new boost::unordered_set<Atom>(*allAtoms_));
+    return *allAtoms_;
+}
+
+void Domain::indexFormula(std::size_t i) {
+    if (i >= plans_.size()) plans_.resize(i+1);
+    plans_[i].reset(new CompiledSentence(formulas_[i].sentence()));
+
+    AtomCollector acollect;
+    formulas_[i].sentence()->visit(acollect);
+    for (AtomCollector::atom_set::const_iterator it = acollect.atoms.begin(); it != acollect.atoms.end(); it++) {
+        AtomId id = AtomTable::global().intern(*it);
+        if (id >= formulasByAtom_.size()) formulasByAtom_.resize(id+1);
+        formulasByAtom_[id].push_back(i);
+    }
+}
+
+void Domain::rebuildFormulaIndex() {
+    formulasByAtom_.clear();
+    plans_.clear();
+    for (std::size_t i = 0; i < formulas_.size(); i++) {
+        indexFormula(i);
+    }
+}
+
 void Domain::growMaxInterval(const Interval& maxInterval) {
     if (maxInterval_.isNull()) setMaxInterval(maxInterval);
     if (maxInterval.start() < maxInterval_.start()
@@ -232,13 +382,13 @@ void Domain::printDebugDescription(std::ostream& out) const {
         out << "    " << *it << "\n";
     }
     out << "  Facts:\n";
-    for (PropMap::const_iterator it = partialModel_.begin(); it != partialModel_.end(); it++) {
+    for (PropMap::const_iterator it = partialModel_->begin(); it != partialModel_->end(); it++) {
         std::pair<Proposition, SISet> pair = *it;
         out << "    " << pair.first << " @ " << pair.second << "\n";
     }
     // ignore atoms and generator for now
     out << "  allAtoms: ";
-    std::copy(allAtoms_.begin(),  allAtoms_.end(), std::ostream_iterator<Atom>(out, ", "));
+    std::copy(allAtoms_->begin(),  allAtoms_->end(), std::ostream_iterator<Atom>(out, ", "));
     out << std::endl;
 }
 
@@ -247,9 +397,9 @@ bool operator==(const Domain& l, const Domain& r) {
             l.dontModifyObsPreds_ == r.dontModifyObsPreds_ &&
             l.maxInterval_ == r.maxInterval_ &&
             l.formulas_ == r.formulas_ &&
-            l.partialModel_ == r.partialModel_ &&
+            (l.partialModel_ == r.partialModel_ || *l.partialModel_ == *r.partialModel_) &&
             //l.predTypes_ == r.predTypes_ &&
-            l.allAtoms_ == r.allAtoms_ &&
+            (l.allAtoms_ == r.allAtoms_ || *l.allAtoms_ == *r.allAtoms_) &&
             l.generator_ == r.generator_
     );
 }
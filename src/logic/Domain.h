@@ -17,6 +17,7 @@
 #include <limits>
 #include <stdexcept>
 #include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/unordered_set.hpp>
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/serialization/access.hpp>
@@ -26,17 +27,30 @@
 #include "ELSyntax.h"
 #include "Collectors.h"
 #include "Model.h"
+#include "CompiledSentence.h"
 #include "../SISet.h"
 #include "NameGenerator.h"
 #include "../LRUCache.h"
 #include "../util/Utils.h"
 
+struct Move;
+
 std::string modelToString(const Model& m);
 
 class Domain {
 public:
     typedef boost::unordered_map<Proposition, SISet> PropMap;
 
+    /**
+     * The formulas a move can change the score of, and their scores once it
+     * is applied, as worked out by scoreDelta().  The vectors are parallel.
+     */
+    struct MoveScores {
+        std::vector<std::size_t> formulas;  // formulasTouchedBy(move)
+        std::vector<double> scores;         // score in the moved model
+        std::vector<bool> fullySatisfied;   // fully satisfied in the moved model
+    };
+
     typedef std::vector<ELSentence>::const_iterator     formula_const_iterator;
     typedef PropMap::const_iterator                     fact_const_iterator;
     typedef boost::unordered_set<Atom>::const_iterator  atom_const_iterator;
@@ -63,6 +77,20 @@ public:
     void addFormula(const ELSentence& e);
     template <class InputIterator>
     void addFormulas(InputIterator begin, InputIterator end);
+
+    /**
+     * Get a copy of this domain with its formulas replaced by the given
+     * ones.  The facts and atoms are shared with this domain rather than
+     * copied, so the cost depends only on the number of new formulas.
+     *
+     * @param begin  start of the formulas to use
+     * @param end    end of the formulas to use
+     * @return a domain with this domain's facts, atoms and max interval, and
+     *   the given formulas
+     */
+    template <class InputIterator>
+    Domain withFormulas(InputIterator begin, InputIterator end) const;
+
     void addFact(const ELSentence& e);
     void addFact(const std::pair<const Proposition, const SISet>& pair);
     void addFact(const Proposition& p, const SISet& where);
@@ -71,6 +99,16 @@ public:
     template <class InputIterator>
     void addAtoms(InputIterator begin, InputIterator end);
 
+    /**
+     * Get the dense id of an atom (see AtomTable).  Every atom added to the
+     * domain already has one.  Nothing is interned, so callers that need an
+     * id for an atom that may be new should use AtomTable::intern().
+     *
+     * @param a  the atom to look up
+     * @return the id used for a in Models, or noAtomId if a has none
+     */
+    AtomId atomId(const Atom& a) const;
+
     bool hasFact(const Proposition& p) const;
     SISet lookupFact(const Proposition& p) const;
 
@@ -86,6 +124,23 @@ public:
      */
     Domain replaceInfForms() const;
 
+    /**
+     * Get a copy of this domain that shares none of its facts with it.
+     * Copies of a domain share their facts and atoms until one of them is
+     * modified (copy-on-write).
+     *
+     * @return a copy of this domain with its own facts and atoms
+     */
+    Domain deepCopy() const;
+
+    /**
+     * Fill in the cached values of the domain's facts (see
+     * SISet::fillCaches()).  After that, and until the domain is next
+     * modified, several threads can score against it and make moves in it
+     * at once, provided each passes its own EvaluationContext.
+     */
+    void fillCaches() const;
+
     NameGenerator& nameGenerator();
     Model defaultModel() const;
     Model randomModel(boost::mt19937& rng) const;
@@ -94,12 +149,113 @@ public:
     void setMaxInterval(const Interval& maxInterval);
 
     bool isLiquid(const std::string& predicate) const;
+    // same as isLiquid() for the interned atom's predicate, without looking
+    // the atom up
+    bool isLiquid(AtomId atom) const;
     bool dontModifyObsPreds() const;
     void setDontModifyObsPreds(bool b);
 
+    /*
+     * The scoring methods below that evaluate compiled formulas (score(Model)
+     * and everything after it) write to an EvaluationContext.  Unless given
+     * one they use the domain's own, so although they are const they are
+     * not reentrant: one domain can't score from several threads at once
+     * that way.  Threads sharing a domain should each pass their own
+     * context (see newEvaluationContext()).
+     */
     double score(const ELSentence& s, const Model& m) const;
     double score(const Model& m) const;
 
+    /**
+     * Find where a formula of this domain is satisfied, using its compiled
+     * evaluation plan (see CompiledSentence) and the satisfaction cache.
+     * This is the same as
+     * formula.sentence()->dSatisfied(m, *this, where), where is the
+     * formula's quantification or everywhere if it has none.
+     *
+     * @param i        index of the formula (in formulas_begin() order)
+     * @param m        the model to evaluate on
+     * @param context  the registers and cache to evaluate with; the
+     *   domain's own if not given
+     * @return where formula i is satisfied
+     */
+    SISet formulaSatisfied(std::size_t i, const Model& m) const;
+    SISet formulaSatisfied(std::size_t i, const Model& m, EvaluationContext& context) const;
+
+    /**
+     * Score a formula of this domain with its compiled evaluation plan.
+     * Same as score(formula, m).
+     */
+    double scoreFormula(std::size_t i, const Model& m) const;
+    double scoreFormula(std::size_t i, const Model& m, EvaluationContext& context) const;
+
+    /**
+     * Score a formula and check whether it is fully satisfied, evaluating
+     * it only once.
+     *
+     * @param fullySatisfied  set to formulaFullySatisfied(i, m)
+     * @return scoreFormula(i, m)
+     */
+    double scoreFormula(std::size_t i, const Model& m, bool& fullySatisfied, EvaluationContext& context) const;
+
+    /**
+     * Check a formula of this domain with its compiled evaluation plan.
+     * Same as formula.fullySatisfied(m, *this).
+     */
+    bool formulaFullySatisfied(std::size_t i, const Model& m) const;
+
+    /**
+     * Get the cache of subformula results used by formulaSatisfied() (and
+     * so by score(Model), scoreDelta() and isFullySatisfied()) when not
+     * given a context, to size it or look at its stats.  Copies of a domain
+     * start with an empty cache of the same capacities.
+     */
+    SatisfactionCache& satisfactionCache() const;
+
+    /**
+     * Get an empty evaluation context whose cache has the same capacities
+     * as satisfactionCache().
+     */
+    EvaluationContext newEvaluationContext() const;
+
+    /**
+     * Get the formulas that mention an atom changed by a move.  These are
+     * the only formulas whose score can change when the move is applied.
+     *
+     * @param move  the move to look at
+     * @return indices of formulas (in formulas_begin() order), sorted and
+     *   without duplicates
+     */
+    std::vector<std::size_t> formulasTouchedBy(const Move& move) const;
+
+    /**
+     * Compute how much applying a move would change a model's score,
+     * rescoring only the formulas that mention the move's atoms.  This is
+     * score(executeMove(*this, move, m)) - score(m), up to rounding.
+     *
+     * @param move  the move to apply
+     * @param m     the model to apply it to
+     * @return the change in score
+     */
+    double scoreDelta(const Move& move, const Model& m) const;
+    double scoreDelta(const Move& move, const Model& m, EvaluationContext& context) const;
+
+    /**
+     * Compute how much applying a move would change a model's score, given
+     * the current score of every formula, and record the new scores of the
+     * formulas it touches.  Only those formulas are evaluated, and only on
+     * the moved model.
+     *
+     * @param move      the move to apply
+     * @param m         the model to apply it to
+     * @param scores    scoreFormula(i, m) for every formula i
+     * @param rescored  filled in with the touched formulas' new scores
+     * @param context   the registers and cache to evaluate with
+     * @return the change in score
+     */
+    double scoreDelta(const Move& move, const Model& m, const std::vector<double>& scores,
+            MoveScores& rescored, EvaluationContext& context) const;
+
     bool isFullySatisfied(const Model& m) const;
 
     void printDebugDescription(std::ostream& out) const;
@@ -110,21 +266,37 @@ public:
     static const unsigned int hardFormulaFactor = 10;
 private:
     friend class boost::serialization::access;
+    friend class Snapshot;
+    friend class SnapshotWriter;
     template <class Archive>
     void serialize(Archive& ar, const unsigned int version);
 
     void growMaxInterval(const Interval& maxInterval);
+    void indexFormula(std::size_t i);
+    void rebuildFormulaIndex();
+    PropMap& writableFacts();
+    boost::unordered_set<Atom>& writableAtoms();
 
     bool dontModifyObsPreds_;
     Interval maxInterval_;
     std::vector<ELSentence> formulas_;
-    PropMap partialModel_;
+    // facts and atoms are shared between copies of a domain (copy-on-write),
+    // since they rarely change once the domain is loaded.  never null.
+    boost::shared_ptr<PropMap> partialModel_;
     //boost::unordered_set<PredicateType> predTypes_;
-    boost::unordered_set<Atom> allAtoms_;
+    boost::shared_ptr<boost::unordered_set<Atom> > allAtoms_;
+    // formulas mentioning each atom, indexed by AtomId.  not archived since
+    // ids are only meaningful within one process
+    std::vector<std::vector<std::size_t> > formulasByAtom_;
+    // compiled formulas, parallel to formulas_.  shared between copies,
+    // since they never change once built.  not archived.
+    std::vector<boost::shared_ptr<const CompiledSentence> > plans_;
+    // registers and subformula cache for evaluating plans_ when the caller
+    // doesn't give a context.  every copy of a domain gets its own, but one
+    // domain can't use it from several threads at once.
+    mutable EvaluationContext context_;
 
     NameGenerator generator_;
-
-    //mutable LRUCache<ModelSentencePair,SISet,ModelSentencePair_cmp> cache_;
 };
 
 void swap(Domain& a, Domain& b);
@@ -134,9 +306,12 @@ inline Domain::Domain()
     : dontModifyObsPreds_(true),
       maxInterval_(),
       formulas_(),
-      partialModel_(),
+      partialModel_(new PropMap()),
     //  predTypes_(),
-      allAtoms_(),
+      allAtoms_(new boost::unordered_set<Atom>()),
+      formulasByAtom_(),
+      plans_(),
+      context_(),
       generator_(){};
 
 inline Domain::Domain(const Domain& d)
@@ -146,6 +321,9 @@ inline Domain::Domain(const Domain& d)
       partialModel_(d.partialModel_),
     //  predTypes_(d.predTypes_),
       allAtoms_(d.allAtoms_),
+      formulasByAtom_(d.formulasByAtom_),
+      plans_(d.plans_),
+      context_(d.context_.cache.capacity(), d.context_.cache.byteCapacity()),
       generator_(d.generator_) {};
 
 inline Domain& Domain::operator=(Domain d) {
@@ -156,19 +334,25 @@ inline Domain& Domain::operator=(Domain d) {
 
 inline Domain::formula_const_iterator Domain::formulas_begin() const {return formulas_.begin();}
 inline Domain::formula_const_iterator Domain::formulas_end() const {return formulas_.end();}
-inline Domain::fact_const_iterator Domain::facts_begin() const {return partialModel_.begin();}
-inline Domain::fact_const_iterator Domain::facts_end() const {return partialModel_.end();}
-inline Domain::atom_const_iterator Domain::atoms_begin() const { return allAtoms_.begin();}
-inline Domain::atom_const_iterator Domain::atoms_end() const { return allAtoms_.end();}
-
-inline std::size_t Domain::atoms_size() const { return allAtoms_.size();}
+inline Domain::fact_const_iterator Domain::facts_begin() const {return partialModel_->begin();}
+inline Domain::fact_const_iterator Domain::facts_end() const {return partialModel_->end();}
+inline Domain::atom_const_iterator Domain::atoms_begin() const { return allAtoms_->begin();}
+inline Domain::atom_const_iterator Domain::atoms_end() const { return allAtoms_->end();}
+
+inline std::size_t Domain::atoms_size() const { return allAtoms_->size();}
+inline AtomId Domain::atomId(const Atom& a) const {
+    AtomId id;
+    return (AtomTable::global().find(a, id) ? id : noAtomId);
+}
 
 inline void Domain::clearFormulas() {
     formulas_.clear();
+    formulasByAtom_.clear();
+    plans_.clear();
 }
 
 inline void Domain::clearFacts() {
-    partialModel_.clear();
+    partialModel_.reset(new PropMap());
 }
 
 template <class InputIterator>
@@ -178,6 +362,20 @@ void Domain::addFormulas(InputIterator begin, InputIterator end) {
     }
 }
 
+template <class InputIterator>
+Domain Domain::withFormulas(InputIterator begin, InputIterator end) const {
+    Domain d;
+    d.dontModifyObsPreds_ = dontModifyObsPreds_;
+    d.maxInterval_ = maxInterval_;
+    d.partialModel_ = partialModel_;
+    d.allAtoms_ = allAtoms_;
+    d.generator_ = generator_;
+    d.context_.cache.setCapacity(context_.cache.capacity());
+    d.context_.cache.setByteCapacity(context_.cache.byteCapacity());
+    d.addFormulas(begin, end);
+    return d;
+}
+
 inline void Domain::addFact(const std::pair<const Proposition, const SISet>& pair) {
     addFact(pair.first, pair.second);
 }
@@ -189,14 +387,18 @@ void Domain::addAtoms(InputIterator begin, InputIterator end) {
     }
 }
 
-inline bool Domain::hasFact(const Proposition& p) const {return partialModel_.count(p) != 0; }
-inline SISet Domain::lookupFact(const Proposition& p) const { return partialModel_.at(p);}
+inline bool Domain::hasFact(const Proposition& p) const {return partialModel_->count(p) != 0; }
+inline SISet Domain::lookupFact(const Proposition& p) const { return partialModel_->at(p);}
 
 inline NameGenerator& Domain::nameGenerator() {return generator_;};
-inline Model Domain::defaultModel() const {return Model(partialModel_, maxInterval_);};
+inline Model Domain::defaultModel() const {return Model(*partialModel_, maxInterval_);};
 inline void Domain::setDontModifyObsPreds(bool b) { dontModifyObsPreds_ = b; }
 inline bool Domain::dontModifyObsPreds() const { return dontModifyObsPreds_; }
 inline Interval Domain::maxInterval() const {return maxInterval_;};
+inline SatisfactionCache& Domain::satisfactionCache() const {return context_.cache;}
+inline EvaluationContext Domain::newEvaluationContext() const {
+    return EvaluationContext(context_.cache.capacity(), context_.cache.byteCapacity());
+}
 inline SpanInterval Domain::maxSpanInterval() const {
     return SpanInterval(maxInterval_.start(), maxInterval_.finish(),
             maxInterval_.start(), maxInterval_.finish());
@@ -207,10 +409,15 @@ void Domain::serialize(Archive& ar, const unsigned int version) {
     ar & dontModifyObsPreds_;
     ar & maxInterval_;
     ar & formulas_;
-    ar & partialModel_;
+    if (Archive::is_loading::value) {
+        partialModel_.reset(new PropMap());
+        allAtoms_.reset(new boost::unordered_set<Atom>());
+    }
+    ar & *partialModel_;
    // ar & predTypes_;
-    ar & allAtoms_;
+    ar & *allAtoms_;
     ar & generator_;
+    if (Archive::is_loading::value) rebuildFormulaIndex();
 }
 
 inline bool operator!=(const Domain& l, const Domain& r) {return !operator==(l, r);}
@@ -0,0 +1,103 @@
+/*
+ * DomainCache.cpp
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <boost/cstdint.hpp>
+#include "DomainCache.h"
+#include "Snapshot.h"
+#include "../Log.h"
+
+namespace {
+    // 64 bit FNV-1a, which is plenty to tell inputs apart (this isn't
+    // guarding against anyone)
+    const boost::uint64_t fnvOffset = 14695981039346656037ULL;
+    const boost::uint64_t fnvPrime = 1099511628211ULL;
+
+    void hashBytes(boost::uint64_t& hash, const char* begin, const char* end) {
+        for (const char* c = begin; c != end; c++) {
+            hash ^= (unsigned char)*c;
+            hash *= fnvPrime;
+        }
+    }
+
+    void hashString(boost::uint64_t& hash, const std::string& s) {
+        hashBytes(hash, s.data(), s.data() + s.size());
+        hash ^= 0xff;       // so ("ab", "c") and ("a", "bc") differ
+        hash *= fnvPrime;
+    }
+}
+
+DomainCache::DomainCache(const std::string& directory) : directory_(directory) {}
+
+std::string DomainCache::makeKey(const std::vector<std::string>& files, const std::string& options) {
+    boost::uint64_t hash = fnvOffset;
+    for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); it++) {
+        std::ifstream in(it->c_str(), std::ios::in | std::ios::binary);
+        if (!in.is_open()) throw std::runtime_error("unable to open file " + *it + " for hashing");
+        char buffer[64*1024];
+        boost::uint64_t size = 0;
+        while (in) {
+            in.read(buffer, sizeof(buffer));
+            hashBytes(hash, buffer, buffer + in.gcount());
+            size += in.gcount();
+        }
+        if (in.bad()) throw std::runtime_error("unable to read file " + *it + " for hashing");
+        std::ostringstream sizeStr;
+        sizeStr << size;
+        hashString(hash, sizeStr.str());
+    }
+    hashString(hash, options);
+
+    std::ostringstream key;
+    key << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return key.str();
+}
+
+bool DomainCache::load(const std::string& key, Domain& d) const {
+    std::string filename = path(key);
+    {
+        std::ifstream in(filename.c_str());
+        if (!in.is_open()) return false;
+    }
+    try {
+        Snapshot snapshot(filename);
+        d = snapshot.domain();
+    } catch (std::exception& e) {
+        LOG_PRINT(LOG_WARN) << "ignoring unreadable cached domain " << filename << ": " << e.what();
+        return false;
+    }
+    LOG(LOG_DEBUG) << "loaded cached domain " << filename;
+    return true;
+}
+
+void DomainCache::store(const std::string& key, const Domain& d) const {
+    // write to a temporary file and move it into place, so an interrupted
+    // run doesn't leave half an entry behind
+    std::string filename = path(key);
+    std::string tmpname = filename + ".tmp";
+    try {
+        SnapshotWriter writer;
+        writer.setDomain(d);
+        writer.write(tmpname);
+    } catch (std::exception& e) {
+        LOG_PRINT(LOG_WARN) << "unable to cache domain: " << e.what();
+        std::remove(tmpname.c_str());
+        return;
+    }
+    if (std::rename(tmpname.c_str(), filename.c_str()) != 0) {
+        LOG_PRINT(LOG_WARN) << "unable to cache domain: can't rename " << tmpname << " to " << filename;
+        std::remove(tmpname.c_str());
+        return;
+    }
+    LOG(LOG_DEBUG) << "cached domain in " << filename;
+}
+
+std::string DomainCache::path(const std::string& key) const {
+    if (directory_.empty()) return key + ".snap";
+    return directory_ + "/" + key + ".snap";
+}
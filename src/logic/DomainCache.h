@@ -0,0 +1,57 @@
+/*
+ * DomainCache.h
+ */
+
+#ifndef DOMAINCACHE_H_
+#define DOMAINCACHE_H_
+
+#include <string>
+#include <vector>
+#include "Domain.h"
+
+/**
+ * An on-disk cache of domains that have already been loaded (and possibly
+ * preprocessed), stored as snapshots in a directory.  Entries are looked up
+ * by a key built from the contents of the input files and a description of
+ * whatever options affect the domain built from them, so a cached domain is
+ * only used for the exact inputs it was built from.
+ *
+ * The cache is best-effort: an entry that can't be read (written by another
+ * build, truncated, ...) is treated as missing, and failing to store an
+ * entry only logs a warning.
+ */
+class DomainCache {
+public:
+    /**
+     * @param directory  where entries are kept; it must already exist
+     */
+    explicit DomainCache(const std::string& directory);
+
+    /**
+     * Build a key from the contents of some files and a description of the
+     * options used to build a domain from them.
+     *
+     * @throws std::runtime_error if one of the files can't be read
+     */
+    static std::string makeKey(const std::vector<std::string>& files, const std::string& options);
+
+    /**
+     * Look up a domain.
+     *
+     * @param d  set to the cached domain if there is one
+     * @return true if the domain was in the cache
+     */
+    bool load(const std::string& key, Domain& d) const;
+
+    void store(const std::string& key, const Domain& d) const;
+
+    /**
+     * @return the file the entry for key is kept in
+     */
+    std::string path(const std::string& key) const;
+
+private:
+    std::string directory_;
+};
+
+#endif /* DOMAINCACHE_H_ */
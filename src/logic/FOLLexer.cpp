@@ -1,4 +1,9 @@
-
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
 #include <vector>
 #include <iostream>
 #include <string>
@@ -6,248 +11,208 @@
 #include "FOLToken.h"
 
 namespace {
-    std::istream::int_type getNextChar(std::istream& stream, unsigned int& colNumber) {
-        colNumber++;
-        return stream.get();
+    struct Keyword {
+        const char* word;
+        FOLParse::TokenType type;
+    };
+
+    const Keyword keywords[] = {
+        {"v", FOLParse::Or},
+        {"var", FOLParse::Var},
+        {"ex1", FOLParse::Exactly1},
+        {"at1", FOLParse::AtLeast1},
+        {"true", FOLParse::True},
+        {"false", FOLParse::False},
+        {"init", FOLParse::Init},
+        {"inf", FOLParse::Infinity},
+        {"type", FOLParse::Type}
+    };
+
+    bool isAlpha(char c) {
+        return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+    }
+
+    bool isDigit(char c) {
+        return c >= '0' && c <= '9';
     }
-}
-// TODO: make this use an iterator rather than return a vector
-std::vector<FOLToken> FOLParse::tokenize(std::istream& input) {
-    std::vector<FOLToken> tokens;
-    unsigned int lineNumber = 1;
-    unsigned int colNumber = 0; // will be advanced to one on first read
 
-    while (!input.eof()) {
-        int c = getNextChar(input, colNumber);
-        if (input.eof()) {
-            break;
+    // reserved words are lexed as identifiers and then looked up
+    FOLParse::TokenType identType(const char* begin, const char* end) {
+        std::size_t len = end - begin;
+        for (std::size_t i = 0; i < sizeof(keywords)/sizeof(keywords[0]); i++) {
+            if (std::strlen(keywords[i].word) == len && std::memcmp(keywords[i].word, begin, len) == 0) {
+                return keywords[i].type;
+            }
         }
-        FOLToken token;
-        token.setLineNumber(lineNumber);
-        token.setColNumber(colNumber);
+        return FOLParse::Identifier;
+    }
+
+    // point a token's contents at a string literal, for tokens with more
+    // than one spelling
+    void setContents(const char* str, const char*& begin, const char*& end) {
+        begin = str;
+        end = str + std::strlen(str);
+    }
+}
+
+// lex the next token, skipping whitespace, comments and characters we don't
+// recognize.  columns count from 1, and lines from 1.
+void FOLParse::TokenIterator::advance() {
+    while (next_ != end_) {
+        const char* start = next_;
+        char c = *next_++;
+        FOLParse::TokenType type = FOLParse::Invalid;
+        const char* contentsBegin = start;
+        const char* contentsEnd = next_;
+
         // first check for identifiers
-        if ((c >= 'A' && c <= 'Z')
-                || (c >= 'a' && c <= 'z')
-                || c == '_') {
-            std::string ident;
-            ident.push_back(c);
-            while (!input.eof()) {
-                c = input.peek();
-                if ((c >= 'A' && c <= 'Z')
-                        || (c >= 'a' && c <= 'z')
-                        || (c >= '0' && c <= '9')
-                        || c == '_'
-                        || c == '-') {
-                    getNextChar(input, colNumber);
-                    ident.push_back(c);
-                } else {
-                    break;
-                }
+        if (isAlpha(c) || c == '_') {
+            while (next_ != end_ && (isAlpha(*next_) || isDigit(*next_) || *next_ == '_' || *next_ == '-')) {
+                next_++;
             }
-            // now check for reserved keywords
-            if (ident == "v") {
-                // OR
-                token.setType(FOLParse::Or);
-            } else if (ident == "var") {
-                // VAR
-                token.setType(FOLParse::Var);
-            } else if (ident == "ex1") {
-                // EX1
-                token.setType(FOLParse::Exactly1);
-            } else if (ident == "at1") {
-                // AT1
-                token.setType(FOLParse::AtLeast1);
-            } else if (ident == "true") {
-                // TRUE
-                token.setType(FOLParse::True);
-            } else if (ident == "false") {
-                // FALSE
-                token.setType(FOLParse::False);
-            } else if (ident == "init") {
-                // INIT
-                token.setType(FOLParse::Init);
-            } else if (ident == "inf") {
-                // INF
-                token.setType(FOLParse::Infinity);
-            } else if (ident == "type") {
-                // TYPE
-                token.setType(FOLParse::Type);
-            } else {
-                // IDENT
-                token.setType(FOLParse::Identifier);
-            }
-            token.setContents(ident);
-            tokens.push_back(token);
-        } else if ((c >= '0' && c <= '9') || c == '.') {
-            std::string num;
+            contentsEnd = next_;
+            type = identType(contentsBegin, contentsEnd);
+        } else if (isDigit(c) || c == '.') {
             bool isFloat = (c == '.');
-            num.push_back(c);
-            while (!input.eof()) {
-                c = input.peek();
-                if ((c >= '0' && c <= '9') || c == '.') {
-                    if (!isFloat && c == '.') isFloat = true;
-                    getNextChar(input, colNumber);
-                    num.push_back(c);
-                } else {
-                    break;
-                }
+            while (next_ != end_ && (isDigit(*next_) || *next_ == '.')) {
+                if (*next_ == '.') isFloat = true;
+                next_++;
             }
-            token.setType(isFloat ? FOLParse::Float : FOLParse::Number);
-            token.setContents(num);
-            tokens.push_back(token);
+            contentsEnd = next_;
+            type = (isFloat ? FOLParse::Float : FOLParse::Number);
         } else if (c == '?') {
-            // variable
-            std::string var;
-            while (!input.eof()) {
-                c = input.peek();
-                if ((c >= 'A' && c <= 'Z')
-                        || (c >= 'a' && c <= 'z')
-                        || (c >= '0' && c <= '9')
-                        || c == '_') {
-                    getNextChar(input, colNumber);
-                    var.push_back(c);
-                } else {
-                    break;
-                }
+            // variable; the contents leave off the '?'
+            while (next_ != end_ && (isAlpha(*next_) || isDigit(*next_) || *next_ == '_')) {
+                next_++;
             }
-            token.setType(FOLParse::Variable);
-            token.setContents(var);
-            tokens.push_back(token);
-        } else if ((c == '-' && input.peek() == '>')
-                || (c == '=' && input.peek() == '>')) {
-            getNextChar(input, colNumber);
+            contentsBegin = start+1;
+            contentsEnd = next_;
+            type = FOLParse::Variable;
+        } else if ((c == '-' || c == '=') && next_ != end_ && *next_ == '>') {
             // implies
-            token.setType(FOLParse::Implies);
-            token.setContents("->");
-            tokens.push_back(token);
-        } else if (c == '<' && input.peek() == '>') {
-            getNextChar(input, colNumber);
+            next_++;
+            setContents("->", contentsBegin, contentsEnd);
+            type = FOLParse::Implies;
+        } else if (c == '<' && next_ != end_ && *next_ == '>') {
             // diamond
-            token.setType(FOLParse::Diamond);
-            token.setContents("<>");
-            tokens.push_back(token);
+            next_++;
+            contentsEnd = next_;
+            type = FOLParse::Diamond;
         } else {
             switch (c) {    // simple cases below
-            case '!':
-            case '~':
-                token.setType(FOLParse::Not);
-                token.setContents("!");
-                tokens.push_back(token);
-                break;
-            case '[':
-                token.setType(FOLParse::OpenBracket);
-                token.setContents("[");
-                tokens.push_back(token);
-                break;
-            case ']':
-                token.setType(FOLParse::CloseBracket);
-                token.setContents("]");
-                tokens.push_back(token);
-                break;
-            case '{':
-                token.setType(FOLParse::OpenBrace);
-                token.setContents("{");
-                tokens.push_back(token);
-                break;
-            case '}':
-                token.setType(FOLParse::CloseBrace);
-                token.setContents("}");
-                tokens.push_back(token);
-                break;
-            case '*':
-                token.setType(FOLParse::Star);
-                token.setContents("*");
-                tokens.push_back(token);
-                break;
-            case '(':
-                token.setType(FOLParse::OpenParen);
-                token.setContents("(");
-                tokens.push_back(token);
-                break;
-            case ')':
-                token.setType(FOLParse::CloseParen);
-                token.setContents(")");
-                tokens.push_back(token);
-                break;
-            case '^':
-            case '&':
-                token.setType(FOLParse::And);
-                token.setContents("^");
-                tokens.push_back(token);
-                break;
-            case '|':
-                token.setType(FOLParse::Or);
-                token.setContents("v");
-                tokens.push_back(token);
-                break;
-            case ',':
-                token.setType(FOLParse::Comma);
-                token.setContents(",");
-                tokens.push_back(token);
-                break;
-            case ':':
-                token.setType(FOLParse::Colon);
-                token.setContents(":");
-                tokens.push_back(token);
-                break;
-            case ';':
-                token.setType(FOLParse::Semicolon);
-                token.setContents(";");
-                tokens.push_back(token);
-                break;
-            case '@':
-                token.setType(FOLParse::At);
-                token.setContents("@");
-                tokens.push_back(token);
-                break;
-            case '=':
-                token.setType(FOLParse::Equals);
-                token.setContents("=");
-                tokens.push_back(token);
-                break;
-            case '<':
-                token.setType(FOLParse::LessThan);
-                token.setContents("<");
-                tokens.push_back(token);
-                break;
-            case '>':
-                token.setType(FOLParse::GreaterThan);
-                token.setContents(">");
-                tokens.push_back(token);
-                break;
-            case '\n':
-                token.setType(FOLParse::EndLine);
-                token.setContents("\n");
-                tokens.push_back(token);
-
-                // update counts to next line
-                lineNumber++;
-                colNumber = 0;
-                break;
+            case '!': type = FOLParse::Not; break;
+            case '~': type = FOLParse::Not; setContents("!", contentsBegin, contentsEnd); break;
+            case '[': type = FOLParse::OpenBracket; break;
+            case ']': type = FOLParse::CloseBracket; break;
+            case '{': type = FOLParse::OpenBrace; break;
+            case '}': type = FOLParse::CloseBrace; break;
+            case '*': type = FOLParse::Star; break;
+            case '(': type = FOLParse::OpenParen; break;
+            case ')': type = FOLParse::CloseParen; break;
+            case '^': type = FOLParse::And; break;
+            case '&': type = FOLParse::And; setContents("^", contentsBegin, contentsEnd); break;
+            case '|': type = FOLParse::Or; setContents("v", contentsBegin, contentsEnd); break;
+            case ',': type = FOLParse::Comma; break;
+            case ':': type = FOLParse::Colon; break;
+            case ';': type = FOLParse::Semicolon; break;
+            case '@': type = FOLParse::At; break;
+            case '=': type = FOLParse::Equals; break;
+            case '<': type = FOLParse::LessThan; break;
+            case '>': type = FOLParse::GreaterThan; break;
+            case '\n': type = FOLParse::EndLine; break;
             case '#':
                 // comment, do nothing until we get to endl
-                while (!input.eof()) {
-                    c = input.peek();
-                    if (c != '\n') {
-                        getNextChar(input, colNumber);
-                    } else {
-                        break;
-                    }
-                }
-
-                break;
+                while (next_ != end_ && *next_ != '\n') next_++;
+                continue;
             case ' ':
             case '\t':
             case '\r':
                 // do nothing!
-                break;
+                continue;
             default:
-                std::cerr << "dont know what " << c << " is" << std::endl;
-                break;
+                std::cerr << "dont know what " << (int)(unsigned char)c << " is" << std::endl;
+                continue;
                 // error!
             }
         }
+
+        pos_ = start;
+        token_ = FOLTokenView(type, contentsBegin, contentsEnd, lineNumber_, start - lineStart_ + 1);
+        if (type == FOLParse::EndLine) {
+            // update counts to next line
+            lineNumber_++;
+            lineStart_ = next_;
+        }
+        return;
     }
+    pos_ = end_;
+    token_ = FOLTokenView();
+    atEnd_ = true;
+}
 
+std::vector<FOLToken> FOLParse::tokenize(std::istream& input) {
+    std::string buffer((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    std::vector<FOLToken> tokens;
+    for (TokenIterator it(buffer.data(), buffer.data() + buffer.size()), end; it != end; it++) {
+        tokens.push_back(it->toToken());
+    }
     return tokens;
 }
+
+std::vector<FOLParse::TokenShard> FOLParse::splitLines(const char* begin, const char* end, std::size_t n) {
+    std::vector<TokenShard> shards;
+    std::size_t size = end - begin;
+    if (n == 0) n = 1;
+    const char* start = begin;
+    unsigned int line = 1;
+    for (std::size_t i = 1; i <= n && start != end; i++) {
+        // run on from the even split point to the end of its line
+        const char* stop = (i == n ? end : std::max(start, begin + size / n * i));
+        stop = std::find(stop, end, '\n');
+        if (stop != end) stop++;
+
+        TokenShard shard;
+        shard.begin = start;
+        shard.end = stop;
+        shard.firstLine = line;
+        shards.push_back(shard);
+
+        line += std::count(start, stop, '\n');
+        start = stop;
+    }
+    return shards;
+}
+
+FOLParse::TokenFile::TokenFile(const std::string& filename) : file_() {
+    std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+    if (!in.is_open()) {
+        throw std::runtime_error("unable to open file " + filename + " for parsing");
+    }
+    // an empty file can't be mapped, and has no tokens anyway
+    if (in.tellg() == std::streampos(0)) return;
+    in.close();
+
+    try {
+        file_.open(filename);
+    } catch (std::exception& e) {
+        throw std::runtime_error("unable to map file " + filename + " for parsing: " + e.what());
+    }
+}
+
+FOLParse::TokenIterator FOLParse::TokenFile::begin() const {
+    if (!file_.is_open()) return TokenIterator();
+    return TokenIterator(file_.data(), file_.data() + file_.size());
+}
+
+FOLParse::TokenIterator FOLParse::TokenFile::end() const {
+    return TokenIterator();
+}
+
+std::vector<FOLParse::TokenShard> FOLParse::TokenFile::split(std::size_t n) const {
+    if (!file_.is_open()) return std::vector<TokenShard>();
+    return splitLines(file_.data(), file_.data() + file_.size(), n);
+}
+
+std::size_t FOLParse::TokenFile::size() const {
+    return (file_.is_open() ? file_.size() : 0);
+}
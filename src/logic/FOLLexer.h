@@ -1,13 +1,152 @@
 #ifndef FOLLEXER_H
 #define FOLLEXER_H
 
+#include <cstddef>
+#include <iterator>
+#include <string>
 #include <vector>
 #include <iostream>
-
-class FOLToken;
+#include <boost/iostreams/device/mapped_file.hpp>
+#include "FOLToken.h"
 
 namespace FOLParse {
+/**
+ * Lex a stream into a vector of tokens, each holding a copy of its
+ * contents.  Convenient for short inputs; files are better lexed with a
+ * TokenFile.
+ */
 std::vector<FOLToken> tokenize(std::istream& input);
+
+/**
+ * A forward iterator over the tokens in a buffer of characters.  Tokens are
+ * lexed one at a time as the iterator is advanced, and are FOLTokenViews
+ * whose contents point into the buffer (or, for tokens with fixed contents
+ * such as "->", into static storage), so nothing is copied.  The buffer
+ * must outlive the iterator and the tokens it yields.
+ *
+ * A default constructed iterator is the end iterator.
+ */
+class TokenIterator {
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef const FOLTokenView value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const FOLTokenView* pointer;
+    typedef const FOLTokenView& reference;
+
+    TokenIterator();
+
+    /**
+     * @param firstLine  the line number of the line begin is at the start
+     *   of, for lexing part of a larger buffer
+     */
+    TokenIterator(const char* begin, const char* end, unsigned int firstLine=1);
+
+    const FOLTokenView& operator*() const;
+    const FOLTokenView* operator->() const;
+    TokenIterator& operator++();
+    TokenIterator operator++(int);
+
+    bool operator==(const TokenIterator& b) const;
+    bool operator!=(const TokenIterator& b) const;
+
+private:
+    void advance();
+
+    const char* next_;      // where lexing the next token starts
+    const char* end_;
+    const char* pos_;       // where the current token starts
+    const char* lineStart_;
+    unsigned int lineNumber_;
+    FOLTokenView token_;
+    bool atEnd_;
+};
+
+/**
+ * A piece of a buffer that starts at the beginning of a line, so that it
+ * can be lexed on its own.
+ */
+struct TokenShard {
+    const char* begin;
+    const char* end;
+    unsigned int firstLine;
+
+    TokenIterator tokens() const;
+};
+
+/**
+ * Split a buffer into at most n shards of roughly equal size, breaking it
+ * only after newlines.  The shards are in order and together cover the
+ * whole buffer; since statements never span lines, each can be parsed
+ * separately.
+ */
+std::vector<TokenShard> splitLines(const char* begin, const char* end, std::size_t n);
+
+/**
+ * The tokens of a file, lexed straight out of a read-only memory mapping of
+ * it.  Iterators and tokens are valid for as long as the TokenFile is.
+ */
+class TokenFile {
+public:
+    /**
+     * @throws std::runtime_error if the file can't be opened
+     */
+    explicit TokenFile(const std::string& filename);
+
+    TokenIterator begin() const;
+    TokenIterator end() const;
+
+    /**
+     * Split the file into at most n shards (see splitLines()).
+     */
+    std::vector<TokenShard> split(std::size_t n) const;
+
+    /**
+     * @return the size of the file in bytes
+     */
+    std::size_t size() const;
+
+private:
+    // not copyable
+    TokenFile(const TokenFile&);
+    TokenFile& operator=(const TokenFile&);
+
+    boost::iostreams::mapped_file_source file_;
+};
 };
 
+// IMPLEMENTATION
+inline FOLParse::TokenIterator::TokenIterator()
+    : next_(0), end_(0), pos_(0), lineStart_(0), lineNumber_(0), token_(), atEnd_(true) {}
+
+inline FOLParse::TokenIterator::TokenIterator(const char* begin, const char* end, unsigned int firstLine)
+    : next_(begin), end_(end), pos_(begin), lineStart_(begin), lineNumber_(firstLine), token_(), atEnd_(false) {
+    advance();
+}
+
+inline const FOLTokenView& FOLParse::TokenIterator::operator*() const {return token_;}
+inline const FOLTokenView* FOLParse::TokenIterator::operator->() const {return &token_;}
+
+inline FOLParse::TokenIterator& FOLParse::TokenIterator::operator++() {
+    advance();
+    return *this;
+}
+
+inline FOLParse::TokenIterator FOLParse::TokenIterator::operator++(int) {
+    TokenIterator old(*this);
+    advance();
+    return old;
+}
+
+inline bool FOLParse::TokenIterator::operator==(const TokenIterator& b) const {
+    if (atEnd_ || b.atEnd_) return atEnd_ == b.atEnd_;
+    return pos_ == b.pos_;
+}
+
+inline bool FOLParse::TokenIterator::operator!=(const TokenIterator& b) const {return !(*this == b);}
+
+inline FOLParse::TokenIterator FOLParse::TokenShard::tokens() const {
+    return TokenIterator(begin, end, firstLine);
+}
+
 #endif
@@ -1,8 +1,11 @@
 #ifndef FOLPARSER_H
 #define FOLPARSER_H
 
+#include <algorithm>
 #include <vector>
 #include <iterator>
+#include <map>
+#include <set>
 #include <string>
 #include <fstream>
 #include <iostream>
@@ -15,6 +18,7 @@
 #include "../Interval.h"
 #include "ELSyntax.h"
 #include "../Log.h"
+#include "../util/ThreadPool.h"
 
 // anonymous namespace for helper functions
 namespace {
@@ -46,18 +50,25 @@ struct iters {
 class ParseOptions {
 public:
     static const bool defAssumeClosedWorldInFacts = true;
+    static const unsigned int defNumThreads = 1;
 
-    ParseOptions() : factsClosed_(defAssumeClosedWorldInFacts) {}
+    ParseOptions() : factsClosed_(defAssumeClosedWorldInFacts), numThreads_(defNumThreads) {}
 
     bool assumeClosedWorldInFacts() const { return factsClosed_;}
     void setAssumeClosedWorldInFacts(bool b) {factsClosed_ = b;}
 
+    // threads to parse files with; files are split into shards of lines
+    unsigned int numThreads() const { return numThreads_;}
+    void setNumThreads(unsigned int n) {numThreads_ = (n == 0 ? 1 : n);}
+
 private:
     bool factsClosed_;
+    unsigned int numThreads_;
 };
 
 std::ostream& operator<<(std::ostream& o, const ParseOptions& p) {
-    o << "{assumeClosedWorldInFacts = " << p.assumeClosedWorldInFacts() << "}";
+    o << "{assumeClosedWorldInFacts = " << p.assumeClosedWorldInFacts()
+      << ", numThreads = " << p.numThreads() << "}";
     return o;
 }
 
@@ -779,6 +790,98 @@ boost::shared_ptr<Sentence> doParseStaticFormula_paren(iters<ForwardIterator> &i
     return s;
 }
 
+// files smaller than this per thread aren't worth splitting
+const std::size_t minShardBytes = 64*1024;
+// shards per thread, so that threads that finish early can pick up more
+const std::size_t shardsPerThread = 4;
+
+// what one shard of a file parses into
+template <class T>
+struct ParsedShard {
+    ParsedShard() : store(), objTypes(), predTypes(), failed(false), details() {}
+
+    std::vector<T> store;
+    std::map<std::string, std::set<std::string> > objTypes;
+    std::map<std::string, std::vector<std::string> > predTypes;
+    bool failed;
+    std::string details;    // of the bad_parse, if failed
+};
+
+void doParseShard(ParsedShard<FOL::Event>& shard, iters<FOLParse::TokenIterator>& its) {
+    doParseEvents(shard.store, shard.objTypes, shard.predTypes, its);
+}
+
+void doParseShard(ParsedShard<ELSentence>& shard, iters<FOLParse::TokenIterator>& its) {
+    doParseFormulas(shard.store, its);
+}
+
+template <class T>
+struct ShardParser {
+    ShardParser(const std::vector<FOLParse::TokenShard>& shards, std::vector<ParsedShard<T> >& parsed)
+        : shards_(shards), parsed_(parsed) {}
+
+    void operator()(unsigned int, std::size_t i) const {
+        iters<FOLParse::TokenIterator> its(shards_[i].tokens(), FOLParse::TokenIterator());
+        try {
+            doParseShard(parsed_[i], its);
+        } catch (bad_parse& e) {
+            parsed_[i].failed = true;
+            parsed_[i].details = e.details;
+        }
+    }
+
+    const std::vector<FOLParse::TokenShard>& shards_;
+    std::vector<ParsedShard<T> >& parsed_;
+};
+
+// as in doParseType(), the first definition of a type is the one kept
+template <class V>
+void mergeTypes(std::map<std::string, V>& into, const std::map<std::string, V>& from) {
+    for (typename std::map<std::string, V>::const_iterator it = from.begin(); it != from.end(); it++) {
+        if (into.count(it->first) != 0) {
+            LOG(LOG_WARN) << "already have an existing type definition for " << it->first << " - keeping the first one.";
+        }
+        into.insert(*it);
+    }
+}
+
+// parse a file in shards of whole lines on numThreads threads.  the shards'
+// results are merged in file order, and the first parse error in the file
+// is the one thrown, so the outcome is the same as parsing it in one piece.
+template <class T>
+void parseFileInShards(const std::string& filename,
+        std::vector<T>& store,
+        std::map<std::string, std::set<std::string> >& objTypes,
+        std::map<std::string, std::vector<std::string> >& predTypes,
+        unsigned int numThreads) {
+    // lex lazily out of the mapped file, without copying it into tokens
+    FOLParse::TokenFile file(filename);
+    std::size_t numShards = 1;
+    if (numThreads > 1) {
+        numShards = std::min<std::size_t>(numThreads*shardsPerThread, file.size()/minShardBytes + 1);
+    }
+    std::vector<FOLParse::TokenShard> shards = file.split(numShards);
+    std::vector<ParsedShard<T> > parsed(shards.size());
+    ShardParser<T> parser(shards, parsed);
+    if (shards.size() > 1) {
+        ThreadPool pool(std::min<std::size_t>(numThreads, shards.size()));
+        pool.parallelFor(shards.size(), parser);
+    } else {
+        for (std::size_t i = 0; i < shards.size(); i++) parser(0, i);
+    }
+
+    for (typename std::vector<ParsedShard<T> >::iterator it = parsed.begin(); it != parsed.end(); it++) {
+        if (it->failed) {
+            bad_parse e;
+            e.details = it->details + "filename: " + filename + "\n";
+            throw e;
+        }
+        store.insert(store.end(), it->store.begin(), it->store.end());
+        mergeTypes(objTypes, it->objTypes);
+        mergeTypes(predTypes, it->predTypes);
+    }
+}
+
 };
 
 namespace FOLParse 
@@ -788,53 +891,23 @@ namespace FOLParse
 void parseEventFile(const std::string &filename,
         std::vector<FOL::Event>& store,
         std::map<std::string, std::set<std::string> >& objTypes,
-        std::map<std::string, std::vector<std::string> >& predTypes) {
-    std::ifstream file(filename.c_str());
-    if (!file.is_open()) {
-        std::runtime_error e("unable to open event file " + filename + " for parsing");
-        throw e;
-    }
-    std::vector<FOLToken> tokens = FOLParse::tokenize(file);
-    //BOOST_FOREACH(FOLToken token, tokens) {
-    //  std::cout << "type: " << token.type() <<  " contents: " << token.contents() << std::endl;
-    //}
-
-    iters<std::vector<FOLToken>::const_iterator > its(tokens.begin(), tokens.end());
-    try {
-        doParseEvents(store, objTypes, predTypes, its);
-    } catch (bad_parse& e) {
-        e.details += "filename: " +filename + "\n";
-        file.close();
-        throw;
-    }
-    file.close();
+        std::map<std::string, std::vector<std::string> >& predTypes,
+        unsigned int numThreads=ParseOptions::defNumThreads) {
+    parseFileInShards(filename, store, objTypes, predTypes, numThreads);
 };
 
 void parseFormulaFile(const std::string &filename,
         std::vector<ELSentence>& store,
         std::map<std::string, std::set<std::string> >& objTypes,
-        std::map<std::string, std::vector<std::string> >& predTypes) {
-    std::ifstream file(filename.c_str());
-    if (!file.is_open()) {
-        std::runtime_error e("unable to open event file " + filename + " for parsing");
-        throw e;
-    }
-    std::vector<FOLToken> tokens = FOLParse::tokenize(file);
-    iters<std::vector<FOLToken>::const_iterator> its(tokens.begin(), tokens.end());
-    try {
-        doParseFormulas(store, its);
-    } catch (bad_parse& e) {
-        e.details += "filename: " + filename + "\n";
-        file.close();
-        throw;
-    }
-    file.close();
+        std::map<std::string, std::vector<std::string> >& predTypes,
+        unsigned int numThreads=ParseOptions::defNumThreads) {
+    parseFileInShards(filename, store, objTypes, predTypes, numThreads);
 };
 
 template <class ForwardIterator>
 void parseFormulas(const ForwardIterator &first,
         const ForwardIterator &last, std::vector<ELSentence>& store) {
-    iters<std::vector<FOLToken>::const_iterator> its(first, last);
+    iters<ForwardIterator> its(first, last);
     doParseFormulas(store, its);
 }
 
@@ -846,9 +919,9 @@ Domain loadDomainFromFiles(const std::string &eventfile, const std::string &form
     std::map<std::string, std::set<std::string> > objTypes;
     std::map<std::string, std::vector<std::string> > predTypes;
 
-    parseEventFile(eventfile, events, objTypes, predTypes);
+    parseEventFile(eventfile, events, objTypes, predTypes, options.numThreads());
     std::cout << "Read " << events.size() << " events from file." << std::endl;
-    parseFormulaFile(formulafile, formSet, objTypes, predTypes);
+    parseFormulaFile(formulafile, formSet, objTypes, predTypes, options.numThreads());
     std::cout << "Read " << formSet.size() << " formulas from file." << std::endl;
 
     Domain d;
@@ -1,6 +1,7 @@
 #ifndef FOLTOKEN_H
 #define FOLTOKEN_H
 
+#include <cstddef>
 #include <string>
 #include <iostream>
 
@@ -144,5 +145,56 @@ private:
     unsigned int colNumber_;
 };
 
+/**
+ * A token that refers to its contents rather than holding a copy of them.
+ * The contents are a range of characters, usually in the buffer the token
+ * was lexed from (see FOLParse::TokenIterator), so a FOLTokenView is only
+ * valid as long as that buffer is.  It has the same interface as FOLToken,
+ * so the parser can be run over either.
+ */
+class FOLTokenView {
+public:
+    FOLTokenView(FOLParse::TokenType type=FOLParse::Invalid,
+            const char* begin=0,
+            const char* end=0,
+            unsigned int lineNumber=0,
+            unsigned int colNumber=0)
+        : type_(type),
+          begin_(begin),
+          end_(end),
+          lineNumber_(lineNumber),
+          colNumber_(colNumber) {}
+
+    FOLParse::TokenType type() const {return type_;}
+
+    /**
+     * Get a copy of the contents of the token (as FOLToken::contents()).
+     */
+    std::string contents() const {return std::string(begin_, end_);}
+
+    /**
+     * The contents of the token, without copying them.
+     */
+    const char* begin() const {return begin_;}
+    const char* end() const {return end_;}
+    std::size_t size() const {return end_ - begin_;}
+
+    unsigned int lineNumber() const { return lineNumber_; }
+    unsigned int colNumber() const { return colNumber_;}
+
+    /**
+     * @return a FOLToken with a copy of the contents
+     */
+    FOLToken toToken() const {return FOLToken(type_, contents(), lineNumber_, colNumber_);}
+
+private:
+    FOLParse::TokenType type_;
+    const char* begin_;
+    const char* end_;
+
+    unsigned int lineNumber_;
+    unsigned int colNumber_;
+};
+
 
 #endif
@@ -0,0 +1,66 @@
+/*
+ * GroundAtom.cpp
+ */
+#include <sstream>
+#include <stdexcept>
+#include "GroundAtom.h"
+
+namespace {
+    const SymbolId noSymbol = (SymbolId)-1;
+}
+
+GroundAtom::GroundAtom() : predicate_(noSymbol), arity_(0) {}
+
+GroundAtom::GroundAtom(const Atom& a) : predicate_(noSymbol), arity_(0) {
+    if (!canRepresent(a)) {
+        throw std::invalid_argument("GroundAtom: can't represent atom " + a.toString());
+    }
+    SymbolTable& symbols = SymbolTable::global();
+    predicate_ = symbols.intern(a.name());
+    for (Atom::term_const_iterator it = a.term_begin(); it != a.term_end(); it++) {
+        args_[arity_++] = symbols.intern(it->name());
+    }
+}
+
+bool GroundAtom::canRepresent(const Atom& a) {
+    return a.arity() <= (int)maxArity && a.isGrounded();
+}
+
+bool GroundAtom::lookup(const Atom& a, GroundAtom& g) {
+    if (!canRepresent(a)) return false;
+    const SymbolTable& symbols = SymbolTable::global();
+    GroundAtom result;
+    if (!symbols.find(a.name(), result.predicate_)) return false;
+    for (Atom::term_const_iterator it = a.term_begin(); it != a.term_end(); it++) {
+        if (!symbols.find(it->name(), result.args_[result.arity_++])) return false;
+    }
+    g = result;
+    return true;
+}
+
+Atom GroundAtom::toAtom() const {
+    const SymbolTable& symbols = SymbolTable::global();
+    Atom a(symbols.name(predicate_));
+    for (boost::uint32_t i = 0; i < arity_; i++) {
+        a.push_back(Constant(symbols.name(args_[i])));
+    }
+    return a;
+}
+
+std::string GroundAtom::toString() const {
+    std::stringstream str;
+    str << *this;
+    return str.str();
+}
+
+// same format as Atom's
+std::ostream& operator<<(std::ostream& out, const GroundAtom& a) {
+    const SymbolTable& symbols = SymbolTable::global();
+    out << symbols.name(a.predicate_) << "(";
+    for (boost::uint32_t i = 0; i < a.arity_; i++) {
+        if (i > 0) out << ", ";
+        out << symbols.name(a.args_[i]);
+    }
+    out << ")";
+    return out;
+}
@@ -0,0 +1,104 @@
+/*
+ * GroundAtom.h
+ */
+
+#ifndef GROUNDATOM_H_
+#define GROUNDATOM_H_
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <boost/functional/hash.hpp>
+#include "SymbolTable.h"
+#include "syntax/Atom.h"
+
+/**
+ * A ground atom stored as plain integers: the interned name of its
+ * predicate and the interned names of its constants, kept inline.  Copying,
+ * hashing and comparing one never touches a string or the heap, so it's
+ * what moves carry around and what AtomTable keys on; Atom remains the
+ * syntax node, and is needed for anything with variables.
+ *
+ * Only atoms of up to maxArity constants can be represented (see
+ * canRepresent()).
+ */
+class GroundAtom {
+public:
+    static const std::size_t maxArity = 6;
+
+    /**
+     * An atom with no predicate, as a placeholder.
+     */
+    GroundAtom();
+
+    /**
+     * Convert an atom, interning its names.  Explicit, since interning
+     * allocates and takes the SymbolTable's write lock for new names; use
+     * lookup() to convert without interning.
+     *
+     * @throws std::invalid_argument if !canRepresent(a)
+     */
+    explicit GroundAtom(const Atom& a);
+
+    /**
+     * @return true if a is ground and has at most maxArity arguments
+     */
+    static bool canRepresent(const Atom& a);
+
+    /**
+     * Convert an atom without interning anything.
+     *
+     * @return false if a can't be represented or one of its names hasn't
+     *   been interned (in which case no atom equal to it has been either)
+     */
+    static bool lookup(const Atom& a, GroundAtom& g);
+
+    SymbolId predicate() const;
+    std::size_t arity() const;
+    SymbolId arg(std::size_t i) const;
+
+    /**
+     * @return the name of the predicate
+     */
+    const std::string& name() const;
+
+    Atom toAtom() const;
+    std::string toString() const;
+
+    friend std::size_t hash_value(const GroundAtom& a);
+    friend bool operator==(const GroundAtom& l, const GroundAtom& r);
+    friend bool operator!=(const GroundAtom& l, const GroundAtom& r);
+    friend std::ostream& operator<<(std::ostream& out, const GroundAtom& a);
+
+private:
+    SymbolId predicate_;
+    boost::uint32_t arity_;
+    SymbolId args_[maxArity];   // only the first arity_ are used
+};
+
+// IMPLEMENTATION
+inline SymbolId GroundAtom::predicate() const {return predicate_;}
+inline std::size_t GroundAtom::arity() const {return arity_;}
+inline SymbolId GroundAtom::arg(std::size_t i) const {return args_[i];}
+
+inline const std::string& GroundAtom::name() const {
+    return SymbolTable::global().name(predicate_);
+}
+
+inline std::size_t hash_value(const GroundAtom& a) {
+    std::size_t seed = a.predicate_;
+    boost::hash_range(seed, a.args_, a.args_ + a.arity_);
+    return seed;
+}
+
+inline bool operator==(const GroundAtom& l, const GroundAtom& r) {
+    if (l.predicate_ != r.predicate_ || l.arity_ != r.arity_) return false;
+    for (boost::uint32_t i = 0; i < l.arity_; i++) {
+        if (l.args_[i] != r.args_[i]) return false;
+    }
+    return true;
+}
+
+inline bool operator!=(const GroundAtom& l, const GroundAtom& r) {return !operator==(l, r);}
+
+#endif /* GROUNDATOM_H_ */
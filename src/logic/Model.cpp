@@ -7,175 +7,179 @@
 
 #include <string>
 #include <sstream>
+#include <algorithm>
+#include <boost/detail/atomic_count.hpp>
 #include "Model.h"
 #include "ELSyntax.h"
 
-Model::Model(const std::vector<FOL::Event>& pairs, const Interval& maxInterval)
-    : amap_(), maxInterval_(maxInterval) {
-    /*
-    unsigned int smallest=UINT_MAX, largest=0;
-    // find the max interval
-    for (std::vector<FOL::Event>::const_iterator it = pairs.begin(); it != pairs.end(); it++) {
-
-        SpanInterval interval = it->where();
-
-        boost::optional<SpanInterval> norm = interval.normalize();
-        if (!norm) {
-            continue;
+namespace {
+    struct AtomIdPairStringCompare {
+        bool operator()(const std::pair<Atom, AtomId>& a, const std::pair<Atom, AtomId>& b) const {
+            return AtomStringCompare()(a.first, b.first);
         }
-        interval = norm.get();
-        smallest = (std::min)(interval.start().start(), smallest);
-        largest = (std::max)(interval.finish().finish(), largest);
-    }
-
-    Interval maxInterval = Interval(smallest, largest);
-    */
+    };
+}
 
+Model::Model(const std::vector<FOL::Event>& pairs, const Interval& maxInterval)
+    : sets_(), versions_(), maxInterval_(maxInterval), none_(false, maxInterval) {
     // initialize observations
     for (std::vector<FOL::Event>::const_iterator it = pairs.begin(); it != pairs.end(); it++) {
         boost::shared_ptr<const Atom> atom = it->atom();
         SpanInterval interval = it->where();
         bool truthVal = it->truthVal();
 
+        AtomId id = AtomTable::global().intern(*atom);
         SISet set(true, maxInterval_);
 
         if (truthVal) set.add(interval);
-        if (amap_.count(*atom) == 1) {
-            set.add(amap_.find(*atom)->second);
-            amap_.erase(*atom);
-        }
-        std::pair<Atom, SISet > pair(*atom, set);
-        amap_.insert(pair);
+        if (hasAtom(id)) set.add(*sets_[id]);
+        reserveId(id);
+        sets_[id].reset(new SISet(set));
+        versions_[id] = newVersion();
     }
 }
 
 Model::Model(const boost::unordered_map<Proposition, SISet>& partialModel, const Interval& maxInterval)
-    : amap_(), maxInterval_(maxInterval) {
+    : sets_(), versions_(), maxInterval_(maxInterval), none_(false, maxInterval) {
     for(boost::unordered_map<Proposition, SISet>::const_iterator it = partialModel.begin();
             it != partialModel.end(); it++) {
-        if (amap_.count(it->first.atom()) == 0) {
-            SISet empty(it->second.forceLiquid(), maxInterval_);
-            amap_.insert(std::pair<const Atom, SISet>(it->first.atom(), empty));
+        AtomId id = AtomTable::global().intern(it->first.atom());
+        if (!hasAtom(id)) {
+            reserveId(id);
+            sets_[id].reset(new SISet(it->second.forceLiquid(), maxInterval_));
         }
         if (it->first.sign()) {
-            amap_.at(it->first.atom()).add(it->second);
+            sets_[id]->add(it->second);
         } else {
-            amap_.at(it->first.atom()).subtract(it->second);
+            sets_[id]->subtract(it->second);
         }
+        versions_[id] = newVersion();
     }
 }
 
-/*
-Model::Model(const Model& m)
-    : amap_(m.amap_) {
-}
-*/
-/*
-Model::~Model() {
-}
-*/
-
-bool Model::hasAtom(const Atom& a) const {
-    return amap_.count(a) == 1;
+void Model::reserveId(AtomId id) {
+    if (id < sets_.size()) return;
+    sets_.resize(id+1);
+    versions_.resize(id+1, 0);
 }
 
-SISet Model::getAtom(const Atom& a) const {
-    if (!hasAtom(a)) {
-        return SISet(false, maxInterval_);
-    }
-
-    return amap_.at(a);
+unsigned long Model::newVersion() {
+    // shared by all models, and models are modified from several threads
+    static boost::detail::atomic_count counter(0);
+    return ++counter;
 }
 
-
-void Model::setAtom(const Atom& a, const SISet &set) {
-    // check to see if atom is in the map
-    if (hasAtom(a)) {
-        SISet current = amap_.at(a);
-        current.add(set);
-        // replace the previous element
-        amap_.erase(a);
-        amap_.insert(std::pair<const Atom, SISet>(a,current));
+void Model::setAtom(AtomId id, const SISet &set) {
+    if (hasAtom(id)) {
+        writableAtom(id).add(set);
     } else {
-        amap_.insert(std::pair<const Atom, SISet>(a,set));
+        reserveId(id);
+        sets_[id].reset(new SISet(set));
+        versions_[id] = newVersion();
     }
 }
 
-void Model::unsetAtom(const Atom& a, const SISet &set) {
-    if (!hasAtom(a)) return;
-    SISet current = amap_.at(a);
-    current.subtract(set);
-    amap_.erase(a);
-    if (current.size() != 0) {
-        amap_.insert(std::pair<const Atom, SISet>(a, current));
-    }
+void Model::unsetAtom(AtomId id, const SISet &set) {
+    if (!hasAtom(id)) return;
+    SISet& atomSet = writableAtom(id);
+    atomSet.subtract(set);
+    if (atomSet.empty()) clearAtom(id);
 }
 
-void Model::clearAtom(const Atom& a) {
-    amap_.erase(a);
+void Model::clearAtom(AtomId id) {
+    if (!hasAtom(id)) return;
+    sets_[id].reset();
+    versions_[id] = 0;
 }
 
+std::vector<AtomId> Model::atomIds() const {
+    std::vector<AtomId> ids;
+    for (std::size_t id = 0; id < sets_.size(); id++) {
+        if (sets_[id]) ids.push_back(id);
+    }
+    return ids;
+}
 
 void Model::setMaxInterval(const Interval& maxInterval) {
     maxInterval_ = maxInterval;
-    boost::unordered_map<Atom, SISet> resized;
-    for (boost::unordered_map<Atom, SISet>::iterator it = amap_.begin(); it != amap_.end(); it++) {
-        const Atom a = it->first;
-        SISet b = it->second;
-
-        b.setMaxInterval(maxInterval);
-        resized.insert(std::pair<const Atom, SISet>(a,b));
+    none_ = SISet(false, maxInterval_);
+    for (std::size_t id = 0; id < sets_.size(); id++) {
+        if (sets_[id]) writableAtom(id).setMaxInterval(maxInterval);
     }
-
-    amap_.swap(resized);
 }
 
 void Model::subtract(const Model& toSubtract) {
-    for (Model::const_iterator it = amap_.begin(); it != amap_.end(); it++) {
-        Atom a = it->first;
-        SISet set = it->second;
-
-        if (toSubtract.amap_.count(a) == 1) {
-            SISet setSubtract = toSubtract.amap_.find(a)->second;
-            set.subtract(setSubtract);
-        }
-        if (set.size() != 0) amap_.insert(std::pair<Atom, SISet>(a, set));
+    for (std::size_t id = 0; id < sets_.size(); id++) {
+        if (sets_[id] && toSubtract.hasAtom(id)) unsetAtom(id, *toSubtract.sets_[id]);
     }
 }
 
 void Model::intersect(const Model& b) {
-
-    for (Model::const_iterator it = amap_.begin(); it != amap_.end(); it++) {
-        Atom atom = it->first;
-        SISet set = it->second;
-
-        if (b.amap_.count(atom) == 1) {
-            SISet intersect = intersection(set, b.amap_.find(atom)->second);
-            if (intersect.size() != 0) amap_.insert(std::pair<Atom, SISet>(atom, intersect));
+    for (std::size_t id = 0; id < sets_.size(); id++) {
+        if (!sets_[id]) continue;
+        if (!b.hasAtom(id)) {
+            clearAtom(id);
+            continue;
+        }
+        if (sets_[id] == b.sets_[id]) continue;     // shared, so already equal
+        SISet both = intersection(*sets_[id], *b.sets_[id]);
+        if (both.empty()) clearAtom(id);
+        else {
+            sets_[id].reset(new SISet(both));
+            versions_[id] = newVersion();
         }
     }
 }
 
 unsigned long Model::size() const {
     unsigned long sum = 0;
-    for (Model::const_iterator it = amap_.begin(); it != amap_.end(); it++) {
-        sum += it->second.liqSize();
+    for (std::size_t id = 0; id < sets_.size(); id++) {
+        if (sets_[id]) sum += sets_[id]->liqSize();
     }
     return sum;
 }
 
-std::ostream& operator<<(std::ostream& out, const Model& m) {
-    // collect the keys, sort them, then print
-    std::list<Atom> atoms;
+void Model::fillCaches() const {
+    for (std::size_t id = 0; id < sets_.size(); id++) {
+        if (sets_[id]) sets_[id]->fillCaches();
+    }
+}
+
+Model Model::deepCopy() const {
+    Model copy(*this);
+    for (std::size_t id = 0; id < copy.sets_.size(); id++) {
+        if (copy.sets_[id]) copy.sets_[id].reset(new SISet(*sets_[id]));
+    }
+    return copy;
+}
+
+bool operator==(const Model& l, const Model& r) {
+    if (l.maxInterval_ != r.maxInterval_) return false;
+    const Model& shorter = (l.sets_.size() <= r.sets_.size() ? l : r);
+    const Model& longer = (l.sets_.size() <= r.sets_.size() ? r : l);
+    std::size_t id = 0;
+    for (; id < shorter.sets_.size(); id++) {
+        const boost::shared_ptr<SISet>& a = shorter.sets_[id];
+        const boost::shared_ptr<SISet>& b = longer.sets_[id];
+        if (a == b) continue;       // both absent, or sharing a set
+        if (!a || !b || *a != *b) return false;
+    }
+    for (; id < longer.sets_.size(); id++) {
+        if (longer.sets_[id]) return false;
+    }
+    return true;
+}
 
-    for (boost::unordered_map<Atom, SISet>::const_iterator it = m.amap_.begin(); it != m.amap_.end(); it++) {
-        std::pair<Atom, SISet> pair = *it;
-        atoms.push_back(pair.first);
+std::ostream& operator<<(std::ostream& out, const Model& m) {
+    // collect the atoms, sort them, then print
+    std::vector<std::pair<Atom, AtomId> > atoms;
+    for (std::size_t id = 0; id < m.sets_.size(); id++) {
+        if (m.sets_[id]) atoms.push_back(std::make_pair(AtomTable::global().atom(id), (AtomId)id));
     }
-    atoms.sort(AtomStringCompare());
+    std::sort(atoms.begin(), atoms.end(), AtomIdPairStringCompare());
 
-    for (std::list<Atom>::const_iterator it = atoms.begin(); it != atoms.end(); it++) {
-        out << it->toString() << " @ " << m.amap_.at(*it) << "\n";
+    for (std::vector<std::pair<Atom, AtomId> >::const_iterator it = atoms.begin(); it != atoms.end(); it++) {
+        out << it->first.toString() << " @ " << *m.sets_[it->second] << "\n";
     }
     return out;
 }
@@ -185,4 +189,3 @@ std::string Model::toString() const {
     strstr << *this;
     return strstr.str();
 }
-
@@ -8,36 +8,98 @@
 #ifndef MODEL_H_
 #define MODEL_H_
 
-#include <boost/unordered_map.hpp>
+#include <vector>
 #include <utility>
+#include <boost/unordered_map.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/core/null_deleter.hpp>
 #include <boost/serialization/access.hpp>
+#include <boost/serialization/shared_ptr.hpp>
+#include <boost/serialization/version.hpp>
+#include <boost/serialization/split_member.hpp>
 #include <boost/serialization/map.hpp>
 #include "../util/boost_serialize_unordered_map.hpp"
 #include "../SISet.h"
 #include "syntax/Atom.h"
 #include "syntax/Constant.h"
 #include "Event.h"
+#include "AtomTable.h"
 
+/**
+ * An assignment of truth values to ground atoms: for every atom it holds
+ * the SISet of intervals where that atom is true.
+ *
+ * Atoms are stored in a flat array indexed by their AtomId (see AtomTable),
+ * so lookups by id are a single array access, and comparing or hashing two
+ * models never needs to look at the atoms themselves.  An atom can be in the
+ * model with an empty set, which is different from not being in the model
+ * at all.
+ *
+ * The per-atom sets are shared between copies of a model and only cloned
+ * when one of the copies modifies that atom (copy-on-write).  Copying a
+ * model is therefore proportional to the number of atoms rather than the
+ * size of their sets, and a model derived from another by a Move only owns
+ * the sets for the atoms the move touched.
+ *
+ * Every atom in a model also has a version (see atomVersion()), which
+ * changes whenever its set does.  Versions let callers such as
+ * SatisfactionCache tell that an atom is unchanged without comparing sets.
+ */
 class Model {
 public:
-    typedef boost::unordered_map<Atom, SISet>::const_iterator const_iterator;
-    typedef boost::unordered_map<Atom, SISet>::value_type value_type;
-
     Model();
     explicit Model(const Interval& maxInterval_);
     Model(const std::vector<FOL::Event>& pairs, const Interval& maxInterval_);
     Model(const boost::unordered_map<Proposition, SISet>& partialModel, const Interval& maxInterval_);
-   // Model(const Model& m);
-  //  virtual ~Model();
 
     friend std::size_t hash_value(const Model& m);
 
     bool hasAtom(const Atom& a) const;
+    bool hasAtom(const GroundAtom& a) const;
+    bool hasAtom(AtomId id) const;
+
+    /**
+     * Get the set of intervals where an atom is true.
+     *
+     * @param a  the atom to look up
+     * @return the atom's SISet, or an empty non-liquid set if the atom is
+     *   not in the model.  The reference is valid until the model is next
+     *   modified.
+     */
+    const SISet& getAtom(const Atom& a) const;
+    const SISet& getAtom(const GroundAtom& a) const;
+    const SISet& getAtom(AtomId id) const;
 
-    SISet getAtom(const Atom& a) const;
     void setAtom(const Atom& a, const SISet &set);
+    void setAtom(const GroundAtom& a, const SISet &set);
+    void setAtom(AtomId id, const SISet &set);
+
+    /**
+     * Remove intervals from an atom's set, or (clearAtom()) remove the atom
+     * from the model altogether.  Atoms that were never interned in the
+     * AtomTable can't be in any model, so they're silently ignored.
+     */
     void unsetAtom(const Atom& a, const SISet &set);
+    void unsetAtom(const GroundAtom& a, const SISet &set);
+    void unsetAtom(AtomId id, const SISet &set);
     void clearAtom(const Atom& a);
+    void clearAtom(AtomId id);
+
+    /**
+     * Get the version of an atom's set.  Each change to an atom's set gives
+     * it a new version from a process-wide counter, so if two models (say a
+     * model and a copy of it with a move applied) have the same version for
+     * an atom, they have the same set for it.
+     *
+     * @param id  the atom to look up
+     * @return the atom's version, or 0 if the atom is not in the model
+     */
+    unsigned long atomVersion(AtomId id) const;
+
+    /**
+     * @return the ids of the atoms in this model, in increasing order
+     */
+    std::vector<AtomId> atomIds() const;
 
     Interval maxInterval() const;
     void setMaxInterval(const Interval& maxInterval);
@@ -46,94 +108,212 @@ public:
     void intersect(const Model& b);
 
     unsigned long size() const;
-    void swap(Model& b) { amap_.swap(b.amap_); };
+    void swap(Model& b);
+
+    /**
+     * Get a copy of this model that shares none of its sets with it.
+     *
+     * @return a copy of this model with its own sets
+     */
+    Model deepCopy() const;
+
+    /**
+     * Fill in the cached values of every set (see SISet::fillCaches()).
+     *
+     * SISets fill in cached values the first time they're read, so a model
+     * can only be read from several threads at once after this has been
+     * called, and until it is next modified.  Threads may then also copy
+     * it and modify their copies, since modifying a set shared with another
+     * model clones it first.
+     */
+    void fillCaches() const;
     std::string toString() const;
-    /*
-    bool operator ==(const Model& a) const;
-    bool operator !=(const Model& a) const {return !(*this == a);}
-*/
+
     friend bool operator==(const Model& l, const Model& r);
     friend bool operator!=(const Model& l, const Model& r);
 
     friend std::ostream& operator<<(std::ostream& out, const Model& m);
-    Model& operator=(const Model& m) { if (this != &m) amap_ = m.amap_; return *this;}   // TODO: use swap() dogg
-
 
 private:
     friend class boost::serialization::access;
-    template <class Archive>
-    void serialize(Archive& ar, const unsigned int version);
-/*
     template <class Archive>
     void save(Archive& ar, const unsigned int version) const;
     template <class Archive>
     void load(Archive& ar, const unsigned int version);
     BOOST_SERIALIZATION_SPLIT_MEMBER()
-*/
-    typedef boost::unordered_map<Atom, SISet> atom_map;
 
-    atom_map amap_;
+    // the id of a, if it has one
+    bool lookup(const Atom& a, AtomId& id) const;
+
+    // make room for atom id
+    void reserveId(AtomId id);
+
+    // get a set we're allowed to modify, cloning it if it is shared with
+    // another model, and give it a new version.  id must be in the model.
+    SISet& writableAtom(AtomId id);
+
+    // get an unused version number
+    static unsigned long newVersion();
+
+    // indexed by AtomId; null for atoms that aren't in the model
+    std::vector<boost::shared_ptr<SISet> > sets_;
+    // version of each set in sets_; 0 for atoms that aren't in the model
+    std::vector<unsigned long> versions_;
     Interval maxInterval_;
+    SISet none_;                    // returned for atoms not in the model
 };
 
+bool operator==(const Model& l, const Model& r);
+bool operator!=(const Model& l, const Model& r);
+
 // IMPLEMENTATION
 inline Model::Model()
-    : amap_(), maxInterval_(0,0) {}
+    : sets_(), versions_(), maxInterval_(0,0), none_(false, Interval(0,0)) {}
 inline Model::Model(const Interval& maxInterval)
-    : amap_(), maxInterval_(maxInterval) {}
+    : sets_(), versions_(), maxInterval_(maxInterval), none_(false, maxInterval) {}
 
 
 inline Interval Model::maxInterval() const {return maxInterval_;}
 
-inline bool operator==(const Model& l, const Model& r) {return l.amap_ == r.amap_ && l.maxInterval_ == r.maxInterval_;}
+inline bool Model::lookup(const Atom& a, AtomId& id) const {
+    return AtomTable::global().find(a, id);
+}
+
+inline bool Model::hasAtom(AtomId id) const {
+    return id < sets_.size() && sets_[id];
+}
+
+inline bool Model::hasAtom(const Atom& a) const {
+    AtomId id;
+    return lookup(a, id) && hasAtom(id);
+}
+
+inline bool Model::hasAtom(const GroundAtom& a) const {
+    AtomId id;
+    return AtomTable::global().find(a, id) && hasAtom(id);
+}
+
+inline const SISet& Model::getAtom(AtomId id) const {
+    if (!hasAtom(id)) return none_;
+    return *sets_[id];
+}
+
+inline unsigned long Model::atomVersion(AtomId id) const {
+    return (id < versions_.size() ? versions_[id] : 0);
+}
+
+inline const SISet& Model::getAtom(const Atom& a) const {
+    AtomId id;
+    if (!lookup(a, id)) return none_;
+    return getAtom(id);
+}
+
+inline const SISet& Model::getAtom(const GroundAtom& a) const {
+    AtomId id;
+    if (!AtomTable::global().find(a, id)) return none_;
+    return getAtom(id);
+}
+
+inline void Model::setAtom(const Atom& a, const SISet &set) {
+    setAtom(AtomTable::global().intern(a), set);
+}
+
+inline void Model::setAtom(const GroundAtom& a, const SISet &set) {
+    setAtom(AtomTable::global().intern(a), set);
+}
+
+inline void Model::unsetAtom(const Atom& a, const SISet &set) {
+    AtomId id;
+    if (lookup(a, id)) unsetAtom(id, set);
+}
+
+inline void Model::unsetAtom(const GroundAtom& a, const SISet &set) {
+    AtomId id;
+    if (AtomTable::global().find(a, id)) unsetAtom(id, set);
+}
+
+inline void Model::clearAtom(const Atom& a) {
+    AtomId id;
+    if (lookup(a, id)) clearAtom(id);
+}
+
+inline void Model::swap(Model& b) {
+    sets_.swap(b.sets_);
+    versions_.swap(b.versions_);
+    std::swap(maxInterval_, b.maxInterval_);
+    std::swap(none_, b.none_);
+}
+
+inline SISet& Model::writableAtom(AtomId id) {
+    if (!sets_[id].unique()) sets_[id].reset(new SISet(*sets_[id]));
+    versions_[id] = newVersion();
+    return *sets_[id];
+}
+
 inline bool operator!=(const Model& l, const Model& r) {return !operator==(l, r);}
 
 inline std::size_t hash_value(const Model& m) {
     std::size_t seed = 0;
-    boost::hash_range(seed, m.amap_.begin(), m.amap_.end());
+    for (std::size_t id = 0; id < m.sets_.size(); id++) {
+        if (!m.sets_[id]) continue;
+        boost::hash_combine(seed, id);
+        boost::hash_combine(seed, *m.sets_[id]);
+    }
     boost::hash_combine(seed, m.maxInterval_);
     return seed;
 }
 
-template <class Archive>
-void Model::serialize(Archive& ar, const unsigned int version) {
-    ar & amap_;
-    ar & maxInterval_;
-}
-/*
+// models are archived as a map from atoms to their sets, since ids are only
+// meaningful within one process
 template <class Archive>
 void Model::save(Archive& ar, const unsigned int version) const {
-    // no support for boost-serialization and the unordered map, so we'll
-    // do it by hand.  this isn't an exact serialization but should be
-    // enough for our purposes
-
-    // write the size
-    // TODO: should we handle bucket size as well?
-    boost::unordered_map<Atom, SISet>::size_type size = amap_.size();
-    ar & size;
-    for (boost::unordered_map<Atom, SISet>::const_iterator it = amap_.begin(); it != amap_.end(); it++) {
-        ar & *it;
+    // atoms are written through pointers into the AtomTable so that an
+    // atom shared by several models in one archive is written once.  sets
+    // are written from the model itself; SISets aren't tracked, so sets
+    // shared between models are simply written twice.
+    std::size_t count = 0;
+    for (std::size_t id = 0; id < sets_.size(); id++) {
+        if (sets_[id]) count++;
     }
-    // max interval
     ar & maxInterval_;
+    ar & count;
+    for (std::size_t id = 0; id < sets_.size(); id++) {
+        if (!sets_[id]) continue;
+        // the AtomTable keeps its atoms in a deque it never erases from, so
+        // the atom stays put for as long as the archive needs the pointer
+        boost::shared_ptr<Atom> atom(const_cast<Atom*>(&AtomTable::global().atom(id)), boost::null_deleter());
+        ar & atom;
+        ar & *sets_[id];
+    }
 }
 
 template <class Archive>
 void Model::load(Archive& ar, const unsigned int version) {
-    // clear the map
-    amap_.clear();
-    // read the size
-    boost::unordered_map<Atom, SISet>::size_type size;
-    ar & size;
-    for (boost::unordered_map<Atom, SISet>::size_type i = 0; i < size; i++) {
-        // read a pair
-        std::pair<Atom, SISet> pair;
-        ar & pair;
-        // insert it into the map
-        amap_.insert(pair);
+    sets_.clear();
+    versions_.clear();
+    if (version == 0) {
+        boost::unordered_map<Atom, SISet> amap;
+        ar & amap;
+        ar & maxInterval_;
+        none_ = SISet(false, maxInterval_);
+        for (boost::unordered_map<Atom, SISet>::const_iterator it = amap.begin(); it != amap.end(); it++) {
+            setAtom(it->first, it->second);
+        }
+        return;
     }
     ar & maxInterval_;
+    none_ = SISet(false, maxInterval_);
+    std::size_t count;
+    ar & count;
+    for (std::size_t i = 0; i < count; i++) {
+        boost::shared_ptr<Atom> atom;
+        SISet set;
+        ar & atom;
+        ar & set;
+        setAtom(*atom, set);
+    }
 }
-*/
+
+BOOST_CLASS_VERSION(Model, 1)
 
 #endif /* MODEL_H_ */
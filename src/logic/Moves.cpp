@@ -21,20 +21,28 @@
 #include "NameGenerator.h"
 
 
+namespace {
+// a change to an atom.  the atom is interned here, once, so scoring and
+// executing the move only ever deal with its id
+Move::change makeChange(const Atom& a, const SpanInterval& si) {
+    return Move::change(AtomTable::global().intern(a), si);
+}
+}
+
 std::string Move::toString() const {
     std::stringstream str;
 
     str << "toAdd: {";
     for (std::vector<Move::change>::const_iterator it = toAdd.begin(); it != toAdd.end(); it++){
         if (it != toAdd.begin()) str << ", ";
-        str << it->get<0>().toString() << " @ " << it->get<1>().toString();
+        str << AtomTable::global().atom(it->get<0>()).toString() << " @ " << it->get<1>().toString();
     }
     str << "}, ";
 
     str << "toDel: {";
     for (std::vector<Move::change>::const_iterator it = toDel.begin(); it != toDel.end(); it++){
         if (it != toDel.begin()) str << ", ";
-        str << it->get<0>().toString() << " @ " << it->get<1>().toString();
+        str << AtomTable::global().atom(it->get<0>()).toString() << " @ " << it->get<1>().toString();
     }
     str << "}";
 
@@ -268,7 +276,7 @@ std::vector<Move> findMovesForForm1(const Domain& d, const Model& m, const Disju
             falseAt = disSingle->dSatisfied(m, d).compliment();
             LOG(LOG_DEBUG) << "false at :" << falseAt.toString();
         }
-        if (falseAt.size() != 0) {
+        if (!falseAt.empty()) {
             // pick a span interval at random
             SpanInterval toSatisfy = falseAt.randomSI(rng);
 
@@ -284,14 +292,14 @@ std::vector<Move> findMovesForForm1(const Domain& d, const Model& m, const Disju
                     toScan = intersection(phi2TrueAt, toScan);
 
                     unsigned int t;
-                    if (toScan.size() != 0) {
+                    if (!toScan.empty()) {
                         t = set_at(toScan.asSet(), 0).start().start()-1;
                         // satisfy precedent over that expinterval
                         std::vector<Move> localMoves = findMovesForLiquid(d, m, *body->sentence(), SpanInterval(b,t,b,t));
                         moves.insert(moves.end(), localMoves.begin(), localMoves.end());
                     }
                     // option 2, add the consequent
-                    if (toScan.size() == 0) {
+                    if (toScan.empty()) {
                         std::vector<Move> localMoves = findMovesForLiquid(d, m, *phi2Liq->sentence(), SpanInterval(b,b+1,b,b+1));
                         moves.insert(moves.end(), localMoves.begin(), localMoves.end());
                     } else {
@@ -308,7 +316,7 @@ std::vector<Move> findMovesForForm1(const Domain& d, const Model& m, const Disju
                     toScan = intersection(phi2TrueAt, toScan);
 
                     unsigned int t;
-                    if (toScan.size() != 0) {
+                    if (!toScan.empty()) {
                         t = set_at(toScan.asSet(), toScan.asSet().size()-1).finish().finish();
                         // delete precedent over that interval
                         std::vector<Move> localMoves = findMovesForLiquid(d, m, *body, SpanInterval(t,b,t,b));
@@ -335,7 +343,7 @@ std::vector<Move> findMovesForForm1(const Domain& d, const Model& m, const Disju
             falseAt = disSingle->dSatisfied(m, d).compliment();
             LOG(LOG_DEBUG) << "false at :" << falseAt.toString();
         }
-        if (falseAt.size() != 0) {
+        if (!falseAt.empty()) {
             // pick a span interval at random
             SpanInterval toSatisfy = falseAt.randomSI(rng);
             unsigned int b = toSatisfy.start().start();
@@ -350,14 +358,14 @@ std::vector<Move> findMovesForForm1(const Domain& d, const Model& m, const Disju
                     toScan = intersection(phi2TrueAt, toScan);
 
                     unsigned int t;
-                    if (toScan.size() != 0) {
+                    if (!toScan.empty()) {
                         t = set_at(toScan.asSet(), toScan.asSet().size()-1).finish().finish()+1;
                         // satisfy precedent over that expinterval
                         std::vector<Move> localMoves = findMovesForLiquid(d, m, *body->sentence(), SpanInterval(t,b-1,t,b-1));
                         moves.insert(moves.end(), localMoves.begin(), localMoves.end());
                     }
                     // option 2, add the consequent
-                    if (toScan.size() == 0) {
+                    if (toScan.empty()) {
                         std::vector<Move> localMoves = findMovesForLiquid(d, m, *phi2Liq->sentence(), SpanInterval(b-2,b-1,b-2,b-1));
                         moves.insert(moves.end(), localMoves.begin(), localMoves.end());
                     } else {
@@ -374,7 +382,7 @@ std::vector<Move> findMovesForForm1(const Domain& d, const Model& m, const Disju
                     toScan = intersection(phi2TrueAt, toScan);
 
                     unsigned int t;
-                    if (toScan.size() != 0) {
+                    if (!toScan.empty()) {
                         t = set_at(toScan.asSet(), 0).start().start()-1;
                         // delete precedent over that interval
                         std::vector<Move> localMoves = findMovesForLiquid(d, m, *body, SpanInterval(b,t,b,t));
@@ -400,7 +408,7 @@ std::vector<Move> findMovesForForm1(const Domain& d, const Model& m, const Disju
             falseAt = disSingle->dSatisfied(m, d).compliment();
             LOG(LOG_DEBUG) << "false at :" << falseAt.toString();
         }
-        if (falseAt.size() != 0) {
+        if (!falseAt.empty()) {
             // pick a span interval at random
             SpanInterval toSatisfy = falseAt.randomSI(rng);
             unsigned int b = toSatisfy.finish().finish();
@@ -415,7 +423,7 @@ std::vector<Move> findMovesForForm1(const Domain& d, const Model& m, const Disju
                     toScan = intersection(phi2TrueAt, toScan);
 
                     unsigned int t;
-                    if (toScan.size() != 0) {
+                    if (!toScan.empty()) {
                         t = set_at(toScan.asSet(), 0).finish().finish();
                         // satisfy precedent over that expinterval
                         std::vector<Move> localMoves = findMovesForLiquid(d, m, *body->sentence(), SpanInterval(b,t,b,t));
@@ -433,7 +441,7 @@ std::vector<Move> findMovesForForm1(const Domain& d, const Model& m, const Disju
                     toScan = intersection(phi2TrueAt, toScan);
 
                     unsigned int t;
-                    if (toScan.size() == 0) {
+                    if (toScan.empty()) {
                         // delete phi1 completely!
                         t = 0;
                     } else {
@@ -443,7 +451,7 @@ std::vector<Move> findMovesForForm1(const Domain& d, const Model& m, const Disju
                     moves.insert(moves.end(), localMoves.begin(), localMoves.end());
 
                     // case 3: extend phi2 until phi1 is true
-                    if (toScan.size() == 0) {
+                    if (toScan.empty()) {
                         t = b-1;    // instead of adding it at 0, we will consider adding for the previous step
                     }
                     localMoves = findMovesForLiquid(d, m, *phi2Liq->sentence(), SpanInterval(t,b,t,b));
@@ -465,7 +473,7 @@ std::vector<Move> findMovesForForm1(const Domain& d, const Model& m, const Disju
                 falseAt = disSingle->dSatisfied(m, d).compliment();
                 LOG(LOG_DEBUG) << "false at :" << falseAt.toString();
             }
-            if (falseAt.size() != 0) {
+            if (!falseAt.empty()) {
                 // TODO: only two moves??
                 // pick a span interval at random
                 SpanInterval toSatisfy = falseAt.randomSI(rng);
@@ -480,7 +488,7 @@ std::vector<Move> findMovesForForm1(const Domain& d, const Model& m, const Disju
                 toScan = intersection(phi2TrueAt, toScan);
 
                 unsigned int t;
-                if (toScan.size() != 0) {
+                if (!toScan.empty()) {
                     t = set_at(toScan.asSet(), toScan.asSet().size()-1).finish().finish()+1;
                 } else {
                     t = b-1;
@@ -490,7 +498,7 @@ std::vector<Move> findMovesForForm1(const Domain& d, const Model& m, const Disju
                 moves.insert(moves.end(), localMoves.begin(), localMoves.end());
 
                 // case 2: delete phi1 until phi2 is true
-                if (toScan.size() == 0) {
+                if (toScan.empty()) {
                     t = toSatisfy.start().start();
                 }
                 localMoves = findMovesForLiquid(d, m, *body, SpanInterval(t,b,t,b));
@@ -603,7 +611,7 @@ std::vector<Move> findMovesForForm2(const Domain& d, const Model& m, const Disju
     toIntersect.add(SpanInterval(b+1, d.maxInterval().finish(), b+1, d.maxInterval().finish()));
     SISet toScan = intersection(phiPrimeTrueAt, toIntersect);
     unsigned int t=0;
-    if (toScan.size() != 0) {
+    if (!toScan.empty()) {
         // pick the first element
         t = set_at(toScan.asSet(), 0).start().start()-1;
         // choose local moves adding phik between b and t
@@ -629,7 +637,7 @@ std::vector<Move> findMovesForForm2(const Domain& d, const Model& m, const Disju
     toIntersect = SISet(true, d.maxInterval());
     toIntersect.add(SpanInterval(phikLowerBound, b, phikLowerBound, b));
     toScan = intersection(phiPrimeTrueAt, toIntersect);
-    if (toScan.size() == 0) {
+    if (toScan.empty()) {
         t = phikLowerBound;
     } else {
         t = set_at(toScan.asSet(), toScan.asSet().size()-1).finish().finish()-1;
@@ -828,13 +836,13 @@ Move findMovesForLiquidLiteral(const Domain& d, const Model& m, const Sentence &
         if (isNegation) {
             // we want to delete span intervals where its true
             BOOST_FOREACH(SpanInterval toModifySi, toModify.asSet()) {
-                Move::change change = boost::make_tuple(*a, toModifySi);
+                Move::change change = makeChange(*a, toModifySi);
                 move.toDel.push_back(change);
             }
         } else {
             BOOST_FOREACH(SpanInterval toModifySi, toModify.asSet()) {
                 // we want to add span intervals where its false
-                Move::change change = boost::make_tuple(*a, toModifySi);
+                Move::change change = makeChange(*a, toModifySi);
                 move.toAdd.push_back(change);
             }
         }
@@ -878,11 +886,11 @@ Move findMovesForLiquidConjunction(const Domain& d, const Model& m, const Conjun
         if (dynamic_cast<const Negation*>(s)) {
             const Negation* n = dynamic_cast<const Negation*>(s);
             const Atom* a = dynamic_cast<const Atom*>(&(*n->sentence()));
-            Move::change change = boost::make_tuple(*a, si);
+            Move::change change = makeChange(*a, si);
             move.toDel.push_back(change);
         } else {
             const Atom* a = dynamic_cast<const Atom*>(s);
-            Move::change change = boost::make_tuple(*a, si);
+            Move::change change = makeChange(*a, si);
             move.toAdd.push_back(change);
         }
     }
@@ -978,7 +986,7 @@ std::vector<Move> findMovesFor(const Domain& d, const Model& m, const ELSentence
         std::copy(it->toDel.begin(), it->toDel.end(), std::back_inserter(allMoves));
 
         for (std::vector<Move::change>::iterator it2 = allMoves.begin(); it2 != allMoves.end(); it2++) {
-            Atom a = it2->get<0>();
+            const Atom& a = AtomTable::global().atom(it2->get<0>());
             SpanInterval where = it2->get<1>();
             SISet asSet(where, false, d.maxInterval());
             SISet mod = d.getModifiableSISet(a, asSet);
@@ -1022,9 +1030,9 @@ std::vector<Move> findMovesForPELCNFLiteral(const Domain& d, const Model& m, con
         if (d.isLiquid(a->name()) && !si.isLiquid()) {
             // need to add it to a liquid spaninterval
             SpanInterval si2(si.start().start(), si.finish().finish(), si.start().start(), si.finish().finish());
-            move.toAdd.push_back(boost::make_tuple(*a, si2));
+            move.toAdd.push_back(makeChange(*a, si2));
         } else {
-            move.toAdd.push_back(boost::make_tuple(*a, si));
+            move.toAdd.push_back(makeChange(*a, si));
         }
         moves.push_back(move);
         return moves;
@@ -1044,9 +1052,9 @@ std::vector<Move> findMovesForPELCNFLiteral(const Domain& d, const Model& m, con
             Move move;
             if (d.isLiquid(a->name()) && !si.isLiquid()) {
                 SpanInterval si2(si.start().start(), si.finish().finish(), si.start().start(), si.finish().finish());
-                move.toDel.push_back(boost::make_tuple(*a, si2));
+                move.toDel.push_back(makeChange(*a, si2));
             } else {
-                move.toDel.push_back(boost::make_tuple(*a, si));
+                move.toDel.push_back(makeChange(*a, si));
             }
             moves.push_back(move);
             return moves;
@@ -1058,7 +1066,7 @@ std::vector<Move> findMovesForPELCNFLiteral(const Domain& d, const Model& m, con
                     // We've got !<>{*}, this is easy
                     Move move;
                     SpanInterval everywhere(d.maxInterval(), d.maxInterval());
-                    move.toDel.push_back(boost::make_tuple(*a, everywhere));
+                    move.toDel.push_back(makeChange(*a, everywhere));
                     moves.push_back(move);
                     return moves;
                 }
@@ -1093,9 +1101,9 @@ std::vector<Move> findMovesForPELCNFLiteral(const Domain& d, const Model& m, con
                 Move move;
                 if (d.isLiquid(a->name()) && !si2.isLiquid()) {
                     SpanInterval si3(si2.start().start(), si2.finish().finish(), si2.start().start(), si2.finish().finish());
-                    move.toDel.push_back(boost::make_tuple(*a, si3));
+                    move.toDel.push_back(makeChange(*a, si3));
                 } else {
-                    move.toDel.push_back(boost::make_tuple(*a, si2));
+                    move.toDel.push_back(makeChange(*a, si2));
                 }
                 moves.push_back(move);
                 return moves;
@@ -1146,7 +1154,7 @@ std::vector<Move> findMovesForPELCNFLiteral(const Domain& d, const Model& m, con
                             Interval inter = interOpt.get();
                             // remove that part of the spanning interval
                             SpanInterval siToRemove(inter.start(), leftSi.finish().finish(), inter.start(), leftSi.finish().finish());
-                            move.toDel.push_back(boost::make_tuple(*leftAtom, siToRemove));
+                            move.toDel.push_back(makeChange(*leftAtom, siToRemove));
                         }
                     }
                     if (!move.isEmpty()) moves.push_back(move);
@@ -1160,7 +1168,7 @@ std::vector<Move> findMovesForPELCNFLiteral(const Domain& d, const Model& m, con
                             Interval inter = interOpt.get();
                             // remove that part of the spanning interval
                             SpanInterval siToRemove(rightSi.start().start(), inter.finish(), rightSi.start().start(), inter.finish());
-                            move.toDel.push_back(boost::make_tuple(*rightAtom, siToRemove));
+                            move.toDel.push_back(makeChange(*rightAtom, siToRemove));
                         }
                     }
                     if (!move.isEmpty()) moves.push_back(move);
@@ -1220,7 +1228,7 @@ std::vector<Move> findMovesForPELCNFLiteral(const Domain& d, const Model& m, con
             boost::uniform_int<unsigned int> pointPick(durInt.start().start(), durInt.start().finish());
             unsigned int point = pointPick(rng);
             Move move;
-            move.toAdd.push_back(boost::make_tuple(*a, SpanInterval(point, point, point, point)));
+            move.toAdd.push_back(makeChange(*a, SpanInterval(point, point, point, point)));
             moves.push_back(move);
             return moves;
         }
@@ -1235,14 +1243,14 @@ std::vector<Move> findMovesForPELCNFLiteral(const Domain& d, const Model& m, con
             if (insideSatisfiedAt.size() == 0) {
                 // just add it at the beginning
                 Move move;
-                move.toAdd.push_back(boost::make_tuple(*a,
+                move.toAdd.push_back(makeChange(*a,
                         SpanInterval(j, j, j, j)));
                 moves.push_back(move);
                 return moves;
             } else {
                 SpanInterval mostRecent = set_at(insideSatisfiedAt.asSet(), insideSatisfiedAt.asSet().size()-1);
                 Move move;
-                move.toAdd.push_back(boost::make_tuple(*a,
+                move.toAdd.push_back(makeChange(*a,
                         SpanInterval(mostRecent.finish().finish()+1,
                                 j,
                                 mostRecent.finish().finish()+1,
@@ -1262,14 +1270,14 @@ std::vector<Move> findMovesForPELCNFLiteral(const Domain& d, const Model& m, con
             if (insideSatisfiedAt.size() == 0) {
                 // just add it at the end
                 Move move;
-                move.toAdd.push_back(boost::make_tuple(*a,
+                move.toAdd.push_back(makeChange(*a,
                         SpanInterval(j, j, j, j)));
                 moves.push_back(move);
                 return moves;
             } else {
                 SpanInterval mostRecent = set_at(insideSatisfiedAt.asSet(), 0);
                 Move move;
-                move.toAdd.push_back(boost::make_tuple(*a,
+                move.toAdd.push_back(makeChange(*a,
                         SpanInterval(j,
                                 mostRecent.start().start(),
                                 j,
@@ -1328,7 +1336,7 @@ Model executeMove(const Domain& d, const Move& move, const Model& model) {
             currentModel.insert(std::pair<const Atom, SISet>(it->get<0>(), trueAt));
         }
         */
-        bool isLiquid = d.isLiquid(it->get<0>().name());
+        bool isLiquid = d.isLiquid(it->get<0>());
         SISet trueAt(isLiquid, d.maxInterval());
         trueAt.add(it->get<1>());
         currentModel.setAtom(it->get<0>(), trueAt);
@@ -1352,7 +1360,7 @@ Model executeMove(const Domain& d, const Move& move, const Model& model) {
         }
         */
         if (currentModel.hasAtom(it->get<0>())) {
-            SISet toRemove(d.isLiquid(it->get<0>().name()), d.maxInterval());
+            SISet toRemove(d.isLiquid(it->get<0>()), d.maxInterval());
             toRemove.add(it->get<1>());
             currentModel.unsetAtom(it->get<0>(), toRemove);
         }
@@ -1494,9 +1502,9 @@ bool moveContainsObservationPreds(const Domain& d, const Move &m) {
         //if (d.observedPredicates().find(it->get<0>().name()) != d.observedPredicates().end()) {
         //  return true;
         //}
-        SISet original(d.isLiquid(it->get<0>().name()), d.maxInterval());
+        SISet original(d.isLiquid(it->get<0>()), d.maxInterval());
         original.add(it->get<1>());
-        SISet modifiable = d.getModifiableSISet(it->get<0>(), original);
+        SISet modifiable = d.getModifiableSISet(AtomTable::global().atom(it->get<0>()), original);
         if (modifiable.size() != original.size()) return true;
 
        // if (it->get<0>().name().find("D-") == 0) return true;
@@ -1511,9 +1519,9 @@ bool moveContainsObservationPreds(const Domain& d, const Move &m) {
         }
         if (it->get<0>().name().find("D-") == 0) return true;
         */
-        SISet original(d.isLiquid(it->get<0>().name()), d.maxInterval());
+        SISet original(d.isLiquid(it->get<0>()), d.maxInterval());
         original.add(it->get<1>());
-        SISet modifiable = d.getModifiableSISet(it->get<0>(), original);
+        SISet modifiable = d.getModifiableSISet(AtomTable::global().atom(it->get<0>()), original);
         if (modifiable.size() != original.size()) return true;
     }
 
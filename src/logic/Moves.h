@@ -14,6 +14,7 @@
 
 #include "../SISet.h"
 #include "Domain.h"
+#include "AtomTable.h"
 #include "../util/Utils.h"
 #include "../Log.h"
 #include "ELSyntax.h"
@@ -21,8 +22,13 @@
 class LiquidOp;
 class Sentence;
 
+/**
+ * A change to a model: intervals to add to and remove from atoms' sets.
+ * Atoms are interned when the move is built, so a change holds the atom's
+ * id; scoring and executing the move never have to look the atom up.
+ */
 struct Move {
-    typedef boost::tuple <Atom, SpanInterval> change;
+    typedef boost::tuple <AtomId, SpanInterval> change;
     std::vector<change> toAdd;
     std::vector<change> toDel;
 
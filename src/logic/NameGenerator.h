@@ -21,6 +21,8 @@ public:
     friend bool operator!=(const NameGenerator& l, const NameGenerator& r);
 private:
     friend class boost::serialization::access;
+    friend class Snapshot;
+    friend class SnapshotWriter;
     template <class Archive>
     void serialize(Archive& ar, const unsigned int version);
 
@@ -0,0 +1,86 @@
+/*
+ * SatisfactionCache.cpp
+ */
+
+#include <boost/functional/hash.hpp>
+#include "SatisfactionCache.h"
+#include "Model.h"
+
+const unsigned int SatisfactionCache::defCapacity = 4096;
+
+SatisfactionCache::SatisfactionCache(unsigned int capacity, std::size_t byteCapacity)
+    : cache_(capacity, byteCapacity), versions_() {}
+
+bool SatisfactionCache::find(const Sentence& s, std::size_t hash, bool forceLiquid, const Interval& maxInterval,
+        const Model& m, const std::vector<AtomId>& atoms, SISet& result) {
+    if (!enabled()) return false;
+    setVersions(m, atoms);
+    Probe probe;
+    probe.sentence = &s;
+    probe.hash = hash;
+    probe.forceLiquid = forceLiquid;
+    probe.maxInterval = &maxInterval;
+    probe.versions = &versions_;
+    const SISet* cached = cache_.find(probe, KeyHash(), KeyEqual());
+    if (cached == 0) return false;
+    result = *cached;
+    return true;
+}
+
+void SatisfactionCache::insert(const boost::shared_ptr<const Sentence>& s, std::size_t hash, bool forceLiquid,
+        const Interval& maxInterval, const Model& m, const std::vector<AtomId>& atoms,
+        const SISet& result) {
+    if (!enabled()) return;
+    setVersions(m, atoms);
+    Key key;
+    key.sentence = s;
+    key.hash = hash;
+    key.forceLiquid = forceLiquid;
+    key.maxInterval = maxInterval;
+    key.versions = versions_;
+    cache_.insert(key, result);
+}
+
+// since versions are unique across atoms and models, the versions alone
+// pin down the state of the atoms
+void SatisfactionCache::setVersions(const Model& m, const std::vector<AtomId>& atoms) {
+    versions_.resize(atoms.size());
+    for (std::size_t i = 0; i < atoms.size(); i++) {
+        versions_[i] = m.atomVersion(atoms[i]);
+    }
+}
+
+std::size_t SatisfactionCache::KeyHash::operator()(const Key& k) const {
+    std::size_t seed = k.hash;
+    boost::hash_combine(seed, k.forceLiquid);
+    boost::hash_combine(seed, k.maxInterval);
+    boost::hash_range(seed, k.versions.begin(), k.versions.end());
+    return seed;
+}
+
+std::size_t SatisfactionCache::KeyHash::operator()(const Probe& p) const {
+    std::size_t seed = p.hash;
+    boost::hash_combine(seed, p.forceLiquid);
+    boost::hash_combine(seed, *p.maxInterval);
+    boost::hash_range(seed, p.versions->begin(), p.versions->end());
+    return seed;
+}
+
+bool SatisfactionCache::KeyEqual::operator()(const Key& a, const Key& b) const {
+    return a.hash == b.hash && a.forceLiquid == b.forceLiquid && a.maxInterval == b.maxInterval
+            && a.versions == b.versions
+            && (a.sentence == b.sentence || *a.sentence == *b.sentence);
+}
+
+bool SatisfactionCache::KeyEqual::operator()(const Probe& a, const Key& b) const {
+    return a.hash == b.hash && a.forceLiquid == b.forceLiquid && *a.maxInterval == b.maxInterval
+            && *a.versions == b.versions
+            && (a.sentence == b.sentence.get() || *a.sentence == *b.sentence);
+}
+
+// roughly the memory an entry takes up, not counting the cache's own
+// bookkeeping
+std::size_t SatisfactionCache::EntrySize::operator()(const Key& k, const SISet& result) const {
+    return sizeof(Key) + k.versions.size()*sizeof(unsigned long)
+            + sizeof(SISet) + result.intervals().size()*sizeof(SpanInterval);
+}
@@ -0,0 +1,145 @@
+/*
+ * SatisfactionCache.h
+ */
+
+#ifndef SATISFACTIONCACHE_H_
+#define SATISFACTIONCACHE_H_
+
+#include <cstddef>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "../Interval.h"
+#include "../LRUCache.h"
+#include "../SISet.h"
+#include "AtomTable.h"
+#include "syntax/Sentence.h"
+
+class Model;
+
+/**
+ * Counts of how a SatisfactionCache has been used, for sizing it.
+ */
+typedef LRUCacheStats SatisfactionCacheStats;
+
+/**
+ * A least-recently-used cache of where subformulas are satisfied.
+ *
+ * An entry is keyed on the subformula (compared structurally, so equal
+ * subformulas of different formulas share entries), the forceLiquid flag it
+ * was evaluated with, the domain's maximum interval, and the versions (see
+ * Model::atomVersion()) of the atoms it mentions in the model it was
+ * evaluated on.  Since a model's version for an atom changes whenever the
+ * atom does, an entry can never be stale with respect to a model: models
+ * that differ only in atoms the subformula doesn't mention get cache hits,
+ * and changing one of its atoms (or the maximum interval) just makes for a
+ * miss.
+ *
+ * A capacity of 0 turns the cache off.  Like SISets, a cache can only be
+ * used by one thread at a time.
+ */
+class SatisfactionCache {
+public:
+    static const unsigned int defCapacity;
+
+    /**
+     * @param capacity      the most entries to hold
+     * @param byteCapacity  the most memory (roughly) for entries to take, or
+     *   0 for no limit
+     */
+    explicit SatisfactionCache(unsigned int capacity=defCapacity, std::size_t byteCapacity=0);
+
+    /**
+     * Look up where a subformula is satisfied in a model.
+     *
+     * @param s            the subformula
+     * @param hash         hash_value(s)
+     * @param forceLiquid  the forceLiquid flag s is evaluated with
+     * @param maxInterval  the maximum interval of the domain s is evaluated
+     *   in
+     * @param m            the model s is evaluated on
+     * @param atoms        the atoms s mentions, in a fixed order (the same
+     *   for every lookup of s)
+     * @param result       set to the cached result on a hit
+     * @return true if the result was in the cache
+     */
+    bool find(const Sentence& s, std::size_t hash, bool forceLiquid, const Interval& maxInterval,
+            const Model& m, const std::vector<AtomId>& atoms, SISet& result);
+
+    /**
+     * Store where a subformula is satisfied, evicting the least recently
+     * used entries if the cache is full.  Arguments are as for find().
+     */
+    void insert(const boost::shared_ptr<const Sentence>& s, std::size_t hash, bool forceLiquid,
+            const Interval& maxInterval, const Model& m, const std::vector<AtomId>& atoms,
+            const SISet& result);
+
+    std::size_t size() const;
+    unsigned int capacity() const;
+    void setCapacity(unsigned int capacity);
+    std::size_t byteCapacity() const;
+    void setByteCapacity(std::size_t byteCapacity);
+    std::size_t bytes() const;
+    bool enabled() const;
+    void clear();
+
+    const SatisfactionCacheStats& stats() const;
+    void resetStats();
+
+    void swap(SatisfactionCache& b);
+
+private:
+    struct Key {
+        boost::shared_ptr<const Sentence> sentence;
+        std::size_t hash;
+        bool forceLiquid;
+        Interval maxInterval;
+        std::vector<unsigned long> versions;
+    };
+
+    // what find() looks up with, to avoid copying into a Key
+    struct Probe {
+        const Sentence* sentence;
+        std::size_t hash;
+        bool forceLiquid;
+        const Interval* maxInterval;
+        const std::vector<unsigned long>* versions;
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& k) const;
+        std::size_t operator()(const Probe& p) const;
+    };
+
+    struct KeyEqual {
+        bool operator()(const Key& a, const Key& b) const;
+        bool operator()(const Probe& a, const Key& b) const;
+    };
+
+    struct EntrySize {
+        std::size_t operator()(const Key& k, const SISet& result) const;
+    };
+
+    void setVersions(const Model& m, const std::vector<AtomId>& atoms);
+
+    LRUCache<Key, SISet, KeyHash, KeyEqual, EntrySize> cache_;
+    std::vector<unsigned long> versions_;   // scratch, to save reallocating
+};
+
+// IMPLEMENTATION
+inline std::size_t SatisfactionCache::size() const {return cache_.size();}
+inline unsigned int SatisfactionCache::capacity() const {return cache_.capacity();}
+inline void SatisfactionCache::setCapacity(unsigned int capacity) {cache_.setCapacity(capacity);}
+inline std::size_t SatisfactionCache::byteCapacity() const {return cache_.byteCapacity();}
+inline void SatisfactionCache::setByteCapacity(std::size_t byteCapacity) {cache_.setByteCapacity(byteCapacity);}
+inline std::size_t SatisfactionCache::bytes() const {return cache_.bytes();}
+inline bool SatisfactionCache::enabled() const {return cache_.capacity() != 0;}
+inline void SatisfactionCache::clear() {cache_.clear();}
+inline const SatisfactionCacheStats& SatisfactionCache::stats() const {return cache_.stats();}
+inline void SatisfactionCache::resetStats() {cache_.resetStats();}
+
+inline void SatisfactionCache::swap(SatisfactionCache& b) {
+    cache_.swap(b.cache_);
+    versions_.swap(b.versions_);
+}
+
+#endif /* SATISFACTIONCACHE_H_ */
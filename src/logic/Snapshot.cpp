@@ -0,0 +1,567 @@
+/*
+ * Snapshot.cpp
+ */
+
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <stdexcept>
+#include <boost/shared_ptr.hpp>
+#include "Snapshot.h"
+#include "ELSyntax.h"
+
+const boost::uint32_t Snapshot::formatVersion = 1;
+
+namespace {
+    typedef boost::uint32_t word;
+
+    const char magic[8] = {'P', 'E', 'L', 'S', 'N', 'A', 'P', '\0'};
+    const word byteOrderMark = 0x01020304;
+
+    // header: magic (2 words), version, byte order mark, size in words,
+    // then where the strings, atoms, domain, formulas and models start
+    enum {
+        VERSION_WORD = 2,
+        BYTE_ORDER_WORD,
+        SIZE_WORD,
+        STRINGS_WORD,
+        ATOMS_WORD,
+        DOMAIN_WORD,
+        FORMULAS_WORD,
+        MODELS_WORD,
+        HEADER_WORDS
+    };
+
+    // operators of the postfix encoding of sentences
+    enum {
+        OP_ATOM,        // followed by an atom index
+        OP_TRUE,
+        OP_FALSE,
+        OP_NEGATION,
+        OP_DISJUNCTION,
+        OP_CONJUNCTION, // followed by relations and temporal constraints
+        OP_DIAMOND,     // likewise
+        OP_LIQUID
+    };
+
+    const word VARIABLE_TERM = 1;   // low bit of a term word
+    const word FORCE_LIQUID = 1;    // flag of an SISet
+    const word INF_WEIGHT = 1;      // flags of a formula
+    const word QUANTIFIED = 2;
+
+    const AtomId noId = (AtomId)-1;
+
+    bool isDefault(const TQConstraints& tq) {
+        const TQConstraints def;
+        return tq.mustBeIn.empty() && tq.mustNotBeIn.empty()
+                && tq.mustBeIn.forceLiquid() == def.mustBeIn.forceLiquid()
+                && tq.mustNotBeIn.forceLiquid() == def.mustNotBeIn.forceLiquid()
+                && tq.mustBeIn.maxInterval() == def.mustBeIn.maxInterval()
+                && tq.mustNotBeIn.maxInterval() == def.mustNotBeIn.maxInterval();
+    }
+
+    void putDouble(std::vector<word>& out, double d) {
+        word w[2];
+        std::memcpy(w, &d, sizeof(d));
+        out.push_back(w[0]);
+        out.push_back(w[1]);
+    }
+
+    void writeWords(std::ostream& out, const std::vector<word>& words) {
+        if (words.empty()) return;
+        out.write(reinterpret_cast<const char*>(&words[0]), words.size()*sizeof(word));
+    }
+
+    // a table is a count, count+1 offsets into its data, and the data
+    std::size_t tableWords(const std::vector<word>& offsets, const std::vector<word>& data) {
+        return 1 + offsets.size() + 1 + data.size();
+    }
+
+    void writeTable(std::ostream& out, const std::vector<word>& offsets, const std::vector<word>& data) {
+        std::vector<word> head;
+        head.push_back(offsets.size());
+        head.insert(head.end(), offsets.begin(), offsets.end());
+        head.push_back(data.size());
+        writeWords(out, head);
+        writeWords(out, data);
+    }
+}
+
+SnapshotWriter::SnapshotWriter()
+    : strings_(), stringIndices_(), atoms_(), atomOffsets_(), atomIndices_(), hasDomain_(false),
+      domain_(), formulas_(), formulaOffsets_(), models_(), modelOffsets_() {}
+
+void SnapshotWriter::setDomain(const Domain& d) {
+    if (hasDomain_) throw std::logic_error("SnapshotWriter::setDomain(): snapshot already has a domain");
+    hasDomain_ = true;
+
+    domain_.push_back(d.dontModifyObsPreds() ? 1 : 0);
+    putInterval(domain_, d.maxInterval());
+    domain_.push_back(d.generator_.counter_);
+
+    domain_.push_back(d.atoms_size());
+    for (Domain::atom_const_iterator it = d.atoms_begin(); it != d.atoms_end(); it++) {
+        domain_.push_back(atomIndex(*it));
+    }
+    std::size_t countAt = domain_.size();
+    domain_.push_back(0);
+    for (Domain::fact_const_iterator it = d.facts_begin(); it != d.facts_end(); it++) {
+        domain_.push_back(atomIndex(it->first.atom()));
+        domain_.push_back(it->first.sign() ? 1 : 0);
+        putSISet(domain_, it->second);
+        domain_[countAt]++;
+    }
+
+    for (Domain::formula_const_iterator it = d.formulas_begin(); it != d.formulas_end(); it++) {
+        formulaOffsets_.push_back(formulas_.size());
+        putFormula(formulas_, *it);
+    }
+}
+
+void SnapshotWriter::addModel(const Model& m) {
+    modelOffsets_.push_back(models_.size());
+    putInterval(models_, m.maxInterval());
+    std::vector<AtomId> ids = m.atomIds();
+    models_.push_back(ids.size());
+    for (std::vector<AtomId>::const_iterator it = ids.begin(); it != ids.end(); it++) {
+        models_.push_back(atomIndex(AtomTable::global().atom(*it)));
+        putSISet(models_, m.getAtom(*it));
+    }
+}
+
+void SnapshotWriter::write(std::ostream& out) const {
+    // the string table's data is its characters, padded out to a word
+    std::vector<word> stringOffsets;
+    std::string chars;
+    for (std::vector<std::string>::const_iterator it = strings_.begin(); it != strings_.end(); it++) {
+        stringOffsets.push_back(chars.size());
+        chars += *it;
+    }
+    std::vector<word> stringData((chars.size() + sizeof(word) - 1) / sizeof(word), 0);
+    if (!chars.empty()) std::memcpy(&stringData[0], chars.data(), chars.size());
+    // offsets are in bytes, so the end offset is the unpadded size
+    std::vector<word> stringHead;
+    stringHead.push_back(stringOffsets.size());
+    stringHead.insert(stringHead.end(), stringOffsets.begin(), stringOffsets.end());
+    stringHead.push_back(chars.size());
+
+    std::vector<word> header(HEADER_WORDS, 0);
+    std::memcpy(&header[0], magic, sizeof(magic));
+    header[VERSION_WORD] = Snapshot::formatVersion;
+    header[BYTE_ORDER_WORD] = byteOrderMark;
+    std::size_t pos = HEADER_WORDS;
+    header[STRINGS_WORD] = pos;
+    pos += stringHead.size() + stringData.size();
+    header[ATOMS_WORD] = pos;
+    pos += tableWords(atomOffsets_, atoms_);
+    if (hasDomain_) {
+        header[DOMAIN_WORD] = pos;
+        pos += domain_.size();
+        header[FORMULAS_WORD] = pos;
+        pos += tableWords(formulaOffsets_, formulas_);
+    }
+    header[MODELS_WORD] = pos;
+    pos += tableWords(modelOffsets_, models_);
+    header[SIZE_WORD] = pos;
+
+    writeWords(out, header);
+    writeWords(out, stringHead);
+    writeWords(out, stringData);
+    writeTable(out, atomOffsets_, atoms_);
+    if (hasDomain_) {
+        writeWords(out, domain_);
+        writeTable(out, formulaOffsets_, formulas_);
+    }
+    writeTable(out, modelOffsets_, models_);
+}
+
+void SnapshotWriter::write(const std::string& filename) const {
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) throw std::runtime_error("unable to open snapshot file " + filename + " for writing");
+    write(out);
+    out.close();
+    if (out.fail()) throw std::runtime_error("unable to write snapshot file " + filename);
+}
+
+SnapshotWriter::word SnapshotWriter::stringIndex(const std::string& s) {
+    boost::unordered_map<std::string, word>::const_iterator found = stringIndices_.find(s);
+    if (found != stringIndices_.end()) return found->second;
+    word i = strings_.size();
+    strings_.push_back(s);
+    stringIndices_.insert(std::make_pair(s, i));
+    return i;
+}
+
+SnapshotWriter::word SnapshotWriter::atomIndex(const Atom& a) {
+    boost::unordered_map<Atom, word>::const_iterator found = atomIndices_.find(a);
+    if (found != atomIndices_.end()) return found->second;
+    word i = atomOffsets_.size();
+    atomOffsets_.push_back(atoms_.size());
+    atoms_.push_back(stringIndex(a.name()));
+    atoms_.push_back(a.arity());
+    for (int t = 0; t < a.arity(); t++) {
+        const Term& term = a.at(t);
+        word isVariable = (dynamic_cast<const Variable*>(&term) != 0 ? VARIABLE_TERM : 0);
+        atoms_.push_back((stringIndex(term.name()) << 1) | isVariable);
+    }
+    atomIndices_.insert(std::make_pair(a, i));
+    return i;
+}
+
+void SnapshotWriter::putInterval(std::vector<word>& out, const Interval& i) {
+    out.push_back(i.isNull() ? 1 : 0);
+    out.push_back(i.start());
+    out.push_back(i.finish());
+}
+
+void SnapshotWriter::putSISet(std::vector<word>& out, const SISet& set) {
+    out.push_back(set.forceLiquid() ? FORCE_LIQUID : 0);
+    putInterval(out, set.maxInterval());
+    out.push_back(set.intervals().size());
+    for (SISet::const_iterator it = set.begin(); it != set.end(); it++) {
+        out.push_back(it->start().start());
+        out.push_back(it->start().finish());
+        out.push_back(it->finish().start());
+        out.push_back(it->finish().finish());
+    }
+}
+
+// children first, so the reader can build sentences with a stack
+void SnapshotWriter::putSentence(std::vector<word>& out, const Sentence& s) {
+    if (s.getTypeCode() == Atom::TypeCode) {
+        word i = atomIndex(static_cast<const Atom&>(s));
+        out.push_back(OP_ATOM);
+        out.push_back(i);
+    } else if (s.getTypeCode() == BoolLit::TypeCode) {
+        out.push_back(static_cast<const BoolLit&>(s).value() ? OP_TRUE : OP_FALSE);
+    } else if (s.getTypeCode() == Negation::TypeCode) {
+        putSentence(out, *static_cast<const Negation&>(s).sentence());
+        out.push_back(OP_NEGATION);
+    } else if (s.getTypeCode() == LiquidOp::TypeCode) {
+        putSentence(out, *static_cast<const LiquidOp&>(s).sentence());
+        out.push_back(OP_LIQUID);
+    } else if (s.getTypeCode() == Disjunction::TypeCode) {
+        const Disjunction& dis = static_cast<const Disjunction&>(s);
+        putSentence(out, *dis.left());
+        putSentence(out, *dis.right());
+        out.push_back(OP_DISJUNCTION);
+    } else if (s.getTypeCode() == Conjunction::TypeCode) {
+        const Conjunction& con = static_cast<const Conjunction&>(s);
+        putSentence(out, *con.left());
+        putSentence(out, *con.right());
+        out.push_back(OP_CONJUNCTION);
+        out.push_back(con.relations().size());
+        out.insert(out.end(), con.relations().begin(), con.relations().end());
+        std::pair<const TQConstraints, const TQConstraints> tq = con.tqconstraints();
+        bool hasTQ = !isDefault(tq.first) || !isDefault(tq.second);
+        out.push_back(hasTQ ? 1 : 0);
+        if (hasTQ) {
+            putSISet(out, tq.first.mustBeIn);
+            putSISet(out, tq.first.mustNotBeIn);
+            putSISet(out, tq.second.mustBeIn);
+            putSISet(out, tq.second.mustNotBeIn);
+        }
+    } else if (s.getTypeCode() == DiamondOp::TypeCode) {
+        const DiamondOp& dia = static_cast<const DiamondOp&>(s);
+        putSentence(out, *dia.sentence());
+        out.push_back(OP_DIAMOND);
+        out.push_back(dia.relations().size());
+        out.insert(out.end(), dia.relations().begin(), dia.relations().end());
+        bool hasTQ = !isDefault(dia.tqconstraints());
+        out.push_back(hasTQ ? 1 : 0);
+        if (hasTQ) {
+            putSISet(out, dia.tqconstraints().mustBeIn);
+            putSISet(out, dia.tqconstraints().mustNotBeIn);
+        }
+    } else {
+        throw std::logic_error("SnapshotWriter: can't encode sentence " + s.toString());
+    }
+}
+
+void SnapshotWriter::putFormula(std::vector<word>& out, const ELSentence& e) {
+    out.push_back((e.hasInfWeight() ? INF_WEIGHT : 0) | (e.isQuantified() ? QUANTIFIED : 0));
+    putDouble(out, e.hasInfWeight() ? 1.0 : e.weight());
+    if (e.isQuantified()) putSISet(out, e.quantification());
+    putSentence(out, *e.sentence());
+}
+
+Snapshot::Cursor::Cursor(const word* begin, const word* end) : pos_(begin), end_(end) {}
+
+Snapshot::word Snapshot::Cursor::next() {
+    return *take(1);
+}
+
+const Snapshot::word* Snapshot::Cursor::take(std::size_t n) {
+    if ((std::size_t)(end_ - pos_) < n) throw std::runtime_error("snapshot is truncated or corrupt");
+    const word* start = pos_;
+    pos_ += n;
+    return start;
+}
+
+double Snapshot::Cursor::nextDouble() {
+    double d;
+    std::memcpy(&d, take(2), sizeof(d));
+    return d;
+}
+
+Snapshot::Snapshot(const std::string& filename)
+    : file_(), words_(0), size_(0), strings_(0), atoms_(0), domain_(0), formulas_(0), models_(0),
+      stringData_(0), ids_() {
+    try {
+        file_.open(filename);
+    } catch (std::exception& e) {
+        throw std::runtime_error("unable to map snapshot file " + filename + ": " + e.what());
+    }
+    open(file_.data(), file_.size());
+}
+
+Snapshot::Snapshot(const char* data, std::size_t size)
+    : file_(), words_(0), size_(0), strings_(0), atoms_(0), domain_(0), formulas_(0), models_(0),
+      stringData_(0), ids_() {
+    open(data, size);
+}
+
+void Snapshot::open(const char* data, std::size_t size) {
+    if (size < HEADER_WORDS*sizeof(word) || size % sizeof(word) != 0
+            || std::memcmp(data, magic, sizeof(magic)) != 0) {
+        throw std::runtime_error("not a snapshot");
+    }
+    words_ = reinterpret_cast<const word*>(data);
+    size_ = size / sizeof(word);
+    if (words_[BYTE_ORDER_WORD] != byteOrderMark) {
+        throw std::runtime_error("snapshot was written on a machine with a different byte order");
+    }
+    if (words_[VERSION_WORD] != formatVersion) {
+        throw std::runtime_error("snapshot has an unsupported format version");
+    }
+    if (words_[SIZE_WORD] != size_) throw std::runtime_error("snapshot is truncated or corrupt");
+    strings_ = words_[STRINGS_WORD];
+    atoms_ = words_[ATOMS_WORD];
+    domain_ = words_[DOMAIN_WORD];
+    formulas_ = words_[FORMULAS_WORD];
+    models_ = words_[MODELS_WORD];
+
+    // the characters follow the string offsets
+    Cursor in = section(strings_);
+    word count = in.next();
+    const word* offsets = in.take(count+1);
+    std::size_t charWords = (offsets[count] + sizeof(word) - 1) / sizeof(word);
+    stringData_ = reinterpret_cast<const char*>(in.take(charWords));
+    for (word i = 0; i < count; i++) {
+        if (offsets[i] > offsets[i+1]) throw std::runtime_error("snapshot is truncated or corrupt");
+    }
+
+    entries(atoms_);
+    entries(models_);
+    ids_.assign(atoms_size(), noId);
+}
+
+Domain Snapshot::domain() const {
+    if (!hasDomain()) throw std::logic_error("Snapshot::domain(): snapshot has no domain");
+    Cursor in = section(domain_);
+    Domain d;
+    d.dontModifyObsPreds_ = (in.next() != 0);
+    d.maxInterval_ = getInterval(in);
+    d.generator_.counter_ = in.next();
+
+    // intern the domain's atoms first, as Domain::addAtom() does, so they
+    // get contiguous ids
+    word numAtoms = in.next();
+    for (word i = 0; i < numAtoms; i++) {
+        word index = in.next();
+        Atom a = atom(index);
+        d.allAtoms_->insert(a);
+        if (ids_[index] == noId) ids_[index] = AtomTable::global().intern(a);
+    }
+    word numFacts = in.next();
+    for (word i = 0; i < numFacts; i++) {
+        Atom a = atom(in.next());
+        bool sign = (in.next() != 0);
+        d.partialModel_->insert(std::make_pair(Proposition(a, sign), getSISet(in)));
+    }
+    for (std::size_t i = 0; i < formulas_size(); i++) {
+        d.formulas_.push_back(formula(i));
+    }
+    d.rebuildFormulaIndex();
+    return d;
+}
+
+ELSentence Snapshot::formula(std::size_t i) const {
+    if (formulas_ == 0) throw std::logic_error("Snapshot::formula(): snapshot has no domain");
+    Cursor in = entry(formulas_, i);
+    return getFormula(in);
+}
+
+Model Snapshot::model(std::size_t i) const {
+    Cursor in = entry(models_, i);
+    Model m(getInterval(in));
+    word count = in.next();
+    for (word j = 0; j < count; j++) {
+        AtomId id = atomId(in.next());
+        m.setAtom(id, getSISet(in));
+    }
+    return m;
+}
+
+std::vector<Model> Snapshot::models() const {
+    std::vector<Model> all;
+    all.reserve(models_size());
+    for (std::size_t i = 0; i < models_size(); i++) {
+        all.push_back(model(i));
+    }
+    return all;
+}
+
+Atom Snapshot::atom(std::size_t i) const {
+    Cursor in = entry(atoms_, i);
+    Atom a(string(in.next()));
+    word arity = in.next();
+    for (word t = 0; t < arity; t++) {
+        word term = in.next();
+        if (term & VARIABLE_TERM) {
+            a.push_back(Variable(string(term >> 1)));
+        } else {
+            a.push_back(Constant(string(term >> 1)));
+        }
+    }
+    return a;
+}
+
+Snapshot::Cursor Snapshot::section(word offset) const {
+    if (offset >= size_) throw std::runtime_error("snapshot is truncated or corrupt");
+    return Cursor(words_ + offset, words_ + size_);
+}
+
+Snapshot::Cursor Snapshot::entry(word offset, std::size_t i) const {
+    Cursor in = section(offset);
+    word count = in.next();
+    if (i >= count) throw std::out_of_range("snapshot entry out of range");
+    const word* offsets = in.take(count+1);
+    const word* data = offsets + count + 1;
+    if (offsets[i] > offsets[i+1] || offsets[i+1] > (std::size_t)(words_ + size_ - data)) {
+        throw std::runtime_error("snapshot is truncated or corrupt");
+    }
+    return Cursor(data + offsets[i], data + offsets[i+1]);
+}
+
+// also checks that the table fits in the snapshot
+std::size_t Snapshot::entries(word offset) const {
+    Cursor in = section(offset);
+    word count = in.next();
+    const word* offsets = in.take(count+1);
+    in.take(offsets[count]);
+    return count;
+}
+
+std::string Snapshot::string(word i) const {
+    Cursor in = section(strings_);
+    word count = in.next();
+    if (i >= count) throw std::runtime_error("snapshot is truncated or corrupt");
+    const word* offsets = in.take(count+1);
+    return std::string(stringData_ + offsets[i], stringData_ + offsets[i+1]);
+}
+
+AtomId Snapshot::atomId(word i) const {
+    if (i >= ids_.size()) throw std::runtime_error("snapshot is truncated or corrupt");
+    if (ids_[i] == noId) ids_[i] = AtomTable::global().intern(atom(i));
+    return ids_[i];
+}
+
+Interval Snapshot::getInterval(Cursor& in) const {
+    bool isNull = (in.next() != 0);
+    word start = in.next();
+    word finish = in.next();
+    return (isNull ? Interval() : Interval(start, finish));
+}
+
+// sets are stored in their canonical (sorted) form, so the members can be
+// copied in as they are rather than added one at a time
+SISet Snapshot::getSISet(Cursor& in) const {
+    bool forceLiquid = ((in.next() & FORCE_LIQUID) != 0);
+    Interval maxInterval = getInterval(in);
+    word count = in.next();
+    const word* ends = in.take(4*(std::size_t)count);
+    SISet set(forceLiquid, maxInterval);
+    set.set_.reserve(count);
+    for (word i = 0; i < count; i++, ends += 4) {
+        set.set_.push_back(SpanInterval(ends[0], ends[1], ends[2], ends[3]));
+    }
+    return set;
+}
+
+boost::shared_ptr<Sentence> Snapshot::getSentence(Cursor& in) const {
+    std::vector<boost::shared_ptr<Sentence> > stack;
+    // a sentence ends where the formula does
+    while (true) {
+        word op;
+        try {
+            op = in.next();
+        } catch (std::runtime_error&) {
+            break;
+        }
+        boost::shared_ptr<Sentence> s;
+        if (op == OP_ATOM) {
+            s.reset(new Atom(atom(in.next())));
+        } else if (op == OP_TRUE || op == OP_FALSE) {
+            s.reset(new BoolLit(op == OP_TRUE));
+        } else if (stack.empty()) {
+            throw std::runtime_error("snapshot is truncated or corrupt");
+        } else if (op == OP_NEGATION) {
+            s.reset(new Negation(stack.back()));
+            stack.pop_back();
+        } else if (op == OP_LIQUID) {
+            s.reset(new LiquidOp(stack.back()));
+            stack.pop_back();
+        } else if (op == OP_DIAMOND) {
+            word numRels = in.next();
+            const word* rels = in.take(numRels);
+            std::vector<Interval::INTERVAL_RELATION> relations;
+            for (word i = 0; i < numRels; i++) relations.push_back((Interval::INTERVAL_RELATION)rels[i]);
+            TQConstraints tq;
+            bool hasTQ = (in.next() != 0);
+            if (hasTQ) {
+                tq.mustBeIn = getSISet(in);
+                tq.mustNotBeIn = getSISet(in);
+            }
+            s.reset(new DiamondOp(stack.back(), relations.begin(), relations.end(), hasTQ ? &tq : 0));
+            stack.pop_back();
+        } else if (stack.size() < 2) {
+            throw std::runtime_error("snapshot is truncated or corrupt");
+        } else if (op == OP_DISJUNCTION) {
+            s.reset(new Disjunction(stack[stack.size()-2], stack.back()));
+            stack.resize(stack.size()-2);
+        } else if (op == OP_CONJUNCTION) {
+            word numRels = in.next();
+            const word* rels = in.take(numRels);
+            std::vector<Interval::INTERVAL_RELATION> relations;
+            for (word i = 0; i < numRels; i++) relations.push_back((Interval::INTERVAL_RELATION)rels[i]);
+            std::pair<TQConstraints, TQConstraints> tq;
+            bool hasTQ = (in.next() != 0);
+            if (hasTQ) {
+                tq.first.mustBeIn = getSISet(in);
+                tq.first.mustNotBeIn = getSISet(in);
+                tq.second.mustBeIn = getSISet(in);
+                tq.second.mustNotBeIn = getSISet(in);
+            }
+            s.reset(new Conjunction(stack[stack.size()-2], stack.back(), relations.begin(), relations.end(),
+                    hasTQ ? &tq : 0));
+            stack.resize(stack.size()-2);
+        } else {
+            throw std::runtime_error("snapshot is truncated or corrupt");
+        }
+        stack.push_back(s);
+    }
+    if (stack.size() != 1) throw std::runtime_error("snapshot is truncated or corrupt");
+    return stack.back();
+}
+
+ELSentence Snapshot::getFormula(Cursor& in) const {
+    word flags = in.next();
+    double weight = in.nextDouble();
+    SISet quantification;
+    if (flags & QUANTIFIED) quantification = getSISet(in);
+    ELSentence e(getSentence(in));
+    if (!(flags & INF_WEIGHT)) e.setWeight(weight);
+    if (flags & QUANTIFIED) e.setQuantification(quantification);
+    return e;
+}
@@ -0,0 +1,192 @@
+/*
+ * Snapshot.h
+ */
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include "AtomTable.h"
+#include "Domain.h"
+#include "Model.h"
+#include "../SISet.h"
+#include "syntax/ELSentence.h"
+
+/**
+ * Writes a domain and a sequence of models (such as the samples an MCSat
+ * run keeps) as a binary snapshot, to be read back with Snapshot.
+ *
+ * A snapshot is an array of 32 bit words in the byte order of the machine
+ * that wrote it.  Names of predicates, constants and variables are stored
+ * once in a string table, and atoms once in an atom table that everything
+ * else refers to by index.  SISets are stored as flat arrays of endpoints,
+ * and formulas in postfix order with one word per operator.  Each formula
+ * and model has its own offset, so a reader can decode any one of them
+ * without looking at the rest.
+ */
+class SnapshotWriter {
+public:
+    SnapshotWriter();
+
+    /**
+     * Set the domain to write (at most one per snapshot).
+     */
+    void setDomain(const Domain& d);
+
+    /**
+     * Add a model to the snapshot, after the ones already added.
+     */
+    void addModel(const Model& m);
+    template <class InputIterator>
+    void addModels(InputIterator begin, InputIterator end);
+
+    std::size_t models_size() const;
+
+    void write(std::ostream& out) const;
+
+    /**
+     * @throws std::runtime_error if the file can't be written
+     */
+    void write(const std::string& filename) const;
+
+private:
+    typedef boost::uint32_t word;
+
+    word stringIndex(const std::string& s);
+    word atomIndex(const Atom& a);
+    void putInterval(std::vector<word>& out, const Interval& i);
+    void putSISet(std::vector<word>& out, const SISet& set);
+    void putSentence(std::vector<word>& out, const Sentence& s);
+    void putFormula(std::vector<word>& out, const ELSentence& e);
+
+    std::vector<std::string> strings_;
+    boost::unordered_map<std::string, word> stringIndices_;
+    std::vector<word> atoms_;
+    std::vector<word> atomOffsets_;
+    boost::unordered_map<Atom, word> atomIndices_;
+    bool hasDomain_;
+    std::vector<word> domain_;
+    std::vector<word> formulas_;
+    std::vector<word> formulaOffsets_;
+    std::vector<word> models_;
+    std::vector<word> modelOffsets_;
+};
+
+/**
+ * A snapshot written by SnapshotWriter, mapped into memory and decoded on
+ * demand: nothing is decoded when the snapshot is opened, and reading one
+ * model or formula decodes only that one.  Atoms are interned into
+ * AtomTable::global() as they are first decoded.
+ *
+ * Snapshots are meant for reloading data written by the same build on the
+ * same kind of machine, not for exchange; the file is checked for its
+ * format version and byte order, and decoding stops with an error rather
+ * than reading past the end of it, but the contents are otherwise trusted.
+ *
+ * A snapshot remembers the ids of atoms it has decoded, so like SISets it
+ * can only be used by one thread at a time.
+ */
+class Snapshot : boost::noncopyable {
+public:
+    static const boost::uint32_t formatVersion;
+
+    /**
+     * Map a snapshot file.
+     *
+     * @throws std::runtime_error if the file can't be opened or isn't a
+     *   snapshot this build can read
+     */
+    explicit Snapshot(const std::string& filename);
+
+    /**
+     * Read a snapshot out of a buffer, which must stay valid (and must be
+     * aligned for 32 bit words) for as long as the snapshot is used.
+     */
+    Snapshot(const char* data, std::size_t size);
+
+    bool hasDomain() const;
+
+    /**
+     * Decode the domain.  Its formulas, facts and atoms are the same as
+     * those of the domain that was written.
+     *
+     * @throws std::logic_error if the snapshot has no domain
+     */
+    Domain domain() const;
+
+    /**
+     * Decode one formula of the domain, without decoding the rest.
+     */
+    std::size_t formulas_size() const;
+    ELSentence formula(std::size_t i) const;
+
+    std::size_t models_size() const;
+    Model model(std::size_t i) const;
+    std::vector<Model> models() const;
+
+    std::size_t atoms_size() const;
+    Atom atom(std::size_t i) const;
+
+private:
+    typedef boost::uint32_t word;
+
+    // reads words from a range of the snapshot, throwing at the end of it
+    class Cursor {
+    public:
+        Cursor(const word* begin, const word* end);
+        word next();
+        const word* take(std::size_t n);
+        double nextDouble();
+    private:
+        const word* pos_;
+        const word* end_;
+    };
+
+    void open(const char* data, std::size_t size);
+    Cursor section(word offset) const;
+    // entry i of a section laid out as a count, count+1 offsets and the
+    // data they point into
+    Cursor entry(word offset, std::size_t i) const;
+    std::size_t entries(word offset) const;
+
+    std::string string(word i) const;
+    AtomId atomId(word i) const;
+    Interval getInterval(Cursor& in) const;
+    SISet getSISet(Cursor& in) const;
+    boost::shared_ptr<Sentence> getSentence(Cursor& in) const;
+    ELSentence getFormula(Cursor& in) const;
+
+    boost::iostreams::mapped_file_source file_;
+    const word* words_;
+    std::size_t size_;          // in words
+    // where each section starts, in words; domain_ and formulas_ are 0 if
+    // there is no domain
+    word strings_, atoms_, domain_, formulas_, models_;
+    const char* stringData_;
+    // ids of the atoms decoded so far, or noId
+    mutable std::vector<AtomId> ids_;
+};
+
+// IMPLEMENTATION
+template <class InputIterator>
+void SnapshotWriter::addModels(InputIterator begin, InputIterator end) {
+    for (InputIterator it = begin; it != end; it++) {
+        addModel(*it);
+    }
+}
+
+inline std::size_t SnapshotWriter::models_size() const {return modelOffsets_.size();}
+
+inline bool Snapshot::hasDomain() const {return domain_ != 0;}
+inline std::size_t Snapshot::formulas_size() const {return (formulas_ == 0 ? 0 : entries(formulas_));}
+inline std::size_t Snapshot::models_size() const {return entries(models_);}
+inline std::size_t Snapshot::atoms_size() const {return entries(atoms_);}
+
+#endif /* SNAPSHOT_H_ */
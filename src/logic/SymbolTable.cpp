@@ -0,0 +1,23 @@
+/*
+ * SymbolTable.cpp
+ */
+#include "SymbolTable.h"
+
+SymbolTable& SymbolTable::global() {
+    static SymbolTable table;
+    return table;
+}
+
+SymbolId SymbolTable::intern(const std::string& name) {
+    SymbolId id;
+    if (find(name, id)) return id;
+
+    boost::unique_lock<boost::shared_mutex> lock(mutex_);
+    // another thread may have added it since we looked
+    boost::unordered_map<std::string, SymbolId>::const_iterator it = ids_.find(name);
+    if (it != ids_.end()) return it->second;
+    id = names_.size();
+    names_.push_back(name);
+    ids_.insert(std::make_pair(name, id));
+    return id;
+}
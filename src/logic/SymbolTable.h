@@ -0,0 +1,82 @@
+/*
+ * SymbolTable.h
+ */
+
+#ifndef SYMBOLTABLE_H_
+#define SYMBOLTABLE_H_
+
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+/**
+ * Dense integer identifier for a predicate or constant name.
+ */
+typedef boost::uint32_t SymbolId;
+
+/**
+ * Interning table for the names of predicates and constants, so that they
+ * can be stored and compared as integers (see GroundAtom).  Like AtomTable
+ * there is a single process-wide table, and like it the table can be used
+ * from several threads at once: lookups share a read lock and intern()
+ * takes a write lock only when it adds a name.
+ */
+class SymbolTable {
+public:
+    /**
+     * Get the table shared by all atoms.
+     */
+    static SymbolTable& global();
+
+    /**
+     * Get the id for a name, assigning the next free one if the name hasn't
+     * been seen before.
+     */
+    SymbolId intern(const std::string& name);
+
+    /**
+     * Look up the id for a name without assigning one.
+     *
+     * @return true if name has been interned
+     */
+    bool find(const std::string& name, SymbolId& id) const;
+
+    /**
+     * Get the name with a given id.  The reference stays valid for the
+     * lifetime of the table.
+     */
+    const std::string& name(SymbolId id) const;
+
+    std::size_t size() const;
+
+private:
+    mutable boost::shared_mutex mutex_;
+    boost::unordered_map<std::string, SymbolId> ids_;
+    std::deque<std::string> names_;     // deque so references aren't invalidated
+};
+
+// IMPLEMENTATION
+inline bool SymbolTable::find(const std::string& name, SymbolId& id) const {
+    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    boost::unordered_map<std::string, SymbolId>::const_iterator it = ids_.find(name);
+    if (it == ids_.end()) return false;
+    id = it->second;
+    return true;
+}
+
+inline const std::string& SymbolTable::name(SymbolId id) const {
+    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    if (id >= names_.size()) throw std::out_of_range("SymbolTable::name() - no symbol with that id");
+    return names_[id];
+}
+
+inline std::size_t SymbolTable::size() const {
+    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    return names_.size();
+}
+
+#endif /* SYMBOLTABLE_H_ */
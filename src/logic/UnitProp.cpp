@@ -11,99 +11,440 @@
 #include <list>
 #include <queue>
 #include <algorithm>
+#include <vector>
+#include <sstream>
+#include <string>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
 #include "UnitProp.h"
 #include "logic/Domain.h"
 #include "logic/Collectors.h"
 #include "Log.h"
 
+namespace {
+    /**
+     * Convert the infinitely-weighted CNF formulas of a list into QCNF,
+     * quantifying any unquantified ones over everywhere.  The others are
+     * added to leftover.
+     */
+    QCNFClauseList convertToSuitableClauses(const std::vector<ELSentence>& formulas, const SpanInterval& everywhere,
+            const Interval& maxInterval, std::vector<ELSentence>& leftover) {
+        std::vector<ELSentence> upforms;
+        for (std::vector<ELSentence>::const_iterator it = formulas.begin(); it != formulas.end(); it++) {
+            // if it's not infinitely weighted, its not suitable
+            if (!it->hasInfWeight()) {
+                leftover.push_back(*it);
+                continue;
+            }
+            // check for cnf
+            if (!isPELCNFLiteral(*it->sentence()) && !isDisjunctionOfPELCNFLiterals(*it->sentence())) {
+                LOG_PRINT(LOG_WARN) << "Sentence: " << *it << " is not in CNF form!  ignoring";
+                leftover.push_back(*it);
+                continue;
+            }
+            upforms.push_back(*it);
+            // add quantification to any formulas that may be missing them
+            if (!it->isQuantified()) {
+                upforms.back().setQuantification(SISet(everywhere, false, maxInterval));
+            }
+        }
+        return convertToQCNFClauseList(upforms);
+    }
+
+    std::string describeResult(const QUnitsFormulasPair& result) {
+        std::stringstream newForms;
+        newForms << "Unit Clauses:\n";
+        for (QCNFLiteralList::const_iterator it = result.first.begin(); it != result.first.end(); it++) {
+            newForms << "\t" << convertFromQCNFClause(*it) << "\n";
+        }
+        newForms << "upforms:\n";
+        for (QCNFClauseList::const_iterator it = result.second.begin(); it != result.second.end(); it++) {
+            newForms << "\t" << convertFromQCNFClause(*it) << "\n";
+        }
+        return newForms.str();
+    }
+}
+
 Domain performUnitPropagation(const Domain& d) {
     LOG(LOG_INFO) << "performing unit propagation...";
-    std::vector<ELSentence> upforms(d.formulas_begin(), d.formulas_end());
-    std::vector<ELSentence> leftover;
-
-    // add quantification to any formulas that may be missing them, and remove
-    // upforms that aren't in CNF form
-    for (std::vector<ELSentence>::iterator it = upforms.begin(); it != upforms.end(); ) {
-        // if it's not infinitely weighted, its not suitable
-        if (!it->hasInfWeight()) {
-            leftover.push_back(*it);
-            it = upforms.erase(it);
-            continue;
-        }
-        if (!it->isQuantified()) {
-            SISet everywhere(d.maxSpanInterval(), false, d.maxInterval());
-            it->setQuantification(everywhere);
+    UnitPropagator propagator(d);
+    Domain newD = propagator.domain();
+    LOG(LOG_INFO) << "unit prop completed.\n" << describeResult(propagator.result());
+    return newD;
+}
+
+QUnitsFormulasPair performUnitPropagation(const QCNFClauseList& sentences) {
+    return UnitPropagator(sentences).result();
+}
+
+namespace {
+    // orders clause ids by rank
+    struct rank_cmp {
+        const std::vector<boost::uint64_t>& ranks;
+        explicit rank_cmp(const std::vector<boost::uint64_t>& r) : ranks(r) {}
+        bool operator()(std::size_t a, std::size_t b) const { return ranks[a] < ranks[b]; }
+    };
+}
+
+const QCNFClauseStore::Rank QCNFClauseStore::spacing;
+
+QCNFClauseStore::QCNFClauseStore()
+    : clauses_(), ranks_(), live_(), order_(), occurrences_(), sentences_(), changes_(), marks_(0) {}
+
+const ELSentence& QCNFClauseStore::sentence(std::size_t id) const {
+    if (!sentences_[id]) {
+        sentences_[id].reset(new ELSentence(convertFromQCNFClause(clauses_[id])));
+        sentences_[id]->setHasInfWeight(true);
+    }
+    return *sentences_[id];
+}
+
+std::vector<std::size_t> QCNFClauseStore::clausesMentioning(const Atom& a) {
+    std::vector<std::size_t> found;
+    boost::unordered_map<Atom, std::vector<std::size_t> >::iterator entry = occurrences_.find(a);
+    if (entry == occurrences_.end()) return found;
+    std::vector<std::size_t>& ids = entry->second;
+    for (std::vector<std::size_t>::iterator it = ids.begin(); it != ids.end(); ) {
+        if (*it < live_.size() && live_[*it]) {
+            found.push_back(*it);
+            it++;
+        } else {
+            it = ids.erase(it);
         }
-        // check for cnf
-        if (!isPELCNFLiteral(*it->sentence()) && !isDisjunctionOfPELCNFLiterals(*it->sentence())) {
-            LOG_PRINT(LOG_WARN) << "Sentence: " << *it << " is not in CNF form!  ignoring";
-            leftover.push_back(*it);
-            it = upforms.erase(it);
-            continue;
+    }
+    std::sort(found.begin(), found.end(), rank_cmp(ranks_));
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    return found;
+}
+
+std::vector<std::size_t> QCNFClauseStore::ids() const {
+    std::vector<std::size_t> result;
+    result.reserve(order_.size());
+    for (std::map<Rank, std::size_t>::const_iterator it = order_.begin(); it != order_.end(); it++) {
+        result.push_back(it->second);
+    }
+    return result;
+}
+
+void QCNFClauseStore::add(const QCNFClause& c) {
+    addAt(c, order_.empty() ? spacing : order_.rbegin()->first + spacing);
+}
+
+void QCNFClauseStore::addAt(const QCNFClause& c, Rank rank) {
+    std::size_t id = clauses_.size();
+    clauses_.push_back(c);
+    ranks_.push_back(rank);
+    live_.push_back(true);
+    sentences_.push_back(boost::shared_ptr<ELSentence>());
+    order_.insert(std::make_pair(rank, id));
+    if (marks_ > 0) {
+        Change change;
+        change.type = ADDED;
+        change.id = id;
+        changes_.push_back(change);
+    }
+
+    AtomCollector collector;
+    for (CNFClause::const_iterator it = c.first.begin(); it != c.first.end(); it++) {
+        (*it)->visit(collector);
+    }
+    for (AtomCollector::atom_set::const_iterator it = collector.atoms.begin(); it != collector.atoms.end(); it++) {
+        occurrences_[*it].push_back(id);
+    }
+}
+
+QCNFClauseStore::Rank QCNFClauseStore::gapAfter(std::size_t id) const {
+    std::map<Rank, std::size_t>::const_iterator next = order_.upper_bound(ranks_[id]);
+    return (next == order_.end() ? spacing : next->first - ranks_[id]);
+}
+
+void QCNFClauseStore::replace(std::size_t id, const QCNFClauseList& with) {
+    if (marks_ > 0) {
+        Change change;
+        change.type = REPLACED;
+        change.id = id;
+        change.clause = clauses_[id];
+        change.live = live_[id];
+        change.rank = ranks_[id];
+        changes_.push_back(change);
+    }
+    sentences_[id].reset();
+    if (with.empty()) {
+        order_.erase(ranks_[id]);
+        live_[id] = false;
+        return;
+    }
+    // the first replacement reuses the slot; its atoms are a subset of
+    // the old clause's, so the index stays correct
+    clauses_[id] = with.front();
+    if (with.size() == 1) return;
+
+    if (gapAfter(id) / with.size() == 0) renumber();
+    Rank step = gapAfter(id) / with.size();
+    Rank rank = ranks_[id];
+    QCNFClauseList::const_iterator it = with.begin();
+    for (it++; it != with.end(); it++) {
+        rank += step;
+        addAt(*it, rank);
+    }
+}
+
+void QCNFClauseStore::renumber() {
+    if (marks_ > 0) {
+        Change change;
+        change.type = RENUMBERED;
+        change.ranks = ranks_;
+        changes_.push_back(change);
+    }
+    std::map<Rank, std::size_t> renumbered;
+    Rank rank = spacing;
+    for (std::map<Rank, std::size_t>::const_iterator it = order_.begin(); it != order_.end(); it++, rank += spacing) {
+        ranks_[it->second] = rank;
+        renumbered.insert(renumbered.end(), std::make_pair(rank, it->second));
+    }
+    order_.swap(renumbered);
+}
+
+QCNFClauseStore::Mark QCNFClauseStore::mark() {
+    Mark m;
+    m.changes = changes_.size();
+    m.slots = clauses_.size();
+    marks_++;
+    return m;
+}
+
+void QCNFClauseStore::rollback(const Mark& m) {
+    while (changes_.size() > m.changes) {
+        Change& change = changes_.back();
+        if (change.type == RENUMBERED) {
+            ranks_.swap(change.ranks);
+            order_.clear();
+            for (std::size_t id = 0; id < live_.size(); id++) {
+                if (live_[id]) order_.insert(std::make_pair(ranks_[id], id));
+            }
+        } else {
+            std::size_t id = change.id;
+            if (live_[id]) order_.erase(ranks_[id]);
+            live_[id] = false;
+            sentences_[id].reset();
+            if (change.type == REPLACED) {
+                clauses_[id] = change.clause;
+                ranks_[id] = change.rank;
+                live_[id] = change.live;
+                if (live_[id]) order_.insert(std::make_pair(ranks_[id], id));
+            }
         }
-        it++;
+        changes_.pop_back();
     }
-    QCNFClauseList clauses = convertToQCNFClauseList(upforms);
+    // every slot added since the mark is dead now
+    clauses_.resize(m.slots);
+    ranks_.resize(m.slots);
+    live_.resize(m.slots);
+    sentences_.resize(m.slots);
+    marks_--;
+}
 
-    // convert all the facts into unit clauses
-    //Model obs = d.defaultModel();
-    //std::set<Atom, atomcmp> atoms = obs.atoms();
+UnitPropagator::UnitPropagator()
+    : maxInterval_(), store_(), units_(), unitsByAtom_(), partialModel_(), modelChanges_(),
+      leftover_(), checkpoints_(), base_(), baseForms_(), baseUnits_(0) {}
+
+UnitPropagator::UnitPropagator(const Domain& d)
+    : maxInterval_(d.maxInterval()), store_(), units_(), unitsByAtom_(), partialModel_(), modelChanges_(),
+      leftover_(), checkpoints_(), base_(), baseForms_(), baseUnits_(0) {
+    QCNFClauseList clauses = convertToSuitableClauses(std::vector<ELSentence>(d.formulas_begin(), d.formulas_end()),
+            d.maxSpanInterval(), maxInterval_, leftover_);
 
+    // convert all the facts into unit clauses
     for (Domain::atom_const_iterator it = d.atoms_begin(); it != d.atoms_end(); it++) {
         for (int boolVal = 0; boolVal < 2; boolVal++) {
             Proposition ptrue(*it, boolVal == 0);
-            boost::shared_ptr<Sentence> atomPtr;
-            SISet trueAt(false, d.maxInterval());
-            if (d.hasFact(ptrue)) {
-                trueAt = d.lookupFact(ptrue);
-                atomPtr = boost::shared_ptr<Sentence>(new Atom(*it));
-                if (boolVal != 0) {
-                    atomPtr = boost::shared_ptr<Sentence>(new Negation(atomPtr));
-                }
-            } else {
-                continue;   // it's not here
+            if (!d.hasFact(ptrue)) continue;   // it's not here
+            SISet trueAt = d.lookupFact(ptrue);
+            if (trueAt.empty()) continue;
+            boost::shared_ptr<Sentence> atomPtr(new Atom(*it));
+            if (boolVal != 0) {
+                atomPtr = boost::shared_ptr<Sentence>(new Negation(atomPtr));
             }
-            CNFClause clause;
-            clause.push_back(atomPtr);
-            QCNFClause qclause(clause, trueAt);
-
-            if (qclause.second.size() != 0) clauses.push_back(qclause);
+            clauses.push_back(QCNFClause(CNFClause(1, atomPtr), trueAt));
         }
     }
+    seed(clauses);
+    // to be safe, add in all atoms even if they're not used
+    base_.addAtoms(d.atoms_begin(), d.atoms_end());
+}
 
-    QUnitsFormulasPair reducedList = performUnitPropagation(clauses);
-    Domain newD;
-    std::stringstream newForms;
-    newForms << "Unit Clauses:\n";
-    for (QCNFLiteralList::const_iterator it = reducedList.first.begin(); it != reducedList.first.end(); it++) {
-        ELSentence newS = convertFromQCNFClause(*it);
+UnitPropagator::UnitPropagator(const QCNFClauseList& clauses)
+    : maxInterval_(), store_(), units_(), unitsByAtom_(), partialModel_(), modelChanges_(),
+      leftover_(), checkpoints_(), base_(), baseForms_(), baseUnits_(0) {
+    seed(clauses);
+}
+
+void UnitPropagator::seed(const QCNFClauseList& clauses) {
+    addClauses(clauses);
+    for (; baseUnits_ < units_.size(); baseUnits_++) {
+        ELSentence newS = convertFromQCNFClause(units_[baseUnits_]);
         newS.setHasInfWeight(true);
-        newForms << "\t" << newS << "\n";
-        if (isSimpleLiteral(*newS.sentence()))
-            newD.addFact(newS);
-        else
-            newD.addFormula(newS);
+        if (isSimpleLiteral(*newS.sentence())) {
+            base_.addFact(newS);
+        } else {
+            baseForms_.push_back(newS);
+        }
     }
-    newForms << "upforms:\n";
-    for (QCNFClauseList::const_iterator it = reducedList.second.begin(); it != reducedList.second.end(); it++) {
-        ELSentence newS = convertFromQCNFClause(*it);
-        // should have inf weight
-        newS.setHasInfWeight(true);
-        newForms << "\t" << newS << "\n";
-        newD.addFormula(newS);
+}
+
+void UnitPropagator::push(const std::vector<ELSentence>& formulas) {
+    Checkpoint checkpoint;
+    checkpoint.store = store_.mark();
+    checkpoint.units = units_.size();
+    checkpoint.modelChanges = modelChanges_.size();
+    checkpoint.leftover = leftover_.size();
+    checkpoints_.push_back(checkpoint);
+    try {
+        SpanInterval everywhere(maxInterval_.start(), maxInterval_.finish(), maxInterval_.start(), maxInterval_.finish());
+        addClauses(convertToSuitableClauses(formulas, everywhere, maxInterval_, leftover_));
+    } catch (...) {
+        pop();
+        throw;
     }
-    LOG(LOG_INFO) << "unit prop completed.\n" << newForms.str();
+}
 
-    // copy in all the unweighted upforms from the original d
-    for (Domain::formula_const_iterator it = leftover.begin(); it != leftover.end(); it++) {
-        newD.addFormula(*it);
+void UnitPropagator::pop() {
+    if (checkpoints_.empty()) {
+        throw std::logic_error("UnitPropagator::pop() - nothing to pop");
     }
-    // to be safe, add in all atoms even if they're not used
-    newD.addAtoms(d.atoms_begin(), d.atoms_end());
+    rollback(checkpoints_.back());
+    checkpoints_.pop_back();
+}
+
+void UnitPropagator::rollback(const Checkpoint& checkpoint) {
+    store_.rollback(checkpoint.store);
+    while (units_.size() > checkpoint.units) {
+        const QCNFLiteral& unit = units_.back();
+        if (isSimpleLiteral(*unit.first)) {
+            unitsByAtom_[convertToProposition(unit).atom()].pop_back();
+        }
+        units_.pop_back();
+    }
+    while (modelChanges_.size() > checkpoint.modelChanges) {
+        std::pair<Proposition, boost::optional<SISet> >& change = modelChanges_.back();
+        if (change.second) {
+            partialModel_.find(change.first)->second = *change.second;
+        } else {
+            partialModel_.erase(change.first);
+        }
+        modelChanges_.pop_back();
+    }
+    leftover_.resize(checkpoint.leftover);
+}
+
+std::vector<std::size_t> UnitPropagator::unitsMentioning(const QCNFClause& c) const {
+    AtomCollector collector;
+    for (CNFClause::const_iterator it = c.first.begin(); it != c.first.end(); it++) {
+        (*it)->visit(collector);
+    }
+    std::vector<std::size_t> found;
+    for (AtomCollector::atom_set::const_iterator it = collector.atoms.begin(); it != collector.atoms.end(); it++) {
+        boost::unordered_map<Atom, std::vector<std::size_t> >::const_iterator entry = unitsByAtom_.find(*it);
+        if (entry != unitsByAtom_.end()) found.insert(found.end(), entry->second.begin(), entry->second.end());
+    }
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+void UnitPropagator::addClauses(const QCNFClauseList& clauses) {
+    std::vector<std::pair<Proposition, boost::optional<SISet> > >* changes = (checkpoints_.empty() ? 0 : &modelChanges_);
+
+    // apply the units found so far to the new clauses, in the order they
+    // were propagated.  units found along the way are split off right away,
+    // as they would have been had the clauses been here from the start
+    QCNFClauseList reduced;
+    QCNFLiteralList newUnitClauses;
+    for (QCNFClauseList::const_iterator it = clauses.begin(); it != clauses.end(); it++) {
+        QCNFClauseList parts(1, *it);
+        splitUnitClauses(parts, newUnitClauses);
+        std::vector<std::size_t> relevant = unitsMentioning(*it);
+        for (std::vector<std::size_t>::const_iterator u = relevant.begin(); u != relevant.end() && !parts.empty(); u++) {
+            QCNFClauseList next;
+            for (QCNFClauseList::const_iterator part = parts.begin(); part != parts.end(); part++) {
+                QCNFClauseList propagated = propagateLiteral(units_[*u], *part);
+                next.splice(next.end(), propagated);
+            }
+            splitUnitClauses(next, newUnitClauses);
+            parts.swap(next);
+        }
+        reduced.splice(reduced.end(), parts);
+    }
+    LOG(LOG_DEBUG) << "found " << newUnitClauses.size() << " unit clauses.";
+
+    // ensure we have no contradictions at this point
+    enforceUnitProps(newUnitClauses, partialModel_, changes);
+    for (QCNFClauseList::const_iterator it = reduced.begin(); it != reduced.end(); it++) {
+        store_.add(*it);
+    }
+    propagate(newUnitClauses);
+}
+
+void UnitPropagator::propagate(QCNFLiteralList& pending) {
+    std::vector<std::pair<Proposition, boost::optional<SISet> > >* changes = (checkpoints_.empty() ? 0 : &modelChanges_);
+
+    while (!pending.empty()) {
+        // pop one out, propagate it into the sentences that mention its atom.
+        // only simple literals are propagated (see propagateLiteral())
+        QCNFLiteral unitClause = pending.front();
+        pending.pop_front();
+
+        bool simple = isSimpleLiteral(*unitClause.first);
+        if (simple && !store_.empty()) {
+            QCNFLiteralList newUnitClauses;
+            std::vector<std::size_t> touched = store_.clausesMentioning(convertToProposition(unitClause).atom());
+            for (std::vector<std::size_t>::const_iterator it = touched.begin(); it != touched.end(); it++) {
+                QCNFClauseList newFormulas = propagateLiteral(unitClause, store_.clause(*it));
+                splitUnitClauses(newFormulas, newUnitClauses);
+                store_.replace(*it, newFormulas);
+            }
+            enforceUnitProps(newUnitClauses, partialModel_, changes); // double check that we got no contradictions
+            pending.insert(pending.end(), newUnitClauses.begin(), newUnitClauses.end());
+        }
+
+        // finished propagating
+        if (simple) unitsByAtom_[convertToProposition(unitClause).atom()].push_back(units_.size());
+        units_.push_back(unitClause);
+    }
+}
+
+QUnitsFormulasPair UnitPropagator::result() const {
+    QUnitsFormulasPair result;
+    result.first.assign(units_.begin(), units_.end());
+    std::vector<std::size_t> ids = store_.ids();
+    for (std::vector<std::size_t>::const_iterator it = ids.begin(); it != ids.end(); it++) {
+        result.second.push_back(store_.clause(*it));
+    }
+    return result;
+}
+
+Domain UnitPropagator::domain() const {
+    Domain newD = base_;
+    std::vector<ELSentence> forms(baseForms_);
+    for (std::size_t i = baseUnits_; i < units_.size(); i++) {
+        ELSentence newS = convertFromQCNFClause(units_[i]);
+        newS.setHasInfWeight(true);
+        if (isSimpleLiteral(*newS.sentence())) {
+            newD.addFact(newS);
+        } else {
+            forms.push_back(newS);
+        }
+    }
+    std::vector<std::size_t> ids = store_.ids();
+    for (std::vector<std::size_t>::const_iterator it = ids.begin(); it != ids.end(); it++) {
+        forms.push_back(store_.sentence(*it));
+    }
+    // and all the formulas that weren't suitable for propagation
+    forms.insert(forms.end(), leftover_.begin(), leftover_.end());
+    newD.addFormulas(forms.begin(), forms.end());
     return newD;
 }
 
-QUnitsFormulasPair performUnitPropagation(const QCNFClauseList& sentences) {
+QUnitsFormulasPair performNaiveUnitPropagation(const QCNFClauseList& sentences) {
     QCNFClauseList formulas = sentences;
 
     // first, do a scan over the sentences, collecting unit clauses and collecting which atoms occur in each sentence
@@ -240,13 +581,22 @@ namespace {
             }
         }
     }
-    void enforceUnitProps(const QCNFLiteralList& unitClauses, boost::unordered_map<Proposition, SISet>& partialModel) {
+    void enforceUnitProps(const QCNFLiteralList& unitClauses, boost::unordered_map<Proposition, SISet>& partialModel,
+            std::vector<std::pair<Proposition, boost::optional<SISet> > >* changes) {
         for (QCNFLiteralList::const_iterator it = unitClauses.begin(); it != unitClauses.end(); it++) {
             try {
                 Proposition unitProp = convertToProposition(*it);
                 Proposition iUnitProp = unitProp.inverse();
                 SISet where = it->second;
 
+                // remember what we're about to change, so it can be undone
+                if (changes != 0 && (partialModel.count(iUnitProp) == 0
+                        || intersection(partialModel.find(iUnitProp)->second, where).empty())) {
+                    boost::unordered_map<Proposition, SISet>::const_iterator old = partialModel.find(unitProp);
+                    changes->push_back(std::make_pair(unitProp,
+                            old == partialModel.end() ? boost::optional<SISet>() : boost::optional<SISet>(old->second)));
+                }
+
                 // check to see if its negated form is in partial model
                 if (partialModel.count(iUnitProp) == 0) {
                     // add it in, woo!
@@ -317,13 +667,13 @@ namespace {
         SISet currentSet = clause.second;
         SISet intersect = intersection(litSet, currentSet);
 
-        if (intersect.size() != 0) {
+        if (!intersect.empty()) {
             LOG(LOG_DEBUG) << "propagating " << unit.first->toString() << " into " << (*lit)->toString() << std::endl;
 
             // if there is still a timepoint that the clause applies to, rewrite and continue
             SISet leftover = currentSet;
             leftover.subtract(intersect);
-            if (leftover.size() != 0) {
+            if (!leftover.empty()) {
                 QCNFClause qRestricted = clause;
                 qRestricted.second = leftover;
                 newSentences.push(qRestricted);
@@ -341,12 +691,12 @@ namespace {
         SISet currentSet = clause.second;
         SISet intersect = intersection(litSet, currentSet);
 
-        if (intersect.size() != 0) {
+        if (!intersect.empty()) {
             LOG(LOG_DEBUG) << "propagating " << unit.first->toString() << " into " << (*lit)->toString() << std::endl;
 
             SISet leftover = currentSet;
             leftover.subtract(intersect);
-            if (leftover.size() != 0) {
+            if (!leftover.empty()) {
                 // add a copy of this sentence only over leftover
                 QCNFClause qRestricted = clause;
                 qRestricted.second = leftover;
@@ -372,7 +722,7 @@ namespace {
         SISet satisfiesRel = unit.second.satisfiesRelation(rel);
         SISet intersect = intersection(satisfiesRel, clause.second);
         // if they don't intersect, nothing to propagate
-        if (intersect.size() == 0) {
+        if (intersect.empty()) {
            return true;
         }
 
@@ -380,7 +730,7 @@ namespace {
             // clause is satisfied, we can drop it (over the intersection that is)
             SISet leftover = clause.second;
             leftover.subtract(intersect);
-            if (leftover.size() != 0) {
+            if (!leftover.empty()) {
                 QCNFClause qRestricted = clause;
                 qRestricted.second = leftover;
                 newSentences.push(qRestricted);
@@ -9,8 +9,13 @@
 #define UNIT_PROP_H_
 
 #include <boost/shared_ptr.hpp>
+#include <boost/optional.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
 #include <utility>
 #include <queue>
+#include <map>
+#include <vector>
 #include <iostream>
 #include "syntax/Sentence.h"
 #include "Domain.h"
@@ -38,11 +43,25 @@ Domain performUnitPropagation(const Domain& d);
 /**
  * Perform unit propagation with the given QCNFClauseList.
  *
+ * Clauses are indexed by the atoms they mention, so each unit is only
+ * propagated into the clauses that mention its atom; the rest are never
+ * copied.  The result is the same as performNaiveUnitPropagation()'s.
+ *
  * @param sentences a list of quantified clauses in CNF form
  * @return a pairing of unit clauses and formulas after propagation
  */
 QUnitsFormulasPair performUnitPropagation(const QCNFClauseList& sentences);
 
+/**
+ * Perform unit propagation with the given QCNFClauseList by propagating
+ * each unit into every remaining clause.  This is O(units x clauses); it's
+ * kept as a reference for performUnitPropagation().
+ *
+ * @param sentences a list of quantified clauses in CNF form
+ * @return a pairing of unit clauses and formulas after propagation
+ */
+QUnitsFormulasPair performNaiveUnitPropagation(const QCNFClauseList& sentences);
+
 /**
  * Propagate a single literal into a clause.
  *
@@ -140,6 +159,185 @@ private:
     const std::string& what_;
 };
 
+/**
+ * Quantified CNF clauses, indexed by the atoms they mention and kept in
+ * order: a clause's replacements take its place in the order.
+ *
+ * Changes made after mark() can be undone with rollback(), which is how
+ * UnitPropagator pops clauses.
+ */
+class QCNFClauseStore {
+public:
+    struct Mark {
+        std::size_t changes;
+        std::size_t slots;
+    };
+
+    QCNFClauseStore();
+
+    bool empty() const;
+    const QCNFClause& clause(std::size_t id) const;
+
+    /**
+     * Get a clause as an infinitely-weighted ELSentence.  The conversion is
+     * cached until the clause changes.
+     */
+    const ELSentence& sentence(std::size_t id) const;
+
+    /**
+     * Get the ids of the live clauses that mention an atom, in order.
+     */
+    std::vector<std::size_t> clausesMentioning(const Atom& a);
+
+    /**
+     * Get the ids of the live clauses, in order.
+     */
+    std::vector<std::size_t> ids() const;
+
+    /**
+     * Add a clause at the end of the order.
+     */
+    void add(const QCNFClause& c);
+
+    /**
+     * Replace a clause with the given ones (possibly none), in its place.
+     */
+    void replace(std::size_t id, const QCNFClauseList& with);
+
+    /**
+     * Start recording changes, so they can be undone by rollback().  Marks
+     * nest.
+     */
+    Mark mark();
+
+    /**
+     * Undo every change made since the given mark, which must be the most
+     * recent one not yet rolled back.
+     */
+    void rollback(const Mark& m);
+private:
+    typedef boost::uint64_t Rank;
+    static const Rank spacing = 1 << 20;
+
+    enum ChangeType { ADDED, REPLACED, RENUMBERED };
+    struct Change {
+        ChangeType type;
+        std::size_t id;
+        QCNFClause clause;          // for REPLACED, the old clause
+        bool live;                  // for REPLACED, whether it was live
+        Rank rank;                  // for REPLACED, its old rank
+        std::vector<Rank> ranks;    // for RENUMBERED, the old ranks
+    };
+
+    void addAt(const QCNFClause& c, Rank rank);
+    void renumber();
+    Rank gapAfter(std::size_t id) const;
+
+    std::vector<QCNFClause> clauses_;
+    std::vector<Rank> ranks_;
+    std::vector<bool> live_;
+    std::map<Rank, std::size_t> order_;
+    // ids of the clauses mentioning each atom.  dead (or reused) ids are
+    // pruned lazily, so this can over-approximate
+    boost::unordered_map<Atom, std::vector<std::size_t> > occurrences_;
+    mutable std::vector<boost::shared_ptr<ELSentence> > sentences_;
+    std::vector<Change> changes_;
+    unsigned int marks_;
+};
+
+/**
+ * Incremental unit propagation.  A propagator is seeded with a domain's
+ * facts and hard clauses, which it propagates once.  Further clauses can
+ * then be pushed and popped: a push propagates only what the new clauses
+ * add (the units found so far are applied to them, and the units they
+ * produce are propagated into everything), and a pop undoes it.
+ *
+ * This lets MCSat reuse the propagation of the facts, which don't change
+ * between iterations, for each iteration's sampled clauses.
+ */
+class UnitPropagator {
+public:
+    UnitPropagator();
+
+    /**
+     * Propagate a domain's facts and its infinitely-weighted CNF formulas.
+     * Its other formulas are passed through untouched.
+     *
+     * @throws contradiction if the facts and hard formulas are inconsistent
+     */
+    explicit UnitPropagator(const Domain& d);
+
+    /**
+     * Propagate a list of quantified clauses.
+     *
+     * @throws contradiction if the clauses are inconsistent
+     */
+    explicit UnitPropagator(const QCNFClauseList& clauses);
+
+    /**
+     * Add formulas and propagate them, treating them like the constructor
+     * treats a domain's formulas.  If a contradiction is found, nothing is
+     * pushed.
+     *
+     * @throws contradiction if the formulas contradict the current state
+     */
+    void push(const std::vector<ELSentence>& formulas);
+
+    /**
+     * Undo the most recent push().
+     */
+    void pop();
+
+    /**
+     * @return the number of pushes not yet popped
+     */
+    std::size_t depth() const;
+
+    /**
+     * @return the unit clauses found and the clauses left, as
+     *   performUnitPropagation() would give them
+     */
+    QUnitsFormulasPair result() const;
+
+    /**
+     * @return the propagated domain: unit clauses become facts, and the
+     *   remaining clauses and untouched formulas become its formulas.  The
+     *   facts found before the first push are shared between calls.
+     */
+    Domain domain() const;
+private:
+    struct Checkpoint {
+        QCNFClauseStore::Mark store;
+        std::size_t units;
+        std::size_t modelChanges;
+        std::size_t leftover;
+    };
+
+    void seed(const QCNFClauseList& clauses);
+    void addClauses(const QCNFClauseList& clauses);
+    void propagate(QCNFLiteralList& pending);
+    void rollback(const Checkpoint& checkpoint);
+    std::vector<std::size_t> unitsMentioning(const QCNFClause& c) const;
+
+    Interval maxInterval_;
+    QCNFClauseStore store_;
+    // units propagated so far, in order, and the simple ones by atom
+    std::vector<QCNFLiteral> units_;
+    boost::unordered_map<Atom, std::vector<std::size_t> > unitsByAtom_;
+    // where each unit must be true, for finding contradictions, and the
+    // previous values of the entries changed since the first push
+    boost::unordered_map<Proposition, SISet> partialModel_;
+    std::vector<std::pair<Proposition, boost::optional<SISet> > > modelChanges_;
+    // formulas not suitable for propagation
+    std::vector<ELSentence> leftover_;
+    std::vector<Checkpoint> checkpoints_;
+
+    // the seed's facts and non-literal units, and how many units that was
+    Domain base_;
+    std::vector<ELSentence> baseForms_;
+    std::size_t baseUnits_;
+};
+
 namespace {
     /**
     * After this function is called, unit clauses will be removed from
@@ -150,7 +348,8 @@ namespace {
      * Enforce unit clauses in a partial model (throws exception if a
      * contradiction is detected - also meant to be called incrementally).
      */
-    void enforceUnitProps(const QCNFLiteralList& unitClauses, boost::unordered_map<Proposition, SISet>& partialModel);
+    void enforceUnitProps(const QCNFLiteralList& unitClauses, boost::unordered_map<Proposition, SISet>& partialModel,
+            std::vector<std::pair<Proposition, boost::optional<SISet> > >* changes=0);
     /**
      * Convert a literal into a proposition.
      */
@@ -196,6 +395,11 @@ inline std::basic_ostream<char,traits>& operator<< (std::basic_ostream<char,trai
     return os;
 }
 
+inline bool QCNFClauseStore::empty() const { return order_.empty(); }
+inline const QCNFClause& QCNFClauseStore::clause(std::size_t id) const { return clauses_[id]; }
+
+inline std::size_t UnitPropagator::depth() const { return checkpoints_.size(); }
+
 inline bool iterator_cmp::operator()(const QCNFClauseList::iterator& a, const QCNFClauseList::iterator& b) const {
     CNFClause aClause = a->first;
     CNFClause bClause = b->first;
@@ -61,8 +61,9 @@ std::ostream& operator<<(std::ostream& out, const Atom& a) {
 SISet Atom::satisfied(const Model& m, const Domain& d, bool forceLiquid) const {
     if (isGrounded()) {
         // make sure its in model
-        if (m.hasAtom(*this)){
-            SISet set = m.getAtom(*this);
+        AtomId id;
+        if (AtomTable::global().find(*this, id) && m.hasAtom(id)) {
+            SISet set = m.getAtom(id);
             set.setForceLiquid(forceLiquid);
             return set;
         } else {
@@ -16,11 +16,17 @@ void Conjunction::visit(SentenceVisitor& v) const {
     v.accept(*this);
 }
 
-const std::set<Interval::INTERVAL_RELATION>& Conjunction::defaultRelations() {
-    static std::set<Interval::INTERVAL_RELATION>* defaults = new std::set<Interval::INTERVAL_RELATION>();
-    if (defaults->empty()) {
+namespace {
+    std::set<Interval::INTERVAL_RELATION>* makeDefaultRelations() {
+        std::set<Interval::INTERVAL_RELATION>* defaults = new std::set<Interval::INTERVAL_RELATION>();
         defaults->insert(Interval::EQUALS);
+        return defaults;
     }
+}
+
+// built in one go, as in DiamondOp::defaultRelations()
+const std::set<Interval::INTERVAL_RELATION>& Conjunction::defaultRelations() {
+    static const std::set<Interval::INTERVAL_RELATION>* defaults = makeDefaultRelations();
     return *defaults;
 }
 
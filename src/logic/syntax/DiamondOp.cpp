@@ -1,9 +1,9 @@
 #include "DiamondOp.h"
 #include "../Domain.h"
 
-const std::set<Interval::INTERVAL_RELATION>& DiamondOp::defaultRelations() {
-    static std::set<Interval::INTERVAL_RELATION>* defaults = new std::set<Interval::INTERVAL_RELATION>();
-    if (defaults->size() == 0) {
+namespace {
+    std::set<Interval::INTERVAL_RELATION>* makeDefaultRelations() {
+        std::set<Interval::INTERVAL_RELATION>* defaults = new std::set<Interval::INTERVAL_RELATION>();
         defaults->insert(Interval::STARTS);
         defaults->insert(Interval::STARTSI);
         defaults->insert(Interval::DURING);
@@ -12,7 +12,14 @@ const std::set<Interval::INTERVAL_RELATION>& DiamondOp::defaultRelations() {
         defaults->insert(Interval::FINISHESI);
         defaults->insert(Interval::OVERLAPS);
         defaults->insert(Interval::OVERLAPSI);
+        return defaults;
     }
+}
+
+// filled in by the static's initializer, so that sentences can be built on
+// several threads at once
+const std::set<Interval::INTERVAL_RELATION>& DiamondOp::defaultRelations() {
+    static const std::set<Interval::INTERVAL_RELATION>* defaults = makeDefaultRelations();
     return *defaults;
 }
 
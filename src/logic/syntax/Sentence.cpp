@@ -12,13 +12,13 @@
 std::string TQConstraints::toString() const {
     std::stringstream str;
 
-    if (mustBeIn.size() != 0) {
+    if (!mustBeIn.empty()) {
         str << "&" << mustBeIn.toString();
     }
 
-    if (mustNotBeIn.size() != 0) {
+    if (!mustNotBeIn.empty()) {
         // only print a comma if we printed something before
-        if (mustBeIn.size() != 0) {
+        if (!mustBeIn.empty()) {
             str << ",";
         }
         str << "\\" << mustNotBeIn.toString();
@@ -223,7 +223,7 @@ inline bool TQConstraints::operator!=(const TQConstraints& b) const {
 }
 
 inline bool TQConstraints::empty() const {
-    return (mustBeIn.size() == 0) && (mustNotBeIn.size() == 0);
+    return mustBeIn.empty() && mustNotBeIn.empty();
 }
 
 template <class Archive>
@@ -0,0 +1,89 @@
+/*
+ * ThreadPool.cpp
+ */
+#include <stdexcept>
+#include <boost/bind.hpp>
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+    : threads_(), mutex_(), workReady_(), workDone_(),
+      task_(0), next_(0), end_(0), generation_(0), busy_(0),
+      stopping_(false), failed_(false), error_() {
+    if (numThreads == 0) throw std::invalid_argument("ThreadPool needs at least one thread");
+    for (unsigned int worker = 1; worker < numThreads; worker++) {
+        threads_.push_back(new boost::thread(boost::bind(&ThreadPool::workerLoop, this, worker)));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        stopping_ = true;
+    }
+    workReady_.notify_all();
+    for (std::vector<boost::thread*>::iterator it = threads_.begin(); it != threads_.end(); it++) {
+        (*it)->join();
+        delete *it;
+    }
+}
+
+void ThreadPool::parallelFor(std::size_t n, const task_type& task) {
+    if (n == 0) return;
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        task_ = &task;
+        next_ = 0;
+        end_ = n;
+        failed_ = false;
+        error_ = boost::exception_ptr();
+        busy_ = threads_.size();
+        generation_++;
+    }
+    workReady_.notify_all();
+
+    runTasks(0);
+
+    boost::mutex::scoped_lock lock(mutex_);
+    while (busy_ != 0) workDone_.wait(lock);
+    task_ = 0;
+    if (failed_) boost::rethrow_exception(error_);
+}
+
+void ThreadPool::workerLoop(unsigned int worker) {
+    unsigned long seen = 0;
+    for (;;) {
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            while (!stopping_ && generation_ == seen) workReady_.wait(lock);
+            if (stopping_) return;
+            seen = generation_;
+        }
+        runTasks(worker);
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            busy_--;
+        }
+        workDone_.notify_one();
+    }
+}
+
+void ThreadPool::runTasks(unsigned int worker) {
+    for (;;) {
+        std::size_t i;
+        const task_type* task;
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            if (failed_ || next_ >= end_) return;
+            i = next_++;
+            task = task_;
+        }
+        try {
+            (*task)(worker, i);
+        } catch (...) {
+            boost::exception_ptr error = boost::current_exception();
+            boost::mutex::scoped_lock lock(mutex_);
+            if (!failed_) error_ = error;
+            failed_ = true;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ * ThreadPool.h
+ */
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+/**
+ * A fixed set of worker threads for running loops whose iterations are
+ * independent.  The calling thread takes part in every loop, so a pool of
+ * size n starts n-1 threads, and a pool of size 1 runs everything inline.
+ *
+ * Each thread has a worker number in [0, size()), with 0 being the calling
+ * thread, that tasks can use to index per-thread scratch data.
+ */
+class ThreadPool : boost::noncopyable {
+public:
+    typedef boost::function<void (unsigned int worker, std::size_t i)> task_type;
+
+    /**
+     * Start a pool.
+     *
+     * @param numThreads  the total number of threads to use, including the
+     *   calling one (must be at least 1)
+     */
+    explicit ThreadPool(unsigned int numThreads);
+    ~ThreadPool();
+
+    unsigned int size() const;
+
+    /**
+     * Call task(worker, i) for every i in [0, n), spread over the pool's
+     * threads, and wait for all of them to finish.  Iterations are handed
+     * out in order but may complete in any order.
+     *
+     * If any call throws, the remaining iterations are skipped and the
+     * first exception is rethrown on the calling thread once all threads
+     * have stopped (see boost::current_exception()).  Standard exceptions
+     * and those thrown with boost::throw_exception() keep their type;
+     * other types come out as boost::unknown_exception unless the compiler
+     * supports std::exception_ptr.
+     */
+    void parallelFor(std::size_t n, const task_type& task);
+
+private:
+    void workerLoop(unsigned int worker);
+    void runTasks(unsigned int worker);
+
+    std::vector<boost::thread*> threads_;
+    boost::mutex mutex_;
+    boost::condition_variable workReady_;
+    boost::condition_variable workDone_;
+
+    // the loop currently running; guarded by mutex_
+    const task_type* task_;
+    std::size_t next_;
+    std::size_t end_;
+    unsigned long generation_;
+    unsigned int busy_;
+    bool stopping_;
+    bool failed_;
+    boost::exception_ptr error_;
+};
+
+// IMPLEMENTATION
+inline unsigned int ThreadPool::size() const {
+    return threads_.size() + 1;
+}
+
+#endif /* THREADPOOL_H_ */
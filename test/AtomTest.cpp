@@ -9,8 +9,15 @@
 #endif
 #include <boost/shared_ptr.hpp>
 #include "logic/ELSyntax.h"
+#include "logic/AtomTable.h"
+#include "logic/GroundAtom.h"
+#include "../src/util/ThreadPool.h"
+#include "TestUtilities.h"
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <vector>
 
 BOOST_AUTO_TEST_CASE( atom )
 {
@@ -26,3 +33,120 @@ BOOST_AUTO_TEST_CASE( atom )
     Atom x(std::string("blarg"), vec.begin(), vec.end());
 }
 
+
+BOOST_AUTO_TEST_CASE( groundAtom )
+{
+    Atom a = static_cast<const Atom&>(*getAsSentence("Holding(alice, ball)"));
+    GroundAtom g(a);
+    BOOST_CHECK_EQUAL(g.arity(), 2);
+    BOOST_CHECK_EQUAL(g.name(), "Holding");
+    BOOST_CHECK_EQUAL(SymbolTable::global().name(g.arg(1)), "ball");
+    BOOST_CHECK_EQUAL(g.toString(), a.toString());
+    BOOST_CHECK(g.toAtom() == a);
+
+    Atom b = static_cast<const Atom&>(*getAsSentence("Holding(ball, alice)"));
+    BOOST_CHECK(GroundAtom(b) != g);
+    BOOST_CHECK(GroundAtom(g.toAtom()) == g);
+    BOOST_CHECK_EQUAL(hash_value(GroundAtom(a)), hash_value(g));
+
+    // lookup doesn't intern anything
+    GroundAtom found;
+    BOOST_CHECK(GroundAtom::lookup(a, found));
+    BOOST_CHECK(found == g);
+    std::size_t numSymbols = SymbolTable::global().size();
+    Atom unseen = static_cast<const Atom&>(*getAsSentence("Holding(alice, neverSeenBefore)"));
+    BOOST_CHECK(!GroundAtom::lookup(unseen, found));
+    BOOST_CHECK_EQUAL(SymbolTable::global().size(), numSymbols);
+
+    Atom open = static_cast<const Atom&>(*getAsSentence("Holding(?x, ball)"));
+    BOOST_CHECK(!GroundAtom::canRepresent(open));
+    BOOST_CHECK_THROW(GroundAtom x(open), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE( atomTable )
+{
+    AtomTable& table = AtomTable::global();
+    Atom a = static_cast<const Atom&>(*getAsSentence("Passes(alice, bob)"));
+    AtomId id;
+    BOOST_CHECK(!table.find(a, id));
+    id = table.intern(a);
+    BOOST_CHECK_EQUAL(table.intern(GroundAtom(a)), id);
+    BOOST_CHECK(table.atom(id) == a);
+    AtomId found = id + 1;
+    BOOST_CHECK(table.find(GroundAtom(a), found));
+    BOOST_CHECK_EQUAL(found, id);
+
+    // atoms with variables get ids too, apart from the ground ones
+    Atom open = static_cast<const Atom&>(*getAsSentence("Passes(?x, bob)"));
+    AtomId openId = table.intern(open);
+    BOOST_CHECK_NE(openId, id);
+    BOOST_CHECK(table.find(open, found));
+    BOOST_CHECK_EQUAL(found, openId);
+}
+
+namespace {
+    // interns names i%numNames from several threads at once
+    struct SymbolTask {
+        const std::vector<std::string>* names;
+        std::vector<SymbolId>* ids;
+        void operator()(unsigned int worker, std::size_t i) const {
+            (*ids)[i] = SymbolTable::global().intern((*names)[i % names->size()]);
+        }
+    };
+
+    // interns atoms i%numAtoms from several threads at once
+    struct InternTask {
+        const std::vector<GroundAtom>* atoms;
+        std::vector<AtomId>* ids;
+        void operator()(unsigned int worker, std::size_t i) const {
+            (*ids)[i] = AtomTable::global().intern((*atoms)[i % atoms->size()]);
+        }
+    };
+}
+
+BOOST_AUTO_TEST_CASE( symbolTableConcurrentIntern )
+{
+    std::vector<std::string> names;
+    for (int i = 0; i < 50; i++) {
+        std::stringstream str;
+        str << "concurrentSymbol" << i;
+        names.push_back(str.str());
+    }
+    std::vector<SymbolId> ids(names.size()*20);
+    SymbolTask task;
+    task.names = &names;
+    task.ids = &ids;
+    ThreadPool pool(4);
+    pool.parallelFor(ids.size(), ThreadPool::task_type(task));
+
+    for (std::size_t i = 0; i < ids.size(); i++) {
+        BOOST_CHECK_EQUAL(ids[i], ids[i % names.size()]);
+        BOOST_CHECK_EQUAL(SymbolTable::global().name(ids[i]), names[i % names.size()]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( atomTableConcurrentIntern )
+{
+    // the names are interned up front; only the atoms are new
+    std::vector<GroundAtom> atoms;
+    for (int i = 0; i < 50; i++) {
+        std::stringstream str;
+        str << "Concurrent(c" << i << ", d" << i % 7 << ")";
+        atoms.push_back(GroundAtom(static_cast<const Atom&>(*getAsSentence(str.str()))));
+    }
+    std::vector<AtomId> ids(atoms.size()*20);
+    InternTask task;
+    task.atoms = &atoms;
+    task.ids = &ids;
+    ThreadPool pool(4);
+    pool.parallelFor(ids.size(), ThreadPool::task_type(task));
+
+    // every thread got the same id for an atom, and the ids are distinct
+    for (std::size_t i = 0; i < ids.size(); i++) {
+        BOOST_CHECK_EQUAL(ids[i], ids[i % atoms.size()]);
+        BOOST_CHECK(AtomTable::global().atom(ids[i]) == atoms[i % atoms.size()].toAtom());
+    }
+    std::vector<AtomId> unique(ids.begin(), ids.begin() + atoms.size());
+    std::sort(unique.begin(), unique.end());
+    BOOST_CHECK(std::unique(unique.begin(), unique.end()) == unique.end());
+}
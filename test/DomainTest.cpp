@@ -16,6 +16,7 @@
 #include "logic/Domain.h"
 #include "logic/ELSyntax.h"
 #include "logic/FOLParser.h"
+#include "logic/Moves.h"
 #include "../src/AllSerializationExports.h"
 
 BOOST_AUTO_TEST_CASE( addFactsFormulas ) {
@@ -345,6 +346,225 @@ BOOST_AUTO_TEST_CASE( scoreTest ) {
     BOOST_CHECK_CLOSE(score, 82.5, 0.01);
 }
 
+BOOST_AUTO_TEST_CASE( evaluationContextMaxIntervalTest ) {
+    std::stringstream facts;
+    facts << "Q(a) @ [1:3]\n";
+    facts << "R(a) @ [2:10]\n";
+
+    // the diamond is cached, and where it holds depends on the maximum
+    // interval
+    std::stringstream formulas;
+    formulas << "1: Q(a) v <> !R(a)\n";
+
+    Domain d = loadDomainWithStreams(facts.str(), formulas.str());
+    Domain uncached = d;
+    uncached.satisfactionCache().setCapacity(0);
+    Model m = d.defaultModel();
+
+    // a context the domain doesn't own isn't cleared when the maximum
+    // interval changes, but mustn't return results for the old one
+    EvaluationContext context = d.newEvaluationContext();
+    BOOST_CHECK_EQUAL(d.scoreFormula(0, m, context), uncached.scoreFormula(0, m));
+    d.setMaxInterval(Interval(1, 20));
+    uncached.setMaxInterval(Interval(1, 20));
+    BOOST_CHECK_EQUAL(d.scoreFormula(0, m, context), uncached.scoreFormula(0, m));
+    BOOST_CHECK_EQUAL(context.cache.stats().hits, 0);
+    BOOST_CHECK_EQUAL(d.scoreFormula(0, m, context), uncached.scoreFormula(0, m));
+    BOOST_CHECK_EQUAL(context.cache.stats().hits, 1);
+}
+
+BOOST_AUTO_TEST_CASE( scoreDeltaTest ) {
+    std::stringstream facts;
+    facts << "Q(a) @ [1:1]\n";
+    facts << "R(a) @ [1:5]\n";
+    facts << "S(a) @ [2:4]\n";
+
+    std::stringstream formulas;
+    formulas << "5.5: [ Q(a) -> R(a) ]\n";
+    formulas << "2: [ S(a) ]\n";
+    formulas << "1: [ R(a) ^ S(a) ]\n";
+
+    Domain d = loadDomainWithStreams(facts.str(), formulas.str());
+    d.setDontModifyObsPreds(false);
+    Model m = d.defaultModel();
+
+    Move move;
+    move.toAdd.push_back(Move::change(AtomTable::global().intern(Atom("S", std::auto_ptr<Term>(new Constant("a")))), SpanInterval(5,6,5,6)));
+    std::vector<std::size_t> touched = d.formulasTouchedBy(move);
+    BOOST_REQUIRE_EQUAL(touched.size(), 2);
+    BOOST_CHECK_EQUAL(touched[0], 1);
+    BOOST_CHECK_EQUAL(touched[1], 2);
+
+    double before = d.score(m);
+    double after = d.score(executeMove(d, move, m));
+    BOOST_CHECK(after != before);
+    BOOST_CHECK_CLOSE(d.scoreDelta(move, m), after - before, 0.01);
+
+    // given every formula's score, the touched ones are rescored on the
+    // moved model only
+    std::vector<double> scores;
+    for (std::size_t i = 0; i < d.formulas_size(); i++) scores.push_back(d.scoreFormula(i, m));
+    Domain::MoveScores rescored;
+    EvaluationContext context = d.newEvaluationContext();
+    BOOST_CHECK_CLOSE(d.scoreDelta(move, m, scores, rescored, context), after - before, 0.01);
+    BOOST_CHECK(rescored.formulas == touched);
+    Model moved = executeMove(d, move, m);
+    for (std::size_t i = 0; i < touched.size(); i++) {
+        BOOST_CHECK_EQUAL(rescored.scores[i], d.scoreFormula(touched[i], moved));
+        BOOST_CHECK_EQUAL(rescored.fullySatisfied[i], d.formulaFullySatisfied(touched[i], moved));
+    }
+
+    // moves on atoms no formula mentions don't change the score
+    Move other;
+    other.toDel.push_back(Move::change(AtomTable::global().intern(Atom("T")), SpanInterval(1,2,1,2)));
+    BOOST_CHECK(d.formulasTouchedBy(other).empty());
+    BOOST_CHECK_EQUAL(d.scoreDelta(other, m), 0.0);
+
+    // looking up an atom's id doesn't give it one
+    std::size_t numAtoms = AtomTable::global().size();
+    BOOST_CHECK_EQUAL(d.atomId(Atom("NotInAnyDomain")), noAtomId);
+    BOOST_CHECK_EQUAL(AtomTable::global().size(), numAtoms);
+    BOOST_CHECK(d.atomId(Atom("S", std::auto_ptr<Term>(new Constant("a")))) != noAtomId);
+
+    // the index survives copying and clearing
+    Domain copy = d;
+    BOOST_CHECK(copy.formulasTouchedBy(move) == touched);
+    copy.clearFormulas();
+    BOOST_CHECK(copy.formulasTouchedBy(move).empty());
+}
+
+BOOST_AUTO_TEST_CASE( withFormulasTest ) {
+    std::stringstream facts;
+    facts << "Q(a) @ [1:1]\n";
+    facts << "R(a) @ [1:5]\n";
+
+    std::stringstream formulas;
+    formulas << "5.5: [ Q(a) -> R(a) ]\n";
+    formulas << "2: [ S(a) ]\n";
+
+    Domain d = loadDomainWithStreams(facts.str(), formulas.str());
+    std::vector<ELSentence> forms(d.formulas_begin()+1, d.formulas_end());
+    Domain sub = d.withFormulas(forms.begin(), forms.end());
+
+    BOOST_CHECK_EQUAL(sub.formulas_size(), 1);
+    BOOST_CHECK(*sub.formulas_begin() == forms[0]);
+    BOOST_CHECK_EQUAL(sub.maxInterval(), d.maxInterval());
+    BOOST_CHECK_EQUAL(sub.atoms_size(), d.atoms_size());
+    BOOST_CHECK(sub.defaultModel() == d.defaultModel());
+
+    // facts added to the copy don't show up in the original
+    Atom ta("T", std::auto_ptr<Term>(new Constant("a")));
+    sub.addFact(Proposition(ta, true), SISet(SpanInterval(2,3,2,3), true, d.maxInterval()));
+    BOOST_CHECK(sub.hasFact(Proposition(ta, true)));
+    BOOST_CHECK(!d.hasFact(Proposition(ta, true)));
+    BOOST_CHECK_EQUAL(sub.atoms_size(), d.atoms_size()+1);
+
+    Domain deep = d.deepCopy();
+    BOOST_CHECK(deep == d);
+}
+
+BOOST_AUTO_TEST_CASE( compiledFormulaTest ) {
+    boost::mt19937 rng;
+    std::stringstream facts;
+    facts << "Q(a) @ [1:3]\n";
+    facts << "R(a) @ [2:10]\n";
+    facts << "S(a) @ [5:12]\n";
 
+    std::stringstream formulas;
+    formulas << "1: [ Q(a) -> R(a) ]\n";
+    formulas << "2: Q(a) ^{m,o} !R(a) @ [1:10]\n";
+    formulas << "3: <>{m,mi} (Q(a) ; R(a) ; <> S(a))\n";
+    formulas << "4: [ Q(a) v !(R(a) ^ S(a)) ] @ {[1:4], [8:12]}\n";
+    formulas << "5: <>{d} [ S(a) ] v false\n";
+    formulas << "6: [ true ^ !T(a) ]\n";
+    formulas << "inf: R(a) ; S(a)\n";
 
+    Domain d = loadDomainWithStreams(facts.str(), formulas.str());
+    for (int trial = 0; trial < 10; trial++) {
+        Model m = (trial == 0 ? d.defaultModel() : d.randomModel(rng));
+        std::size_t i = 0;
+        for (Domain::formula_const_iterator it = d.formulas_begin(); it != d.formulas_end(); it++, i++) {
+            SISet where = (it->isQuantified() ? it->quantification() : SISet(d.maxSpanInterval(), false, d.maxInterval()));
+            BOOST_CHECK_EQUAL(d.formulaSatisfied(i, m), it->sentence()->dSatisfied(m, d, where));
+            BOOST_CHECK_EQUAL(d.formulaFullySatisfied(i, m), it->fullySatisfied(m, d));
+            if (!it->hasInfWeight()) BOOST_CHECK_EQUAL(d.scoreFormula(i, m), d.score(*it, m));
+        }
+        BOOST_CHECK_EQUAL(d.isFullySatisfied(m), false);
+    }
 
+    // registers can be reused between sentences
+    Model m = d.defaultModel();
+    std::vector<SISet> registers;
+    for (Domain::formula_const_iterator it = d.formulas_begin(); it != d.formulas_end(); it++) {
+        CompiledSentence plan(it->sentence());
+        BOOST_CHECK(plan.registersNeeded() <= plan.size() + 2);
+        BOOST_CHECK_EQUAL(plan.satisfied(m, d, registers), it->sentence()->satisfied(m, d, false));
+    }
+}
+
+BOOST_AUTO_TEST_CASE( satisfactionCacheTest ) {
+    boost::mt19937 rng;
+    std::stringstream facts;
+    facts << "Q(a) @ [1:3]\n";
+    facts << "R(a) @ [2:10]\n";
+    facts << "S(a) @ [5:12]\n";
+
+    // both formulas contain (R(a) ^ S(a))
+    std::stringstream formulas;
+    formulas << "1: Q(a) v (R(a) ^ S(a))\n";
+    formulas << "2: !T(a) v (R(a) ^ S(a))\n";
+
+    Domain d = loadDomainWithStreams(facts.str(), formulas.str());
+    Domain uncached = d;
+    uncached.satisfactionCache().setCapacity(0);
+    BOOST_CHECK_EQUAL(d.satisfactionCache().capacity(), SatisfactionCache::defCapacity);
+
+    Model m = d.defaultModel();
+    BOOST_CHECK_EQUAL(d.score(m), uncached.score(m));
+    const SatisfactionCacheStats& stats = d.satisfactionCache().stats();
+    BOOST_CHECK_EQUAL(stats.hits, 1);       // the second formula's arm
+    BOOST_CHECK_EQUAL(stats.misses, 1);
+    BOOST_CHECK_EQUAL(uncached.satisfactionCache().stats().misses, 0);
+
+    // changing an atom outside the shared arm still hits, changing one in
+    // it misses
+    Atom qa("Q", std::auto_ptr<Term>(new Constant("a")));
+    Atom ra("R", std::auto_ptr<Term>(new Constant("a")));
+    m.setAtom(qa, SISet(SpanInterval(4,6,4,6), true, d.maxInterval()));
+    BOOST_CHECK_EQUAL(d.scoreFormula(0, m), uncached.scoreFormula(0, m));
+    BOOST_CHECK_EQUAL(stats.hits, 2);
+    m.unsetAtom(ra, SISet(SpanInterval(4,6,4,6), true, d.maxInterval()));
+    BOOST_CHECK_EQUAL(d.scoreFormula(0, m), uncached.scoreFormula(0, m));
+    BOOST_CHECK_EQUAL(stats.misses, 2);
+
+    for (int i = 0; i < 10; i++) {
+        Model random = d.randomModel(rng);
+        BOOST_CHECK_EQUAL(d.score(random), uncached.score(random));
+        BOOST_CHECK_EQUAL(d.isFullySatisfied(random), uncached.isFullySatisfied(random));
+    }
+
+    // scoring with a context of its own leaves the domain's cache alone
+    EvaluationContext context = d.newEvaluationContext();
+    BOOST_CHECK_EQUAL(context.cache.capacity(), d.satisfactionCache().capacity());
+    std::size_t lookups = stats.hits + stats.misses;
+    BOOST_CHECK_EQUAL(d.scoreFormula(0, m, context), uncached.scoreFormula(0, m));
+    BOOST_CHECK_EQUAL(d.formulaSatisfied(1, m, context), uncached.formulaSatisfied(1, m));
+    BOOST_CHECK_EQUAL(stats.hits + stats.misses, lookups);
+    BOOST_CHECK_EQUAL(context.cache.stats().hits, 1);
+
+    // a full cache evicts, and copies get an empty cache of the same size
+    d.satisfactionCache().setCapacity(1);
+    BOOST_CHECK_EQUAL(d.satisfactionCache().size(), 1);
+    d.satisfactionCache().resetStats();
+    d.score(d.randomModel(rng));
+    d.score(d.randomModel(rng));
+    BOOST_CHECK(stats.evictions > 0);
+    BOOST_CHECK(stats.hitRate() >= 0.0 && stats.hitRate() <= 1.0);
+    Domain copy = d;
+    BOOST_CHECK_EQUAL(copy.satisfactionCache().capacity(), 1);
+    BOOST_CHECK_EQUAL(copy.satisfactionCache().size(), 0);
+
+    // changing the maximum interval invalidates the cache
+    d.setMaxInterval(Interval(0, 20));
+    BOOST_CHECK_EQUAL(d.satisfactionCache().size(), 0);
+}
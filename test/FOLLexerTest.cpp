@@ -9,7 +9,11 @@
 #endif
 #include "logic/FOLLexer.h"
 #include "logic/FOLToken.h"
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -38,3 +42,116 @@ BOOST_AUTO_TEST_CASE( parser_test )
     BOOST_CHECK_EQUAL(tokens[11].type(), FOLParse::CloseBracket);
     BOOST_CHECK_EQUAL(tokens[12].type(), FOLParse::EndLine);
 }
+
+BOOST_AUTO_TEST_CASE( token_iterator_test )
+{
+    std::string input("1: [a](P(a,?x) -> ~Q(b)) @ [1:2.5]\n# comment\n  foo-bar | init\n");
+    std::istringstream stream(input);
+    std::vector<FOLToken> tokens = FOLParse::tokenize(stream);
+
+    // the iterator yields the same tokens tokenize() does
+    std::vector<FOLTokenView> views(FOLParse::TokenIterator(input.data(), input.data() + input.size()),
+            FOLParse::TokenIterator());
+    BOOST_REQUIRE_EQUAL(views.size(), tokens.size());
+    for (std::size_t i = 0; i < tokens.size(); i++) {
+        BOOST_CHECK_EQUAL(views[i].type(), tokens[i].type());
+        BOOST_CHECK_EQUAL(views[i].contents(), tokens[i].contents());
+        BOOST_CHECK_EQUAL(views[i].lineNumber(), tokens[i].lineNumber());
+        BOOST_CHECK_EQUAL(views[i].colNumber(), tokens[i].colNumber());
+    }
+
+    // contents point into the input rather than being copied
+    BOOST_CHECK_EQUAL(views[6].type(), FOLParse::Identifier);
+    BOOST_CHECK(views[6].begin() == input.data() + 7);
+    BOOST_CHECK_EQUAL(views[6].size(), 1);
+    BOOST_CHECK_EQUAL(views[10].type(), FOLParse::Variable);
+    BOOST_CHECK_EQUAL(views[10].contents(), "x");
+    BOOST_CHECK_EQUAL(views[12].type(), FOLParse::Implies);
+    BOOST_CHECK_EQUAL(views[13].type(), FOLParse::Not);
+    BOOST_CHECK_EQUAL(views[13].contents(), "!");
+    BOOST_CHECK_EQUAL(views[23].type(), FOLParse::Float);
+    BOOST_CHECK_EQUAL(views[23].contents(), "2.5");
+
+    // the comment line leaves only its end of line
+    BOOST_CHECK_EQUAL(views[26].type(), FOLParse::EndLine);
+    BOOST_CHECK_EQUAL(views[26].lineNumber(), 2);
+    BOOST_CHECK_EQUAL(views[27].contents(), "foo-bar");
+    BOOST_CHECK_EQUAL(views[27].lineNumber(), 3);
+    BOOST_CHECK_EQUAL(views[27].colNumber(), 3);
+    BOOST_CHECK_EQUAL(views[28].type(), FOLParse::Or);
+    BOOST_CHECK_EQUAL(views[29].type(), FOLParse::Init);
+
+    // copies of an iterator advance independently
+    FOLParse::TokenIterator it(input.data(), input.data() + input.size());
+    FOLParse::TokenIterator copy = it;
+    it++;
+    BOOST_CHECK(it != copy);
+    BOOST_CHECK_EQUAL(copy->contents(), "1");
+    copy++;
+    BOOST_CHECK(it == copy);
+
+    BOOST_CHECK(FOLParse::TokenIterator(input.data(), input.data()) == FOLParse::TokenIterator());
+}
+
+BOOST_AUTO_TEST_CASE( token_file_test )
+{
+    const char* filename = "follexertest-tokens.tmp";
+    {
+        std::ofstream out(filename);
+        out << "P(a) @ [1:5]\nQ(b) @ [2:3]\n";
+    }
+    {
+        FOLParse::TokenFile file(filename);
+        std::vector<FOLTokenView> tokens(file.begin(), file.end());
+        BOOST_CHECK_EQUAL(tokens.size(), 22);
+        BOOST_CHECK_EQUAL(tokens[0].contents(), "P");
+        BOOST_CHECK_EQUAL(tokens[11].contents(), "Q");
+        BOOST_CHECK_EQUAL(tokens[11].lineNumber(), 2);
+    }
+
+    { std::ofstream out(filename); }
+    {
+        FOLParse::TokenFile file(filename);
+        BOOST_CHECK_EQUAL(file.size(), 0);
+        BOOST_CHECK(file.begin() == file.end());
+    }
+    std::remove(filename);
+
+    BOOST_CHECK_THROW(FOLParse::TokenFile("follexertest-no-such-file"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE( split_lines_test )
+{
+    std::string input("P(a) @ [1:2]\nQ(b) @ [2:3]\n\nR(c) @ [3:4]\nS(d) @ [4:5]");
+    const char* begin = input.data();
+    const char* end = input.data() + input.size();
+
+    std::vector<FOLParse::TokenShard> shards = FOLParse::splitLines(begin, end, 3);
+    BOOST_REQUIRE_EQUAL(shards.size(), 3);
+    BOOST_CHECK(shards.front().begin == begin);
+    BOOST_CHECK(shards.back().end == end);
+    for (std::size_t i = 0; i < shards.size(); i++) {
+        if (i > 0) {
+            BOOST_CHECK(shards[i].begin == shards[i-1].end);
+            BOOST_CHECK_EQUAL(*(shards[i].begin - 1), '\n');
+        }
+    }
+
+    // lexing the shards one after another gives the tokens of the whole
+    std::vector<FOLTokenView> whole(FOLParse::TokenIterator(begin, end), FOLParse::TokenIterator());
+    std::vector<FOLTokenView> pieces;
+    for (std::size_t i = 0; i < shards.size(); i++) {
+        pieces.insert(pieces.end(), shards[i].tokens(), FOLParse::TokenIterator());
+    }
+    BOOST_REQUIRE_EQUAL(pieces.size(), whole.size());
+    for (std::size_t i = 0; i < whole.size(); i++) {
+        BOOST_CHECK(pieces[i].begin() == whole[i].begin());
+        BOOST_CHECK_EQUAL(pieces[i].lineNumber(), whole[i].lineNumber());
+        BOOST_CHECK_EQUAL(pieces[i].colNumber(), whole[i].colNumber());
+    }
+
+    // no more shards than lines
+    BOOST_CHECK_EQUAL(FOLParse::splitLines(begin, end, 100).size(), 5);
+    BOOST_CHECK_EQUAL(FOLParse::splitLines(begin, end, 1).size(), 1);
+    BOOST_CHECK(FOLParse::splitLines(begin, begin, 4).empty());
+}
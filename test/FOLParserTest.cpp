@@ -13,6 +13,8 @@
 #include "logic/FOLToken.h"
 #include "logic/ELSyntax.h"
 #include "SpanInterval.h"
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <algorithm>
 #include <string>
@@ -182,3 +184,62 @@ BOOST_AUTO_TEST_CASE( type_test ) {
             expectedArgs.begin(), expectedArgs.end());
 
 }
+
+BOOST_AUTO_TEST_CASE( sharded_file_test ) {
+    // big enough to be split into several shards
+    const char* eventFile = "folparsertest-events.tmp";
+    const char* formulaFile = "folparsertest-formulas.tmp";
+    {
+        std::ofstream events(eventFile);
+        std::ofstream formulas(formulaFile);
+        events << "type: dogs = {fred, louie}\n";
+        for (unsigned int i = 0; i < 8000; i++) {
+            events << (i % 3 == 0 ? "!" : "") << "P" << i % 17 << "(a" << i << ") @ [" << i << ":" << i+5 << "]\n";
+            formulas << "# formula " << i << "\n";
+            formulas << i % 10 << ": [P" << i % 17 << "(a" << i << ") ^ Q(b)] -> R" << i << "(c)\n";
+        }
+    }
+
+    std::vector<FOL::Event> events1, events4;
+    std::vector<ELSentence> formulas1, formulas4;
+    std::map<std::string, std::set<std::string> > objTypes1, objTypes4;
+    std::map<std::string, std::vector<std::string> > predTypes1, predTypes4;
+    FOLParse::parseEventFile(eventFile, events1, objTypes1, predTypes1, 1);
+    FOLParse::parseEventFile(eventFile, events4, objTypes4, predTypes4, 4);
+    FOLParse::parseFormulaFile(formulaFile, formulas1, objTypes1, predTypes1, 1);
+    FOLParse::parseFormulaFile(formulaFile, formulas4, objTypes4, predTypes4, 4);
+
+    BOOST_REQUIRE_EQUAL(events1.size(), 8000);
+    BOOST_REQUIRE_EQUAL(events4.size(), events1.size());
+    for (std::size_t i = 0; i < events1.size(); i++) {
+        BOOST_CHECK_EQUAL(events4[i].atom()->toString(), events1[i].atom()->toString());
+        BOOST_CHECK_EQUAL(events4[i].where(), events1[i].where());
+        BOOST_CHECK_EQUAL(events4[i].truthVal(), events1[i].truthVal());
+    }
+    BOOST_CHECK_EQUAL(objTypes4.size(), 1);
+    BOOST_CHECK_EQUAL(objTypes4.count("dogs"), 1);
+
+    BOOST_REQUIRE_EQUAL(formulas1.size(), 8000);
+    BOOST_REQUIRE_EQUAL(formulas4.size(), formulas1.size());
+    for (std::size_t i = 0; i < formulas1.size(); i++) {
+        BOOST_CHECK(formulas4[i] == formulas1[i]);
+    }
+
+    // the error reported is the first in the file, with its line number
+    {
+        std::ofstream formulas(formulaFile, std::ios::app);
+        formulas << "1: P(a) v\n";
+        formulas << "2: Q(b) ^\n";
+    }
+    std::vector<ELSentence> bad;
+    try {
+        FOLParse::parseFormulaFile(formulaFile, bad, objTypes4, predTypes4, 4);
+        BOOST_ERROR("expected a bad_parse");
+    } catch (bad_parse& e) {
+        BOOST_CHECK_MESSAGE(e.details.find("line number: 16001") != std::string::npos, e.details);
+        BOOST_CHECK(e.details.find(formulaFile) != std::string::npos);
+    }
+
+    std::remove(eventFile);
+    std::remove(formulaFile);
+}
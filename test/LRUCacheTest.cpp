@@ -34,3 +34,126 @@ BOOST_AUTO_TEST_CASE( lrucache_basic_test)
 
 
 }
+
+namespace {
+    // hashes and compares C strings against std::string keys
+    struct CStringHash {
+        std::size_t operator()(const char* s) const {return boost::hash<std::string>()(s);}
+    };
+    struct CStringEqual {
+        bool operator()(const char* a, const std::string& b) const {return b == a;}
+    };
+
+    struct StringIntSize {
+        std::size_t operator()(const std::string& key, int /* value */) const {return key.size();}
+    };
+}
+
+BOOST_AUTO_TEST_CASE( lrucache_find_test )
+{
+    LRUCache<std::string, int> cache(3);
+    BOOST_CHECK(cache.find("a") == 0);
+    BOOST_CHECK_THROW(cache.get("a"), std::out_of_range);
+    cache.insert("a", 1);
+    cache.insert("b", 2);
+    cache.insert("c", 3);
+
+    // using "a" makes "b" the least recently used
+    BOOST_REQUIRE(cache.find("a") != 0);
+    BOOST_CHECK_EQUAL(*cache.find("a"), 1);
+    *cache.find("a") = 10;
+    cache.insert("d", 4);
+    BOOST_CHECK_EQUAL(cache.count("b"), 0);
+    BOOST_CHECK_EQUAL(cache.get("a"), 10);
+
+    // peek and count don't change the order
+    BOOST_CHECK_EQUAL(*cache.peek("c"), 3);
+    cache.insert("e", 5);
+    BOOST_CHECK_EQUAL(cache.count("c"), 0);
+
+    // replacing a key keeps one entry for it
+    cache.insert("e", 6);
+    BOOST_CHECK_EQUAL(cache.size(), 3);
+    BOOST_CHECK_EQUAL(cache.get("e"), 6);
+
+    BOOST_REQUIRE(cache.find("d", CStringHash(), CStringEqual()) != 0);
+    BOOST_CHECK_EQUAL(*cache.find("d", CStringHash(), CStringEqual()), 4);
+    BOOST_CHECK(cache.find("z", CStringHash(), CStringEqual()) == 0);
+
+    BOOST_CHECK(cache.erase("d"));
+    BOOST_CHECK(!cache.erase("d"));
+    BOOST_CHECK_EQUAL(cache.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE( lrucache_stats_test )
+{
+    LRUCache<std::string, int> cache(2);
+    cache.insert("a", 1);
+    cache.find("a");
+    cache.find("b");
+    cache.count("a");
+    cache.insert("b", 2);
+    cache.insert("c", 3);
+    BOOST_CHECK_EQUAL(cache.stats().hits, 1);
+    BOOST_CHECK_EQUAL(cache.stats().misses, 1);
+    BOOST_CHECK_EQUAL(cache.stats().evictions, 1);
+    BOOST_CHECK_CLOSE(cache.stats().hitRate(), 0.5, 0.01);
+
+    cache.setCapacity(1);
+    BOOST_CHECK_EQUAL(cache.size(), 1);
+    BOOST_CHECK_EQUAL(cache.stats().evictions, 2);
+    cache.resetStats();
+    BOOST_CHECK_EQUAL(cache.stats().hits + cache.stats().misses + cache.stats().evictions, 0);
+
+    // turned off
+    cache.setCapacity(0);
+    cache.insert("d", 4);
+    BOOST_CHECK(cache.empty());
+}
+
+BOOST_AUTO_TEST_CASE( lrucache_bytes_test )
+{
+    LRUCache<std::string, int, boost::hash<std::string>, std::equal_to<std::string>, StringIntSize> cache(100, 10);
+    cache.insert("aaaa", 1);
+    cache.insert("bbbb", 2);
+    BOOST_CHECK_EQUAL(cache.bytes(), 8);
+    cache.insert("ccc", 3);
+    BOOST_CHECK_EQUAL(cache.count("aaaa"), 0);
+    BOOST_CHECK_EQUAL(cache.bytes(), 7);
+
+    // too big to hold at all
+    cache.insert("ddddddddddd", 4);
+    BOOST_CHECK_EQUAL(cache.count("ddddddddddd"), 0);
+    BOOST_CHECK_EQUAL(cache.size(), 2);
+
+    cache.setByteCapacity(3);
+    BOOST_CHECK_EQUAL(cache.size(), 1);
+    BOOST_CHECK_EQUAL(cache.count("ccc"), 1);
+    cache.setByteCapacity(0);
+    cache.insert("ddddddddddd", 4);
+    BOOST_CHECK_EQUAL(cache.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE( lrucache_copy_test )
+{
+    LRUCache<std::string, int> cache(3);
+    cache.insert("a", 1);
+    cache.insert("b", 2);
+
+    LRUCache<std::string, int> copy(cache);
+    copy.insert("c", 3);
+    copy.find("a");
+    copy.insert("d", 4);
+    BOOST_CHECK_EQUAL(copy.count("b"), 0);
+    BOOST_CHECK_EQUAL(cache.count("b"), 1);
+    BOOST_CHECK_EQUAL(cache.size(), 2);
+
+    cache = copy;
+    cache.insert("e", 5);
+    BOOST_CHECK_EQUAL(cache.count("c"), 0);
+    BOOST_CHECK_EQUAL(copy.count("c"), 1);
+
+    copy.swap(cache);
+    BOOST_CHECK_EQUAL(copy.count("e"), 1);
+    BOOST_CHECK_EQUAL(cache.count("e"), 0);
+}
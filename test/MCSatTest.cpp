@@ -23,6 +23,9 @@
 #include <boost/serialization/serialization.hpp>
 #include <iostream>
 #include <fstream>
+#include <limits>
+#include <sstream>
+#include <boost/math/special_functions/fpclassify.hpp>
 #include "../src/inference/MCSat.h"
 #include "../src/inference/MCSatSamplePerfectlyStrategy.h"
 #include "../src/inference/MCSatSampleLiquidlyStrategy.h"
@@ -126,5 +129,180 @@ BOOST_AUTO_TEST_CASE( mcsatSamplePerfectlyStrategy) {
 
 }
 
+BOOST_AUTO_TEST_CASE( mcsatChains ) {
+    FileLog::globalLogLevel() = LOG_ERROR;
+    std::string facts("D-P(a) @ {[1:10]}\n");
+    std::string formulas("1: [ D-P(a) -> !P(a) ] @ [1:10]\n"
+            "1.2: [ D-P(a) -> P(a) ] @ [1:10]\n");
+    Domain d = loadDomainWithStreams(facts, formulas);
+
+    MCSat serial(&d);
+    serial.setNumSamples(10);
+    serial.setBurnInIterations(2);
+    serial.setWalksatIterations(20);
+    serial.setNumChains(3);
+    BOOST_CHECK_THROW(serial.setNumChains(0), std::logic_error);
+    MCSat parallel = serial;
+    parallel.setNumThreads(2);
+
+    boost::mt19937 rng1(7), rng2(7);
+    serial.run(rng1);
+    parallel.run(rng2);
+
+    // samples are split 4/3/3 between the chains, in chain order
+    BOOST_REQUIRE_EQUAL(serial.size(), 10);
+    unsigned int perChain[3] = {0, 0, 0};
+    for (std::size_t i = 0; i < serial.size(); i++) {
+        perChain[serial.chainOf(i)]++;
+        if (i > 0) BOOST_CHECK(serial.chainOf(i-1) <= serial.chainOf(i));
+    }
+    BOOST_CHECK_EQUAL(perChain[0], 4);
+    BOOST_CHECK_EQUAL(perChain[1], 3);
+    BOOST_CHECK_EQUAL(perChain[2], 3);
+
+    // the thread count doesn't change the samples
+    BOOST_CHECK(std::equal(serial.begin(), serial.end(), parallel.begin()));
+
+    boost::shared_ptr<Sentence> pa = getAsSentence("P(a)");
+    Proposition propPa(static_cast<const Atom&>(*pa), true);
+    double prob = serial.estimateProbability(propPa, Interval(1,1));
+    BOOST_CHECK_CLOSE(prob, serial.countProps(propPa, Interval(1,1)) / 10.0, 0.001);
+}
+
+BOOST_AUTO_TEST_CASE( mcsatQueries ) {
+    FileLog::globalLogLevel() = LOG_ERROR;
+    std::string facts("D-P(a) @ {[1:10]}\n");
+    std::string formulas("1: [ D-P(a) -> !P(a) ] @ [1:10]\n"
+            "1.2: [ D-P(a) -> P(a) ] @ [1:10]\n");
+    Domain d = loadDomainWithStreams(facts, formulas);
+    boost::shared_ptr<Sentence> pa = getAsSentence("P(a)");
+    const Atom& atomPa = static_cast<const Atom&>(*pa);
+    Proposition propPa(atomPa, true);
+
+    MCSat full(&d);
+    full.setNumSamples(12);
+    full.setBurnInIterations(2);
+    full.setWalksatIterations(20);
+    full.setNumChains(2);
+    MCSat streaming = full;
+    streaming.setKeepSamples(false);
+    std::size_t q = streaming.addQuery(propPa, Interval(2,4));
+    std::size_t m = streaming.addMarginalQuery(atomPa);
+
+    boost::mt19937 rng1(3), rng2(3);
+    full.run(rng1);
+    streaming.run(rng2);
+
+    // the streaming counts match a scan over the stored samples
+    BOOST_CHECK_EQUAL(streaming.size(), 0);
+    BOOST_CHECK_EQUAL(streaming.samplesCounted(), 12);
+    BOOST_CHECK_EQUAL(streaming.queryCount(q), full.countProps(propPa, Interval(2,4)));
+    BOOST_CHECK_EQUAL(streaming.countProps(propPa, Interval(2,4)), full.countProps(propPa, Interval(2,4)));
+    BOOST_REQUIRE_EQUAL(streaming.marginalCounts(m).size(), 10);
+    for (unsigned int t = 1; t <= 10; t++) {
+        BOOST_CHECK_EQUAL(streaming.marginalCounts(m)[t-1], full.countProps(propPa, Interval(t,t)));
+        BOOST_CHECK_EQUAL(streaming.countProps(propPa.inverse(), Interval(t,t)),
+                full.countProps(propPa.inverse(), Interval(t,t)));
+        BOOST_CHECK_CLOSE(streaming.estimateProbability(propPa, Interval(t,t)),
+                full.estimateProbability(propPa, Interval(t,t)), 0.001);
+    }
+    // without samples, unregistered queries can't be answered
+    BOOST_CHECK_THROW(streaming.countProps(propPa, Interval(1,10)), std::logic_error);
+}
+
+BOOST_AUTO_TEST_CASE( mcsatCountMarginals ) {
+    FileLog::globalLogLevel() = LOG_ERROR;
+    std::string facts("D-P(a) @ {[1:10]}\n");
+    std::string formulas("1: [ D-P(a) -> !P(a) ] @ [1:10]\n"
+            "1.2: [ D-P(a) -> P(a) ] @ [1:10]\n");
+    Domain d = loadDomainWithStreams(facts, formulas);
+    boost::shared_ptr<Sentence> pa = getAsSentence("P(a)");
+    const Atom& atomPa = static_cast<const Atom&>(*pa);
+    boost::shared_ptr<Sentence> dpa = getAsSentence("D-P(a)");
+    const Atom& atomDpa = static_cast<const Atom&>(*dpa);
+
+    MCSat mcSatSolver(&d);
+    mcSatSolver.setNumSamples(8);
+    mcSatSolver.setBurnInIterations(2);
+    mcSatSolver.setWalksatIterations(20);
+    boost::mt19937 rng;
+    mcSatSolver.run(rng);
+
+    std::vector<Atom> atoms;
+    atoms.push_back(atomPa);
+    atoms.push_back(atomDpa);
+    unsigned int maxLength = 3;
+    std::vector<std::vector<unsigned int> > counts = mcSatSolver.countMarginals(atoms, maxLength);
+    BOOST_REQUIRE_EQUAL(counts.size(), 2);
+    for (std::size_t a = 0; a < atoms.size(); a++) {
+        BOOST_REQUIRE_EQUAL(counts[a].size(), maxLength*10);
+        Proposition prop(atoms[a], true);
+        for (unsigned int len = 1; len <= maxLength; len++) {
+            for (unsigned int t = 1; t <= 10; t++) {
+                unsigned int expected = (t+len-1 <= 10 ? mcSatSolver.countProps(prop, Interval(t, t+len-1)) : 0);
+                BOOST_CHECK_EQUAL(counts[a][(len-1)*10 + (t-1)], expected);
+            }
+        }
+    }
+    // D-P(a) is observed everywhere
+    BOOST_CHECK_EQUAL(counts[1][0], 8);
+}
+
+BOOST_AUTO_TEST_CASE( mcsatDiagnostics ) {
+    FileLog::globalLogLevel() = LOG_ERROR;
+    std::string facts("D-P(a) @ {[1:10]}\n");
+    std::string formulas("1: [ D-P(a) -> !P(a) ] @ [1:10]\n"
+            "1.2: [ D-P(a) -> P(a) ] @ [1:10]\n");
+    Domain d = loadDomainWithStreams(facts, formulas);
+    boost::shared_ptr<Sentence> pa = getAsSentence("P(a)");
+    Proposition propPa(static_cast<const Atom&>(*pa), true);
 
+    MCSat mcSatSolver(&d);
+    mcSatSolver.setNumSamples(40);
+    mcSatSolver.setBurnInIterations(2);
+    mcSatSolver.setWalksatIterations(20);
+    mcSatSolver.addQuery(propPa, Interval(3, 3));
+    mcSatSolver.addMarginalQuery(propPa.atom());
+    mcSatSolver.setDiagnosticInterval(10);
+    std::stringstream trace;
+    mcSatSolver.setTraceStream(&trace);
+    boost::mt19937 rng;
+    mcSatSolver.run(rng);
 
+    // one chain: no R-hat, and the full run since there's no target precision
+    const MCSatDiagnostics& diag = mcSatSolver.diagnostics();
+    BOOST_CHECK_EQUAL(diag.samples, 40);
+    BOOST_REQUIRE_EQUAL(diag.mean.size(), 2);
+    BOOST_CHECK_CLOSE(diag.mean[0], mcSatSolver.estimateProbability(propPa, Interval(3, 3)), 1e-9);
+    for (std::size_t k = 0; k < 2; k++) {
+        BOOST_CHECK(diag.ess[k] >= 1.0 && diag.ess[k] <= 40.0);
+        BOOST_CHECK(diag.stdError[k] >= 0.0);
+        BOOST_CHECK(boost::math::isnan(diag.rHat[k]));
+    }
+    BOOST_CHECK(diag.acceptanceRate >= 0.0 && diag.acceptanceRate <= 1.0);
+    BOOST_CHECK(diag.novelRate <= diag.acceptanceRate);
+
+    // a header plus a row per round
+    std::string line;
+    std::vector<std::string> lines;
+    while (std::getline(trace, line)) lines.push_back(line);
+    BOOST_REQUIRE_EQUAL(lines.size(), 5);
+    BOOST_CHECK_EQUAL(lines[0].substr(0, 24), "samples\tacceptance\tnovel");
+    BOOST_CHECK_EQUAL(lines[4].substr(0, 3), "40\t");
+
+    // a loose target precision stops after the first round
+    MCSat earlySolver(&d);
+    earlySolver.setNumSamples(1000);
+    earlySolver.setBurnInIterations(2);
+    earlySolver.setWalksatIterations(20);
+    earlySolver.setNumChains(2);
+    earlySolver.addQuery(propPa, Interval(3, 3));
+    earlySolver.setDiagnosticInterval(20);
+    earlySolver.setTargetPrecision(0.5);
+    earlySolver.setMaxRHat(std::numeric_limits<double>::infinity());
+    rng.seed(1);
+    earlySolver.run(rng);
+    BOOST_CHECK_EQUAL(earlySolver.samplesCounted(), 40);
+    BOOST_CHECK_EQUAL(earlySolver.diagnostics().rHat.size(), 1);
+    BOOST_CHECK(!boost::math::isnan(earlySolver.diagnostics().rHat[0]));
+}
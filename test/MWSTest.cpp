@@ -60,3 +60,109 @@ BOOST_AUTO_TEST_CASE( MaxWalkSat_competing ) {
             "P(a) @ {[1:10]}\n"
             "Q(a) @ {[11:15]}\n");
 }
+
+BOOST_AUTO_TEST_CASE( MaxWalkSat_threads ) {
+    std::string facts(
+            "D-P(a) @ [1:10]\n"
+            "D-Q(a) @ [1:15]\n"
+            "D-R(a) @ [5:20]\n");
+
+    std::string formulas(
+            "5: [!D-P(a) v P(a)]\n"
+            "5: [!P(a) v D-P(a)]\n"
+            "1: [!D-Q(a) v Q(a)]\n"
+            "1: [!Q(a) v D-Q(a)]\n"
+            "2: [!D-R(a) v R(a)]\n"
+            "3: [!R(a) v !Q(a)]\n"
+            "5: [!P(a) v !Q(a)]");
+
+    Domain d = loadDomainWithStreams(facts, formulas);
+    MWSSolver solver(&d);
+    solver.setNumIterations(200);
+    BOOST_CHECK_EQUAL(solver.numThreads(), 1);
+    BOOST_CHECK_THROW(solver.setNumThreads(0), std::logic_error);
+
+    boost::mt19937 rng(3);
+    Model serial = solver.run(rng);
+    for (unsigned int threads = 2; threads <= 4; threads++) {
+        solver.setNumThreads(threads);
+        boost::mt19937 rng(3);
+        Model parallel = solver.run(rng);
+        BOOST_CHECK_EQUAL(parallel.toString(), serial.toString());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( MaxWalkSat_restarts ) {
+    std::string facts(
+            "D-P(a) @ [1:10]\n"
+            "D-Q(a) @ [1:15]\n");
+
+    std::string formulas(
+            "5: [!D-P(a) v P(a)]\n"
+            "5: [!P(a) v D-P(a)]\n"
+            "1: [!D-Q(a) v Q(a)]\n"
+            "1: [!Q(a) v D-Q(a)]\n"
+            "5: [!P(a) v !Q(a)]");
+
+    Domain d = loadDomainWithStreams(facts, formulas);
+    MWSSolver solver(&d);
+    solver.setNumIterations(100);
+
+    std::vector<Model> initialModels;
+    boost::mt19937 modelRng(1);
+    for (int i = 0; i < 5; i++) initialModels.push_back(d.randomModel(modelRng));
+
+    boost::mt19937 rng(0);
+    std::vector<Model> serial = solver.runRestarts(rng, initialModels);
+    BOOST_REQUIRE_EQUAL(serial.size(), initialModels.size());
+    boost::mt19937 bestRng(0);
+    Model best = solver.runBest(bestRng, initialModels);
+    for (std::vector<Model>::const_iterator it = serial.begin(); it != serial.end(); it++) {
+        BOOST_CHECK(d.score(best) >= d.score(*it));
+    }
+
+    // the same seed gives the same searches regardless of the thread count
+    solver.setNumThreads(3);
+    boost::mt19937 parallelRng(0);
+    std::vector<Model> parallel = solver.runRestarts(parallelRng, initialModels);
+    BOOST_REQUIRE_EQUAL(parallel.size(), serial.size());
+    for (std::size_t i = 0; i < serial.size(); i++) {
+        BOOST_CHECK_EQUAL(parallel[i].toString(), serial[i].toString());
+    }
+    boost::mt19937 parallelBestRng(0);
+    BOOST_CHECK(solver.runBest(parallelBestRng, initialModels) == best);
+    BOOST_CHECK_THROW(solver.runBest(parallelBestRng, std::vector<Model>()), std::logic_error);
+
+    // a single search behaves exactly like run() with the same generator
+    boost::mt19937 runRng(0);
+    Model single = solver.run(runRng, initialModels[0]);
+    boost::mt19937 singleRng(0);
+    BOOST_CHECK_EQUAL(solver.runBest(singleRng, std::vector<Model>(1, initialModels[0])).toString(),
+            single.toString());
+    BOOST_CHECK(singleRng == runRng);
+}
+
+BOOST_AUTO_TEST_CASE( MaxWalkSat_negativeScores ) {
+    std::string facts(
+            "D-P(a) @ [1:10]\n"
+            "D-Q(a) @ [1:10]\n");
+
+    std::string formulas(
+            "1: [!D-P(a) v P(a)]\n"
+            "1: [!P(a) v D-P(a)]\n"
+            "1: [D-Q(a)]\n");
+
+    // the last formula is always satisfied and outweighs the others, so
+    // every candidate move leads to a negative score
+    Domain loaded = loadDomainWithStreams(facts, formulas);
+    std::vector<ELSentence> weighted(loaded.formulas_begin(), loaded.formulas_end());
+    weighted[2].setWeight(-100);
+    Domain d = loaded.withFormulas(weighted.begin(), weighted.end());
+    BOOST_REQUIRE(d.score(d.defaultModel()) < 0.0);
+
+    MWSSolver solver(0, 0.0, &d);
+    solver.setNumIterations(20);
+    boost::mt19937 rng(0);
+    Model m = solver.run(rng);
+    BOOST_CHECK_EQUAL(m.getAtom(Atom("P", std::auto_ptr<Term>(new Constant("a")))).toString(), "{[1:10]}");
+}
@@ -19,7 +19,123 @@
 #include "SISet.h"
 #include "logic/ELSyntax.h"
 
-// TODO: write some test cases fool!
+#include <boost/functional/hash.hpp>
+
 BOOST_AUTO_TEST_CASE(basicModelTest) {
+    Interval maxInterval(1,10);
+    Atom a("A");
+    Atom b("B", std::auto_ptr<Term>(new Constant("x")));
+    Model m(maxInterval);
+
+    BOOST_CHECK(!m.hasAtom(a));
+    BOOST_CHECK(m.getAtom(a).empty());
+    BOOST_CHECK_EQUAL(m.getAtom(a).maxInterval(), maxInterval);
+
+    m.setAtom(a, SISet(SpanInterval(1,4,1,4), true, maxInterval));
+    m.setAtom(a, SISet(SpanInterval(6,7,6,7), true, maxInterval));
+    BOOST_CHECK(m.hasAtom(a));
+    BOOST_CHECK_EQUAL(m.getAtom(a).toString(), "{[1:4], [6:7]}");
+    BOOST_CHECK_EQUAL(m.size(), 6);
+
+    // atoms are looked up by their interned ids
+    AtomId aId = AtomTable::global().intern(a);
+    BOOST_CHECK(&m.getAtom(aId) == &m.getAtom(a));
+    BOOST_CHECK_EQUAL(AtomTable::global().atom(aId), a);
+
+    m.unsetAtom(a, SISet(SpanInterval(1,7,1,7), true, maxInterval));
+    BOOST_CHECK(!m.hasAtom(a));
+
+    // an atom set to an empty set is still in the model
+    m.setAtom(b, SISet(true, maxInterval));
+    BOOST_CHECK(m.hasAtom(b));
+    BOOST_CHECK_EQUAL(m.toString(), "B(x) @ {}\n");
+    m.clearAtom(b);
+    BOOST_CHECK(!m.hasAtom(b));
+}
+
+BOOST_AUTO_TEST_CASE(modelEqualityTest) {
+    Interval maxInterval(1,10);
+    Atom a("A");
+    Atom c("C");
+    AtomTable::global().intern(a);
+    AtomTable::global().intern(c);
+
+    Model m1(maxInterval);
+    Model m2(maxInterval);
+    m1.setAtom(a, SISet(SpanInterval(1,4,1,4), true, maxInterval));
+    m2.setAtom(a, SISet(SpanInterval(1,4,1,4), true, maxInterval));
+    BOOST_CHECK(m1 == m2);
+    BOOST_CHECK_EQUAL(boost::hash<Model>()(m1), boost::hash<Model>()(m2));
+
+    // m2 has room for c but doesn't hold it, so they are still equal
+    m2.setAtom(c, SISet(SpanInterval(2,2,2,2), true, maxInterval));
+    BOOST_CHECK(m1 != m2);
+    m2.clearAtom(c);
+    BOOST_CHECK(m1 == m2);
+    BOOST_CHECK(m2 == m1);
+    BOOST_CHECK_EQUAL(boost::hash<Model>()(m1), boost::hash<Model>()(m2));
+
+    Model m3(Interval(1,11));
+    m3.setAtom(a, SISet(SpanInterval(1,4,1,4), true, maxInterval));
+    BOOST_CHECK(m1 != m3);
+}
+
+BOOST_AUTO_TEST_CASE(modelCopyOnWriteTest) {
+    Interval maxInterval(1,10);
+    Atom a("A");
+    Atom b("B");
+    Model m1(maxInterval);
+    m1.setAtom(a, SISet(SpanInterval(1,4,1,4), true, maxInterval));
+    m1.setAtom(b, SISet(SpanInterval(2,3,2,3), true, maxInterval));
+
+    // copies share their sets until one of them writes to an atom
+    Model m2(m1);
+    BOOST_CHECK(&m1.getAtom(a) == &m2.getAtom(a));
+    m2.setAtom(a, SISet(SpanInterval(6,7,6,7), true, maxInterval));
+    BOOST_CHECK_EQUAL(m1.getAtom(a).toString(), "{[1:4]}");
+    BOOST_CHECK_EQUAL(m2.getAtom(a).toString(), "{[1:4], [6:7]}");
+    BOOST_CHECK(&m1.getAtom(b) == &m2.getAtom(b));
+
+    Model m3(m1);
+    m3.unsetAtom(b, SISet(SpanInterval(2,3,2,3), true, maxInterval));
+    m3.clearAtom(a);
+    BOOST_CHECK(m1.hasAtom(a));
+    BOOST_CHECK_EQUAL(m1.getAtom(b).toString(), "{[2:3]}");
+    BOOST_CHECK(!m3.hasAtom(b));
+
+    m3 = m1;
+    m3.setMaxInterval(Interval(1,5));
+    BOOST_CHECK_EQUAL(m1.getAtom(a).maxInterval(), maxInterval);
+    BOOST_CHECK(m1 == Model(m1));
+}
+
+BOOST_AUTO_TEST_CASE(modelAtomVersionTest) {
+    Interval maxInterval(1,10);
+    Atom a("A");
+    Atom b("B");
+    Model m1(maxInterval);
+    m1.setAtom(a, SISet(SpanInterval(1,4,1,4), true, maxInterval));
+    m1.setAtom(b, SISet(SpanInterval(2,3,2,3), true, maxInterval));
+    AtomId aId = AtomTable::global().intern(a);
+    AtomId bId = AtomTable::global().intern(b);
+    BOOST_CHECK(m1.atomVersion(aId) != 0);
+    BOOST_CHECK(m1.atomVersion(aId) != m1.atomVersion(bId));
+
+    // copies share versions until an atom changes
+    Model m2(m1);
+    BOOST_CHECK_EQUAL(m2.atomVersion(aId), m1.atomVersion(aId));
+    unsigned long before = m1.atomVersion(aId);
+    m2.setAtom(a, SISet(SpanInterval(6,7,6,7), true, maxInterval));
+    BOOST_CHECK(m2.atomVersion(aId) != before);
+    BOOST_CHECK_EQUAL(m1.atomVersion(aId), before);
+    BOOST_CHECK_EQUAL(m2.atomVersion(bId), m1.atomVersion(bId));
+
+    // changing an unshared set in place also gives a new version
+    before = m2.atomVersion(aId);
+    m2.unsetAtom(a, SISet(SpanInterval(6,7,6,7), true, maxInterval));
+    BOOST_CHECK(m2.atomVersion(aId) != before);
 
+    m2.clearAtom(b);
+    BOOST_CHECK_EQUAL(m2.atomVersion(bId), 0);
+    BOOST_CHECK_EQUAL(m2.atomVersion(AtomTable::global().intern(Atom("C"))), 0);
 }
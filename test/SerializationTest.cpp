@@ -16,9 +16,13 @@
 #endif
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include "../src/inference/MCSat.h"
+#include "../src/logic/DomainCache.h"
+#include "../src/logic/Snapshot.h"
 #include "../src/AllSerializationExports.h"
 #include "TestUtilities.h"
 
@@ -90,4 +94,164 @@ BOOST_AUTO_TEST_CASE(mcSatSerialization) {
     MCSat sat(&d);
     // don't actually run it, it takes too long. just test it
     checkSerialization(sat);
+
+    // a short multi-chain run, to check the chain of each sample is kept
+    FileLog::globalLogLevel() = LOG_ERROR;
+    sat.setNumSamples(4);
+    sat.setBurnInIterations(1);
+    sat.setWalksatIterations(10);
+    sat.setNumChains(2);
+    boost::mt19937 rng;
+    sat.run(rng);
+    checkSerialization(sat);
+
+    // and one that only keeps query counts
+    sat.setKeepSamples(false);
+    sat.addMarginalQuery(static_cast<const Atom&>(*getAsSentence("Q(a)")));
+    sat.setTargetPrecision(0.25);
+    sat.setDiagnosticInterval(5);
+    sat.run(rng);
+    checkSerialization(sat);
+}
+
+namespace {
+    Domain snapshotDomain() {
+        std::string facts("P(a) @ [1:10]\n"
+                "!Q(A) @ [5:6]\n"
+                "R(a, b) @ [1:3]");
+        std::string formulas("1: [P(a) -> Q(a)]\n"
+                "2.5: P(a) ^{m} R(a, b)\n"
+                "0.5: <>{s,f} [!P(?x) v R(?x, b)] @ [1:5]\n"
+                "[Q(a) -> P(a)]");
+        Domain d = loadDomainWithStreams(facts, formulas);
+
+        // temporal constraints can't be written in the formula syntax
+        std::pair<TQConstraints, TQConstraints> tq;
+        tq.first.mustBeIn = SISet(SpanInterval(2,4), true, Interval(1,10));
+        tq.second.mustNotBeIn = SISet(SpanInterval(1,2,3,4), false, Interval(1,10));
+        boost::shared_ptr<Sentence> p = getAsSentence("P(a)");
+        boost::shared_ptr<Sentence> q = getAsSentence("Q(a)");
+        std::set<Interval::INTERVAL_RELATION> rels;
+        rels.insert(Interval::MEETS);
+        boost::shared_ptr<Sentence> con(new Conjunction(p, q, rels.begin(), rels.end(), &tq));
+        d.addFormula(ELSentence(con, 3.0));
+        TQConstraints diaTQ;
+        diaTQ.mustBeIn = SISet(SpanInterval(3,5), false, Interval(1,10));
+        boost::shared_ptr<Sentence> dia(new DiamondOp(con, &diaTQ));
+        d.addFormula(ELSentence(dia));
+        return d;
+    }
+
+    std::string writeSnapshot(const SnapshotWriter& writer) {
+        std::ostringstream out;
+        writer.write(out);
+        return out.str();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(domainSnapshot) {
+    Domain d = snapshotDomain();
+    SnapshotWriter writer;
+    writer.setDomain(d);
+    std::string data = writeSnapshot(writer);
+
+    Snapshot snapshot(data.data(), data.size());
+    BOOST_REQUIRE(snapshot.hasDomain());
+    BOOST_CHECK(snapshot.domain() == d);
+    BOOST_CHECK_EQUAL(snapshot.models_size(), 0);
+
+    // formulas can be decoded one at a time, in any order
+    std::vector<ELSentence> formulas(d.formulas_begin(), d.formulas_end());
+    BOOST_REQUIRE_EQUAL(snapshot.formulas_size(), formulas.size());
+    for (std::size_t i = formulas.size(); i-- > 0;) {
+        BOOST_CHECK(snapshot.formula(i) == formulas[i]);
+    }
+    BOOST_CHECK_THROW(snapshot.formula(formulas.size()), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(modelSnapshot) {
+    std::string facts("P(a) @ [1:10]\n"
+            "Q(A) @ [5:6]");
+    std::string formulas("1: [P(a) -> Q(a)]\n"
+            "[Q(a) -> P(a)]");
+    Domain d = loadDomainWithStreams(facts, formulas);
+    MCSat sat(&d);
+    FileLog::globalLogLevel() = LOG_ERROR;
+    sat.setNumSamples(4);
+    sat.setBurnInIterations(1);
+    sat.setWalksatIterations(10);
+    boost::mt19937 rng;
+    sat.run(rng);
+
+    SnapshotWriter writer;
+    writer.addModel(d.defaultModel());
+    writer.addModels(sat.begin(), sat.end());
+    BOOST_CHECK_EQUAL(writer.models_size(), 5);
+    std::string data = writeSnapshot(writer);
+
+    Snapshot snapshot(data.data(), data.size());
+    BOOST_CHECK(!snapshot.hasDomain());
+    BOOST_CHECK_THROW(snapshot.domain(), std::logic_error);
+    BOOST_REQUIRE_EQUAL(snapshot.models_size(), 5);
+    BOOST_CHECK(snapshot.model(3) == *(sat.begin()+2));
+    BOOST_CHECK(snapshot.model(0) == d.defaultModel());
+    std::vector<Model> models = snapshot.models();
+    BOOST_CHECK(std::equal(sat.begin(), sat.end(), models.begin()+1));
+
+    // and through a file
+    std::string filename("snapshotTest.snap");
+    writer.write(filename);
+    {
+        Snapshot mapped(filename);
+        BOOST_CHECK(mapped.models() == models);
+    }
+    std::remove(filename.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(badSnapshot) {
+    SnapshotWriter writer;
+    writer.setDomain(snapshotDomain());
+    std::string data = writeSnapshot(writer);
+
+    std::string badMagic(data);
+    badMagic[0] = 'X';
+    BOOST_CHECK_THROW(Snapshot(badMagic.data(), badMagic.size()), std::runtime_error);
+    std::string truncated(data, 0, data.size() - 8);
+    BOOST_CHECK_THROW(Snapshot(truncated.data(), truncated.size()), std::runtime_error);
+    BOOST_CHECK_THROW(Snapshot("noSuchSnapshot.snap"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(domainCache) {
+    std::vector<std::string> files;
+    files.push_back("domainCacheTest.txt");
+    {
+        std::ofstream out(files[0].c_str());
+        out << "P(a) @ [1:10]\n";
+    }
+    std::string key = DomainCache::makeKey(files, "unitProp=0");
+    BOOST_CHECK_EQUAL(key, DomainCache::makeKey(files, "unitProp=0"));
+    BOOST_CHECK_NE(key, DomainCache::makeKey(files, "unitProp=1"));
+    {
+        std::ofstream out(files[0].c_str(), std::ios::app);
+        out << "Q(a) @ [1:10]\n";
+    }
+    BOOST_CHECK_NE(key, DomainCache::makeKey(files, "unitProp=0"));
+    std::remove(files[0].c_str());
+    BOOST_CHECK_THROW(DomainCache::makeKey(files, ""), std::runtime_error);
+
+    DomainCache cache("");
+    Domain d = snapshotDomain();
+    Domain loaded;
+    BOOST_CHECK(!cache.load(key, loaded));
+    cache.store(key, d);
+    BOOST_REQUIRE(cache.load(key, loaded));
+    BOOST_CHECK(loaded == d);
+
+    // an entry that can't be read is a miss
+    {
+        std::ofstream out(cache.path(key).c_str(), std::ios::out | std::ios::trunc);
+        out << "garbage";
+    }
+    BOOST_CHECK(!cache.load(key, loaded));
+    std::remove(cache.path(key).c_str());
 }
@@ -12,6 +12,9 @@
 #include "../src/SpanInterval.h"
 #include "../src/Interval.h"
 #include "../src/SISet.h"
+#include "../src/SpanIntervalBlock.h"
+#include <boost/random/uniform_int.hpp>
+#include <climits>
 
 #include <boost/foreach.hpp>
 #include <iostream>
@@ -69,17 +72,175 @@ BOOST_AUTO_TEST_CASE( siset_test ) {
     set.add(sp1);
     BOOST_CHECK(set.isDisjoint());
     set.add(sp2);
-    BOOST_CHECK(!set.isDisjoint());
+    // sets are kept disjoint as they are built
+    BOOST_CHECK(set.isDisjoint());
+    BOOST_CHECK_EQUAL(set.size(), 59);
     set.makeDisjoint();
     BOOST_CHECK(set.isDisjoint());
 
 
-    // TODO turn this part into a test
-    //std::cout << "compliment of " << set.toString() << " is " << set.compliment().toString() << std::endl;
+    SISet compliment = set.compliment();
+    BOOST_CHECK(compliment.isDisjoint());
+    BOOST_CHECK_EQUAL(compliment.size(), 66 - 59);
+    BOOST_CHECK(intersection(set, compliment).size() == 0);
 
     SISet dcompliment = set.compliment().compliment();
-    dcompliment.makeDisjoint(); //
-    //std::cout << "double compliment is " << dcompliment.toString() << std::endl;
+    BOOST_CHECK_EQUAL(dcompliment.size(), set.size());
+    BOOST_CHECK(intersection(dcompliment, set).size() == set.size());
+}
+
+BOOST_AUTO_TEST_CASE( sisetComplimentTest ) {
+    SISet liq(true, Interval(1,20));
+    BOOST_CHECK_EQUAL(liq.compliment().toString(), "{[1:20]}");
+    liq.add(SpanInterval(3,5,3,5));
+    liq.add(SpanInterval(9,20,9,20));
+    BOOST_CHECK_EQUAL(liq.compliment().toString(), "{[1:2], [6:8]}");
+    BOOST_CHECK(liq.compliment().compliment() == liq);
+
+    // bands of starting points with the same uncovered finishing points
+    // should come out as a single spanning interval
+    SISet set(false, Interval(1,10));
+    set.add(SpanInterval(1,4,8,10));
+    set.add(SpanInterval(5,7,8,10));
+    BOOST_CHECK_EQUAL(set.compliment().toString(), "{[1:7], [8:10]}");
+    BOOST_CHECK_EQUAL(set.compliment().size() + set.size(), 55);
+}
+
+BOOST_AUTO_TEST_CASE( sisetCachedSizeTest ) {
+    SISet set(false, Interval(1,10));
+    BOOST_CHECK(set.empty());
+    BOOST_CHECK_EQUAL(set.size(), 0);
+    set.add(SpanInterval(1,10,1,10));
+    BOOST_CHECK(!set.empty());
+    BOOST_CHECK_EQUAL(set.size(), 55);
+    BOOST_CHECK(set.isDisjoint());
+
+    // each modifier must drop the cached values
+    set.subtract(SpanInterval(1,1,1,10));
+    BOOST_CHECK_EQUAL(set.size(), 45);
+    set.setMaxInterval(Interval(1,5));
+    BOOST_CHECK_EQUAL(set.size(), 10);
+    SISet other(false, Interval(1,5));
+    other.add(SpanInterval(1,1,1,5));
+    set.add(other);
+    BOOST_CHECK_EQUAL(set.size(), 15);
+    set.subtract(other);
+    BOOST_CHECK_EQUAL(set.size(), 10);
+    set.clear();
+    BOOST_CHECK(set.empty());
+    BOOST_CHECK_EQUAL(set.size(), 0);
+
+    SISet liq(false, Interval(1,10));
+    liq.add(SpanInterval(1,3,1,3));
+    liq.add(SpanInterval(3,5,3,5));
+    BOOST_CHECK_EQUAL(liq.size(), 6 + 6 - 1);
+    liq.setForceLiquid(true);
+    BOOST_CHECK_EQUAL(liq.liqSize(), 5);
+}
+
+BOOST_AUTO_TEST_CASE( sisetIndexTest ) {
+    SISet set(false, Interval(1,20));
+    set.add(SpanInterval(1,4,6,8));
+    set.add(SpanInterval(3,5,10,12));
+    set.add(SpanInterval(15,16,17,20));
+
+    BOOST_CHECK(set.contains(Interval(2,7)));
+    BOOST_CHECK(set.contains(Interval(4,11)));
+    BOOST_CHECK(!set.contains(Interval(2,9)));
+    BOOST_CHECK(!set.contains(Interval(6,11)));
+    BOOST_CHECK(set.contains(Interval(16,20)));
+
+    BOOST_CHECK(set.overlaps(SpanInterval(4,4,12,15)));
+    BOOST_CHECK(!set.overlaps(SpanInterval(6,14,6,14)));
+
+    std::vector<SpanInterval> stabbed = set.stab(9);
+    BOOST_REQUIRE_EQUAL(stabbed.size(), 1);
+    BOOST_CHECK_EQUAL(stabbed[0], SpanInterval(3,5,10,12));
+    BOOST_CHECK_EQUAL(set.stab(6).size(), 2);
+    BOOST_CHECK(set.stab(14).empty());
+
+    // the index has to be rebuilt after the set changes
+    set.subtract(SpanInterval(2,2,7,7));
+    BOOST_CHECK(!set.contains(Interval(2,7)));
+    BOOST_CHECK(set.contains(Interval(2,8)));
+
+    // filling the caches up front gives the same answers as filling them
+    // on demand, and a modifier still drops them
+    SISet filled = set;
+    filled.fillCaches();
+    BOOST_CHECK_EQUAL(filled.size(), set.size());
+    BOOST_CHECK_EQUAL(filled.isDisjoint(), set.isDisjoint());
+    BOOST_CHECK(filled.contains(Interval(2,8)));
+    BOOST_CHECK(filled.stab(9) == set.stab(9));
+    filled.subtract(SpanInterval(2,2,8,8));
+    BOOST_CHECK(!filled.contains(Interval(2,8)));
+
+    // compare against the subtraction-based checks on random sets
+    boost::mt19937 rng(7);
+    Interval maxInterval(0,30);
+    for (int i = 0; i < 50; i++) {
+        // randomSISet() only makes liquid sets, so build the others by hand
+        SISet random = SISet::randomSISet(true, maxInterval, rng);
+        if (i % 2 == 1) {
+            random.setForceLiquid(false);
+            boost::uniform_int<unsigned int> endpoint(0, 30);
+            for (int j = 0; j < 6; j++) {
+                unsigned int e[4] = {endpoint(rng), endpoint(rng), endpoint(rng), endpoint(rng)};
+                std::sort(e, e+4);
+                random.add(SpanInterval(e[0], e[2], e[1], e[3]));
+            }
+        }
+        for (unsigned int s = 0; s <= 30; s += 3) {
+            for (unsigned int f = s; f <= 30; f += 2) {
+                SISet only(false, maxInterval);
+                only.add(SpanInterval(s,s,f,f));
+                SISet rest = only;
+                rest.subtract(random);
+                BOOST_CHECK_EQUAL(random.contains(Interval(s,f)), rest.empty());
+                SpanInterval query(s, f, f, 30);
+                BOOST_CHECK_EQUAL(random.overlaps(query), !intersection(random, query).empty());
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( spanIntervalBlockTest ) {
+    boost::mt19937 rng(11);
+    // use both small endpoints and ones near UINT_MAX, where a signed
+    // comparison would go wrong
+    unsigned int bases[] = {0, UINT_MAX - 40};
+    for (int b = 0; b < 2; b++) {
+        boost::uniform_int<unsigned int> endpoint(bases[b], bases[b] + 40);
+        std::vector<SpanInterval> members;
+        for (int i = 0; i < 37; i++) {
+            unsigned int e[4] = {endpoint(rng), endpoint(rng), endpoint(rng), endpoint(rng)};
+            std::sort(e, e+4);
+            if (i % 3 == 0) members.push_back(SpanInterval(e[0], e[3], e[0], e[3]));
+            else members.push_back(SpanInterval(e[0], e[2], e[1], e[3]));
+        }
+        SpanIntervalBlock block(members.begin(), members.end());
+        BOOST_REQUIRE_EQUAL(block.size(), members.size());
+        BOOST_CHECK_EQUAL(block.at(5), members[5]);
+
+        for (int q = 0; q < 200; q++) {
+            unsigned int e[4] = {endpoint(rng), endpoint(rng), endpoint(rng), endpoint(rng)};
+            std::sort(e, e+4);
+            SpanInterval query(e[0], e[2], e[1], e[3]);
+            std::size_t first = q % 5;
+            std::size_t last = members.size() - (q % 7);
+
+            std::vector<SpanInterval> expected;
+            for (std::size_t i = first; i < last; i++) {
+                boost::optional<SpanInterval> intersect = intersection(query, members[i]);
+                if (intersect) expected.push_back(*intersect);
+            }
+            std::vector<SpanInterval> found;
+            block.intersect(query, first, last, found);
+            BOOST_CHECK(found == expected);
+            BOOST_CHECK_EQUAL(block.intersectsAny(query, first, last), !expected.empty());
+        }
+    }
+    BOOST_CHECK_THROW(SpanIntervalBlock().intersectsAny(SpanInterval(1,1,1,1), 0, 1), std::out_of_range);
 }
 
 BOOST_AUTO_TEST_CASE( hammingliq_dist_test) {
@@ -122,6 +283,37 @@ BOOST_AUTO_TEST_CASE( sisetliq_test ) {
     BOOST_CHECK(set.isDisjoint());
 }
 
+BOOST_AUTO_TEST_CASE( sisetCanonicalTest ) {
+    Interval maxInterval(0,20);
+    SISet a(true, maxInterval);
+    SISet b(true, maxInterval);
+
+    a.add(SpanInterval(1,3,1,3));
+    a.add(SpanInterval(8,9,8,9));
+    a.add(SpanInterval(4,6,4,6));
+    b.add(SpanInterval(8,9,8,9));
+    b.add(SpanInterval(2,6,2,6));
+    b.add(SpanInterval(1,1,1,1));
+    BOOST_CHECK_EQUAL(a.toString(), "{[1:6], [8:9]}");
+    BOOST_CHECK(a == b);
+
+    SISet c(true, maxInterval);
+    c.add(SpanInterval(5,12,5,12));
+    BOOST_CHECK_EQUAL(intersection(a, c).toString(), "{[5:6], [8:9]}");
+    a.add(c);
+    BOOST_CHECK_EQUAL(a.toString(), "{[1:12]}");
+    a.subtract(b);
+    BOOST_CHECK_EQUAL(a.toString(), "{[7:7], [10:12]}");
+
+    SISet d(false, maxInterval);
+    d.add(SpanInterval(1,5,3,9));
+    d.add(SpanInterval(2,8,6,12));
+    d.add(SpanInterval(1,5,3,9));
+    BOOST_CHECK(d.isDisjoint());
+    BOOST_CHECK_EQUAL(d.size(), SpanInterval(1,5,3,9).size() + SpanInterval(6,8,6,12).size()
+            + SpanInterval(2,5,10,12).size());
+}
+
 BOOST_AUTO_TEST_CASE( spanInterval_relations ) {
     Interval maxInterval(0, 1000);
     SpanInterval universe(maxInterval);
@@ -156,6 +156,90 @@ BOOST_AUTO_TEST_CASE( simpleLitToLiq) {
 
 }
 
+namespace {
+    std::string describe(const QUnitsFormulasPair& result) {
+        std::ostringstream str;
+        for (QCNFLiteralList::const_iterator it = result.first.begin(); it != result.first.end(); it++) {
+            str << "unit " << *it << "\n";
+        }
+        for (QCNFClauseList::const_iterator it = result.second.begin(); it != result.second.end(); it++) {
+            str << "clause " << *it << "\n";
+        }
+        return str.str();
+    }
+}
+
+BOOST_AUTO_TEST_CASE( indexedMatchesNaive ) {
+    std::vector<std::string> cases;
+    cases.push_back("P(a) @ [1:3]\n"
+            "!P(a) @ [8:11]\n"
+            "Q(a) @ [1:10]\n"
+            "P(a) v Q(a) v R(a) @ [1:20]");
+    cases.push_back("P(a) @ [1:3]\n"
+            "<>{d} P(a) v Q(a) @ [1:4]\n");
+    cases.push_back("P(a) @ [1:20]\n"
+            "[ P(a) ] v Q(a) @ [1:30]\n"
+            "[ !P(a) v R(a) ] @ [1:30]\n");
+    // a chain of units, each found by propagating the one before it
+    cases.push_back("!P(a) @ [1:10]\n"
+            "R(a) v S(a) @ [1:10]\n"
+            "P(a) v Q(a) @ [1:10]\n"
+            "!Q(a) v R(a) @ [1:5]\n"
+            "!R(a) v T(a) v P(a) @ [1:10]\n"
+            "S(a) v T(a) @ [1:10]\n"
+            "!Q(a) v U(a) @ [3:8]\n");
+
+    for (std::vector<std::string>::const_iterator it = cases.begin(); it != cases.end(); it++) {
+        Domain d = loadDomainWithStreams("video(a) @ [1:20]", *it);
+        std::vector<ELSentence> flist(d.formulas_begin(), d.formulas_end());
+        QCNFClauseList clauseList = convertToQCNFClauseList(flist);
+        BOOST_CHECK_EQUAL(describe(performUnitPropagation(clauseList)), describe(performNaiveUnitPropagation(clauseList)));
+    }
+}
+
+BOOST_AUTO_TEST_CASE( propagatorPushPop ) {
+    std::string facts = "P(a) @ [1:10]\n"
+            "!R(a) @ [1:5]\n";
+    std::string formulas = "inf: !P(a) v Q(a) @ [1:20]\n"
+            "1: Q(a) v S(a) @ [1:20]\n";
+    std::string pushed = "inf: !Q(a) v R(a) v T(a) @ [1:20]\n"
+            "inf: !T(a) v U(a) @ [1:20]\n";
+    Domain d = loadDomainWithStreams(facts, formulas);
+    Domain combined = loadDomainWithStreams(facts, formulas + pushed);
+    Domain pushedOnly = loadDomainWithStreams("", pushed);
+    std::vector<ELSentence> pushedForms(pushedOnly.formulas_begin(), pushedOnly.formulas_end());
+
+    UnitPropagator propagator(d);
+    std::string before = describe(propagator.result());
+    Domain beforeD = propagator.domain();
+    BOOST_CHECK(beforeD.defaultModel() == performUnitPropagation(d).defaultModel());
+
+    propagator.push(pushedForms);
+    BOOST_CHECK_EQUAL(propagator.depth(), 1);
+    // Q(a) and !R(a) give T(a), and so U(a)
+    Domain pushedD = propagator.domain();
+    Domain scratch = performUnitPropagation(combined);
+    BOOST_CHECK(pushedD.defaultModel() == scratch.defaultModel());
+    BOOST_CHECK_EQUAL(pushedD.formulas_size(), scratch.formulas_size());
+    Proposition u(static_cast<const Atom&>(*getAsSentence("U(a)")), true);
+    BOOST_CHECK(pushedD.hasFact(u));
+    BOOST_CHECK(!beforeD.hasFact(u));
+
+    propagator.pop();
+    BOOST_CHECK_EQUAL(propagator.depth(), 0);
+    BOOST_CHECK_EQUAL(describe(propagator.result()), before);
+    BOOST_CHECK(propagator.domain().defaultModel() == beforeD.defaultModel());
+    BOOST_CHECK_EQUAL(propagator.domain().formulas_size(), beforeD.formulas_size());
+    BOOST_CHECK_THROW(propagator.pop(), std::logic_error);
+
+    // a contradicting push leaves the propagator as it was
+    Domain contra = loadDomainWithStreams("", "inf: !P(a) @ [3:4]\n");
+    std::vector<ELSentence> contraForms(contra.formulas_begin(), contra.formulas_end());
+    BOOST_CHECK_THROW(propagator.push(contraForms), contradiction);
+    BOOST_CHECK_EQUAL(propagator.depth(), 0);
+    BOOST_CHECK_EQUAL(describe(propagator.result()), before);
+}
+
 BOOST_AUTO_TEST_CASE( cnfConvertBasic ) {
 
     boost::shared_ptr<Sentence> a = getAsSentence("P(a) v Q(a) v !R(a) v S(a)");
@@ -16,8 +16,13 @@
 #endif
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/uniform_int.hpp>
+#include <boost/throw_exception.hpp>
 #include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
 #include "../src/util/RNG.h"
+#include "../src/util/ThreadPool.h"
 
 BOOST_AUTO_TEST_CASE( rng ) {
     boost::mt19937 gen;
@@ -28,3 +33,63 @@ BOOST_AUTO_TEST_CASE( rng ) {
     BOOST_CHECK_EQUAL(gen(), 3890346734);
     BOOST_CHECK_EQUAL(rng(), 3586334585);
 }
+
+namespace {
+    struct SquareTask {
+        SquareTask(std::vector<unsigned long>& o, std::vector<unsigned int>& w) : out(o), workers(w) {}
+        void operator()(unsigned int worker, std::size_t i) const {
+            if (i == 1000) throw std::runtime_error("task 1000 failed");
+            out[i] = (unsigned long)i * i;
+            workers[i] = worker;
+        }
+        std::vector<unsigned long>& out;
+        std::vector<unsigned int>& workers;
+    };
+
+    struct TaskError : std::exception {
+        const char* what() const throw() {return "task error";}
+    };
+
+    // throws a different type depending on n
+    struct ThrowingTask {
+        explicit ThrowingTask(int n) : n(n) {}
+        void operator()(unsigned int /* worker */, std::size_t i) const {
+            if (i != 5) return;
+            if (n == 0) throw std::invalid_argument("bad argument");
+            if (n == 1) throw std::out_of_range("out of range");
+            boost::throw_exception(TaskError());
+        }
+        int n;
+    };
+}
+
+BOOST_AUTO_TEST_CASE( threadPool ) {
+    for (unsigned int threads = 1; threads <= 4; threads++) {
+        ThreadPool pool(threads);
+        BOOST_CHECK_EQUAL(pool.size(), threads);
+        for (int rep = 0; rep < 3; rep++) {
+            std::vector<unsigned long> out(1000, 0);
+            std::vector<unsigned int> workers(1000, 0);
+            pool.parallelFor(out.size(), SquareTask(out, workers));
+            for (std::size_t i = 0; i < out.size(); i++) {
+                BOOST_REQUIRE_EQUAL(out[i], (unsigned long)i * i);
+                BOOST_REQUIRE(workers[i] < threads);
+            }
+        }
+        std::vector<unsigned long> out(1001, 0);
+        std::vector<unsigned int> workers(1001, 0);
+        BOOST_CHECK_THROW(pool.parallelFor(out.size(), SquareTask(out, workers)), std::runtime_error);
+        pool.parallelFor(0, SquareTask(out, workers));
+
+        // errors come out of parallelFor() with the type they were thrown as
+        BOOST_CHECK_THROW(pool.parallelFor(10, ThrowingTask(0)), std::invalid_argument);
+        BOOST_CHECK_THROW(pool.parallelFor(10, ThrowingTask(1)), std::out_of_range);
+        BOOST_CHECK_THROW(pool.parallelFor(10, ThrowingTask(2)), TaskError);
+        try {
+            pool.parallelFor(10, ThrowingTask(0));
+        } catch (std::invalid_argument& e) {
+            BOOST_CHECK_EQUAL(std::string(e.what()), "bad argument");
+        }
+    }
+    BOOST_CHECK_THROW(ThreadPool(0), std::invalid_argument);
+}
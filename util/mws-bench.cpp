@@ -0,0 +1,93 @@
+/*
+ * mws-bench.cpp
+ *
+ *  Scaling benchmark for multi-start MaxWalkSat.  Runs the same set of
+ *  restarts (same seed) with an increasing number of threads and reports
+ *  the wall-clock time and speedup over one thread, checking that every
+ *  thread count finds the same model.
+ */
+#include <boost/program_options.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/thread.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/logic/Domain.h"
+#include "../src/logic/FOLParser.h"
+#include "../src/inference/MaxWalkSat.h"
+#include "../src/Log.h"
+
+namespace po = boost::program_options;
+
+int main(int argc, char* argv[]) {
+    po::options_description options("Allowed options");
+    options.add_options()
+            ("help", "this message")
+            ("facts-file", po::value<std::string>(), "facts file")
+            ("formula-file", po::value<std::string>(), "formula file")
+            ("restarts,r", po::value<unsigned int>()->default_value(32), "number of searches to run")
+            ("iterations,i", po::value<unsigned int>()->default_value(1000), "iterations per search")
+            ("prob,p", po::value<double>()->default_value(0.25), "probability of taking a random move")
+            ("max-threads", po::value<unsigned int>()->default_value(boost::thread::hardware_concurrency()),
+                    "largest number of threads to test")
+            ("seed", po::value<unsigned int>()->default_value(0), "rng seed");
+    po::positional_options_description positional;
+    positional.add("facts-file", 1);
+    positional.add("formula-file", 1);
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(options).positional(positional).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help") || !vm.count("facts-file") || !vm.count("formula-file")) {
+        std::cout << "Usage: mws-bench [OPTION]... FACT-FILE FORMULA-FILE" << std::endl;
+        std::cout << options << std::endl;
+        return EXIT_FAILURE;
+    }
+    unsigned int restarts = vm["restarts"].as<unsigned int>();
+    unsigned int maxThreads = std::max(1u, vm["max-threads"].as<unsigned int>());
+    unsigned int seed = vm["seed"].as<unsigned int>();
+    FileLog::globalLogLevel() = LOG_ERROR;
+
+    Domain d = FOLParse::loadDomainFromFiles(vm["facts-file"].as<std::string>(), vm["formula-file"].as<std::string>());
+    d = d.replaceInfForms();
+    MWSSolver solver(vm["iterations"].as<unsigned int>(), vm["prob"].as<double>(), &d);
+
+    std::vector<Model> initialModels;
+    {
+        boost::mt19937 rng(seed);
+        for (unsigned int i = 0; i < restarts; i++) initialModels.push_back(d.randomModel(rng));
+    }
+
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "time (s)"
+            << std::setw(10) << "speedup" << std::setw(12) << "best score" << std::endl;
+    // powers of two, then maxThreads itself
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int threads = 1; threads < maxThreads; threads *= 2) threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+
+    double serialTime = 0.0;
+    Model serialModel;
+    for (std::vector<unsigned int>::const_iterator it = threadCounts.begin(); it != threadCounts.end(); it++) {
+        unsigned int threads = *it;
+        solver.setNumThreads(threads);
+        boost::mt19937 rng(seed);
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+        Model best = solver.runBest(rng, initialModels);
+        double seconds = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1e6;
+        if (threads == 1) {
+            serialTime = seconds;
+            serialModel = best;
+        } else if (best != serialModel) {
+            std::cerr << "model found with " << threads << " threads differs from the serial one" << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << std::setw(8) << threads << std::setw(12) << seconds
+                << std::setw(10) << (seconds > 0 ? serialTime / seconds : 0.0)
+                << std::setw(12) << d.score(best) << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+/*
+ * siset-bench.cpp
+ *
+ *  Micro-benchmark for SISet::compliment().  Compares the sweep-based
+ *  compliment against the older algorithm (intersecting the compliments of
+ *  every member pairwise) on sets with a growing number of members.
+ */
+#include <boost/random.hpp>
+#include <boost/program_options.hpp>
+#include <boost/optional.hpp>
+#include <ctime>
+#include <cstdlib>
+#include <algorithm>
+#include <list>
+#include <iterator>
+#include <iomanip>
+#include <iostream>
+#include "../src/SISet.h"
+#include "../src/SpanInterval.h"
+
+namespace po = boost::program_options;
+
+namespace {
+    // the compliment algorithm SISet used before the sweep was introduced
+    SISet pairwiseCompliment(const SISet& set) {
+        Interval maxInterval = set.maxInterval();
+        if (set.size() == 0) {
+            return SISet(SpanInterval(maxInterval), set.forceLiquid(), maxInterval);
+        }
+        std::list<std::list<SpanInterval> > intersections;
+        for (SISet::const_iterator it = set.begin(); it != set.end(); it++) {
+            std::list<SpanInterval> compliment;
+            if (set.forceLiquid()) {
+                it->liqCompliment(SpanInterval(maxInterval), std::inserter(compliment, compliment.end()));
+            } else {
+                it->compliment(SpanInterval(maxInterval), std::inserter(compliment, compliment.end()));
+            }
+            intersections.push_back(compliment);
+        }
+        while (intersections.size() > 1) {
+            std::list<SpanInterval> first = intersections.front();
+            intersections.pop_front();
+            std::list<SpanInterval> second = intersections.front();
+            intersections.pop_front();
+            std::list<SpanInterval> intersected;
+            for (std::list<SpanInterval>::const_iterator lIt = first.begin(); lIt != first.end(); lIt++) {
+                for (std::list<SpanInterval>::const_iterator sIt = second.begin(); sIt != second.end(); sIt++) {
+                    boost::optional<SpanInterval> intersect = intersection(*lIt, *sIt);
+                    if (intersect) intersected.push_back(*intersect);
+                }
+            }
+            if (!intersected.empty()) intersections.push_front(intersected);
+        }
+        if (intersections.empty()) return SISet(set.forceLiquid(), maxInterval);
+        return SISet(intersections.front().begin(), intersections.front().end(), set.forceLiquid(), maxInterval);
+    }
+
+    // a set of (roughly) count short members spread over [0, 8*count]
+    SISet makeSet(bool liquid, unsigned int count, boost::mt19937& rng) {
+        Interval maxInterval(0, 8*count);
+        SISet set(liquid, maxInterval);
+        boost::uniform_int<unsigned int> startDist(0, maxInterval.finish());
+        boost::uniform_int<unsigned int> lengthDist(0, 4);
+        for (unsigned int i = 0; i < count; i++) {
+            unsigned int start = startDist(rng);
+            unsigned int end = std::min(start + lengthDist(rng), maxInterval.finish());
+            if (liquid) {
+                set.add(SpanInterval(start, end, start, end));
+            } else {
+                unsigned int finish = std::min(end + lengthDist(rng), maxInterval.finish());
+                set.add(SpanInterval(start, end, end, finish));
+            }
+        }
+        return set;
+    }
+
+    // average number of seconds one call to fn(set) takes over reps calls
+    template <class Fn>
+    double timeCompliment(Fn fn, const SISet& set, unsigned int reps, unsigned int& resultSize) {
+        std::clock_t begin = std::clock();
+        for (unsigned int i = 0; i < reps; i++) {
+            SISet result = fn(set);
+            resultSize = set.forceLiquid() ? result.liqSize() : result.size();
+        }
+        return (double)(std::clock() - begin) / CLOCKS_PER_SEC / reps;
+    }
+
+    SISet sweepCompliment(const SISet& set) {
+        return set.compliment();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    po::options_description options("Allowed options");
+    options.add_options()
+            ("help", "this message")
+            ("max-count", po::value<unsigned int>()->default_value(512), "largest number of members to test")
+            ("reps", po::value<unsigned int>()->default_value(20), "repetitions per measurement")
+            ("max-pairwise-time", po::value<double>()->default_value(2.0), "stop timing the pairwise algorithm once one call takes this many seconds")
+            ("seed", po::value<unsigned int>()->default_value(0), "rng seed");
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(options).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << "Usage: siset-bench [OPTION]..." << std::endl;
+        std::cout << options << std::endl;
+        return EXIT_FAILURE;
+    }
+    unsigned int maxCount = vm["max-count"].as<unsigned int>();
+    unsigned int reps = vm["reps"].as<unsigned int>();
+    double maxPairwiseTime = vm["max-pairwise-time"].as<double>();
+    boost::mt19937 rng(vm["seed"].as<unsigned int>());
+
+    for (int liquid = 1; liquid >= 0; liquid--) {
+        std::cout << (liquid ? "liquid" : "non-liquid") << " sets:" << std::endl;
+        std::cout << std::setw(8) << "members" << std::setw(14) << "sweep (s)"
+                << std::setw(14) << "pairwise (s)" << std::setw(10) << "speedup" << std::endl;
+        bool runPairwise = true;
+        for (unsigned int count = 4; count <= maxCount; count *= 2) {
+            SISet set = makeSet(liquid, count, rng);
+            unsigned int sweepSize = 0, pairwiseSize = 0;
+            double sweep = timeCompliment(sweepCompliment, set, reps, sweepSize);
+            std::cout << std::setw(8) << set.intervals().size() << std::setw(14) << sweep;
+            if (runPairwise) {
+                double pairwise = timeCompliment(pairwiseCompliment, set, 1, pairwiseSize);
+                if (pairwise < maxPairwiseTime) {
+                    pairwise = timeCompliment(pairwiseCompliment, set, reps, pairwiseSize);
+                } else {
+                    runPairwise = false;
+                }
+                std::cout << std::setw(14) << pairwise << std::setw(10) << (sweep > 0 ? pairwise / sweep : 0.0);
+                if (pairwiseSize != sweepSize) {
+                    std::cerr << "compliments differ in size: " << sweepSize << " vs " << pairwiseSize << std::endl;
+                    return EXIT_FAILURE;
+                }
+            }
+            std::cout << std::endl;
+        }
+    }
+    return EXIT_SUCCESS;
+}
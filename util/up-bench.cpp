@@ -0,0 +1,108 @@
+/*
+ * up-bench.cpp
+ *
+ *  Benchmark for unit propagation.  Rewrites every formula of a domain as a
+ *  hard PEL CNF clause, adds the facts as unit clauses, and times the
+ *  indexed propagation engine against the naive one, checking that both
+ *  give the same units and clauses.
+ */
+#include <boost/program_options.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/logic/Domain.h"
+#include "../src/logic/FOLParser.h"
+#include "../src/logic/Moves.h"
+#include "../src/logic/UnitProp.h"
+#include "../src/Log.h"
+
+namespace po = boost::program_options;
+
+namespace {
+    std::string describe(const QUnitsFormulasPair& result) {
+        std::ostringstream str;
+        for (QCNFLiteralList::const_iterator it = result.first.begin(); it != result.first.end(); it++) {
+            str << *it << "\n";
+        }
+        for (QCNFClauseList::const_iterator it = result.second.begin(); it != result.second.end(); it++) {
+            str << *it << "\n";
+        }
+        return str.str();
+    }
+
+    // run one engine repeat times, returning the average seconds per run
+    double timeEngine(QUnitsFormulasPair (*engine)(const QCNFClauseList&), const QCNFClauseList& clauses,
+            unsigned int repeat, QUnitsFormulasPair& result) {
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+        for (unsigned int i = 0; i < repeat; i++) result = engine(clauses);
+        return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1e6 / repeat;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    po::options_description options("Allowed options");
+    options.add_options()
+            ("help", "this message")
+            ("facts-file", po::value<std::string>(), "facts file")
+            ("formula-file", po::value<std::string>(), "formula file")
+            ("repeat,r", po::value<unsigned int>()->default_value(3), "number of times to run each engine");
+    po::positional_options_description positional;
+    positional.add("facts-file", 1);
+    positional.add("formula-file", 1);
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(options).positional(positional).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help") || !vm.count("facts-file") || !vm.count("formula-file")) {
+        std::cout << "Usage: up-bench [OPTION]... FACT-FILE FORMULA-FILE" << std::endl;
+        std::cout << options << std::endl;
+        return EXIT_FAILURE;
+    }
+    unsigned int repeat = std::max(1u, vm["repeat"].as<unsigned int>());
+    FileLog::globalLogLevel() = LOG_ERROR;
+
+    Domain d = FOLParse::loadDomainFromFiles(vm["facts-file"].as<std::string>(), vm["formula-file"].as<std::string>());
+
+    // treat every formula as hard, as MCSat::sampleSat() does
+    std::vector<ELSentence> hardForms;
+    std::vector<ELSentence> forms(d.formulas_begin(), d.formulas_end());
+    for (std::vector<ELSentence>::const_iterator it = forms.begin(); it != forms.end(); it++) {
+        std::vector<boost::shared_ptr<Sentence> > support;
+        support.push_back(convertToPELCNF(it->sentence(), support, d));
+        SISet where = (it->isQuantified() ? it->quantification() : SISet(d.maxSpanInterval(), false, d.maxInterval()));
+        for (std::vector<boost::shared_ptr<Sentence> >::const_iterator s = support.begin(); s != support.end(); s++) {
+            if (!isPELCNFLiteral(**s) && !isDisjunctionOfPELCNFLiterals(**s)) continue;
+            ELSentence hard(*s);
+            hard.setHasInfWeight(true);
+            hard.setQuantification(where);
+            hardForms.push_back(hard);
+        }
+    }
+    QCNFClauseList clauses = convertToQCNFClauseList(hardForms);
+    std::size_t numFormulas = clauses.size();
+    for (Domain::fact_const_iterator it = d.facts_begin(); it != d.facts_end(); it++) {
+        if (it->second.empty()) continue;
+        boost::shared_ptr<Sentence> lit(new Atom(it->first.atom()));
+        if (!it->first.sign()) lit.reset(new Negation(lit));
+        clauses.push_back(QCNFClause(CNFClause(1, lit), it->second));
+    }
+    std::cout << numFormulas << " clauses and " << clauses.size() - numFormulas << " facts" << std::endl;
+
+    QUnitsFormulasPair indexed, naive;
+    double indexedTime = timeEngine(&performUnitPropagation, clauses, repeat, indexed);
+    double naiveTime = timeEngine(&performNaiveUnitPropagation, clauses, repeat, naive);
+    if (describe(indexed) != describe(naive)) {
+        std::cerr << "the indexed and naive engines gave different results" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << indexed.first.size() << " units, " << indexed.second.size() << " clauses left" << std::endl;
+    std::cout << std::setw(10) << "engine" << std::setw(12) << "time (s)" << std::endl;
+    std::cout << std::setw(10) << "naive" << std::setw(12) << naiveTime << std::endl;
+    std::cout << std::setw(10) << "indexed" << std::setw(12) << indexedTime << std::endl;
+    std::cout << "speedup: " << (indexedTime > 0 ? naiveTime / indexedTime : 0.0) << std::endl;
+    return EXIT_SUCCESS;
+}
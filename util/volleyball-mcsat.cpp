@@ -37,18 +37,18 @@ int analyzeOutput(const std::string& filename) {
             tin >> solver;
         }
     }
-    std::cout << "number of samples: " << solver.numSamples() << std::endl;
+    std::cout << "number of samples: " << solver.samplesCounted() << std::endl;
+    std::cout << "number of chains: " << solver.numChains() << std::endl;
 
     boost::shared_ptr<Sentence> ballContactS = getAsSentence("BallContact(them)");
     Proposition ballContactProp(static_cast<const Atom&>(*ballContactS), true);
 
     std::cout << "counts:" << std::endl;
     Interval maxInterval = solver.domain()->maxInterval();
-    unsigned int counts[maxInterval.finish() - maxInterval.start() + 1];
+    std::vector<unsigned int> counts = solver.countMarginals(std::vector<Atom>(1, ballContactProp.atom()))[0];
 
     for (unsigned int j = maxInterval.start(); j <= maxInterval.finish(); j++) {
-        counts[j] = solver.countProps(ballContactProp, Interval(j,j));
-        std::cout << counts[j];
+        std::cout << counts[j - maxInterval.start()];
         if (j != maxInterval.finish()) std::cout << ", ";
     }
     std::cout << std::endl;
@@ -64,6 +64,11 @@ int main(int argc, char* argv[]) {
             ("disable-up", "disable unit propagation")
             ("analyze", po::value<std::string>(), "analyse previously-generated output")
             ("seed", po::value<unsigned int>(), "rng seed")
+            ("chains", po::value<unsigned int>()->default_value(1), "number of independent chains to sample with")
+            ("threads", po::value<unsigned int>()->default_value(1), "number of threads to run the chains on")
+            ("keep-samples", "store every sample in the output file (for debugging)")
+            ("precision", po::value<double>(), "stop sampling early once every query's standard error is at most this")
+            ("trace", po::value<std::string>(), "write convergence diagnostics to this file as sampling goes")
             ("name", po::value<std::string>(), "job name (used for file naming)");
     po::variables_map vm;
     po::store(po::command_line_parser(argc, argv).options(options).run(), vm);
@@ -371,7 +376,25 @@ int main(int argc, char* argv[]) {
     } else {
         mcSatSolver.setUseUnitPropagation(true);
     }
-    std::cout << "running mcSatSolver with " << mcSatSolver.burnInIterations() << " burn in iterations and a sample size of " << mcSatSolver.numSamples() << std::endl;
+    // only the BallContact(them) marginals are analyzed, so count those as
+    // we go rather than storing every sample
+    boost::shared_ptr<Sentence> ballContactS = getAsSentence("BallContact(them)");
+    mcSatSolver.addMarginalQuery(static_cast<const Atom&>(*ballContactS));
+    mcSatSolver.setKeepSamples(vm.count("keep-samples") != 0);
+    mcSatSolver.setNumChains(vm["chains"].as<unsigned int>());
+    mcSatSolver.setNumThreads(vm["threads"].as<unsigned int>());
+    if (vm.count("precision")) mcSatSolver.setTargetPrecision(vm["precision"].as<double>());
+    std::ofstream traceFile;
+    if (vm.count("trace")) {
+        traceFile.open(vm["trace"].as<std::string>().c_str());
+        if (!traceFile) {
+            std::cerr << "unable to open file " + vm["trace"].as<std::string>() + " for the trace." << std::endl;
+        } else {
+            mcSatSolver.setTraceStream(&traceFile);
+        }
+    }
+    std::cout << "running mcSatSolver with " << mcSatSolver.burnInIterations() << " burn in iterations and a sample size of " << mcSatSolver.numSamples()
+            << " over " << mcSatSolver.numChains() << " chain(s)" << std::endl;
     std::string prefix = (vm.count("name") ? vm["name"].as<std::string>() : "mcsat-volleyball");
     std::cout << "saving random seed..." << std::endl;
     {
@@ -394,6 +417,8 @@ int main(int argc, char* argv[]) {
     mcSatSolver.run(rng);
     std::clock_t end = std::clock();
     std::cout << "ran in " << (end - start)/CLOCKS_PER_SEC << " seconds." << std::endl;
+    std::cout << "kept " << mcSatSolver.diagnostics().samples << " samples; acceptance rate "
+            << mcSatSolver.diagnostics().acceptanceRate << std::endl;
     std::cout << "saving model file..." << std::endl;
     {
         std::string outFilename = prefix + "-model.dat.gz";